@@ -283,6 +283,25 @@ void L3GD20_DisableIT(uint8_t IntSel)
   GYRO_IO_Write(&tmpreg, L3GD20_CTRL_REG3_ADDR, 1);
 }
 
+/**
+  * @brief  Select the events routed to the INT2 pin (DRDY and FIFO).
+  * @param  Int2Config: combination of L3GD20_INT2_xxx sources, 0 for none
+  * @retval None
+  */
+void L3GD20_INT2InterruptConfig(uint8_t Int2Config)
+{
+  uint8_t tmpreg;
+  
+  /* Read CTRL_REG3 register */
+  GYRO_IO_Read(&tmpreg, L3GD20_CTRL_REG3_ADDR, 1);
+  
+  tmpreg &= ~L3GD20_INT2_MASK;
+  tmpreg |= (Int2Config & L3GD20_INT2_MASK);
+  
+  /* Write value to MEMS CTRL_REG3 register */
+  GYRO_IO_Write(&tmpreg, L3GD20_CTRL_REG3_ADDR, 1);
+}
+
 /**
   * @brief  Set High Pass Filter Modality
   * @param  FilterStruct: contains the configuration setting for the L3GD20.        
@@ -397,6 +416,68 @@ void L3GD20_ReadXYZAngRate(float *pfData)
   }
 }
 
+/**
+  * @brief  Configure the 32 sample angular rate FIFO.
+  * @param  FifoMode: L3GD20_FIFOMODE_BYPASS turns it off, any other
+  *         mode enables it. The FIFO goes through bypass first, so it
+  *         always starts empty.
+  * @param  Watermark: FIFO level that raises the WTM flag, 0 to 31
+  * @retval None
+  */
+void L3GD20_FifoConfig(uint8_t FifoMode, uint8_t Watermark)
+{
+  uint8_t tmpreg = L3GD20_FIFOMODE_BYPASS;
+  
+  /* Empty the FIFO */
+  GYRO_IO_Write(&tmpreg, L3GD20_FIFO_CTRL_REG_ADDR, 1);
+  
+  /* Read CTRL_REG5 register */
+  GYRO_IO_Read(&tmpreg, L3GD20_CTRL_REG5_ADDR, 1);
+  
+  tmpreg &= ~L3GD20_FIFO_ENABLE;
+  if(FifoMode != L3GD20_FIFOMODE_BYPASS)
+  {
+    tmpreg |= L3GD20_FIFO_ENABLE;
+  }
+  
+  /* Write value to MEMS CTRL_REG5 register */
+  GYRO_IO_Write(&tmpreg, L3GD20_CTRL_REG5_ADDR, 1);
+  
+  /* Write value to MEMS FIFO_CTRL_REG register */
+  tmpreg = FifoMode | (Watermark & L3GD20_FIFO_LEVEL_MASK);
+  GYRO_IO_Write(&tmpreg, L3GD20_FIFO_CTRL_REG_ADDR, 1);
+}
+
+/**
+  * @brief  Read the FIFO source register.
+  * @param  None
+  * @retval L3GD20_FIFO_xxx_FLAG bits and the stored level
+  *         (L3GD20_FIFO_LEVEL_MASK)
+  */
+uint8_t L3GD20_FifoStatus(void)
+{
+  uint8_t tmpreg;
+  
+  /* Read FIFO_SRC_REG register */
+  GYRO_IO_Read(&tmpreg, L3GD20_FIFO_SRC_REG_ADDR, 1);
+  
+  return tmpreg;
+}
+
+/**
+  * @brief  Start reading samples out of the FIFO in one DMA transfer.
+  * @note   With the FIFO enabled the address wraps from OUT_Z_H back to
+  *         OUT_X_L, so each 6 bytes are the next stored sample.
+  *         Completion is reported by the IO layer.
+  * @param  pBuffer: 6 bytes per sample, X, Y, Z as set in CTRL_REG4 (BLE)
+  * @param  Samples: samples to read, at most the FIFO level
+  * @retval 1 if the transfer started, 0 if the bus is busy
+  */
+uint8_t L3GD20_FifoRead_DMA(uint8_t *pBuffer, uint8_t Samples)
+{
+  return GYRO_IO_Read_DMA(pBuffer, L3GD20_OUT_X_L_ADDR, (uint16_t)Samples * 6);
+}
+
 /**
   * @}
   */ 
@@ -220,6 +220,36 @@
   * @}
   */
 
+/** @defgroup INT2_Interrupt_sources
+  * @{
+  */
+#define L3GD20_INT2_DRDY                   ((uint8_t)0x08)  /*!< I2_DRDY: data ready */
+#define L3GD20_INT2_WTM                    ((uint8_t)0x04)  /*!< I2_WTM: FIFO level at watermark */
+#define L3GD20_INT2_ORUN                   ((uint8_t)0x02)  /*!< I2_ORun: FIFO overrun */
+#define L3GD20_INT2_EMPTY                  ((uint8_t)0x01)  /*!< I2_Empty: FIFO empty */
+#define L3GD20_INT2_MASK                   ((uint8_t)0x0F)
+/**
+  * @}
+  */
+
+/** @defgroup FIFO_Configuration
+  * @{
+  */
+#define L3GD20_FIFO_ENABLE                 ((uint8_t)0x40)  /*!< FIFO_EN bit of CTRL_REG5 */
+#define L3GD20_FIFOMODE_BYPASS             ((uint8_t)0x00)  /*!< FIFO off, also empties it */
+#define L3GD20_FIFOMODE_FIFO               ((uint8_t)0x20)  /*!< Stops collecting when full */
+#define L3GD20_FIFOMODE_STREAM             ((uint8_t)0x40)  /*!< Oldest sample overwritten when full */
+#define L3GD20_FIFOMODE_STREAM_TO_FIFO     ((uint8_t)0x60)
+#define L3GD20_FIFOMODE_BYPASS_TO_STREAM   ((uint8_t)0x80)
+#define L3GD20_FIFO_WTM_FLAG               ((uint8_t)0x80)  /*!< FIFO_SRC_REG: level at or above watermark */
+#define L3GD20_FIFO_OVRN_FLAG              ((uint8_t)0x40)  /*!< FIFO_SRC_REG: FIFO full */
+#define L3GD20_FIFO_EMPTY_FLAG             ((uint8_t)0x20)  /*!< FIFO_SRC_REG: FIFO empty */
+#define L3GD20_FIFO_LEVEL_MASK             ((uint8_t)0x1F)  /*!< FIFO_SRC_REG: samples stored */
+#define L3GD20_FIFO_DEPTH                  32               /*!< XYZ samples */
+/**
+  * @}
+  */
+
 /** @defgroup INT1_Interrupt_ActiveEdge 
   * @{
   */   
@@ -283,6 +313,7 @@ void    L3GD20_RebootCmd(void);
 void    L3GD20_INT1InterruptConfig(uint16_t Int1Config);
 void    L3GD20_EnableIT(uint8_t IntSel);
 void    L3GD20_DisableIT(uint8_t IntSel);
+void    L3GD20_INT2InterruptConfig(uint8_t Int2Config);
 
 /* High Pass Filter Configuration Functions */
 void    L3GD20_FilterConfig(uint8_t FilterStruct);
@@ -290,11 +321,19 @@ void    L3GD20_FilterCmd(uint8_t HighPassFilterState);
 void    L3GD20_ReadXYZAngRate(float *pfData);
 uint8_t L3GD20_GetDataStatus(void);
 
+/* FIFO Functions */
+void    L3GD20_FifoConfig(uint8_t FifoMode, uint8_t Watermark);
+uint8_t L3GD20_FifoStatus(void);
+uint8_t L3GD20_FifoRead_DMA(uint8_t *pBuffer, uint8_t Samples);
+
 /* Gyroscope IO functions */
 void    GYRO_IO_Init(void);
 void    GYRO_IO_DeInit(void);
 void    GYRO_IO_Write(uint8_t *pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite);
 void    GYRO_IO_Read(uint8_t *pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+void    GYRO_IO_ITConfig(void);
+uint8_t GYRO_IO_Read_DMA(uint8_t *pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+void    GYRO_IO_ReadDone(void);
 
 /* Gyroscope driver structure */
 extern GYRO_DrvTypeDef L3gd20Drv;
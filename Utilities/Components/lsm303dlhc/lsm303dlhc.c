@@ -119,7 +119,7 @@ void LSM303DLHC_AccInit(uint16_t InitStruct)
   COMPASSACCELERO_IO_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG1_A, ctrl);
   
   /* Write value to ACC MEMS CTRL_REG4 register */
-  ctrl = (uint8_t) (InitStruct << 8);
+  ctrl = (uint8_t) (InitStruct >> 8);
   COMPASSACCELERO_IO_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG4_A, ctrl);
 }
 
@@ -220,21 +220,15 @@ void LSM303DLHC_AccReadXYZ(int16_t* pData)
 {
   int16_t pnRawData[3];
   uint8_t ctrlx[2]={0,0};
-  int8_t buffer[6];
+  uint8_t buffer[6];
   uint8_t i = 0;
   uint8_t sensitivity = LSM303DLHC_ACC_SENSITIVITY_2G;
   
-  /* Read the acceleration control register content */
-  ctrlx[0] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG4_A);
-  ctrlx[1] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG5_A);
+  /* Read CTRL_REG4_A and CTRL_REG5_A in one transfer */
+  COMPASSACCELERO_IO_ReadBuffer(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG4_A | LSM303DLHC_AUTO_INCREMENT, ctrlx, 2);
   
-  /* Read output register X, Y & Z acceleration */
-  buffer[0] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A); 
-  buffer[1] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_H_A);
-  buffer[2] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_OUT_Y_L_A);
-  buffer[3] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_OUT_Y_H_A);
-  buffer[4] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_OUT_Z_L_A);
-  buffer[5] = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_OUT_Z_H_A);
+  /* Read output register X, Y & Z acceleration in one transfer */
+  COMPASSACCELERO_IO_ReadBuffer(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A | LSM303DLHC_AUTO_INCREMENT, buffer, 6);
   
   /* Check in the control register4 the data alignment*/
   if(!(ctrlx[0] & LSM303DLHC_BLE_MSB)) 
@@ -559,6 +553,107 @@ void LSM303DLHC_AccZClickITConfig(void)
   LSM303DLHC_AccClickITEnable(LSM303DLHC_Z_SINGLE_CLICK);
 }
 
+/**
+  * @brief  Configure the 32 sample acceleration FIFO.
+  * @param  FifoMode: LSM303DLHC_FIFOMODE_BYPASS turns it off, any other
+  *         mode enables it. The FIFO goes through bypass first, so it
+  *         always starts empty.
+  * @param  Watermark: FIFO level that raises the WTM flag, 0 to 31
+  * @retval None
+  */
+void LSM303DLHC_AccFifoConfig(uint8_t FifoMode, uint8_t Watermark)
+{
+  uint8_t tmpreg;
+  
+  /* Empty the FIFO */
+  COMPASSACCELERO_IO_Write(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A, LSM303DLHC_FIFOMODE_BYPASS);
+  
+  /* Read CTRL_REG5 register */
+  tmpreg = COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG5_A);
+  
+  tmpreg &= ~LSM303DLHC_FIFO_ENABLE;
+  if(FifoMode != LSM303DLHC_FIFOMODE_BYPASS)
+  {
+    tmpreg |= LSM303DLHC_FIFO_ENABLE;
+  }
+  
+  /* Write value to MEMS CTRL_REG5 register */
+  COMPASSACCELERO_IO_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG5_A, tmpreg);
+  
+  /* Write value to MEMS FIFO_CTRL_REG_A register */
+  COMPASSACCELERO_IO_Write(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A,
+                           FifoMode | (Watermark & LSM303DLHC_FIFO_LEVEL_MASK));
+}
+
+/**
+  * @brief  Read the FIFO source register.
+  * @param  None
+  * @retval LSM303DLHC_FIFO_xxx_FLAG bits and the stored level
+  *         (LSM303DLHC_FIFO_LEVEL_MASK)
+  */
+uint8_t LSM303DLHC_AccFifoStatus(void)
+{
+  return COMPASSACCELERO_IO_Read(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_SRC_REG_A);
+}
+
+/**
+  * @brief  Start reading samples out of the FIFO in one DMA transfer.
+  * @note   With the FIFO enabled the sub-address wraps from OUT_Z_H_A back
+  *         to OUT_X_L_A, so each 6 bytes are the next stored sample.
+  *         Completion is reported by the IO layer.
+  * @param  pBuffer: 6 bytes per sample, X, Y, Z as set in CTRL_REG4_A (BLE)
+  * @param  Samples: samples to read, at most the FIFO level
+  * @retval 1 if the transfer started, 0 if the bus is busy
+  */
+uint8_t LSM303DLHC_AccFifoRead_DMA(uint8_t* pBuffer, uint8_t Samples)
+{
+  return COMPASSACCELERO_IO_Read_DMA(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A | LSM303DLHC_AUTO_INCREMENT,
+                                     pBuffer, (uint16_t)Samples * 6);
+}
+
+/**
+  * @brief  Set LSM303DLHC Magnetometer Initialization.
+  * @param  InitStruct: CRA_REG_M (temperature sensor, data rate) in bits 0-7,
+  *         CRB_REG_M (full scale) in bits 8-15 and MR_REG_M (working mode)
+  *         in bits 16-23
+  * @retval None
+  */
+void LSM303DLHC_MagInit(uint32_t InitStruct)
+{
+  COMPASSACCELERO_IO_Write(MAG_I2C_ADDRESS, LSM303DLHC_CRA_REG_M, (uint8_t) InitStruct);
+  COMPASSACCELERO_IO_Write(MAG_I2C_ADDRESS, LSM303DLHC_CRB_REG_M, (uint8_t) (InitStruct >> 8));
+  COMPASSACCELERO_IO_Write(MAG_I2C_ADDRESS, LSM303DLHC_MR_REG_M, (uint8_t) (InitStruct >> 16));
+}
+
+/**
+  * @brief  Read LSM303DLHC Magnetometer identification register A.
+  * @param  None
+  * @retval I_AM_LSM303DLHC_M when present
+  */
+uint8_t LSM303DLHC_MagReadID(void)
+{
+  return COMPASSACCELERO_IO_Read(MAG_I2C_ADDRESS, LSM303DLHC_IRA_REG_M);
+}
+
+/**
+  * @brief  Read X, Y, Z magnetic field raw counts in one transfer.
+  * @note   The Z axis is less sensitive, see LSM303DLHC_M_SENSITIVITY_Z_xx.
+  *         The address pointer of the magnetometer increments on its own.
+  * @param  pData: X, Y, Z counts
+  * @retval None
+  */
+void LSM303DLHC_MagReadXYZ(int16_t* pData)
+{
+  uint8_t buffer[6];
+  
+  COMPASSACCELERO_IO_ReadBuffer(MAG_I2C_ADDRESS, LSM303DLHC_OUT_X_H_M, buffer, 6);
+  
+  /* Output registers are X, Z, Y, high byte first */
+  pData[0] = (int16_t)(((uint16_t)buffer[0] << 8) + buffer[1]);
+  pData[1] = (int16_t)(((uint16_t)buffer[4] << 8) + buffer[5]);
+  pData[2] = (int16_t)(((uint16_t)buffer[2] << 8) + buffer[3]);
+}
+
 /**
   * @}
   */ 
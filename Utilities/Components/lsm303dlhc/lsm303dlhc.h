@@ -134,6 +134,7 @@
 /******************************************************************************/
 
 #define I_AM_LMS303DLHC                   ((uint8_t)0x33)
+#define I_AM_LSM303DLHC_M                 ((uint8_t)0x48)  /*!< IRA_REG_M content */
 
 /** @defgroup Acc_Power_Mode_selection
   * @{
@@ -301,6 +302,24 @@
 /**
   * @}
   */  
+
+/** @defgroup Acc_FIFO_Configuration_definition
+  * @{
+  */
+#define LSM303DLHC_FIFO_ENABLE             ((uint8_t)0x40)  /*!< FIFO_EN bit of CTRL_REG5_A */
+#define LSM303DLHC_FIFOMODE_BYPASS         ((uint8_t)0x00)  /*!< FIFO off, also empties it */
+#define LSM303DLHC_FIFOMODE_FIFO           ((uint8_t)0x40)  /*!< Stops collecting when full */
+#define LSM303DLHC_FIFOMODE_STREAM         ((uint8_t)0x80)  /*!< Oldest sample overwritten when full */
+#define LSM303DLHC_FIFOMODE_TRIGGER        ((uint8_t)0xC0)
+#define LSM303DLHC_FIFO_WTM_FLAG           ((uint8_t)0x80)  /*!< FIFO_SRC_REG_A: level above watermark */
+#define LSM303DLHC_FIFO_OVRN_FLAG          ((uint8_t)0x40)  /*!< FIFO_SRC_REG_A: FIFO full */
+#define LSM303DLHC_FIFO_EMPTY_FLAG         ((uint8_t)0x20)  /*!< FIFO_SRC_REG_A: FIFO empty */
+#define LSM303DLHC_FIFO_LEVEL_MASK         ((uint8_t)0x1F)  /*!< FIFO_SRC_REG_A: samples stored */
+#define LSM303DLHC_FIFO_DEPTH              32               /*!< XYZ samples */
+#define LSM303DLHC_AUTO_INCREMENT          ((uint8_t)0x80)  /*!< Sub-address MSB: multiple byte access */
+/**
+  * @}
+  */
  
 /** @defgroup Acc_Interrupt2_Configuration_definition
   * @{
@@ -463,12 +482,22 @@ void    LSM303DLHC_AccINT2InterruptDisable(uint8_t ITCombination, uint8_t ITAxes
 void    LSM303DLHC_AccClickITEnable(uint8_t ITClick);
 void    LSM303DLHC_AccClickITDisable(uint8_t ITClick);
 void    LSM303DLHC_AccZClickITConfig(void);
+void    LSM303DLHC_AccFifoConfig(uint8_t FifoMode, uint8_t Watermark);
+uint8_t LSM303DLHC_AccFifoStatus(void);
+uint8_t LSM303DLHC_AccFifoRead_DMA(uint8_t* pBuffer, uint8_t Samples);
+
+/* MAG functions */
+void    LSM303DLHC_MagInit(uint32_t InitStruct);
+uint8_t LSM303DLHC_MagReadID(void);
+void    LSM303DLHC_MagReadXYZ(int16_t* pData);
 
 /* COMPASS / ACCELERO IO functions */
 void    COMPASSACCELERO_IO_Init(void);
 void    COMPASSACCELERO_IO_ITConfig(void);
 void    COMPASSACCELERO_IO_Write(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t Value);
 uint8_t COMPASSACCELERO_IO_Read(uint16_t DeviceAddr, uint8_t RegisterAddr);
+void    COMPASSACCELERO_IO_ReadBuffer(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t* pBuffer, uint16_t NumByteToRead);
+uint8_t COMPASSACCELERO_IO_Read_DMA(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t* pBuffer, uint16_t NumByteToRead);
 
 /* ACC driver structure */
 extern ACCELERO_DrvTypeDef Lsm303dlhcDrv;
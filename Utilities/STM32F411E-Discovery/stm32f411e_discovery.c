@@ -3,13 +3,17 @@
 uint32_t I2cxTimeout = I2Cx_TIMEOUT_MAX;    /*<! Value of Timeout when I2C communication fails */
 uint32_t SpixTimeout = SPIx_TIMEOUT_MAX;    /*<! Value of Timeout when SPI communication fails */
 
-static I2C_HandleTypeDef I2cHandle;
-static SPI_HandleTypeDef SpiHandle;
+I2C_HandleTypeDef I2cHandle;
+static DMA_HandleTypeDef hdma_i2cx_rx;
+SPI_HandleTypeDef SpiHandle;
+static DMA_HandleTypeDef hdma_spix_rx;
+static DMA_HandleTypeDef hdma_spix_tx;
 
 /* I2Cx bus function */
 static void    I2Cx_Init(void);
 static void    I2Cx_WriteData(uint16_t Addr, uint8_t Reg, uint8_t Value);
 static uint8_t I2Cx_ReadData(uint16_t Addr, uint8_t Reg);
+static void    I2Cx_ReadBuffer(uint16_t Addr, uint8_t Reg, uint8_t *pBuffer, uint16_t Length);
 static void    I2Cx_Error (void);
 static void    I2Cx_MspInit(I2C_HandleTypeDef *hi2c);
 
@@ -23,6 +27,9 @@ static void    SPIx_MspInit(SPI_HandleTypeDef *hspi);
 void GYRO_IO_Init(void);
 void GYRO_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite);
 void GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+void GYRO_IO_ITConfig(void);
+uint8_t GYRO_IO_Read_DMA(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+void GYRO_IO_ReadDone(void);
 
 /* Link functions for AUDIO */
 void    AUDIO_IO_Init(void);
@@ -36,6 +43,8 @@ void    COMPASSACCELERO_IO_Init(void);
 void    COMPASSACCELERO_IO_ITConfig(void);
 void    COMPASSACCELERO_IO_Write(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t Value);
 uint8_t COMPASSACCELERO_IO_Read(uint16_t DeviceAddr, uint8_t RegisterAddr);
+void    COMPASSACCELERO_IO_ReadBuffer(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t *pBuffer, uint16_t NumByteToRead);
+uint8_t COMPASSACCELERO_IO_Read_DMA(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t *pBuffer, uint16_t NumByteToRead);
 
 
 
@@ -111,6 +120,27 @@ static uint8_t I2Cx_ReadData(uint16_t Addr, uint8_t Reg)
   return value;
 }
 
+/**
+  * @brief  Reads consecutive bytes of the device through BUS in one transfer.
+  * @param  Addr: Device address on BUS Bus.
+  * @param  Reg: The first register address, with the device auto-increment bit if it has one
+  * @param  pBuffer: Where the bytes are stored
+  * @param  Length: Number of bytes to read
+  */
+static void I2Cx_ReadBuffer(uint16_t Addr, uint8_t Reg, uint8_t *pBuffer, uint16_t Length)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+
+  status = HAL_I2C_Mem_Read(&I2cHandle, Addr, Reg, I2C_MEMADD_SIZE_8BIT, pBuffer, Length, I2cxTimeout);
+
+  /* Check the communication status */
+  if(status != HAL_OK)
+  {
+    /* Execute user timeout callback */
+    I2Cx_Error();
+  }
+}
+
 /**
   * @brief  I2Cx error treatment function.
   */
@@ -159,6 +189,25 @@ static void I2Cx_MspInit(I2C_HandleTypeDef *hi2c)
   /* Enable and set I2Cx Interrupt to the lowest priority */
   HAL_NVIC_SetPriority(DISCOVERY_I2Cx_ER_IRQn, 0x0F, 0);
   HAL_NVIC_EnableIRQ(DISCOVERY_I2Cx_ER_IRQn);
+
+  /* RX DMA for burst reads, peripheral to memory, byte wide */
+  DISCOVERY_I2Cx_DMA_CLK_ENABLE();
+  hdma_i2cx_rx.Instance                 = DISCOVERY_I2Cx_RX_DMA_STREAM;
+  hdma_i2cx_rx.Init.Channel             = DISCOVERY_I2Cx_RX_DMA_CHANNEL;
+  hdma_i2cx_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  hdma_i2cx_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdma_i2cx_rx.Init.MemInc              = DMA_MINC_ENABLE;
+  hdma_i2cx_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_i2cx_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdma_i2cx_rx.Init.Mode                = DMA_NORMAL;
+  hdma_i2cx_rx.Init.Priority            = DMA_PRIORITY_LOW;
+  hdma_i2cx_rx.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  HAL_DMA_DeInit(&hdma_i2cx_rx);
+  HAL_DMA_Init(&hdma_i2cx_rx);
+  __HAL_LINKDMA(hi2c, hdmarx, hdma_i2cx_rx);
+
+  HAL_NVIC_SetPriority(DISCOVERY_I2Cx_RX_DMA_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(DISCOVERY_I2Cx_RX_DMA_IRQn);
 }
 
 /******************************* SPI Routines**********************************/
@@ -248,6 +297,46 @@ static void SPIx_MspInit(SPI_HandleTypeDef *hspi)
   GPIO_InitStructure.Speed = GPIO_SPEED_MEDIUM;
   GPIO_InitStructure.Alternate = DISCOVERY_SPIx_AF;
   HAL_GPIO_Init(DISCOVERY_SPIx_GPIO_PORT, &GPIO_InitStructure);
+
+  /* RX and TX DMA for burst reads. A master read in full duplex also
+     clocks dummy bytes out, so both streams are needed. RX gets the
+     higher priority so the data register never overruns */
+  DISCOVERY_SPIx_DMA_CLK_ENABLE();
+  hdma_spix_rx.Instance                 = DISCOVERY_SPIx_RX_DMA_STREAM;
+  hdma_spix_rx.Init.Channel             = DISCOVERY_SPIx_RX_DMA_CHANNEL;
+  hdma_spix_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  hdma_spix_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdma_spix_rx.Init.MemInc              = DMA_MINC_ENABLE;
+  hdma_spix_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_spix_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdma_spix_rx.Init.Mode                = DMA_NORMAL;
+  hdma_spix_rx.Init.Priority            = DMA_PRIORITY_HIGH;
+  hdma_spix_rx.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  HAL_DMA_DeInit(&hdma_spix_rx);
+  HAL_DMA_Init(&hdma_spix_rx);
+  __HAL_LINKDMA(hspi, hdmarx, hdma_spix_rx);
+
+  hdma_spix_tx.Instance                 = DISCOVERY_SPIx_TX_DMA_STREAM;
+  hdma_spix_tx.Init.Channel             = DISCOVERY_SPIx_TX_DMA_CHANNEL;
+  hdma_spix_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  hdma_spix_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdma_spix_tx.Init.MemInc              = DMA_MINC_ENABLE;
+  hdma_spix_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_spix_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdma_spix_tx.Init.Mode                = DMA_NORMAL;
+  hdma_spix_tx.Init.Priority            = DMA_PRIORITY_LOW;
+  hdma_spix_tx.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  HAL_DMA_DeInit(&hdma_spix_tx);
+  HAL_DMA_Init(&hdma_spix_tx);
+  __HAL_LINKDMA(hspi, hdmatx, hdma_spix_tx);
+
+  /* Enable and set SPIx and DMA Interrupts to the lowest priority */
+  HAL_NVIC_SetPriority(DISCOVERY_SPIx_RX_DMA_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(DISCOVERY_SPIx_RX_DMA_IRQn);
+  HAL_NVIC_SetPriority(DISCOVERY_SPIx_TX_DMA_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(DISCOVERY_SPIx_TX_DMA_IRQn);
+  HAL_NVIC_SetPriority(DISCOVERY_SPIx_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(DISCOVERY_SPIx_IRQn);
 }
 
 /*******************************************************************************
@@ -355,6 +444,69 @@ void GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead)
   GYRO_CS_HIGH();
 }
 
+/**
+  * @brief  Configures the GYRO INT2 pin (data ready / FIFO) as interrupt.
+  */
+void GYRO_IO_ITConfig(void)
+{
+  GPIO_InitTypeDef GPIO_InitStructure;
+
+  /* Enable INT2 GPIO clock and configure the pin to detect interrupts */
+  GYRO_INT_GPIO_CLK_ENABLE();
+  GPIO_InitStructure.Pin = GYRO_INT2_PIN;
+  GPIO_InitStructure.Mode = GPIO_MODE_IT_RISING;
+  GPIO_InitStructure.Speed = GPIO_SPEED_FAST;
+  GPIO_InitStructure.Pull = GPIO_NOPULL;
+  HAL_GPIO_Init(GYRO_INT_GPIO_PORT, &GPIO_InitStructure);
+
+  /* Enable and set GYRO INT2 Interrupt to the lowest priority */
+  HAL_NVIC_SetPriority(GYRO_INT2_EXTI_IRQn, 0x0F, 0x00);
+  HAL_NVIC_EnableIRQ(GYRO_INT2_EXTI_IRQn);
+}
+
+/**
+  * @brief  Starts a DMA read of several registers of the GYRO.
+  *         The address byte goes out blocking (about 1.5 us), the data
+  *         bytes by DMA. Chip select stays low until GYRO_IO_ReadDone,
+  *         call it from HAL_SPI_RxCpltCallback and HAL_SPI_ErrorCallback.
+  * @param  pBuffer: Where the register values are stored, must outlive the transfer.
+  *         Its contents are clocked out as dummy bytes, the GYRO ignores them.
+  * @param  ReadAddr: GYRO's internal address to read from.
+  * @param  NumByteToRead: Number of bytes to read from the GYRO.
+  * @retval 1 if the transfer started, 0 if the bus is busy
+  */
+uint8_t GYRO_IO_Read_DMA(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead)
+{
+  if(HAL_SPI_GetState(&SpiHandle) != HAL_SPI_STATE_READY)
+  {
+    return 0;
+  }
+
+  ReadAddr |= (uint8_t)(READWRITE_CMD | MULTIPLEBYTE_CMD);
+
+  /* Set chip select Low at the start of the transmission */
+  GYRO_CS_LOW();
+
+  /* Send the Address of the indexed register */
+  SPIx_WriteRead(ReadAddr);
+
+  /* In 2 lines master mode the HAL sends pBuffer while receiving into it */
+  if(HAL_SPI_Receive_DMA(&SpiHandle, pBuffer, NumByteToRead) != HAL_OK)
+  {
+    GYRO_CS_HIGH();
+    return 0;
+  }
+  return 1;
+}
+
+/**
+  * @brief  Ends a GYRO_IO_Read_DMA transfer: Chip select High.
+  */
+void GYRO_IO_ReadDone(void)
+{
+  GYRO_CS_HIGH();
+}
+
 /********************************* LINK AUDIO *********************************/
 
 /**
@@ -486,3 +638,31 @@ uint8_t COMPASSACCELERO_IO_Read(uint16_t DeviceAddr, uint8_t RegisterAddr)
   /* Call I2Cx Read data bus function */
   return I2Cx_ReadData(DeviceAddr, RegisterAddr);
 }
+
+/**
+  * @brief  Reads several registers of the COMPASS / ACCELERO in one transfer.
+  * @param  DeviceAddr: the slave address to be programmed(ACC_I2C_ADDRESS or MAG_I2C_ADDRESS).
+  * @param  RegisterAddr: first register, with the auto-increment bit set
+  * @param  pBuffer: Where the register values are stored
+  * @param  NumByteToRead: Number of registers to read
+  */
+void COMPASSACCELERO_IO_ReadBuffer(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t *pBuffer, uint16_t NumByteToRead)
+{
+  I2Cx_ReadBuffer(DeviceAddr, RegisterAddr, pBuffer, NumByteToRead);
+}
+
+/**
+  * @brief  Starts a DMA read of several registers of the COMPASS / ACCELERO.
+  *         HAL_I2C_MemRxCpltCallback reports the end of the transfer and
+  *         HAL_I2C_ErrorCallback a failure, both from interrupt context.
+  * @param  DeviceAddr: the slave address to be programmed(ACC_I2C_ADDRESS or MAG_I2C_ADDRESS).
+  * @param  RegisterAddr: first register, with the auto-increment bit set
+  * @param  pBuffer: Where the register values are stored, must outlive the transfer
+  * @param  NumByteToRead: Number of registers to read
+  * @retval 1 if the transfer started, 0 if the bus is busy
+  */
+uint8_t COMPASSACCELERO_IO_Read_DMA(uint16_t DeviceAddr, uint8_t RegisterAddr, uint8_t *pBuffer, uint16_t NumByteToRead)
+{
+  return HAL_I2C_Mem_Read_DMA(&I2cHandle, DeviceAddr, RegisterAddr, I2C_MEMADD_SIZE_8BIT,
+                              pBuffer, NumByteToRead) == HAL_OK;
+}
@@ -1066,9 +1066,7 @@ static void PDMDecoder_Init(uint32_t AudioFreq, uint32_t ChnlNbrIn, uint32_t Chn
 {
   uint32_t index = 0;
 
-  /* Enable CRC peripheral to unlock the PDM library */
-  __HAL_RCC_CRC_CLK_ENABLE();
-
+  /* The in-tree PDM filter (src/pdm_filter.c) has no CRC lock */
   for(index = 0; index < ChnlNbrIn; index++)
   {
     /* Init PDM filters */
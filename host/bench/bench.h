@@ -0,0 +1,51 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "stm32f4xx_hal.h"
+
+/*
+ * Benchmark support. Durations are DWT->CYCCNT differences, that is host
+ * time stamp counter ticks in this build, and include the cost of the two
+ * counter reads (bench_overhead). They are for comparing versions of the
+ * code on one machine, not Cortex-M4 cycles.
+ */
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Median cost of an empty measurement */
+static inline uint32_t bench_overhead(void)
+{
+	uint32_t t[1001], start;
+
+	for(int i = 0; i < 1001; i++){
+		start = DWT->CYCCNT;
+		t[i]  = DWT->CYCCNT - start;
+	}
+	qsort(t, 1001, sizeof(t[0]), bench_cmp);
+	return t[500];
+}
+
+/**
+ * @brief prints p50/p99/p99.9/max of n durations (sorts them), divided by per
+ */
+static inline void bench_report(const char *name, uint32_t *t, uint32_t n, double per)
+{
+	double sum = 0;
+
+	qsort(t, n, sizeof(t[0]), bench_cmp);
+	for(uint32_t i = 0; i < n; i++){
+		sum += t[i];
+	}
+	printf("%-28s p50 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f  mean %8.1f\n", name,
+		   t[n / 2] / per, t[(uint32_t)(n * 0.99)] / per, t[(uint32_t)(n * 0.999)] / per,
+		   t[n - 1] / per, sum / n / per);
+}
+
+#endif /* BENCH_H_ */
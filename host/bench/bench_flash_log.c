@@ -0,0 +1,78 @@
+#include <string.h>
+#include "flash_log.h"
+#include "prof.h"
+#include "bench.h"
+
+/*
+ * BSP geometry (sectors 6 and 7, 2 x 128 KB), 20000 appends of 40 to
+ * 128 bytes. Flash time is the simulated program and erase time of the
+ * F411 (sim_flash_time_us), CPU time is host cycles of the log_append
+ * probe around flash_log_append, as BSP_LOG_Append takes it.
+ */
+
+#define APPENDS 	20000
+
+static CRC_HandleTypeDef hcrc;
+static flash_log_t 		 flog;
+static uint32_t 		 t[APPENDS];
+
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue)
+{
+	if(ReturnValue == 0xFFFFFFFFU){
+		flash_log_erase_done(&flog, 1);
+	}
+}
+
+int main(void)
+{
+	uint8_t  data[FLASH_LOG_RECORD_MAX];
+	uint32_t seed = 3, bytes = 0, start;
+	uint64_t program_us = 0, erase_us = 0, us;
+	uint16_t len;
+
+	sim_init();
+	prof_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+	memset(data, 0x5A, sizeof(data));
+	flash_log_mount(&flog, &hcrc, 0x08040000, FLASH_SECTOR_6, 2, 128 * 1024);
+
+	for(uint32_t i = 0; i < APPENDS; i++){
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		len = 40 + seed % 89;
+
+		//the erase is flash time the appends do not pay, counted apart
+		us = sim_flash_time_us();
+		flash_log_poll(&flog);
+		if(sim_flash_erase_pending()){
+			HAL_FLASH_IRQHandler();
+		}
+		erase_us += sim_flash_time_us() - us;
+
+		us 	  = sim_flash_time_us();
+		start = PROF_BEGIN();
+		flash_log_append(&flog, data, len);
+		t[i]  = DWT->CYCCNT - start;
+		PROF_END(PROF_LOG_APPEND, start);
+		program_us += sim_flash_time_us() - us;
+		bytes 	   += len;
+	}
+
+	printf("%lu appends, %.1f B mean, %lu erases, %lu lost\n", (unsigned long)flog.appends,
+		   (double)bytes / APPENDS, (unsigned long)flog.erases, (unsigned long)flog.lost);
+	printf("simulated flash time: %.0f us per append, %.0f appends/s programming only, "
+		   "%.0f appends/s with the erases\n",
+		   (double)program_us / APPENDS, APPENDS * 1e6 / program_us,
+		   APPENDS * 1e6 / (program_us + erase_us));
+	bench_report("append, host cycles", t, APPENDS, 1);
+
+	//mount of the full log, host cycles
+	for(int i = 0; i < 1000; i++){
+		start = DWT->CYCCNT;
+		flash_log_mount(&flog, &hcrc, 0x08040000, FLASH_SECTOR_6, 2, 128 * 1024);
+		t[i]  = DWT->CYCCNT - start;
+	}
+	bench_report("mount, host cycles", t, 1000, 1);
+	return 0;
+}
@@ -0,0 +1,188 @@
+#include <string.h>
+#include <time.h>
+#include "uart_rx.h"
+#include "adc_acq.h"
+#include "mk_dht11.h"
+#include "bench.h"
+
+/*
+ * The station's input side driven by a stimulus script (station.stim, or
+ * the file given as argument): the Wi-Fi line into uart_rx, ADC1 scans
+ * into adc_acq, DHT11 edges into the TIM2 capture, the user button. The
+ * interrupt callbacks are those of BSP, the loop does one pass of the
+ * sensor task per simulated ms, the worst case (on the board it sleeps
+ * until a sensor is due, or 10 ms while the DHT11 is reading):
+ *
+ *  - BSP_DHT11_Read: a read per second, advanced without blocking;
+ *  - the soil and temperature channels through adc_acq_get;
+ *  - the wifi task's reading of the ring, line by line;
+ *  - the button level.
+ *
+ * Reports loop passes per host second (script and interrupts included),
+ * the cost of a pass, the interrupt cost per received byte, per ADC
+ * block and per captured edge, and sensor read latency in simulated ms:
+ * DHT11 request to result, ADC step to the filtered value.
+ */
+
+#define RUN_MS 			10000
+#define SOIL_STEP_MS 	5000						// Soil step of station.stim
+#define SOIL_AFTER 		2600
+
+static USART_TypeDef 		usart2;
+static DMA_Stream_TypeDef 	stream_rx;
+static DMA_HandleTypeDef 	hdma_rx = { &stream_rx, NULL };
+static UART_HandleTypeDef 	huart2 = { .Instance = &usart2, .hdmarx = &hdma_rx };
+static ADC_HandleTypeDef 	hadc1 = { (void *)0x40012000, NULL };
+static TIM_TypeDef 			tim2;
+static TIM_HandleTypeDef 	htim2 = { &tim2, HAL_TIM_ACTIVE_CHANNEL_CLEARED };
+
+static uint8_t 		rx_buffer[256];
+static uart_rx_t 	wifi_rx;
+static adc_acq_t 	adc_acq;
+static dht11_t 		dht;
+static uint8_t 		res[2];
+static uint32_t 	pass[RUN_MS];
+
+static uint64_t 	uart_cycles, adc_cycles, capture_cycles;
+static uint32_t 	adc_blocks, edges;
+
+/* Interrupt callbacks, as in BSP */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	uart_rx_update(&wifi_rx);
+	uart_cycles += DWT->CYCCNT - t;
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	uart_rx_update(&wifi_rx);
+	uart_cycles += DWT->CYCCNT - t;
+}
+
+void sim_uart_irq(UART_HandleTypeDef *huart)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	uart_rx_irq_handler(&wifi_rx);
+	uart_cycles += DWT->CYCCNT - t;
+}
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	adc_acq_process(&adc_acq, &adc_acq.buffer[0], HAL_GetTick());
+	adc_cycles += DWT->CYCCNT - t;
+	adc_blocks++;
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	adc_acq_process(&adc_acq, &adc_acq.buffer[ADC_ACQ_HALF], HAL_GetTick());
+	adc_cycles += DWT->CYCCNT - t;
+	adc_blocks++;
+}
+
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	if(htim->Instance == &tim2){
+		dht11_capture_isr(&dht);
+	}
+	capture_cycles += DWT->CYCCNT - t;
+	edges++;
+}
+
+/* BSP_DHT11_Read */
+static uint8_t dht11_read(void)
+{
+	if(dht.state == DHT11_IDLE && HAL_GetTick() - dht.tick >= 1000){
+		dht11_request(&dht);
+	}
+	if(dht11_process(&dht) && dht.error == DHT11_OK){
+		res[0] = dht.temperature;
+		res[1] = dht.humidty;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char 	   *path = argc > 1 ? argv[1] : STATION_STIM;
+	const uint8_t  *data;
+	struct timespec t0, t1;
+	uint32_t 		start, requested = 0, reads = 0, dht_ms = 0, dht_max = 0, soil_ms = 0;
+	uint32_t 		lines = 0, read_bytes = 0, presses = 0, played = 0, temp = 0;
+	uint16_t 		span;
+	uint8_t 		button = 0, level;
+	double 			wall;
+
+	sim_init();
+	HAL_UART_Init(&huart2);
+	uart_rx_start(&wifi_rx, &huart2, rx_buffer, sizeof(rx_buffer));
+	adc_acq_start(&adc_acq, &hadc1);
+	init_dht11(&dht, &htim2, TIM_CHANNEL_1, GPIOA, GPIO_PIN_15, GPIO_AF1_TIM2);
+	sim_script_bind("wifi", &huart2);
+	sim_script_bind("adc1", &hadc1);
+	sim_script_bind("tim2", &htim2);
+	if(sim_script_load(path) < 0){
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(uint32_t ms = 0; ms < RUN_MS; ms++){
+		sim_set_tick(ms);
+		played += sim_script_run(ms);
+
+		start = DWT->CYCCNT;
+		if(dht.state == DHT11_IDLE && ms - dht.tick >= 1000){
+			requested = ms;
+		}
+		if(dht11_read()){
+			reads++;
+			dht_ms 	+= ms - requested;
+			dht_max  = ms - requested > dht_max ? ms - requested : dht_max;
+		}
+		temp += adc_acq_get(&adc_acq, 0);
+		if(soil_ms == 0 && ms >= SOIL_STEP_MS && adc_acq_get(&adc_acq, 1) >= SOIL_AFTER - 5){
+			soil_ms = ms - SOIL_STEP_MS;
+		}
+		while((span = uart_rx_peek(&wifi_rx, &data)) > 0){
+			for(uint16_t i = 0; i < span; i++){
+				lines += data[i] == '\n';
+			}
+			read_bytes += span;
+			uart_rx_consume(&wifi_rx, span);
+		}
+		level 	 = HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_0);
+		presses += level && !button;
+		button 	 = level;
+		pass[ms] = DWT->CYCCNT - start;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	printf("%s: %lu events played over %u simulated ms%s\n", path, (unsigned long)played, RUN_MS,
+		   sim_script_done() ? "" : ", some still pending");
+	printf("loop: %.0f passes per host second, script and interrupts included\n", RUN_MS / wall);
+	bench_report("loop pass, host cycles", pass, RUN_MS, 1);
+	printf("uart rx interrupts: %.1f host cycles per received byte (%lu bytes, %lu lines)\n",
+		   (double)uart_cycles / read_bytes, (unsigned long)read_bytes, (unsigned long)lines);
+	printf("adc interrupts: %.0f host cycles per block of %u scans (%lu blocks)\n",
+		   (double)adc_cycles / adc_blocks, ADC_ACQ_SCANS, (unsigned long)adc_blocks);
+	printf("capture interrupts: %.1f host cycles per edge (%lu edges)\n",
+		   (double)capture_cycles / edges, (unsigned long)edges);
+	printf("dht11: %lu reads of %u C / %u %%, request to result %.1f ms mean, %lu ms max (simulated)\n",
+		   (unsigned long)reads, res[0], res[1], reads ? (double)dht_ms / reads : 0.0, (unsigned long)dht_max);
+	printf("soil step: filtered value within 5 counts after %lu ms (simulated), %lu button presses\n",
+		   (unsigned long)soil_ms, (unsigned long)presses);
+	return temp == 0;
+}
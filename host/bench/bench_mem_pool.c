@@ -0,0 +1,125 @@
+#include "FreeRTOS.h"
+#include "mem_pool.h"
+#include "bench.h"
+
+/*
+ * Pools against heap_4 (built from Middlewares with the stand-ins in
+ * bench/freertos) on the same message mix: 70 % of 12-16 bytes, 20 % of
+ * 24-48 and 10 % of 100-128. A set of live blocks is kept full: every
+ * step frees a random one and allocates its replacement, 1M steps give
+ * 2M timed operations. Run for 40, 160 and 640 live blocks.
+ */
+
+#define STEPS 		1000000
+#define MAX_LIVE 	640
+
+volatile unsigned long bench_scheduler_suspended = 0;
+
+MEM_POOL_BUFFER(small_buffer, 16, MAX_LIVE);
+MEM_POOL_BUFFER(medium_buffer, 48, MAX_LIVE);
+MEM_POOL_BUFFER(large_buffer, 128, MAX_LIVE);
+
+static mem_pool_t pools[3];
+static void 	  *live[MAX_LIVE];
+static uint32_t   t_alloc[STEPS], t_free[STEPS];
+static uint16_t   sizes[STEPS];
+static uint16_t   slots[STEPS];
+
+static uint32_t bench_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static uint16_t message_size(uint32_t *seed)
+{
+	uint32_t r = bench_rand(seed) % 100;
+
+	if(r < 70){
+		return 12 + bench_rand(seed) % 5;
+	}
+	if(r < 90){
+		return 24 + bench_rand(seed) % 25;
+	}
+	return 100 + bench_rand(seed) % 29;
+}
+
+static void *heap_alloc(uint16_t size)
+{
+	return pvPortMalloc(size);
+}
+
+static void heap_free(void *block)
+{
+	vPortFree(block);
+}
+
+static void *pool_alloc(uint16_t size)
+{
+	return mem_pool_set_alloc(pools, 3, size);
+}
+
+static void pool_free(void *block)
+{
+	mem_pool_set_free(pools, 3, block);
+}
+
+/**
+ * @brief the same step sequence on one allocator
+ */
+static void run(const char *name, uint16_t count, void *(*alloc)(uint16_t), void (*release)(void *))
+{
+	uint32_t start, failed = 0;
+	char 	 label[40];
+
+	for(uint16_t i = 0; i < count; i++){
+		live[i] = alloc(sizes[i]);
+	}
+	for(uint32_t s = 0; s < STEPS; s++){
+		start 	   = DWT->CYCCNT;
+		release(live[slots[s]]);
+		t_free[s]  = DWT->CYCCNT - start;
+		start 	   = DWT->CYCCNT;
+		live[slots[s]] = alloc(sizes[s]);
+		t_alloc[s] = DWT->CYCCNT - start;
+		failed 	  += live[slots[s]] == NULL;
+	}
+	for(uint16_t i = 0; i < count; i++){
+		release(live[i]);
+	}
+	snprintf(label, sizeof(label), "%s %3u live alloc", name, count);
+	bench_report(label, t_alloc, STEPS, 1);
+	snprintf(label, sizeof(label), "%s %3u live free", name, count);
+	bench_report(label, t_free, STEPS, 1);
+	if(failed){
+		printf("  %lu allocations failed\n", (unsigned long)failed);
+	}
+}
+
+int main(void)
+{
+	static const uint16_t counts[] = {40, 160, 640};
+	uint32_t 			  seed = 1;
+
+	sim_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+	mem_pool_init(&pools[0], small_buffer, 16, MAX_LIVE);
+	mem_pool_init(&pools[1], medium_buffer, 48, MAX_LIVE);
+	mem_pool_init(&pools[2], large_buffer, 128, MAX_LIVE);
+
+	for(unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); c++){
+		for(uint32_t s = 0; s < STEPS; s++){
+			sizes[s] = message_size(&seed);
+			slots[s] = bench_rand(&seed) % counts[c];
+		}
+		run("heap_4", counts[c], heap_alloc, heap_free);
+		run("pools ", counts[c], pool_alloc, pool_free);
+	}
+	printf("heap_4 free bytes after the runs %lu of %lu\n", (unsigned long)xPortGetFreeHeapSize(),
+		   (unsigned long)configTOTAL_HEAP_SIZE);
+	return 0;
+}
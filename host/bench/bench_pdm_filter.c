@@ -0,0 +1,58 @@
+#include "pdm2pcm_glo.h"
+#include "prof.h"
+#include "bench.h"
+#include "../test/pdm_source.h"
+
+/* BSP configuration: 1 ms blocks of 16 samples, D = 64 */
+#define BLOCK 		16
+#define BLOCKS 		20000
+
+static uint8_t 	pdm[BLOCKS][BLOCK * 64 / 8];
+static int16_t 	pcm[BLOCK];
+static uint32_t t[BLOCKS];
+
+int main(void)
+{
+	static const struct{ uint16_t code; uint32_t d; } dec[] = {
+		{PDM_FILTER_DEC_FACTOR_16, 16}, {PDM_FILTER_DEC_FACTOR_32, 32},
+		{PDM_FILTER_DEC_FACTOR_64, 64},
+	};
+	PDM_Filter_Handler_t handler = {0};
+	PDM_Filter_Config_t  config  = {0};
+	struct pdm_source 	 src;
+	char 				 name[32];
+	uint32_t 			 start;
+
+	sim_init();
+	prof_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+
+	for(unsigned i = 0; i < sizeof(dec) / sizeof(dec[0]); i++){
+		handler.bit_order 		 = PDM_FILTER_BIT_ORDER_LSB;
+		handler.endianness 		 = PDM_FILTER_ENDIANNESS_BE;
+		handler.high_pass_tap 	 = 2122358088;
+		handler.in_ptr_channels  = 1;
+		handler.out_ptr_channels = 1;
+		config.decimation_factor 	 = dec[i].code;
+		config.output_samples_number = BLOCK;
+		PDM_Filter_Init(&handler);
+		PDM_Filter_setConfig(&handler, &config);
+
+		pdm_source_init(&src, 16000.0 * dec[i].d);
+		for(int b = 0; b < BLOCKS; b++){
+			pdm_source_sine(&src, pdm[b], BLOCK * dec[i].d / 8, 1000, 0.5, 0);
+		}
+		prof_reset();
+		for(int b = 0; b < BLOCKS; b++){
+			start = PROF_BEGIN();
+			PDM_Filter(pdm[b], pcm, &handler);
+			t[b] = DWT->CYCCNT - start;
+			PROF_END(PROF_MIC_BLOCK, start);
+		}
+		snprintf(name, sizeof(name), "D=%lu per sample", (unsigned long)dec[i].d);
+		bench_report(name, t, BLOCKS, BLOCK);
+		printf("%-28s mean %8.1f\n", "  mic_block probe, per block",
+			   (double)prof_get(PROF_MIC_BLOCK)->total / prof_get(PROF_MIC_BLOCK)->count);
+	}
+	return 0;
+}
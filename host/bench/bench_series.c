@@ -0,0 +1,84 @@
+#include <string.h>
+#include "series.h"
+#include "telemetry.h"
+#include "bench.h"
+#include "../test/series_trace.h"
+
+/*
+ * 100000 samples of every synthetic trace (test/series_trace.h):
+ * compressed size against 8 raw bytes per sample (tick and float) and
+ * against telemetry frames of the same samples, whole blocks and frames
+ * counted. Encode cost is host cycles per series_add.
+ */
+
+#define SAMPLES 	100000
+
+static CRC_HandleTypeDef hcrc;
+static uint32_t 		 t[SAMPLES];
+
+//bytes of the blocks holding the trace, each add timed
+static uint32_t series_bytes(enum series_trace_kind kind, uint8_t decimals)
+{
+	static series_t 	se;
+	struct series_trace tr;
+	const uint8_t 		*block;
+	uint32_t 			tick, start, bytes = 0;
+	float 				value;
+	uint8_t 			ok;
+
+	series_trace_init(&tr, kind, 0);
+	series_init(&se, kind, decimals);
+	for(uint32_t i = 0; i < SAMPLES; i++){
+		series_trace_next(&tr, &tick, &value);
+		start = DWT->CYCCNT;
+		ok 	  = series_add(&se, tick, value);
+		t[i]  = DWT->CYCCNT - start;
+		if(!ok){
+			bytes += series_finish(&se, &block);
+			series_add(&se, tick, value);
+		}
+	}
+	return bytes + series_finish(&se, &block);
+}
+
+//bytes of the telemetry frames holding the trace, one sensor
+static uint32_t telemetry_bytes(enum series_trace_kind kind)
+{
+	static telemetry_t 	tm;
+	struct series_trace tr;
+	const uint8_t 		*frame;
+	uint32_t 			tick, bytes = 0;
+	float 				value;
+
+	series_trace_init(&tr, kind, 0);
+	telemetry_init(&tm, &hcrc);
+	for(uint32_t i = 0; i < SAMPLES; i++){
+		series_trace_next(&tr, &tick, &value);
+		if(!telemetry_add(&tm, kind, tick, value)){
+			bytes += telemetry_finish(&tm, &frame);
+			telemetry_add(&tm, kind, tick, value);
+		}
+	}
+	return bytes + telemetry_finish(&tm, &frame);
+}
+
+int main(void)
+{
+	uint32_t bytes, frames;
+
+	sim_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+	for(int k = 0; k < TRACE_KINDS; k++){
+		frames = telemetry_bytes(k);
+		bytes  = series_bytes(k, series_trace_decimals[k]);
+		printf("%-26s scaled %5.2f bits/sample, %5.1fx vs raw, %5.1fx vs telemetry frames\n",
+			   series_trace_name[k], bytes * 8.0 / SAMPLES, 8.0 * SAMPLES / bytes, (double)frames / bytes);
+		bench_report("  add, scaled", t, SAMPLES, 1);
+
+		bytes = series_bytes(k, SERIES_FLOAT);
+		printf("%-26s float  %5.2f bits/sample, %5.1fx vs raw, %5.1fx vs telemetry frames\n",
+			   series_trace_name[k], bytes * 8.0 / SAMPLES, 8.0 * SAMPLES / bytes, (double)frames / bytes);
+		bench_report("  add, float", t, SAMPLES, 1);
+	}
+	return 0;
+}
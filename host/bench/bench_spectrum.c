@@ -0,0 +1,54 @@
+#include <math.h>
+#include "spectrum.h"
+#include "bench.h"
+
+#define RUNS 		2000
+
+static int16_t 	frame[SPECTRUM_MAX_N];
+static int16_t 	work[SPECTRUM_MAX_N] __attribute__((aligned(4)));
+static uint16_t mag[SPECTRUM_MAX_N / 2];
+static uint32_t t[RUNS];
+
+int main(void)
+{
+	spectrum_t 	sp;
+	char 		name[32];
+	uint32_t 	start;
+	float 		sink = 0;
+
+	sim_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+
+	for(uint16_t n = SPECTRUM_MIN_N; n <= SPECTRUM_MAX_N; n *= 2){
+		spectrum_init(&sp, n, frame, work);
+		for(uint16_t i = 0; i < n; i++){
+			frame[i] = (int16_t)lrint(300 * sin(2 * M_PI * 37.3 * i / n) + 20 * sin(i * 1.7));
+		}
+
+		//as the sensor task runs it: transform, then the bands
+		for(int r = 0; r < RUNS; r++){
+			start = DWT->CYCCNT;
+			spectrum_transform(&sp, frame, 1);
+			t[r] = DWT->CYCCNT - start;
+		}
+		snprintf(name, sizeof(name), "transform n=%u", n);
+		bench_report(name, t, RUNS, 1);
+
+		for(int r = 0; r < RUNS; r++){
+			start = DWT->CYCCNT;
+			sink += spectrum_band(&sp, 1, n / 2);
+			t[r] = DWT->CYCCNT - start;
+		}
+		snprintf(name, sizeof(name), "band (all bins) n=%u", n);
+		bench_report(name, t, RUNS, 1);
+
+		for(int r = 0; r < RUNS; r++){
+			start = DWT->CYCCNT;
+			spectrum_magnitude(&sp, mag);
+			t[r] = DWT->CYCCNT - start;
+		}
+		snprintf(name, sizeof(name), "magnitude n=%u", n);
+		bench_report(name, t, RUNS, 1);
+	}
+	return sink < 0;
+}
@@ -0,0 +1,264 @@
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "spsc.h"
+#include "bench.h"
+
+/*
+ * spsc against a copy queue of the xQueueSendFromISR / xQueueReceive kind:
+ * a mutex stands for the critical section, a condition variable for the
+ * blocked receiver, one 16-byte item per call on both sides.
+ *
+ * Threaded: a producer thread (the interrupt) sends ITEMS stamped records
+ * as fast as the channel takes them and yields when it is full; a consumer
+ * thread (the task) drains and blocks when empty, on a semaphore given by
+ * the spsc notify callback. Throughput is wall clock, latency host cycles
+ * from the stamp to the read.
+ * On the target the producer is an interrupt, which the task never runs
+ * inside, so spsc_write sees the channel state atomically. Threads do
+ * interleave: the consumer can empty the channel while a write is under
+ * way and the notify is skipped, so the consumer waits with a 1 ms timeout
+ * and the wakes that found items that way are counted.
+ *
+ * Single thread: push and pop of the same items, no contention, the cost
+ * of the channel code alone.
+ */
+
+#define ITEMS 		2000000
+#define SIZE 		256				// Items per channel
+#define RUNS 		100000
+
+struct record{
+	uint64_t stamp;
+	uint32_t seq;
+	uint32_t value;
+};
+
+/* Copy queue, xQueueSendFromISR / xQueueReceive */
+struct lock_queue{
+	pthread_mutex_t lock;
+	pthread_cond_t  ready;
+	uint8_t 		waiting;
+	uint32_t 		head, tail;
+	struct record 	items[SIZE];
+};
+
+static spsc_t 			 ch;
+static struct record 	 ch_buffer[SIZE];
+static uint8_t 			 byte_buffer[SIZE];
+static struct lock_queue lq;
+static sem_t 			 wake;
+static uint32_t 		 latency[ITEMS];
+static uint32_t 		 batch, late_wakes, bad_seq;
+static uint32_t 		 t[RUNS];
+
+static uint8_t lq_send(struct lock_queue *q, const struct record *r)
+{
+	pthread_mutex_lock(&q->lock);
+	if(q->head - q->tail == SIZE){
+		pthread_mutex_unlock(&q->lock);
+		return 0;
+	}
+	q->items[q->head++ % SIZE] = *r;
+	if(q->waiting){
+		q->waiting = 0;
+		pthread_cond_signal(&q->ready);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return 1;
+}
+
+static void lq_receive(struct lock_queue *q, struct record *r)
+{
+	pthread_mutex_lock(&q->lock);
+	while(q->head == q->tail){
+		q->waiting = 1;
+		pthread_cond_wait(&q->ready, &q->lock);
+	}
+	*r = q->items[q->tail++ % SIZE];
+	pthread_mutex_unlock(&q->lock);
+}
+
+//non-blocking receive for the single thread runs
+static uint8_t lq_try_receive(struct lock_queue *q, struct record *r)
+{
+	uint8_t ok;
+
+	pthread_mutex_lock(&q->lock);
+	ok = q->head != q->tail;
+	if(ok){
+		*r = q->items[q->tail++ % SIZE];
+	}
+	pthread_mutex_unlock(&q->lock);
+	return ok;
+}
+
+static void notify(void *ctx)
+{
+	sem_post(&wake);
+}
+
+static void *spsc_producer(void *arg)
+{
+	struct record r[16];
+	uint32_t 	  sent = 0, n, done;
+
+	while(sent < ITEMS){
+		n = ITEMS - sent < batch ? ITEMS - sent : batch;
+		for(uint32_t i = 0; i < n; i++){
+			r[i].seq   = sent + i;
+			r[i].stamp = sim_cycles();
+		}
+		//a full channel refuses the rest, as in the interrupt
+		while((done = spsc_write(&ch, r, n)) == 0){
+			sched_yield();
+		}
+		sent += done;
+		//the refused ones go again, after the consumer ran
+		if(done < n){
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void *spsc_consumer(void *arg)
+{
+	struct record 	r[16];
+	struct timespec until;
+	uint32_t 		got = 0, n;
+
+	while(got < ITEMS){
+		while((n = spsc_read(&ch, r, 16)) > 0){
+			for(uint32_t i = 0; i < n; i++){
+				bad_seq += r[i].seq != got;
+				latency[got++] = sim_cycles() - r[i].stamp;
+			}
+		}
+		if(got == ITEMS){
+			break;
+		}
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_nsec += 1000000;
+		if(until.tv_nsec >= 1000000000){
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+		if(sem_timedwait(&wake, &until) != 0 && errno == ETIMEDOUT && spsc_count(&ch) > 0){
+			late_wakes++;
+		}
+	}
+	return NULL;
+}
+
+static void *lq_producer(void *arg)
+{
+	struct record r;
+
+	for(uint32_t sent = 0; sent < ITEMS; sent++){
+		r.seq 	= sent;
+		r.stamp = sim_cycles();
+		while(!lq_send(&lq, &r)){
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void *lq_consumer(void *arg)
+{
+	struct record r;
+
+	for(uint32_t got = 0; got < ITEMS; got++){
+		lq_receive(&lq, &r);
+		bad_seq 	+= r.seq != got;
+		latency[got] = sim_cycles() - r.stamp;
+	}
+	return NULL;
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief one threaded run, throughput and latency
+ */
+static void threaded(const char *name, void *(*producer)(void *), void *(*consumer)(void *))
+{
+	pthread_t p, c;
+	double 	  start;
+	char 	  label[40];
+
+	bad_seq = late_wakes = 0;
+	start 	= seconds();
+	pthread_create(&c, NULL, consumer, NULL);
+	pthread_create(&p, NULL, producer, NULL);
+	pthread_join(p, NULL);
+	pthread_join(c, NULL);
+	printf("%-14s %6.2f Mitems/s, %lu out of order, %lu late wakes\n", name, ITEMS / (seconds() - start) / 1e6,
+		   (unsigned long)bad_seq, (unsigned long)late_wakes);
+	snprintf(label, sizeof(label), "  latency");
+	bench_report(label, latency, ITEMS, 1);
+}
+
+/**
+ * @brief uncontended write and read of n items of size bytes, per item
+ */
+static void single(const char *name, uint16_t size, uint16_t n)
+{
+	uint8_t  data[16 * 64];
+	uint32_t start;
+
+	spsc_init(&ch, size == 1 ? (void *)byte_buffer : (void *)ch_buffer, size, SIZE);
+	memset(data, 0x5A, sizeof(data));
+	for(uint32_t i = 0; i < RUNS; i++){
+		start = DWT->CYCCNT;
+		spsc_write(&ch, data, n);
+		spsc_read(&ch, data, n);
+		t[i]  = DWT->CYCCNT - start;
+	}
+	bench_report(name, t, RUNS, n);
+}
+
+int main(void)
+{
+	struct record r = {0};
+	uint32_t 	  start;
+
+	sim_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+
+	//single thread, cycles per item
+	single("spsc 16 B x1 write+read", sizeof(struct record), 1);
+	single("spsc 16 B x16 write+read", sizeof(struct record), 16);
+	single("spsc 1 B x64 write+read", 1, 64);
+	pthread_mutex_init(&lq.lock, NULL);
+	pthread_cond_init(&lq.ready, NULL);
+	for(uint32_t i = 0; i < RUNS; i++){
+		start = DWT->CYCCNT;
+		lq_send(&lq, &r);
+		lq_try_receive(&lq, &r);
+		t[i]  = DWT->CYCCNT - start;
+	}
+	bench_report("queue 16 B send+receive", t, RUNS, 1);
+
+	//threads
+	sem_init(&wake, 0, 0);
+	spsc_init(&ch, ch_buffer, sizeof(struct record), SIZE);
+	spsc_set_notify(&ch, notify, NULL);
+	batch = 1;
+	threaded("spsc batch 1", spsc_producer, spsc_consumer);
+	batch = 16;
+	threaded("spsc batch 16", spsc_producer, spsc_consumer);
+	lq.head = lq.tail = 0;
+	threaded("queue", lq_producer, lq_consumer);
+	return 0;
+}
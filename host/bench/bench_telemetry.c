@@ -0,0 +1,139 @@
+#include <string.h>
+#include <math.h>
+#include "telemetry.h"
+#include "telemetry_decode.h"
+#include "bench.h"
+#include "../test/series_trace.h"
+
+/*
+ * Telemetry frames against a text encoding of the same samples: one JSON
+ * object per line, {"id":0,"t":123456,"v":21.4}, the value at the
+ * resolution of its sensor, what the station would print with snprintf
+ * to send text instead. 100000 samples: the four synthetic traces of
+ * test/series_trace.h interleaved in tick order, as the sensor task
+ * queues them, then each trace alone.
+ *
+ * Bytes per sample count whole frames (header, padding, CRC) and every
+ * character of the lines. Encode cost is host cycles per sample:
+ * telemetry_add plus telemetry_finish and the CRC of each frame spread
+ * over its samples, against one snprintf. The frames are decoded back
+ * and compared.
+ */
+
+#define SAMPLES 	100000
+
+static CRC_HandleTypeDef  hcrc;
+static uint8_t 			  id[SAMPLES];
+static uint32_t 		  tick[SAMPLES];
+static float 			  value[SAMPLES];
+static telemetry_sample_t got[TELEMETRY_FRAME_SIZE];
+static uint32_t 		  t[SAMPLES];
+
+//the traces in tick order, or only the one given
+static void samples(int only)
+{
+	struct series_trace tr[TRACE_KINDS];
+	uint32_t 			next[TRACE_KINDS];
+	float 				v[TRACE_KINDS];
+	int 				k;
+
+	for(k = 0; k < TRACE_KINDS; k++){
+		series_trace_init(&tr[k], k, 0);
+		series_trace_next(&tr[k], &next[k], &v[k]);
+	}
+	for(uint32_t i = 0; i < SAMPLES; i++){
+		k = only;
+		for(int j = 0; only < 0 && j < TRACE_KINDS; j++){
+			k = k < 0 || next[j] < next[k] ? j : k;
+		}
+		id[i] 	 = k;
+		tick[i]  = next[k];
+		value[i] = v[k];
+		series_trace_next(&tr[k], &next[k], &v[k]);
+	}
+}
+
+//frame bytes, cycles per sample in t[], decoded back
+static uint32_t frames(void)
+{
+	static telemetry_t tm;
+	const uint8_t 	  *frame;
+	uint32_t 		   bytes = 0, start, cost, first = 0, bad = 0;
+	uint16_t 		   len;
+	int 			   n;
+
+	telemetry_init(&tm, &hcrc);
+	for(uint32_t i = 0; i <= SAMPLES; i++){
+		start = DWT->CYCCNT;
+		if(i < SAMPLES && telemetry_add(&tm, id[i], tick[i], value[i])){
+			t[i] = DWT->CYCCNT - start;
+			continue;
+		}
+		//full, or the end: the frame and its CRC go to the samples in it
+		len    = telemetry_finish(&tm, &frame);
+		cost   = DWT->CYCCNT - start;
+		bytes += len;
+		for(uint32_t k = first; k < i; k++){
+			t[k] += cost / (i - first);
+		}
+
+		n = telemetry_decode(frame, len, NULL, got, TELEMETRY_FRAME_SIZE);
+		for(int k = 0; k < n; k++){
+			bad += got[k].sensor != id[first + k] || got[k].tick != tick[first + k] ||
+				   got[k].scaled != (int32_t)lroundf(value[first + k] * 10.0f);
+		}
+		bad  += n != (int)(i - first);
+		first = i;
+		if(i < SAMPLES){
+			start = DWT->CYCCNT;
+			telemetry_add(&tm, id[i], tick[i], value[i]);
+			t[i]  = DWT->CYCCNT - start;
+		}
+	}
+	if(bad){
+		printf("  %lu samples decoded wrong\n", (unsigned long)bad);
+	}
+	return bytes;
+}
+
+//line bytes, cycles per sample in t[]
+static uint32_t lines(void)
+{
+	char 	 line[64];
+	uint32_t bytes = 0, start;
+	int 	 n;
+
+	for(uint32_t i = 0; i < SAMPLES; i++){
+		start = DWT->CYCCNT;
+		n 	  = snprintf(line, sizeof(line), "{\"id\":%u,\"t\":%lu,\"v\":%.*f}\n", id[i],
+						 (unsigned long)tick[i], id[i] < TRACE_KINDS ? series_trace_decimals[id[i]] : 1, value[i]);
+		t[i]  = DWT->CYCCNT - start;
+		bytes += n;
+	}
+	return bytes;
+}
+
+static void run(const char *name, int only)
+{
+	uint32_t binary, text;
+
+	samples(only);
+	printf("%s\n", name);
+	binary = frames();
+	bench_report("  frames, encode", t, SAMPLES, 1);
+	text = lines();
+	bench_report("  json lines, encode", t, SAMPLES, 1);
+	printf("  frames %.2f bytes/sample, json lines %.2f bytes/sample, %.1fx smaller\n",
+		   (double)binary / SAMPLES, (double)text / SAMPLES, (double)text / binary);
+}
+
+int main(void)
+{
+	sim_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+	run("all four traces, tick order", -1);
+	for(int k = 0; k < TRACE_KINDS; k++){
+		run(series_trace_name[k], k);
+	}
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include "timer_wheel.h"
+#include "bench.h"
+
+/*
+ * Cost of one tick of the timer task: every timer_wheel_expire call up to
+ * the tick, the 0 that ends it included. Then, timed apart, each call on
+ * its own: what the task holds a critical section for. N periodic timers
+ * with periods of N/2..3N/2 ticks give about one expiry per tick whatever
+ * N is, so the runs differ only in how full the wheel is. 200000 ticks per
+ * run, after one full period of warm up.
+ *
+ * Then the worst case for one tick: N timers in one slot of the top level
+ * coming down at once, and a catch up of 2^17 ticks over them, the whole
+ * catch up and each call.
+ */
+
+#define TICKS 		200000
+#define MAX_TIMERS 	10000
+
+static timer_wheel_t tw;
+static wheel_timer_t timers[MAX_TIMERS];
+static uint32_t 	 t[TICKS];
+static uint32_t 	 call[TICKS];
+
+static uint32_t bench_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+//every call up to tick, each one timed into calls[] from *n if not NULL
+static uint32_t expire_all(uint32_t tick, uint32_t *calls, uint32_t *n)
+{
+	wheel_timer_t *timer;
+	uint32_t 	   start, expired = 0;
+	uint8_t 	   more;
+
+	do{
+		start = DWT->CYCCNT;
+		more  = timer_wheel_expire(&tw, tick, &timer);
+		if(calls != NULL && *n < TICKS){
+			calls[(*n)++] = DWT->CYCCNT - start;
+		}
+		expired += timer != NULL;
+	}while(more);
+	return expired;
+}
+
+static void run(uint32_t count, uint32_t *seed)
+{
+	uint32_t tick = 0, start, period, expired = 0, n = 0;
+	char 	 label[40];
+
+	timer_wheel_init(&tw, tick);
+	for(uint32_t i = 0; i < count; i++){
+		period = count / 2 + bench_rand(seed) % (count + 1);
+		timer_wheel_start(&tw, &timers[i], tick, 1 + bench_rand(seed) % period, period);
+	}
+	//warm up: every timer fires once, the phases spread
+	for(uint32_t i = 0; i < count * 3 / 2; i++){
+		tick++;
+		expire_all(tick, NULL, NULL);
+	}
+	for(uint32_t i = 0; i < TICKS; i++){
+		tick++;
+		start 	 = DWT->CYCCNT;
+		expired += expire_all(tick, NULL, NULL);
+		t[i] 	 = DWT->CYCCNT - start;
+	}
+	snprintf(label, sizeof(label), "%5lu timers, tick", (unsigned long)count);
+	bench_report(label, t, TICKS, 1);
+	while(n < TICKS){
+		expire_all(++tick, call, &n);
+	}
+	snprintf(label, sizeof(label), "%5lu timers, call", (unsigned long)count);
+	bench_report(label, call, n, 1);
+	printf("  %.2f expiries per tick, high water %u\n", (double)expired / TICKS, tw.high_water);
+	for(uint32_t i = 0; i < count; i++){
+		timer_wheel_stop(&tw, &timers[i]);
+	}
+}
+
+static void run_cascade(uint32_t count)
+{
+	uint32_t start, total = 0, n = 0;
+
+	//the whole catch up, then each call
+	for(int pass = 0; pass < 2; pass++){
+		timer_wheel_init(&tw, 0);
+		for(uint32_t i = 0; i < count; i++){
+			timer_wheel_start(&tw, &timers[i], 0, 3 * (1u << (TIMER_WHEEL_BITS * 3)) + i % 2000, 0);
+		}
+		start = DWT->CYCCNT;
+		expire_all(0x20000, pass ? call : NULL, &n);
+		total = pass ? total : DWT->CYCCNT - start;
+	}
+	printf("%5lu timers in one slot, catch up of 2^17 ticks: %lu cycles in %lu calls\n",
+		   (unsigned long)count, (unsigned long)total, (unsigned long)n);
+	bench_report("  call", call, n, 1);
+}
+
+int main(void)
+{
+	static const uint32_t counts[] = {10, 100, 1000, 10000};
+	uint32_t 			  seed = 1;
+
+	sim_init();
+	printf("timer overhead %lu\n", (unsigned long)bench_overhead());
+	for(unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); c++){
+		run(counts[c], &seed);
+	}
+	for(unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); c++){
+		run_cascade(counts[c]);
+	}
+	return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Stand-in for FreeRTOS.h, just enough to build MemMang/heap_4.c on the
+ * host for bench_mem_pool and src/trace.c for test_trace. Alignment is the
+ * Cortex-M port one; the block header is two host pointers wide (16 bytes,
+ * 8 on the board).
+ */
+
+#define configSUPPORT_DYNAMIC_ALLOCATION 	1
+#define configAPPLICATION_ALLOCATED_HEAP 	0
+#define configUSE_MALLOC_FAILED_HOOK 		0
+#define configTOTAL_HEAP_SIZE 				((size_t)(96 * 1024))
+#define configTICK_RATE_HZ 					1000
+#define configMAX_TASK_NAME_LEN 			16
+
+#define portBYTE_ALIGNMENT 					8
+#define portBYTE_ALIGNMENT_MASK 			0x0007
+
+#define configASSERT(x)
+#define mtCOVERAGE_TEST_MARKER()
+#define traceMALLOC(p, size)
+#define traceFREE(p, size)
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+void 	*pvPortMalloc(size_t xWantedSize);
+void 	vPortFree(void *pv);
+size_t 	xPortGetFreeHeapSize(void);
+
+#endif /* FREERTOS_H_ */
@@ -0,0 +1,32 @@
+#ifndef TASK_H_
+#define TASK_H_
+
+/*
+ * Scheduler lock of heap_4. On the board vTaskSuspendAll is an increment
+ * and xTaskResumeAll a critical section that also checks for pending
+ * ready tasks; here both are a counter, so heap_4 is timed without that
+ * extra cost.
+ */
+
+extern volatile unsigned long bench_scheduler_suspended;
+
+static inline void vTaskSuspendAll(void)
+{
+	bench_scheduler_suspended++;
+}
+
+static inline BaseType_t xTaskResumeAll(void)
+{
+	bench_scheduler_suspended--;
+	return 0;
+}
+
+/* Task table of trace_dump, the fields it reads; the test fills it */
+typedef struct{
+	const char 	*pcTaskName;
+	UBaseType_t xTaskNumber;
+} TaskStatus_t;
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pxTaskStatusArray, UBaseType_t uxArraySize, uint32_t *pulTotalRunTime);
+
+#endif /* TASK_H_ */
@@ -0,0 +1,93 @@
+#include "telemetry_decode.h"
+
+/**
+ * @brief CRC of the STM32 unit over len bytes (a multiple of 4) fed as
+ * 		  little endian words: CRC-32/MPEG-2 of each word taken most
+ * 		  significant byte first
+ * @param data:	bytes as they are in memory
+ * @param len:	multiple of 4
+ * @return crc
+ */
+uint32_t telemetry_crc(const uint8_t *data, size_t len)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	for(size_t i = 0; i + 4 <= len; i += 4){
+		crc ^= data[i] | data[i + 1] << 8 | data[i + 2] << 16 | (uint32_t)data[i + 3] << 24;
+		for(int b = 0; b < 32; b++){
+			crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04C11DB7u : crc << 1;
+		}
+	}
+	return crc;
+}
+
+//varint up to 5 bytes, 0 if it runs past end or is longer
+static uint8_t get_varint(const uint8_t **p, const uint8_t *end, uint32_t *value)
+{
+	*value = 0;
+	for(int shift = 0; shift < 35; shift += 7){
+		if(*p >= end){
+			return 0;
+		}
+		*value |= (uint32_t)(**p & 0x7F) << shift;
+		if(!(*(*p)++ & 0x80)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief decodes one frame, checks header, length, CRC and every sample
+ * @param frame:	frame bytes
+ * @param len:		frame length
+ * @param sequence:	sequence number of the frame, NULL if not needed
+ * @param out:		decoded samples
+ * @param max:		room in out
+ * @return samples decoded, -1 if the frame is malformed or holds more
+ * 		   than max samples
+ */
+int telemetry_decode(const uint8_t *frame, size_t len, uint16_t *sequence,
+					 telemetry_sample_t *out, int max)
+{
+	int32_t 	   last[TELEMETRY_SENSORS];
+	uint32_t 	   seen = 0, tick, crc, zz, dt;
+	const uint8_t *p, *end;
+	int32_t 	   delta;
+	int 		   n = 0;
+
+	if(len < TELEMETRY_HEADER_SIZE + 4 || len % 4 || frame[0] != TELEMETRY_SYNC ||
+	   frame[1] != TELEMETRY_VERSION || (size_t)TELEMETRY_HEADER_SIZE + frame[8] > len - 4){
+		return -1;
+	}
+	crc = frame[len - 4] | frame[len - 3] << 8 | frame[len - 2] << 16 | (uint32_t)frame[len - 1] << 24;
+	if(telemetry_crc(frame, len - 4) != crc){
+		return -1;
+	}
+
+	tick = frame[4] | frame[5] << 8 | frame[6] << 16 | (uint32_t)frame[7] << 24;
+	p 	 = frame + TELEMETRY_HEADER_SIZE;
+	end  = p + frame[8];
+	while(p < end){
+		uint8_t sensor = *p++;
+
+		if(sensor >= TELEMETRY_SENSORS || n == max || !get_varint(&p, end, &dt) || !get_varint(&p, end, &zz)){
+			return -1;
+		}
+		tick  += dt;
+		delta  = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+		last[sensor] = (seen & (1u << sensor)) ? last[sensor] + delta : delta;
+		seen |= 1u << sensor;
+		out[n].sensor = sensor;
+		out[n].tick   = tick;
+		out[n].scaled = last[sensor];
+		n++;
+	}
+	if(n != frame[9]){
+		return -1;
+	}
+	if(sequence != NULL){
+		*sequence = frame[2] | frame[3] << 8;
+	}
+	return n;
+}
@@ -0,0 +1,33 @@
+#ifndef TELEMETRY_DECODE_H_
+#define TELEMETRY_DECODE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "telemetry.h"
+
+/*
+ * Receiving side of the telemetry frames of inc/telemetry.h, for the host
+ * tests and benchmarks and for tools reading captures. It needs only the
+ * frame constants of telemetry.h, the CRC is computed in software the way
+ * the STM32 unit does it.
+ * Every length and sensor id is checked, a malformed frame is rejected
+ * whole and never read past len.
+ */
+
+/**
+ * @brief sample as the frame carries it
+ */
+struct _telemetry_sample_t{
+	uint8_t 	sensor;
+	uint32_t 	tick;						// ms
+	int32_t 	scaled;						// value*10
+};
+typedef struct _telemetry_sample_t telemetry_sample_t;
+
+
+uint32_t 	telemetry_crc(const uint8_t *data, size_t len);
+int 		telemetry_decode(const uint8_t *frame, size_t len, uint16_t *sequence,
+							 telemetry_sample_t *out, int max);
+
+
+#endif /* TELEMETRY_DECODE_H_ */
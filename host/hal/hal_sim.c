@@ -0,0 +1,557 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "stm32f4xx_hal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define SIM_UART_CAPTURE 	(64 * 1024)
+#define SIM_FLASH_SECTORS 	8
+#define SIM_PROGRAM_US 		16
+
+uint32_t 		SystemCoreClock = 96000000;
+uint32_t 		sim_primask = 0;
+GPIO_TypeDef 	sim_gpio[5];
+CoreDebug_Type 	sim_core_debug;
+
+static DWT_Type 	sim_dwt_regs;
+static uint32_t 	sim_dwt_last = 0;				// CYCCNT handed out last
+static uint64_t 	sim_dwt_base = 0;				// Counter value at CYCCNT = 0
+static uint32_t 	sim_tick = 0;
+static uint32_t 	sim_crc = 0xFFFFFFFF;
+static uint8_t 		sim_uart[SIM_UART_CAPTURE];
+static size_t 		sim_uart_len = 0;
+static uint32_t 	sim_uart_refuse = 0;			// HAL_UART_Transmit_DMA calls to refuse
+static uint16_t    *sim_adc_data = NULL;			// Buffer of HAL_ADC_Start_DMA, NULL stopped
+static uint32_t 	sim_adc_length = 0;
+static uint32_t 	sim_adc_ndtr = 0;
+static uint8_t 	   *sim_flash = NULL;
+static uint8_t 		sim_flash_lock = 1;
+static int32_t 		sim_erase_sector = -1;			// Erase started by HAL_FLASHEx_Erase_IT
+static uint64_t 	sim_flash_us = 0;
+static uint32_t 	sim_cut_ops = 0;				// Operations left before the cut, 0 none
+static jmp_buf 	   *sim_cut_jump = NULL;
+static uint32_t 	sim_cut_seed = 1;
+static uint32_t 	sim_cut_count = 0;
+
+/* F411 sectors: 4 x 16 KB, 64 KB, 3 x 128 KB */
+static const uint32_t sim_sector_start[SIM_FLASH_SECTORS + 1] = {
+	0x00000, 0x04000, 0x08000, 0x0C000, 0x10000, 0x20000, 0x40000, 0x60000, 0x80000
+};
+static const uint32_t sim_erase_us[SIM_FLASH_SECTORS] = {
+	250000, 250000, 250000, 250000, 550000, 1000000, 1000000, 1000000
+};
+
+//maps size bytes at addr, aborts if the host already uses the range
+static uint8_t *sim_map(uintptr_t addr, size_t size, uint8_t fill)
+{
+	void *p = mmap((void *)addr, size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	if(p != (void *)addr){
+		fprintf(stderr, "sim: cannot map 0x%08lx\n", (unsigned long)addr);
+		exit(2);
+	}
+	memset(p, fill, size);
+	return p;
+}
+
+/**
+ * @brief maps the flash (erased) and the system memory page (zeros)
+ */
+void sim_init(void)
+{
+	if(sim_flash == NULL){
+		sim_flash = sim_map(FLASH_BASE, FLASH_SIZE, 0xFF);
+		sim_map(SIM_SYSMEM_BASE, SIM_SYSMEM_SIZE, 0x00);
+	}
+	sim_tick 		 = 0;
+	sim_uart_len 	 = 0;
+	sim_uart_refuse  = 0;
+	sim_adc_data 	 = NULL;
+	memset(sim_gpio, 0, sizeof(sim_gpio));
+	sim_flash_lock 	 = 1;
+	sim_erase_sector = -1;
+	sim_flash_us 	 = 0;
+	sim_cut_ops 	 = 0;
+	sim_cut_count 	 = 0;
+}
+
+
+/******************************************************************************
+ * 								CORTEX-M / TICK								  *
+ ******************************************************************************/
+uint64_t sim_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+DWT_Type *sim_dwt(void)
+{
+	uint64_t now = sim_cycles();
+
+	//a write to CYCCNT since the last access moves the origin
+	if(sim_dwt_regs.CYCCNT != sim_dwt_last){
+		sim_dwt_base = now - sim_dwt_regs.CYCCNT;
+	}
+	sim_dwt_last = sim_dwt_regs.CYCCNT = (uint32_t)(now - sim_dwt_base);
+	return &sim_dwt_regs;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return sim_tick;
+}
+
+void sim_set_tick(uint32_t tick)
+{
+	sim_tick = tick;
+}
+
+void sim_advance_tick(uint32_t ms)
+{
+	sim_tick += ms;
+}
+
+void sim_set_sysmem(uint32_t addr, const void *data, size_t len)
+{
+	memcpy((void *)(uintptr_t)addr, data, len);
+}
+
+
+/******************************************************************************
+ * 								CRC											  *
+ ******************************************************************************/
+uint32_t HAL_CRC_Accumulate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength)
+{
+	for(uint32_t i = 0; i < BufferLength; i++){
+		sim_crc ^= pBuffer[i];
+		for(int b = 0; b < 32; b++){
+			sim_crc = (sim_crc & 0x80000000u) ? (sim_crc << 1) ^ 0x04C11DB7u : sim_crc << 1;
+		}
+	}
+	return sim_crc;
+}
+
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength)
+{
+	sim_crc = 0xFFFFFFFF;
+	return HAL_CRC_Accumulate(hcrc, pBuffer, BufferLength);
+}
+
+
+/******************************************************************************
+ * 								UART										  *
+ ******************************************************************************/
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	size_t n = Size < SIM_UART_CAPTURE - sim_uart_len ? Size : SIM_UART_CAPTURE - sim_uart_len;
+
+	memcpy(&sim_uart[sim_uart_len], pData, n);
+	sim_uart_len += n;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+	huart->ErrorCode = HAL_UART_ERROR_NONE;
+	huart->gState 	 = HAL_UART_STATE_READY;
+	huart->RxState 	 = HAL_UART_STATE_READY;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if(huart->gState != HAL_UART_STATE_READY){
+		return HAL_BUSY;
+	}
+	if(pData == NULL || Size == 0 || sim_uart_refuse > 0){
+		sim_uart_refuse -= sim_uart_refuse > 0;
+		return HAL_ERROR;
+	}
+	huart->pTxBuffPtr = pData;
+	huart->TxXferSize = Size;
+	huart->gState 	  = HAL_UART_STATE_BUSY_TX;
+	return HAL_OK;
+}
+
+void sim_uart_tx_refuse(uint32_t calls)
+{
+	sim_uart_refuse = calls;
+}
+
+uint8_t sim_uart_tx_complete(UART_HandleTypeDef *huart)
+{
+	if(huart->gState != HAL_UART_STATE_BUSY_TX){
+		return 0;
+	}
+	huart->gState = HAL_UART_STATE_READY;
+	HAL_UART_TxCpltCallback(huart);
+	return 1;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if(huart->RxState != HAL_UART_STATE_READY){
+		return HAL_BUSY;
+	}
+	if(pData == NULL || Size == 0){
+		return HAL_ERROR;
+	}
+	huart->pRxBuffPtr 			 = pData;
+	huart->RxXferSize 			 = Size;
+	huart->ErrorCode 			 = HAL_UART_ERROR_NONE;
+	huart->hdmarx->Instance->M0AR = (uint32_t)(uintptr_t)pData;
+	huart->hdmarx->Instance->NDTR = Size;
+	huart->RxState 				 = HAL_UART_STATE_BUSY_RX;
+	return HAL_OK;
+}
+
+size_t sim_uart_receive(UART_HandleTypeDef *huart, const uint8_t *data, size_t len)
+{
+	DMA_Stream_TypeDef *dma = huart->hdmarx->Instance;
+	size_t 				i;
+
+	for(i = 0; i < len && huart->RxState == HAL_UART_STATE_BUSY_RX; i++){
+		huart->pRxBuffPtr[huart->RxXferSize - dma->NDTR] = data[i];
+		//circular mode: reloaded before the transfer complete callback
+		if(--dma->NDTR == 0){
+			dma->NDTR = huart->RxXferSize;
+			HAL_UART_RxCpltCallback(huart);
+		}
+		else if(dma->NDTR == huart->RxXferSize / 2u){
+			HAL_UART_RxHalfCpltCallback(huart);
+		}
+	}
+	return i;
+}
+
+void sim_uart_idle(UART_HandleTypeDef *huart)
+{
+	huart->Instance->SR |= USART_SR_IDLE;
+	if(huart->Instance->CR1 & USART_CR1_IDLEIE){
+		sim_uart_irq(huart);
+	}
+}
+
+void sim_uart_error(UART_HandleTypeDef *huart, uint32_t error)
+{
+	huart->ErrorCode |= error;
+	huart->RxState 	  = HAL_UART_STATE_READY;
+	HAL_UART_ErrorCallback(huart);
+}
+
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+}
+
+__attribute__((weak)) void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+}
+
+__attribute__((weak)) void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+}
+
+__attribute__((weak)) void sim_uart_irq(UART_HandleTypeDef *huart)
+{
+}
+
+const uint8_t *sim_uart_output(size_t *len)
+{
+	*len = sim_uart_len;
+	return sim_uart;
+}
+
+void sim_uart_clear(void)
+{
+	sim_uart_len = 0;
+}
+
+
+/******************************************************************************
+ * 								GPIO										  *
+ ******************************************************************************/
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+	for(uint32_t p = 0; p < 16; p++){
+		if(!(GPIO_Init->Pin & (1u << p))){
+			continue;
+		}
+		GPIOx->MODER 	 = (GPIOx->MODER & ~(3u << 2 * p)) | (GPIO_Init->Mode & 3u) << 2 * p;
+		GPIOx->PUPDR 	 = (GPIOx->PUPDR & ~(3u << 2 * p)) | (GPIO_Init->Pull & 3u) << 2 * p;
+		GPIOx->OSPEEDR 	 = (GPIOx->OSPEEDR & ~(3u << 2 * p)) | (GPIO_Init->Speed & 3u) << 2 * p;
+		if((GPIO_Init->Mode & 3u) == GPIO_MODE_AF_PP){
+			GPIOx->AFR[p / 8] = (GPIOx->AFR[p / 8] & ~(15u << 4 * (p % 8))) | (GPIO_Init->Alternate & 15u) << 4 * (p % 8);
+		}
+	}
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	GPIOx->ODR = PinState == GPIO_PIN_SET ? GPIOx->ODR | GPIO_Pin : GPIOx->ODR & ~(uint32_t)GPIO_Pin;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void sim_gpio_input(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState level)
+{
+	port->IDR = level == GPIO_PIN_SET ? port->IDR | pin : port->IDR & ~(uint32_t)pin;
+}
+
+
+/******************************************************************************
+ * 								TIM											  *
+ ******************************************************************************/
+//CCxE in CCER and CCxIE in DIER of a channel
+#define SIM_CCER(ch) 	(1u << (ch))
+#define SIM_DIER(ch) 	(1u << ((ch) / 4 + 1))
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	htim->Instance->CCER |= SIM_CCER(Channel);
+	htim->Instance->DIER |= SIM_DIER(Channel);
+	htim->Instance->CR1  |= 1u;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	htim->Instance->CCER &= ~SIM_CCER(Channel);
+	htim->Instance->DIER &= ~SIM_DIER(Channel);
+	return HAL_OK;
+}
+
+uint32_t HAL_TIM_ReadCapturedValue(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	return (&htim->Instance->CCR1)[Channel / 4];
+}
+
+uint8_t sim_tim_capture(TIM_HandleTypeDef *htim, uint32_t channel, uint32_t count)
+{
+	TIM_TypeDef *tim = htim->Instance;
+
+	if(!(tim->CCER & SIM_CCER(channel))){
+		return 0;
+	}
+	(&tim->CCR1)[channel / 4] = count;
+	if(tim->DIER & SIM_DIER(channel)){
+		htim->Channel = (HAL_TIM_ActiveChannel)(1u << channel / 4);
+		HAL_TIM_IC_CaptureCallback(htim);
+		htim->Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+	}
+	return 1;
+}
+
+__attribute__((weak)) void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+}
+
+
+/******************************************************************************
+ * 								ADC											  *
+ ******************************************************************************/
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length)
+{
+	if(sim_adc_data != NULL){
+		return HAL_BUSY;
+	}
+	if(pData == NULL || Length == 0){
+		return HAL_ERROR;
+	}
+	sim_adc_data   = (uint16_t *)pData;
+	sim_adc_length = Length;
+	sim_adc_ndtr   = Length;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc)
+{
+	sim_adc_data = NULL;
+	return HAL_OK;
+}
+
+size_t sim_adc_convert(ADC_HandleTypeDef *hadc, const uint16_t *values, size_t n)
+{
+	size_t i;
+
+	for(i = 0; i < n && sim_adc_data != NULL; i++){
+		sim_adc_data[sim_adc_length - sim_adc_ndtr] = values[i];
+		if(--sim_adc_ndtr == 0){
+			sim_adc_ndtr = sim_adc_length;
+			HAL_ADC_ConvCpltCallback(hadc);
+		}
+		else if(sim_adc_ndtr == sim_adc_length / 2){
+			HAL_ADC_ConvHalfCpltCallback(hadc);
+		}
+	}
+	return i;
+}
+
+__attribute__((weak)) void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+}
+
+__attribute__((weak)) void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+}
+
+
+/******************************************************************************
+ * 								FLASH										  *
+ ******************************************************************************/
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	sim_flash_lock = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	sim_flash_lock = 1;
+	return HAL_OK;
+}
+
+static uint32_t sim_random(void)
+{
+	uint32_t x = sim_cut_seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return sim_cut_seed = x;
+}
+
+//counts one flash operation, 1 if the power goes during it
+static uint8_t sim_flash_cutting(void)
+{
+	return sim_cut_ops > 0 && --sim_cut_ops == 0;
+}
+
+static void sim_power_off(void)
+{
+	sim_flash_lock 	 = 1;
+	sim_erase_sector = -1;
+	sim_cut_count++;
+	longjmp(*sim_cut_jump, 1);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	uint32_t bytes = 1u << TypeProgram;
+	uint8_t *p, cut;
+
+	if(sim_flash_lock || sim_erase_sector >= 0 || TypeProgram > FLASH_TYPEPROGRAM_DOUBLEWORD ||
+	   Address < FLASH_BASE || Address + bytes > FLASH_BASE + FLASH_SIZE || Address % bytes != 0){
+		return HAL_ERROR;
+	}
+	//programming only clears bits, a cut one only some of them
+	cut = sim_flash_cutting();
+	p 	= &sim_flash[Address - FLASH_BASE];
+	for(uint32_t i = 0; i < bytes; i++){
+		p[i] &= (uint8_t)(Data >> (8 * i)) | (cut ? (uint8_t)sim_random() : 0);
+	}
+	sim_flash_us += SIM_PROGRAM_US;
+	if(cut){
+		sim_power_off();
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit)
+{
+	if(sim_flash_lock || sim_erase_sector >= 0 || pEraseInit->TypeErase != FLASH_TYPEERASE_SECTORS ||
+	   pEraseInit->NbSectors != 1 || pEraseInit->Sector >= SIM_FLASH_SECTORS){
+		return HAL_ERROR;
+	}
+	if(sim_flash_cutting()){
+		for(uint32_t a = sim_sector_start[pEraseInit->Sector]; a < sim_sector_start[pEraseInit->Sector + 1]; a++){
+			sim_flash[a] |= (uint8_t)(sim_random() & sim_random());
+		}
+		sim_power_off();
+	}
+	sim_erase_sector = pEraseInit->Sector;
+	return HAL_OK;
+}
+
+/**
+ * @brief ends the erase started by HAL_FLASHEx_Erase_IT and reports it like
+ * 		  the HAL: once for the sector, then with 0xFFFFFFFF
+ */
+void HAL_FLASH_IRQHandler(void)
+{
+	uint32_t sector = sim_erase_sector;
+
+	if(sim_erase_sector < 0){
+		return;
+	}
+	memset(&sim_flash[sim_sector_start[sector]], 0xFF, sim_sector_start[sector + 1] - sim_sector_start[sector]);
+	sim_flash_us 	+= sim_erase_us[sector];
+	sim_erase_sector = -1;
+	HAL_FLASH_EndOfOperationCallback(sector);
+	HAL_FLASH_EndOfOperationCallback(0xFFFFFFFFU);
+}
+
+__attribute__((weak)) void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue)
+{
+}
+
+__attribute__((weak)) void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue)
+{
+}
+
+void sim_flash_erase_all(void)
+{
+	memset(sim_flash, 0xFF, FLASH_SIZE);
+	sim_erase_sector = -1;
+}
+
+uint8_t sim_flash_erase_pending(void)
+{
+	return sim_erase_sector >= 0;
+}
+
+uint8_t sim_flash_locked(void)
+{
+	return sim_flash_lock;
+}
+
+uint64_t sim_flash_time_us(void)
+{
+	return sim_flash_us;
+}
+
+void sim_flash_time_reset(void)
+{
+	sim_flash_us = 0;
+}
+
+void sim_flash_cut(uint32_t ops, jmp_buf *jump, uint32_t seed)
+{
+	sim_cut_ops  = ops;
+	sim_cut_jump = jump;
+	sim_cut_seed = seed ? seed : 1;
+}
+
+uint32_t sim_flash_cuts(void)
+{
+	return sim_cut_count;
+}
@@ -0,0 +1,101 @@
+#ifndef HAL_SIM_H_
+#define HAL_SIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+/*
+ * Controls of the simulated HAL (stm32f4xx_hal.h), for the host tests and
+ * benchmarks only. sim_init must run first: it maps the flash and the
+ * system memory page at their target addresses, so the modules read them
+ * through the same pointers as on the board.
+ */
+
+#define SIM_SYSMEM_BASE 		0x1FFF7000UL
+#define SIM_SYSMEM_SIZE 		0x1000
+
+void 		sim_init(void);
+
+/* Tick */
+void 		sim_set_tick(uint32_t tick);
+void 		sim_advance_tick(uint32_t ms);
+
+/* Host time stamp counter, the clock behind DWT->CYCCNT */
+uint64_t 	sim_cycles(void);
+
+/* System memory (factory calibration) */
+void 		sim_set_sysmem(uint32_t addr, const void *data, size_t len);
+
+/* UART transmit capture */
+const uint8_t *sim_uart_output(size_t *len);
+void 		sim_uart_clear(void);
+
+/* UART DMA transmit: ends the transfer running (pTxBuffPtr, TxXferSize),
+   0 if there was none */
+uint8_t 	sim_uart_tx_complete(UART_HandleTypeDef *huart);
+
+/* HAL_UART_Transmit_DMA returns HAL_ERROR for the next calls calls */
+void 		sim_uart_tx_refuse(uint32_t calls);
+
+/* UART reception: the DMA writes len bytes (they are lost while it is
+   stopped) and calls the half / full transfer callbacks on the way. The
+   idle line sets the flag and, if its interrupt is enabled, calls
+   sim_uart_irq, the USARTx_IRQHandler of the test. An error stops the
+   DMA and calls HAL_UART_ErrorCallback, as the HAL does */
+size_t 		sim_uart_receive(UART_HandleTypeDef *huart, const uint8_t *data, size_t len);
+void 		sim_uart_idle(UART_HandleTypeDef *huart);
+void 		sim_uart_error(UART_HandleTypeDef *huart, uint32_t error);
+void 		sim_uart_irq(UART_HandleTypeDef *huart);
+
+/* GPIO: level seen on an input pin */
+void 		sim_gpio_input(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState level);
+
+/* TIM: an edge on the capture channel at count, 1 if captured (started) */
+uint8_t 	sim_tim_capture(TIM_HandleTypeDef *htim, uint32_t channel, uint32_t count);
+
+/* ADC: n conversions of the scan sequence go through the circular DMA
+   into the buffer of HAL_ADC_Start_DMA, with the half / full transfer
+   callbacks on the way. Returns the conversions stored, 0 if stopped */
+size_t 		sim_adc_convert(ADC_HandleTypeDef *hadc, const uint16_t *values, size_t n);
+
+/* Stimulus scripts: one event per line, lines starting with '#' are
+   comments.
+
+     <ms>[+<period>x<count>] <event>
+
+   uart <name> "<text>"			bytes (\r \n \t \" \\ \xHH), then the idle line
+   adc <name> <value>...		conversions, sim_adc_convert
+   gpio <port> <pin> <level>	input level, port A to E
+   capture <name> <ch> <us>...	edges on channel 1-4: one at the counter
+								value, then one after each width
+
+   Names are those given to sim_script_bind with the UART, ADC or TIM
+   handle. sim_script_load returns the events read, -1 on an error (the
+   line is printed); sim_script_run plays every event due up to tick and
+   returns how many it played */
+void 		sim_script_bind(const char *name, void *handle);
+int 		sim_script_load(const char *path);
+uint32_t 	sim_script_run(uint32_t tick);
+uint8_t 	sim_script_done(void);
+
+/* Flash */
+void 		sim_flash_erase_all(void);
+uint8_t 	sim_flash_erase_pending(void);
+uint8_t 	sim_flash_locked(void);
+
+/* Flash time spent programming and erasing, typical F411 figures at 3.3 V
+   and x32 parallelism: 16 us per program, 250 ms / 550 ms / 1 s per 16 /
+   64 / 128 KB sector erase */
+uint64_t 	sim_flash_time_us(void);
+void 		sim_flash_time_reset(void);
+
+/* Power cut on the ops-th flash operation from now (program, or erase
+   start), 0 for none. A cut program clears a random part of its bits, a
+   cut erase sets a random part of the sector bits, then the flash is
+   locked, idle, and the sim longjmps to jump (setjmp returns 1) */
+void 		sim_flash_cut(uint32_t ops, jmp_buf *jump, uint32_t seed);
+uint32_t 	sim_flash_cuts(void);
+
+
+#endif /* HAL_SIM_H_ */
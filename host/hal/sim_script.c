@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "stm32f4xx_hal.h"
+
+/*
+ * Stimulus scripts for the simulated peripherals, see hal_sim.h for the
+ * format. The whole file is parsed by sim_script_load, sim_script_run
+ * then plays the events due on each call, in file order within a tick.
+ */
+
+#define SIM_SCRIPT_NAMES 	8
+#define SIM_SCRIPT_DATA 	256						// Bytes, values or widths per event
+
+enum sim_event_type{ SIM_EV_UART, SIM_EV_ADC, SIM_EV_GPIO, SIM_EV_CAPTURE };
+
+struct sim_event{
+	uint32_t 			due;						// Tick of the next delivery
+	uint32_t 			period;
+	uint32_t 			left;						// Deliveries left
+	enum sim_event_type type;
+	char 				name[16];					// Handle, or port letter
+	uint32_t 			arg;						// GPIO pin, capture channel
+	uint32_t 			n;
+	uint32_t 			data[SIM_SCRIPT_DATA];
+};
+
+static struct{
+	const char *name;
+	void 	   *handle;
+} sim_names[SIM_SCRIPT_NAMES];
+
+static struct sim_event *sim_events = NULL;
+static uint32_t 		 sim_n_events = 0;
+
+void sim_script_bind(const char *name, void *handle)
+{
+	for(int i = 0; i < SIM_SCRIPT_NAMES; i++){
+		if(sim_names[i].name == NULL || strcmp(sim_names[i].name, name) == 0){
+			sim_names[i].name 	= name;
+			sim_names[i].handle = handle;
+			return;
+		}
+	}
+}
+
+static void *sim_script_handle(const char *name)
+{
+	for(int i = 0; i < SIM_SCRIPT_NAMES && sim_names[i].name != NULL; i++){
+		if(strcmp(sim_names[i].name, name) == 0){
+			return sim_names[i].handle;
+		}
+	}
+	return NULL;
+}
+
+//quoted text with \r \n \t \" \\ and \xHH escapes
+static int sim_script_text(const char *p, struct sim_event *ev)
+{
+	if(*p++ != '"'){
+		return -1;
+	}
+	while(*p != '"'){
+		if(*p == '\0' || ev->n == SIM_SCRIPT_DATA){
+			return -1;
+		}
+		if(*p != '\\'){
+			ev->data[ev->n++] = (uint8_t)*p++;
+			continue;
+		}
+		switch(*++p){
+		case 'r': ev->data[ev->n++] = '\r'; break;
+		case 'n': ev->data[ev->n++] = '\n'; break;
+		case 't': ev->data[ev->n++] = '\t'; break;
+		case 'x': ev->data[ev->n++] = (uint8_t)strtoul(p + 1, NULL, 16); p += 2; break;
+		default:  ev->data[ev->n++] = (uint8_t)*p; break;
+		}
+		p++;
+	}
+	return 0;
+}
+
+static int sim_script_numbers(char *p, struct sim_event *ev)
+{
+	char *end;
+
+	for(;;){
+		while(isspace((unsigned char)*p)){
+			p++;
+		}
+		if(*p == '\0'){
+			return ev->n > 0 ? 0 : -1;
+		}
+		if(ev->n == SIM_SCRIPT_DATA){
+			return -1;
+		}
+		ev->data[ev->n++] = strtoul(p, &end, 0);
+		if(end == p){
+			return -1;
+		}
+		p = end;
+	}
+}
+
+//one line into ev, 0 ok, 1 nothing on it, -1 error
+static int sim_script_line(char *line, struct sim_event *ev)
+{
+	char type[16];
+	int  used = 0;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	if(sscanf(line, " %15s", type) != 1 || type[0] == '#'){
+		return 1;
+	}
+	memset(ev, 0, sizeof(*ev));
+	ev->left = 1;
+	if(sscanf(line, " %u%n", &ev->due, &used) != 1){
+		return -1;
+	}
+	line += used;
+	if(*line == '+'){
+		if(sscanf(line, "+%ux%u%n", &ev->period, &ev->left, &used) != 2 || ev->period == 0){
+			return -1;
+		}
+		line += used;
+	}
+	if(sscanf(line, " %15s %15s%n", type, ev->name, &used) != 2){
+		return -1;
+	}
+	line += used;
+
+	if(strcmp(type, "uart") == 0){
+		ev->type = SIM_EV_UART;
+		while(isspace((unsigned char)*line)){
+			line++;
+		}
+		return sim_script_text(line, ev);
+	}
+	if(strcmp(type, "adc") == 0){
+		ev->type = SIM_EV_ADC;
+		return sim_script_numbers(line, ev);
+	}
+	if(strcmp(type, "gpio") == 0 || strcmp(type, "capture") == 0){
+		ev->type = type[0] == 'g' ? SIM_EV_GPIO : SIM_EV_CAPTURE;
+		ev->arg  = strtoul(line, &line, 0);
+		if(sim_script_numbers(line, ev) != 0){
+			return -1;
+		}
+		if(ev->type == SIM_EV_GPIO){
+			return ev->name[0] >= 'A' && ev->name[0] <= 'E' && ev->arg < 16 && ev->n == 1 ? 0 : -1;
+		}
+		return ev->arg >= 1 && ev->arg <= 4 ? 0 : -1;
+	}
+	return -1;
+}
+
+int sim_script_load(const char *path)
+{
+	FILE 			 *f = fopen(path, "r");
+	char 			  line[2048];
+	struct sim_event  ev;
+	uint32_t 		  number = 0;
+	int 			  r;
+
+	if(f == NULL){
+		fprintf(stderr, "sim: cannot open %s\n", path);
+		return -1;
+	}
+	free(sim_events);
+	sim_events 	 = NULL;
+	sim_n_events = 0;
+	while(fgets(line, sizeof(line), f) != NULL){
+		number++;
+		if((r = sim_script_line(line, &ev)) == 1){
+			continue;
+		}
+		if(r < 0 || (ev.type != SIM_EV_GPIO && sim_script_handle(ev.name) == NULL)){
+			fprintf(stderr, "%s:%lu: bad event\n", path, (unsigned long)number);
+			fclose(f);
+			return -1;
+		}
+		sim_events = realloc(sim_events, (sim_n_events + 1) * sizeof(ev));
+		sim_events[sim_n_events++] = ev;
+	}
+	fclose(f);
+	return (int)sim_n_events;
+}
+
+static void sim_script_play(const struct sim_event *ev)
+{
+	void 	*handle = sim_script_handle(ev->name);
+	uint8_t  bytes[SIM_SCRIPT_DATA];
+	uint16_t values[SIM_SCRIPT_DATA];
+	uint32_t count;
+
+	switch(ev->type){
+	case SIM_EV_UART:
+		for(uint32_t i = 0; i < ev->n; i++){
+			bytes[i] = (uint8_t)ev->data[i];
+		}
+		sim_uart_receive(handle, bytes, ev->n);
+		sim_uart_idle(handle);
+		break;
+	case SIM_EV_ADC:
+		for(uint32_t i = 0; i < ev->n; i++){
+			values[i] = (uint16_t)ev->data[i];
+		}
+		sim_adc_convert(handle, values, ev->n);
+		break;
+	case SIM_EV_GPIO:
+		sim_gpio_input(&sim_gpio[ev->name[0] - 'A'], (uint16_t)(1u << ev->arg),
+					   ev->data[0] ? GPIO_PIN_SET : GPIO_PIN_RESET);
+		break;
+	case SIM_EV_CAPTURE:
+		//first edge at the counter value, then one per width
+		count = ((TIM_HandleTypeDef *)handle)->Instance->CNT;
+		sim_tim_capture(handle, (ev->arg - 1) * 4, count);
+		for(uint32_t i = 0; i < ev->n; i++){
+			count += ev->data[i];
+			sim_tim_capture(handle, (ev->arg - 1) * 4, count);
+		}
+		break;
+	}
+}
+
+uint32_t sim_script_run(uint32_t tick)
+{
+	uint32_t played = 0;
+
+	for(uint32_t i = 0; i < sim_n_events; i++){
+		while(sim_events[i].left > 0 && (int32_t)(tick - sim_events[i].due) >= 0){
+			sim_script_play(&sim_events[i]);
+			sim_events[i].due += sim_events[i].period;
+			sim_events[i].left--;
+			played++;
+		}
+	}
+	return played;
+}
+
+uint8_t sim_script_done(void)
+{
+	for(uint32_t i = 0; i < sim_n_events; i++){
+		if(sim_events[i].left > 0){
+			return 0;
+		}
+	}
+	return 1;
+}
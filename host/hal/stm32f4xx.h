@@ -0,0 +1,7 @@
+#ifndef STM32F4XX_H_
+#define STM32F4XX_H_
+
+/* Device header of the host build: everything lives in the HAL stand-in */
+#include "stm32f4xx_hal.h"
+
+#endif /* STM32F4XX_H_ */
@@ -0,0 +1,433 @@
+#ifndef STM32F4XX_HAL_H_
+#define STM32F4XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Host stand-in for the parts of the STM32F4 HAL and CMSIS that the pure
+ * modules use (host/CMakeLists.txt lists them). Only what those modules
+ * touch is declared, with the HAL names and signatures:
+ *
+ *  - Cortex-M intrinsics. __DMB is a full fence, LDREX/STREX are plain
+ *    accesses that always succeed (the host build is single threaded
+ *    around them), the DSP intrinsics are left out so every module takes
+ *    its scalar path.
+ *  - DWT->CYCCNT reads the host time stamp counter: prof probes and the
+ *    benchmarks report host cycles, not Cortex-M4 cycles.
+ *  - The tick is a variable the tests move (sim_set_tick).
+ *  - CRC: the STM32 CRC unit in software (poly 0x04C11DB7, init
+ *    0xFFFFFFFF, 32 bit words, no reflection, no final xor).
+ *  - UART: blocking transmits are captured in a buffer (sim_uart_output).
+ *    A DMA transmit keeps the UART busy until the test ends it with
+ *    sim_uart_tx_complete, which calls HAL_UART_TxCpltCallback.
+ *    Reception by DMA into a circular buffer: sim_uart_receive writes the
+ *    bytes through the stream counter (NDTR) and raises the half and full
+ *    transfer callbacks where the DMA would, sim_uart_idle raises the idle
+ *    line interrupt and sim_uart_error a reception error.
+ *  - GPIO: ports A to E as register blocks. HAL_GPIO_Init sets MODER and
+ *    AFR, WritePin sets ODR, ReadPin reads IDR, which sim_gpio_input sets.
+ *  - TIM: input capture. sim_tim_capture latches a count in CCRx and, if
+ *    the channel was started with HAL_TIM_IC_Start_IT, calls
+ *    HAL_TIM_IC_CaptureCallback.
+ *  - ADC: HAL_ADC_Start_DMA takes the circular buffer, sim_adc_convert
+ *    writes conversions into it and raises the half and full callbacks.
+ *  - Flash: the 512 KB of the F411 mapped at 0x08000000 with its sector
+ *    layout. Programming can only clear bits, an erase sets a sector to
+ *    0xFF. HAL_FLASHEx_Erase_IT completes in HAL_FLASH_IRQHandler, which
+ *    the test calls in place of the interrupt. Every operation adds its
+ *    typical datasheet time to sim_flash_time_us, and sim_flash_cut
+ *    injects a power cut that tears one operation.
+ *  - System memory: the calibration page at 0x1FFF7A00, filled with
+ *    sim_set_sysmem.
+ */
+
+#define __IO 					volatile
+#define __STATIC_INLINE 		static inline
+#define UNUSED(x) 				((void)(x))
+
+typedef enum
+{
+  HAL_OK       = 0x00U,
+  HAL_ERROR    = 0x01U,
+  HAL_BUSY     = 0x02U,
+  HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+extern uint32_t SystemCoreClock;
+
+
+/******************************************************************************
+ * 								CORTEX-M									  *
+ ******************************************************************************/
+static inline void __DMB(void) 		{ __sync_synchronize(); }
+static inline void __DSB(void) 		{ __sync_synchronize(); }
+static inline void __ISB(void) 		{ __sync_synchronize(); }
+static inline void __NOP(void) 		{ }
+static inline void __CLREX(void) 	{ }
+
+static inline uint32_t __LDREXW(volatile uint32_t *addr)
+{
+	return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+	*addr = value;
+	return 0;
+}
+
+static inline uint16_t __LDREXH(volatile uint16_t *addr)
+{
+	return *addr;
+}
+
+static inline uint32_t __STREXH(uint16_t value, volatile uint16_t *addr)
+{
+	*addr = value;
+	return 0;
+}
+
+static inline uint32_t __CLZ(uint32_t value)
+{
+	return value ? (uint32_t)__builtin_clz(value) : 32;
+}
+
+static inline uint32_t __RBIT(uint32_t value)
+{
+	uint32_t result = 0;
+
+	for(int i = 0; i < 32; i++){
+		result = (result << 1) | ((value >> i) & 1);
+	}
+	return result;
+}
+
+extern uint32_t sim_primask;
+
+static inline uint32_t __get_PRIMASK(void) 			{ return sim_primask; }
+static inline void __set_PRIMASK(uint32_t primask) 	{ sim_primask = primask; }
+static inline void __disable_irq(void) 				{ sim_primask = 1; }
+static inline void __enable_irq(void) 				{ sim_primask = 0; }
+static inline uint32_t __get_IPSR(void) 			{ return 0; }
+
+typedef struct
+{
+  __IO uint32_t CTRL;
+  __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+  __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk 			(1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk 		(1UL << 24)
+
+/* Every DWT access refreshes CYCCNT from the time stamp counter */
+DWT_Type 		*sim_dwt(void);
+extern CoreDebug_Type sim_core_debug;
+#define DWT 			(sim_dwt())
+#define CoreDebug 		(&sim_core_debug)
+
+
+/******************************************************************************
+ * 								TICK										  *
+ ******************************************************************************/
+uint32_t 	HAL_GetTick(void);
+
+
+/******************************************************************************
+ * 								CRC											  *
+ ******************************************************************************/
+typedef struct
+{
+  void 		*Instance;
+} CRC_HandleTypeDef;
+
+uint32_t 	HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength);
+uint32_t 	HAL_CRC_Accumulate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength);
+
+
+/******************************************************************************
+ * 								DMA											  *
+ ******************************************************************************/
+typedef struct
+{
+  __IO uint32_t CR;
+  __IO uint32_t NDTR;
+  __IO uint32_t PAR;
+  __IO uint32_t M0AR;
+  __IO uint32_t M1AR;
+  __IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+  DMA_Stream_TypeDef 	*Instance;
+  void 					*Parent;
+} DMA_HandleTypeDef;
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__) 	((__HANDLE__)->Instance->NDTR)
+
+
+/******************************************************************************
+ * 								UART										  *
+ ******************************************************************************/
+typedef struct
+{
+  __IO uint32_t SR;
+  __IO uint32_t DR;
+  __IO uint32_t BRR;
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  __IO uint32_t CR3;
+  __IO uint32_t GTPR;
+} USART_TypeDef;
+
+#define USART_SR_ORE 				(1UL << 3)
+#define USART_SR_IDLE 				(1UL << 4)
+#define USART_CR1_IDLEIE 			(1UL << 4)
+
+typedef enum
+{
+  HAL_UART_STATE_RESET      = 0x00U,
+  HAL_UART_STATE_READY      = 0x20U,
+  HAL_UART_STATE_BUSY       = 0x24U,
+  HAL_UART_STATE_BUSY_TX    = 0x21U,
+  HAL_UART_STATE_BUSY_RX    = 0x22U,
+  HAL_UART_STATE_BUSY_TX_RX = 0x23U,
+  HAL_UART_STATE_TIMEOUT    = 0xA0U,
+  HAL_UART_STATE_ERROR      = 0xE0U
+} HAL_UART_StateTypeDef;
+
+#define HAL_UART_ERROR_NONE 		0x00000000U
+#define HAL_UART_ERROR_NE 			0x00000002U
+#define HAL_UART_ERROR_FE 			0x00000004U
+#define HAL_UART_ERROR_ORE 			0x00000008U
+#define HAL_UART_ERROR_DMA 			0x00000010U
+
+typedef struct __UART_HandleTypeDef
+{
+  USART_TypeDef 			*Instance;
+  uint8_t 					*pTxBuffPtr;
+  uint16_t 					TxXferSize;
+  uint8_t 					*pRxBuffPtr;
+  uint16_t 					RxXferSize;
+  DMA_HandleTypeDef 		*hdmatx;
+  DMA_HandleTypeDef 		*hdmarx;
+  __IO HAL_UART_StateTypeDef gState;
+  __IO HAL_UART_StateTypeDef RxState;
+  __IO uint32_t 			ErrorCode;
+} UART_HandleTypeDef;
+
+/* Only the CR1 interrupts, the HAL also encodes the register in the value */
+#define UART_FLAG_IDLE 				USART_SR_IDLE
+#define UART_IT_IDLE 				USART_CR1_IDLEIE
+
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__) 		(((__HANDLE__)->Instance->SR & (__FLAG__)) == (__FLAG__))
+#define __HAL_UART_CLEAR_IDLEFLAG(__HANDLE__) 			((__HANDLE__)->Instance->SR &= ~USART_SR_IDLE)
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __IT__) 		((__HANDLE__)->Instance->CR1 |= (__IT__))
+#define __HAL_UART_DISABLE_IT(__HANDLE__, __IT__) 		((__HANDLE__)->Instance->CR1 &= ~(__IT__))
+#define __HAL_UART_GET_IT_SOURCE(__HANDLE__, __IT__) 	(((__HANDLE__)->Instance->CR1 & (__IT__)) == (__IT__))
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void 			  HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void 			  HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void 			  HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void 			  HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+
+/******************************************************************************
+ * 								GPIO										  *
+ ******************************************************************************/
+typedef struct
+{
+  __IO uint32_t MODER;
+  __IO uint32_t OTYPER;
+  __IO uint32_t OSPEEDR;
+  __IO uint32_t PUPDR;
+  __IO uint32_t IDR;
+  __IO uint32_t ODR;
+  __IO uint32_t BSRR;
+  __IO uint32_t LCKR;
+  __IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct
+{
+  uint32_t Pin;
+  uint32_t Mode;
+  uint32_t Pull;
+  uint32_t Speed;
+  uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+  GPIO_PIN_RESET = 0,
+  GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0 					((uint16_t)0x0001)
+#define GPIO_PIN_1 					((uint16_t)0x0002)
+#define GPIO_PIN_2 					((uint16_t)0x0004)
+#define GPIO_PIN_3 					((uint16_t)0x0008)
+#define GPIO_PIN_4 					((uint16_t)0x0010)
+#define GPIO_PIN_5 					((uint16_t)0x0020)
+#define GPIO_PIN_6 					((uint16_t)0x0040)
+#define GPIO_PIN_7 					((uint16_t)0x0080)
+#define GPIO_PIN_8 					((uint16_t)0x0100)
+#define GPIO_PIN_9 					((uint16_t)0x0200)
+#define GPIO_PIN_10 				((uint16_t)0x0400)
+#define GPIO_PIN_11 				((uint16_t)0x0800)
+#define GPIO_PIN_12 				((uint16_t)0x1000)
+#define GPIO_PIN_13 				((uint16_t)0x2000)
+#define GPIO_PIN_14 				((uint16_t)0x4000)
+#define GPIO_PIN_15 				((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT 			0x00000000U
+#define GPIO_MODE_OUTPUT_PP 		0x00000001U
+#define GPIO_MODE_AF_PP 			0x00000002U
+#define GPIO_MODE_ANALOG 			0x00000003U
+
+#define GPIO_NOPULL 				0x00000000U
+#define GPIO_PULLUP 				0x00000001U
+#define GPIO_PULLDOWN 				0x00000002U
+
+#define GPIO_SPEED_FREQ_LOW 		0x00000000U
+#define GPIO_SPEED_FREQ_MEDIUM 		0x00000001U
+#define GPIO_SPEED_FREQ_HIGH 		0x00000002U
+#define GPIO_SPEED_FREQ_VERY_HIGH 	0x00000003U
+
+#define GPIO_AF1_TIM2 				((uint8_t)0x01)
+
+extern GPIO_TypeDef sim_gpio[5];
+#define GPIOA 			(&sim_gpio[0])
+#define GPIOB 			(&sim_gpio[1])
+#define GPIOC 			(&sim_gpio[2])
+#define GPIOD 			(&sim_gpio[3])
+#define GPIOE 			(&sim_gpio[4])
+
+void 		  HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void 		  HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+
+/******************************************************************************
+ * 								TIM											  *
+ ******************************************************************************/
+typedef struct
+{
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  __IO uint32_t SMCR;
+  __IO uint32_t DIER;
+  __IO uint32_t SR;
+  __IO uint32_t EGR;
+  __IO uint32_t CCMR1;
+  __IO uint32_t CCMR2;
+  __IO uint32_t CCER;
+  __IO uint32_t CNT;
+  __IO uint32_t PSC;
+  __IO uint32_t ARR;
+  __IO uint32_t RCR;
+  __IO uint32_t CCR1;
+  __IO uint32_t CCR2;
+  __IO uint32_t CCR3;
+  __IO uint32_t CCR4;
+} TIM_TypeDef;
+
+typedef enum
+{
+  HAL_TIM_ACTIVE_CHANNEL_1       = 0x01U,
+  HAL_TIM_ACTIVE_CHANNEL_2       = 0x02U,
+  HAL_TIM_ACTIVE_CHANNEL_3       = 0x04U,
+  HAL_TIM_ACTIVE_CHANNEL_4       = 0x08U,
+  HAL_TIM_ACTIVE_CHANNEL_CLEARED = 0x00U
+} HAL_TIM_ActiveChannel;
+
+typedef struct
+{
+  TIM_TypeDef 			*Instance;
+  HAL_TIM_ActiveChannel Channel;
+} TIM_HandleTypeDef;
+
+#define TIM_CHANNEL_1 				0x00000000U
+#define TIM_CHANNEL_2 				0x00000004U
+#define TIM_CHANNEL_3 				0x00000008U
+#define TIM_CHANNEL_4 				0x0000000CU
+
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__) 	((__HANDLE__)->Instance->CNT = (__COUNTER__))
+#define __HAL_TIM_GET_COUNTER(__HANDLE__) 				((__HANDLE__)->Instance->CNT)
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+uint32_t 		  HAL_TIM_ReadCapturedValue(TIM_HandleTypeDef *htim, uint32_t Channel);
+void 			  HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim);
+
+
+/******************************************************************************
+ * 								ADC											  *
+ ******************************************************************************/
+typedef struct
+{
+  void 					*Instance;
+  DMA_HandleTypeDef 	*DMA_Handle;
+} ADC_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length);
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc);
+void 			  HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc);
+void 			  HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc);
+
+
+/******************************************************************************
+ * 								FLASH										  *
+ ******************************************************************************/
+#define FLASH_BASE 					0x08000000UL
+#define FLASH_SIZE 					(512 * 1024)
+
+#define FLASH_TYPEPROGRAM_BYTE 		0x00000000U
+#define FLASH_TYPEPROGRAM_HALFWORD 	0x00000001U
+#define FLASH_TYPEPROGRAM_WORD 		0x00000002U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x00000003U
+
+#define FLASH_TYPEERASE_SECTORS 	0x00000000U
+#define FLASH_TYPEERASE_MASSERASE 	0x00000001U
+#define FLASH_VOLTAGE_RANGE_3 		0x00000002U
+
+#define FLASH_SECTOR_0 				0U
+#define FLASH_SECTOR_1 				1U
+#define FLASH_SECTOR_2 				2U
+#define FLASH_SECTOR_3 				3U
+#define FLASH_SECTOR_4 				4U
+#define FLASH_SECTOR_5 				5U
+#define FLASH_SECTOR_6 				6U
+#define FLASH_SECTOR_7 				7U
+
+typedef struct
+{
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t Sector;
+  uint32_t NbSectors;
+  uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit);
+void 			  HAL_FLASH_IRQHandler(void);
+void 			  HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue);
+void 			  HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue);
+
+
+#include "hal_sim.h"
+
+#endif /* STM32F4XX_HAL_H_ */
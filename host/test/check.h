@@ -0,0 +1,34 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+
+/*
+ * Minimal test support: CHECK counts and reports failures and lets the test
+ * go on, CHECK_DONE is the return value of main (ctest fails on non zero).
+ */
+
+static int check_failures = 0;
+
+#define CHECK(cond) 														\
+	do{ 																	\
+		if(!(cond)){ 														\
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			check_failures++; 												\
+		} 																	\
+	}while(0)
+
+#define CHECK_DONE() 	(check_failures == 0 ? 0 : 1)
+
+/* Deterministic random numbers, xorshift32 */
+static inline uint32_t check_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+#endif /* CHECK_H_ */
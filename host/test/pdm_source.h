@@ -0,0 +1,99 @@
+#ifndef PDM_SOURCE_H_
+#define PDM_SOURCE_H_
+
+#include <math.h>
+#include <string.h>
+
+/*
+ * PDM microphone model for the tests: a second order sigma-delta
+ * modulator in double precision, packed like the I2S2 DMA buffer of the
+ * BSP (PDM_FILTER_BIT_ORDER_LSB: the MSB of a byte is the oldest bit,
+ * PDM_FILTER_ENDIANNESS_BE: bytes swapped in pairs).
+ */
+
+struct pdm_source{
+	double 		rate;				// PDM bits per second
+	double 		phase;				// Cycles
+	double 		i1, i2;				// Integrators
+	double 		y;					// Last output bit, +-1
+};
+
+static inline void pdm_source_init(struct pdm_source *s, double rate)
+{
+	memset(s, 0, sizeof(*s));
+	s->rate = rate;
+	s->y 	= 1;
+}
+
+/**
+ * @brief modulates bytes * 8 bits of a sine plus an offset
+ * @param amplitude:	full scale 1, stable below about 0.7
+ */
+static inline void pdm_source_sine(struct pdm_source *s, uint8_t *out, uint32_t bytes,
+								   double hz, double amplitude, double offset)
+{
+	double x;
+
+	for(uint32_t b = 0; b < bytes; b++){
+		uint8_t byte = 0;
+
+		for(int k = 0; k < 8; k++){
+			x 		  = amplitude * sin(2 * M_PI * s->phase) + offset;
+			s->phase += hz / s->rate;
+			if(s->phase >= 1){
+				s->phase -= 1;
+			}
+			s->i1 += x - s->y;
+			s->i2 += s->i1 - s->y;
+			s->y   = s->i2 >= 0 ? 1 : -1;
+			byte   = (byte << 1) | (s->y > 0);
+		}
+		out[b ^ 1] = byte;
+	}
+}
+
+/**
+ * @brief least squares fit of a * sin + b * cos + c at hz
+ * @param amplitude:	fitted amplitude
+ * @param noise:		residual power
+ */
+static inline void pdm_fit(const int16_t *x, uint32_t n, double hz, double fs,
+						   double *amplitude, double *noise)
+{
+	double m[3][4] = {{0}}, basis[3], coef[3], r, sum = 0;
+
+	for(uint32_t i = 0; i < n; i++){
+		basis[0] = sin(2 * M_PI * hz * i / fs);
+		basis[1] = cos(2 * M_PI * hz * i / fs);
+		basis[2] = 1;
+		for(int a = 0; a < 3; a++){
+			for(int b = 0; b < 3; b++){
+				m[a][b] += basis[a] * basis[b];
+			}
+			m[a][3] += basis[a] * x[i];
+		}
+	}
+	//Gauss-Jordan on the 3x3 normal equations
+	for(int a = 0; a < 3; a++){
+		for(int b = 0; b < 3; b++){
+			if(b != a){
+				double f = m[b][a] / m[a][a];
+
+				for(int c = 0; c < 4; c++){
+					m[b][c] -= f * m[a][c];
+				}
+			}
+		}
+	}
+	for(int a = 0; a < 3; a++){
+		coef[a] = m[a][3] / m[a][a];
+	}
+	for(uint32_t i = 0; i < n; i++){
+		r = x[i] - coef[0] * sin(2 * M_PI * hz * i / fs) - coef[1] * cos(2 * M_PI * hz * i / fs) - coef[2];
+		sum += r * r;
+	}
+	*amplitude = sqrt(coef[0] * coef[0] + coef[1] * coef[1]);
+	*noise 	   = sum / n;
+}
+
+#endif /* PDM_SOURCE_H_ */
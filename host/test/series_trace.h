@@ -0,0 +1,90 @@
+#ifndef SERIES_TRACE_H_
+#define SERIES_TRACE_H_
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+ * Synthetic station traces for the series tests and benchmark, there are
+ * no recorded ones in the tree. Deterministic: same seed, same trace.
+ * Values come out at the resolution the sensor delivers them.
+ */
+
+enum series_trace_kind{
+	TRACE_TEMP_BOARD,		// 1 s, 0.1 C, daily swing plus die noise
+	TRACE_HUM_SOIL,			// 1 s, 1 %, slow drying with ADC flicker
+	TRACE_TEMP_DHT11,		// 2 s, 1 C steps
+	TRACE_MIC_LA,			// 1 s with +-2 ms scheduling jitter, 0.1 dB
+	TRACE_KINDS
+};
+
+struct series_trace{
+	enum series_trace_kind kind;
+	uint32_t 			   seed;
+	uint32_t 			   n;
+	uint32_t 			   tick;
+	double 				   level;
+};
+
+static const char *const series_trace_name[TRACE_KINDS] = {
+	"board temp, 1 s, x10", "soil humidity, 1 s, x1", "DHT11 temp, 2 s, x1", "mic LA, 1 s jitter, x10",
+};
+
+static const uint8_t series_trace_decimals[TRACE_KINDS] = {1, 0, 0, 1};
+
+static inline double series_trace_rand(struct series_trace *tr)
+{
+	uint32_t x = tr->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	tr->seed = x;
+	return x / 4294967296.0;
+}
+
+static inline void series_trace_init(struct series_trace *tr, enum series_trace_kind kind, uint32_t start_tick)
+{
+	tr->kind  = kind;
+	tr->seed  = 0x9E3779B9u ^ kind;
+	tr->n 	  = 0;
+	tr->tick  = start_tick;
+	tr->level = 0;
+}
+
+/**
+ * @brief next sample of the trace
+ */
+static inline void series_trace_next(struct series_trace *tr, uint32_t *tick, float *value)
+{
+	double 	t = tr->n++, day = 2 * M_PI * t / 86400, v;
+	int32_t jitter = 0;
+
+	switch(tr->kind){
+	case TRACE_TEMP_BOARD:
+		tr->tick += 1000;
+		tr->level += (series_trace_rand(tr) - 0.5) * 0.02;
+		v = 31 + 6 * sin(day) + tr->level + (series_trace_rand(tr) - 0.5) * 0.3;
+		v = round(v * 10) / 10;
+		break;
+	case TRACE_HUM_SOIL:
+		tr->tick += 1000;
+		v = 62 - 10 * t / 100000 + (series_trace_rand(tr) < 0.1 ? (series_trace_rand(tr) < 0.5 ? -1 : 1) : 0);
+		v = round(v);
+		break;
+	case TRACE_TEMP_DHT11:
+		tr->tick += 2000;
+		v = round(18 + 5 * sin(2 * day) + (series_trace_rand(tr) - 0.5) * 0.6);
+		break;
+	default:
+		tr->tick += 1000;
+		jitter 	  = (int32_t)(series_trace_rand(tr) * 5) - 2;
+		v = -42 + 8 * sin(day * 24) + (series_trace_rand(tr) - 0.5) * 6;
+		v = round(v * 10) / 10;
+		break;
+	}
+	*tick  = tr->tick + jitter;
+	*value = (float)v;
+}
+
+#endif /* SERIES_TRACE_H_ */
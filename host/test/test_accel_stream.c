@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <string.h>
+#include "accel_stream.h"
+#include "check.h"
+
+/*
+ * LSM303DLHC accelerometer FIFO on a simulated register file, driven the
+ * way the BSP drives it:
+ *  - a sample every 2500 us (400 Hz) enters the 32 deep FIFO, in stream
+ *    mode the oldest is overwritten when it is full;
+ *  - INT1 is high while the FIFO holds the watermark; its rising edge is
+ *    the EXTI interrupt (accel_stream_watermark);
+ *  - a burst read auto-increments from OUT_X_L_A and wraps from OUT_Z_H_A
+ *    back to it, each wrap pops one sample. It ends 2300 us later (96 bytes
+ *    at 400 kHz) in the completion callback with the INT1 level, or in the
+ *    error callback;
+ *  - the sensor task runs every 10 ms: BSP_ACCEL_Read (restart if the line
+ *    is high and nothing runs, then read the ring) and, when asked, a
+ *    magnetometer read that claims the bus for 300 us.
+ * Sample n carries x = n, y = ~n, z = n >> 16, so order and gaps show.
+ */
+
+#define OUT_X_L_A 		0x28
+#define OUT_Z_H_A 		0x2D
+#define FIFO_DEPTH 		32
+#define WATERMARK 		16
+#define STEP_US 		50
+#define SAMPLE_US 		2500
+#define TRANSFER_US 	2300
+#define TASK_US 		10000
+#define MAG_US 			300
+
+struct sim{
+	uint8_t 	fifo[FIFO_DEPTH][6];
+	uint8_t 	level;
+	uint8_t 	first;
+	uint32_t 	produced;			// Samples made by the sensor
+	uint32_t 	overrun;			// Samples overwritten in the FIFO
+	uint8_t 	line;				// INT1
+	uint8_t 	*dst;				// Transfer running: destination
+	uint16_t 	bytes;
+	uint8_t 	addr;
+	uint32_t 	now_us;
+	uint32_t 	end_us;
+	uint32_t 	reads;				// Burst reads asked for
+	uint32_t 	refused;			// Reads that did not start
+	uint32_t 	failed;				// Reads ended by a bus error
+	uint32_t 	popped;				// Samples popped by the failed reads
+	uint32_t 	fail_every;			// Fail every Nth read, 0 never
+	uint32_t 	refuse_every;		// Refuse to start every Nth read, 0 never
+};
+
+static struct sim 		sim;
+static accel_stream_t 	as;
+
+static void sim_produce(void)
+{
+	uint32_t n = sim.produced++;
+	uint8_t *s;
+
+	if(sim.level == FIFO_DEPTH){
+		sim.first = (sim.first + 1) % FIFO_DEPTH;
+		sim.level--;
+		sim.overrun++;
+	}
+	s = sim.fifo[(sim.first + sim.level) % FIFO_DEPTH];
+	s[0] = n; 	   s[1] = n >> 8;
+	s[2] = ~n; 	   s[3] = ~n >> 8;
+	s[4] = n >> 16; s[5] = n >> 24;
+	sim.level++;
+}
+
+//one register read of the auto-increment burst
+static uint8_t sim_register(void)
+{
+	uint8_t value = sim.level ? sim.fifo[sim.first][sim.addr - OUT_X_L_A] : 0;
+
+	if(sim.addr++ == OUT_Z_H_A){
+		sim.addr = OUT_X_L_A;
+		if(sim.level){
+			sim.first = (sim.first + 1) % FIFO_DEPTH;
+			sim.level--;
+		}
+	}
+	return value;
+}
+
+/* accel_read_t: starts the DMA burst, LSM303DLHC_AccFifoRead_DMA */
+static uint8_t sim_read(uint8_t *buffer, uint8_t samples)
+{
+	CHECK(sim.dst == NULL);
+	sim.reads++;
+	if(sim.refuse_every && sim.reads % sim.refuse_every == 0){
+		sim.refused++;
+		return 0;
+	}
+	sim.dst 	= buffer;
+	sim.bytes 	= samples * 6;
+	sim.addr 	= OUT_X_L_A;
+	sim.end_us 	= sim.now_us + TRANSFER_US;
+	return 1;
+}
+
+//INT1 level, and the EXTI on its rising edge
+static void sim_line(uint32_t tick)
+{
+	uint8_t line = sim.level >= WATERMARK;
+
+	if(line && !sim.line){
+		sim.line = 1;
+		accel_stream_watermark(&as, tick);
+	}
+	sim.line = line;
+}
+
+/**
+ * @brief runs the sensor and the bus until us
+ */
+static void sim_run(uint32_t *now, uint32_t until)
+{
+	uint8_t fail;
+
+	for(; *now < until; *now += STEP_US){
+		sim.now_us = *now;
+		sim_set_tick(*now / 1000);
+		if(*now % SAMPLE_US == 0){
+			sim_produce();
+		}
+		sim_line(HAL_GetTick());
+		if(sim.dst != NULL && *now >= sim.end_us){
+			fail = sim.fail_every && sim.reads % sim.fail_every == 0;
+			//a failed read stops half way: half a block popped and lost
+			for(uint16_t i = 0; i < (fail ? sim.bytes / 2 : sim.bytes); i++){
+				sim.dst[i] = sim_register();
+			}
+			sim.dst = NULL;
+			if(fail){
+				sim.failed++;
+				sim.popped += sim.bytes / 12;
+				accel_stream_error(&as);
+			}
+			else{
+				sim.line = sim.level >= WATERMARK;
+				accel_stream_done(&as, HAL_GetTick(), sim.line);
+			}
+		}
+	}
+}
+
+struct result{
+	uint32_t 	samples;
+	uint32_t 	gaps;				// Samples missing between two received ones
+	uint32_t 	disorder;			// Samples out of order or damaged
+	uint32_t 	mag_reads;
+};
+
+/**
+ * @brief runs seconds of streaming with the sensor task every 10 ms
+ * @param mag_every:	magnetometer read every that many task runs, 0 never
+ * @param stall_every:	task skips reading the ring for 250 ms every that many runs, 0 never
+ */
+static void run(uint32_t seconds, uint32_t mag_every, uint32_t stall_every, struct result *r)
+{
+	accel_block_t block;
+	uint32_t 	  now = 0, expect = 0, runs = 0, last_tick = 0, skip = 0;
+	uint16_t 	  x, y;
+
+	memset(r, 0, sizeof(*r));
+	accel_stream_init(&as, sim_read, WATERMARK);
+
+	while(now < seconds * 1000000u){
+		sim_run(&now, now + TASK_US);
+		runs++;
+
+		//magnetometer on the same bus, between two bursts
+		if(mag_every && runs % mag_every == 0 && accel_stream_claim(&as)){
+			sim_run(&now, now + MAG_US);
+			accel_stream_release(&as, HAL_GetTick());
+			r->mag_reads++;
+		}
+
+		if(stall_every && runs % stall_every == 0){
+			skip = 25;
+		}
+		if(skip){
+			skip--;
+			continue;
+		}
+		//BSP_ACCEL_Read: restart a stream a lost read left stalled
+		if(!as.busy && sim.line){
+			accel_stream_watermark(&as, HAL_GetTick());
+		}
+		while(accel_stream_read(&as, &block)){
+			CHECK(block.count == WATERMARK);
+			CHECK(block.tick >= last_tick);
+			last_tick = block.tick;
+			for(uint8_t i = 0; i < block.count; i++){
+				uint32_t n = (uint16_t)block.xyz[i][0] | ((uint32_t)(uint16_t)block.xyz[i][2] << 16);
+
+				x = block.xyz[i][0];
+				y = block.xyz[i][1];
+				if((uint16_t)(x ^ y) != 0xFFFF || n < expect){
+					r->disorder++;
+					continue;
+				}
+				r->gaps   += n - expect;
+				expect 	   = n + 1;
+				r->samples++;
+			}
+		}
+	}
+}
+
+/* Steady stream: every sample in order, one transaction per 16 samples */
+static void test_stream(void)
+{
+	struct result r;
+
+	memset(&sim, 0, sizeof(sim));
+	run(250, 0, 0, &r);
+	printf("stream: %lu samples in %lu transfers (%.4f per sample), lost %lu, overrun %lu\n",
+		   (unsigned long)r.samples, (unsigned long)as.transfers, (double)as.transfers / r.samples,
+		   (unsigned long)as.lost, (unsigned long)sim.overrun);
+	CHECK(r.disorder == 0 && r.gaps == 0);
+	CHECK(as.lost == 0 && sim.overrun == 0);
+	CHECK(as.transfers * WATERMARK == as.samples);
+	CHECK(r.samples == as.samples);
+	CHECK(r.samples + sim.level >= sim.produced - WATERMARK);
+}
+
+/* The magnetometer borrows the bus: watermarks meanwhile are served on release */
+static void test_claim(void)
+{
+	struct result r;
+
+	memset(&sim, 0, sizeof(sim));
+	run(100, 3, 0, &r);
+	printf("claim: %lu magnetometer reads, %lu samples, %lu transfers, lost %lu\n",
+		   (unsigned long)r.mag_reads, (unsigned long)r.samples, (unsigned long)as.transfers,
+		   (unsigned long)as.lost);
+	CHECK(r.mag_reads > 0);
+	CHECK(r.disorder == 0 && r.gaps == 0 && as.lost == 0 && sim.overrun == 0);
+	CHECK(as.transfers * WATERMARK == as.samples);
+}
+
+/* Failed and refused reads: counted, the task restarts the stream, order kept */
+static void test_errors(void)
+{
+	struct result r;
+
+	memset(&sim, 0, sizeof(sim));
+	sim.fail_every 	 = 37;
+	sim.refuse_every = 53;
+	run(100, 0, 0, &r);
+	printf("errors: %lu samples, %lu missing, %lu failed and %lu refused of %lu reads, lost %lu, overrun %lu\n",
+		   (unsigned long)r.samples, (unsigned long)r.gaps, (unsigned long)sim.failed,
+		   (unsigned long)sim.refused, (unsigned long)sim.reads, (unsigned long)as.lost,
+		   (unsigned long)sim.overrun);
+	CHECK(r.disorder == 0);
+	CHECK(sim.failed > 0 && sim.refused > 0);
+	CHECK(as.lost == sim.failed + sim.refused);
+	//missing: what the failed reads popped plus what the FIFO overwrote meanwhile
+	CHECK(r.gaps == sim.popped + sim.overrun);
+	CHECK(r.samples + sim.level + r.gaps >= sim.produced - WATERMARK);
+}
+
+/* A task that stops reading: full ring drops whole blocks, the FIFO never overruns */
+static void test_ring_full(void)
+{
+	struct result r;
+
+	memset(&sim, 0, sizeof(sim));
+	run(60, 0, 100, &r);
+	printf("ring full: %lu samples, %lu missing, lost %lu blocks\n",
+		   (unsigned long)r.samples, (unsigned long)r.gaps, (unsigned long)as.lost);
+	CHECK(r.disorder == 0 && sim.overrun == 0);
+	CHECK(as.lost > 0 && r.gaps == as.lost * WATERMARK);
+}
+
+int main(void)
+{
+	sim_init();
+	test_stream();
+	test_claim();
+	test_errors();
+	test_ring_full();
+	return CHECK_DONE();
+}
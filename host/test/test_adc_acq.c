@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "adc_acq.h"
+#include "check.h"
+
+/*
+ * adc_acq on the simulated ADC and circular DMA. TIM5 triggers one scan
+ * of the three channels per period (1 ms in the BSP), the DMA half / full
+ * callbacks hand the finished half to adc_acq_process as
+ * HAL_ADC_ConvHalfCpltCallback / HAL_ADC_ConvCpltCallback do.
+ *
+ *  - hand-off: each scan carries its number in the soil channel, so the
+ *    half handed over must hold the 16 scans that just ended. The block is
+ *    also processed up to 15 scans late, while the DMA writes the other
+ *    half, as a delayed interrupt would;
+ *  - filter: block averages and the first order filter against a double
+ *    model, for a step with noise on the temperature channel;
+ *  - samples/s: the 1 s window at 1000, 800 and 333 scans/s, with the tick
+ *    wrapping past 2^32 on the way.
+ */
+
+#define SCAN 			ADC_ACQ_CHANNELS
+
+static ADC_HandleTypeDef hadc = { (void *)0x40012000, NULL };
+static adc_acq_t 		 acq;
+static const uint16_t 	*pending;				// Half waiting for the late interrupt
+static uint32_t 		 pending_end;			// Scans done when it ended
+static uint32_t 		 scans;
+static uint32_t 		 latency;				// Scans between the DMA event and its interrupt
+static uint32_t 		 blocks, bad_blocks;
+static double 			 model[SCAN];
+static double 			 max_error;
+
+static void handoff(const uint16_t *half)
+{
+	pending 	= half;
+	pending_end = scans + 1;
+}
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *h)
+{
+	handoff(&acq.buffer[0]);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *h)
+{
+	handoff(&acq.buffer[ADC_ACQ_HALF]);
+}
+
+/* The interrupt, latency scans after the DMA event */
+static void serve(void)
+{
+	uint32_t sum;
+	double 	 v;
+
+	if(pending == NULL || scans - pending_end < latency){
+		return;
+	}
+	//the 16 scans that ended the half, the DMA is on the other one
+	for(uint32_t s = 0; s < ADC_ACQ_SCANS; s++){
+		bad_blocks += pending[s * SCAN + 1] != ((pending_end - ADC_ACQ_SCANS + s) & 0xFFF);
+	}
+	for(int ch = 0; ch < SCAN; ch++){
+		sum = 0;
+		for(uint32_t s = 0; s < ADC_ACQ_SCANS; s++){
+			sum += pending[s * SCAN + ch];
+		}
+		v 		  = (double)sum * 16 / ADC_ACQ_SCANS;
+		model[ch] = acq.primed ? model[ch] + (v - model[ch]) / 4 : v;
+	}
+	adc_acq_process(&acq, pending, HAL_GetTick());
+	for(int ch = 0; ch < SCAN; ch++){
+		v 		  = fabs(acq.filtered[ch] - model[ch]);
+		max_error = v > max_error ? v : max_error;
+		CHECK(adc_acq_get(&acq, ch) == (uint16_t)floor(acq.filtered[ch] / 16.0 + 0.5));
+	}
+	pending = NULL;
+	blocks++;
+}
+
+static void start(uint32_t tick)
+{
+	sim_init();
+	sim_set_tick(tick);
+	pending = NULL;
+	scans 	= blocks = bad_blocks = 0;
+	CHECK(adc_acq_start(&acq, &hadc) == HAL_OK);
+}
+
+static void convert(uint16_t temp, uint16_t vref)
+{
+	uint16_t scan[SCAN] = { temp, scans & 0xFFF, vref };
+
+	CHECK(sim_adc_convert(&hadc, scan, SCAN) == SCAN);
+	scans++;
+	serve();
+}
+
+/* Hand-off and filter: 2 s at 1 kHz, temperature step at 1 s */
+static void test_filter(void)
+{
+	uint32_t seed = 5, settled = 0;
+	int32_t  noise;
+
+	for(latency = 0; latency < ADC_ACQ_SCANS; latency += 5){
+		start(0);
+		max_error = 0;
+		for(uint32_t ms = 0; ms < 2000; ms++){
+			sim_set_tick(ms);
+			noise = (int32_t)(check_rand(&seed) % 41) - 20;
+			convert((ms < 1000 ? 1000 : 1200) + noise, 1500 + (int32_t)(check_rand(&seed) % 7) - 3);
+			if(ms >= 1000 && settled == 0 && adc_acq_get(&acq, 0) >= 1195){
+				settled = ms - 1000;
+			}
+		}
+		printf("interrupt %2lu scans late: %lu blocks, %lu out of place, filter off the model by %.2f / 16 counts at most\n",
+			   (unsigned long)latency, (unsigned long)blocks, (unsigned long)bad_blocks, max_error);
+		CHECK(blocks == 2000 / ADC_ACQ_SCANS - (latency > 0));
+		CHECK(bad_blocks == 0);
+		CHECK(max_error < 4);
+		CHECK(abs(adc_acq_get(&acq, 0) - 1200) <= 5 && abs(adc_acq_get(&acq, 2) - 1500) <= 1);
+	}
+	printf("200 count step: within 5 counts after %lu ms\n", (unsigned long)settled);
+	CHECK(settled > 0 && settled < 400);
+}
+
+/* Samples/s over the 1 s window, tick wrapping */
+static void test_rate(void)
+{
+	static const uint32_t periods_us[] = { 1000, 1250, 3000 };
+	const uint32_t 		  t0 = 0xFFFFFFFFu - 2500;
+	uint32_t 			  expected, windows, last;
+
+	latency = 0;
+	for(unsigned p = 0; p < sizeof(periods_us) / sizeof(periods_us[0]); p++){
+		start(t0);
+		expected = 1000000 / periods_us[p];
+		windows  = 0;
+		last 	 = t0;
+		for(uint64_t us = 0; us < 6000000; us += periods_us[p]){
+			sim_set_tick(t0 + (uint32_t)(us / 1000));
+			convert(1000, 1500);
+			if(us < 1000000){
+				CHECK(adc_acq_rate(&acq, 0) == 0);
+			}
+			if(acq.window_start != last){
+				last = acq.window_start;
+				windows++;
+				for(int ch = 0; ch < SCAN; ch++){
+					CHECK(adc_acq_rate(&acq, ch) + 1 >= expected && adc_acq_rate(&acq, ch) <= expected + 1);
+				}
+			}
+		}
+		printf("%4lu scans/s: %lu windows, rate %lu samples/s per channel\n", (unsigned long)expected,
+			   (unsigned long)windows, (unsigned long)adc_acq_rate(&acq, 1));
+		CHECK(windows == 5);
+	}
+}
+
+int main(void)
+{
+	test_filter();
+	test_rate();
+	return CHECK_DONE();
+}
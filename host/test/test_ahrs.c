@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <math.h>
+#include "ahrs.h"
+#include "prof.h"
+#include "check.h"
+
+/*
+ * Replay of a mast trace through the BSP_IMU_Update pipeline: gyro blocks
+ * of 16 samples at 760 Hz, accelerometer blocks of 16 at 400 Hz whose mean
+ * is the gravity reference, one magnetometer reading (75 Hz) per gyro
+ * drain. The task runs whenever a block completes, like the IMU
+ * notifications wake it. No recorded trace exists yet, so the trace is
+ * synthetic: heading 30 +- 20 deg, roll 5 deg at 0.5 Hz plus a 3 Hz sway,
+ * pitch 3 deg at 0.2 Hz. Readings are quantised to the sensor LSBs, the
+ * gyro carries a bias and every sensor some noise.
+ */
+
+#define GYRO_RATE 			760
+#define ACC_RATE 			400
+#define MAG_RATE 			75
+#define BLOCK 				16
+#define SECONDS 			120
+#define SETTLE 				10
+#define DEG 				(M_PI / 180)
+#define GYRO_RAD_PER_LSB 	(0.0175f * 0.0174532925f)	// As the BSP, 500 dps
+#define GYRO_LSB_PER_DPS 	(1 / 0.0175)
+#define ACC_LSB_PER_G 		1000						// 2 g, 1 mg per count
+#define MAG_LSB_PER_GA 		1100						// 1.3 Ga
+#define MAG_FIELD_GA 		0.5
+
+static const double gyro_bias_dps[3] = {0.6, -0.4, 0.3};
+
+struct attitude{
+	double q[4];			// Board to earth, w x y z
+	double heading, roll, pitch;
+};
+
+static void reference(double t, struct attitude *a)
+{
+	double h, cr, sr, cp, sp, cy, sy;
+
+	a->heading = 30 + 20 * sin(2 * M_PI * 0.02 * t);
+	a->roll    = 5 * sin(2 * M_PI * 0.5 * t) + 0.5 * sin(2 * M_PI * 3 * t);
+	a->pitch   = 3 * sin(2 * M_PI * 0.2 * t + 1);
+
+	//yaw about Z up turns X (north) towards Y (west), heading goes the other way
+	h  = -a->heading * DEG / 2;
+	cy = cos(h); sy = sin(h);
+	cp = cos(a->pitch * DEG / 2); sp = sin(a->pitch * DEG / 2);
+	cr = cos(a->roll * DEG / 2);  sr = sin(a->roll * DEG / 2);
+	a->q[0] = cr * cp * cy + sr * sp * sy;
+	a->q[1] = sr * cp * cy - cr * sp * sy;
+	a->q[2] = cr * sp * cy + sr * cp * sy;
+	a->q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+//earth vector into the board frame, v_b = q* v_e q
+static void to_board(const double *q, const double *e, double *b)
+{
+	double w = q[0], x = q[1], y = q[2], z = q[3];
+
+	b[0] = (1 - 2 * (y * y + z * z)) * e[0] + 2 * (x * y + w * z) * e[1] + 2 * (x * z - w * y) * e[2];
+	b[1] = 2 * (x * y - w * z) * e[0] + (1 - 2 * (x * x + z * z)) * e[1] + 2 * (y * z + w * x) * e[2];
+	b[2] = 2 * (x * z + w * y) * e[0] + 2 * (y * z - w * x) * e[1] + (1 - 2 * (x * x + y * y)) * e[2];
+}
+
+//board angular rate in rad/s, 2 q* dq/dt
+static void rate(double t, double *w)
+{
+	struct attitude a, b;
+	double 			h = 1e-5, d[4];
+
+	reference(t - h, &a);
+	reference(t + h, &b);
+	for(int i = 0; i < 4; i++){
+		d[i] = (b.q[i] - a.q[i]) / (2 * h);
+	}
+	reference(t, &a);
+	w[0] = 2 * (a.q[0] * d[1] - a.q[1] * d[0] - a.q[2] * d[3] + a.q[3] * d[2]);
+	w[1] = 2 * (a.q[0] * d[2] + a.q[1] * d[3] - a.q[2] * d[0] - a.q[3] * d[1]);
+	w[2] = 2 * (a.q[0] * d[3] - a.q[1] * d[2] + a.q[2] * d[1] - a.q[3] * d[0]);
+}
+
+static uint32_t seed = 11;
+
+//roughly gaussian, unit variance
+static double noise(void)
+{
+	double s = 0;
+
+	for(int i = 0; i < 12; i++){
+		s += check_rand(&seed) / 4294967296.0;
+	}
+	return s - 6;
+}
+
+static int16_t lsb(double v)
+{
+	return (int16_t)lrint(v);
+}
+
+struct errors{
+	double tilt_rms, tilt_max, heading_rms, heading_max;
+	uint32_t n;
+};
+
+static void compare(const ahrs_t *ah, double t, struct errors *e)
+{
+	struct attitude a;
+	double 			tilt, dt, dh;
+
+	reference(t, &a);
+	tilt = acos(1 - 2 * (a.q[1] * a.q[1] + a.q[2] * a.q[2])) / DEG;
+	dt 	 = fabs(ahrs_tilt(ah) - tilt);
+	dh 	 = fabs(fmod(ahrs_heading(ah) - a.heading + 540, 360) - 180);
+	e->tilt_rms    += dt * dt;
+	e->heading_rms += dh * dh;
+	e->tilt_max    = dt > e->tilt_max ? dt : e->tilt_max;
+	e->heading_max = dh > e->heading_max ? dh : e->heading_max;
+	e->n++;
+}
+
+/* The replay: tilt and heading against the reference, bias, cycles */
+static void test_replay(void)
+{
+	static const double up[3] = {0, 0, 1};
+	static const double field[3] = {MAG_FIELD_GA * 0.5, 0, -MAG_FIELD_GA * 0.8660254};	// 60 deg dip
+	int16_t 			gyro[BLOCK][3], acc[BLOCK][3], mag[3] = {0};
+	uint32_t 			g = 0, k = 0, m = 0, gn = 0, an = 0, start;
+	int32_t 			sum[3];
+	struct attitude 	a;
+	struct errors 		e = {0};
+	double 				t, v[3], w[3], bias;
+	ahrs_t 				ah;
+	const prof_stat_t 	*stat = prof_get(PROF_AHRS);
+	uint32_t 			p50 = 0, seen = 0;
+
+	ahrs_init(&ah, GYRO_RATE, 2.0f, 0.1f);
+	prof_reset();
+	while(g < SECONDS * GYRO_RATE){
+		//next sample of whichever sensor comes first
+		if((double)k / ACC_RATE < (double)g / GYRO_RATE){
+			t = (double)k++ / ACC_RATE;
+			reference(t, &a);
+			to_board(a.q, up, v);
+			for(int i = 0; i < 3; i++){
+				acc[an][i] = lsb(v[i] * ACC_LSB_PER_G + 4 * noise());
+			}
+			if(++an < BLOCK){
+				continue;
+			}
+			an = 0;
+			//task: a full accelerometer block is the new gravity reference
+			sum[0] = sum[1] = sum[2] = 0;
+			for(int i = 0; i < BLOCK; i++){
+				sum[0] += acc[i][0];
+				sum[1] += acc[i][1];
+				sum[2] += acc[i][2];
+			}
+			ahrs_set_acc(&ah, (float)sum[0], (float)sum[1], (float)sum[2]);
+			continue;
+		}
+		t = (double)g++ / GYRO_RATE;
+		rate(t, w);
+		for(int i = 0; i < 3; i++){
+			gyro[gn][i] = lsb((w[i] / DEG + gyro_bias_dps[i]) * GYRO_LSB_PER_DPS + 2 * noise());
+		}
+		//magnetometer sample register, refreshed at 75 Hz
+		if(t * MAG_RATE >= m){
+			m++;
+			reference(t, &a);
+			to_board(a.q, field, v);
+			for(int i = 0; i < 3; i++){
+				mag[i] = lsb(v[i] * MAG_LSB_PER_GA + 2 * noise());
+			}
+		}
+		if(++gn < BLOCK){
+			continue;
+		}
+		gn = 0;
+		//task: one magnetometer read, then a filter step per gyro sample
+		ahrs_set_mag(&ah, mag[0], mag[1], mag[2]);
+		for(int i = 0; i < BLOCK; i++){
+			start = PROF_BEGIN();
+			ahrs_update(&ah, gyro[i][0] * GYRO_RAD_PER_LSB, gyro[i][1] * GYRO_RAD_PER_LSB,
+						gyro[i][2] * GYRO_RAD_PER_LSB);
+			PROF_END(PROF_AHRS, start);
+		}
+		if(t >= SETTLE){
+			compare(&ah, t, &e);
+		}
+	}
+
+	e.tilt_rms 	  = sqrt(e.tilt_rms / e.n);
+	e.heading_rms = sqrt(e.heading_rms / e.n);
+	printf("tilt: rms %.2f max %.2f deg, heading: rms %.2f max %.2f deg\n",
+		   e.tilt_rms, e.tilt_max, e.heading_rms, e.heading_max);
+	CHECK(e.tilt_rms < 0.3 && e.tilt_max < 1.0);
+	CHECK(e.heading_rms < 0.3 && e.heading_max < 1.0);
+	for(int i = 0; i < 3; i++){
+		bias = ah.bias[i] / DEG + gyro_bias_dps[i];
+		printf("gyro bias %c: %+.3f dps left\n", 'x' + i, bias);
+		CHECK(fabs(bias) < 0.01);
+	}
+
+	for(int b = 0; b < PROF_BUCKETS && seen < stat->count / 2; b++){
+		seen += stat->hist[b];
+		p50   = 1u << b;
+	}
+	printf("ahrs probe: %lu updates, mean %.0f, min %lu, median below %lu host cycles\n",
+		   (unsigned long)stat->count, (double)stat->total / stat->count,
+		   (unsigned long)stat->min, (unsigned long)p50);
+	CHECK(stat->count == ah.updates);
+}
+
+/* Fast inverse square root and atan2 against libm */
+static void test_math(void)
+{
+	double worst = 0, err;
+
+	for(float x = 1e-6f; x < 1e9f; x *= 1.0007f){
+		err = fabs(ahrs_inv_sqrt(x) * sqrt(x) - 1);
+		worst = err > worst ? err : worst;
+	}
+	printf("inv_sqrt: max relative error %.2e\n", worst);
+	CHECK(worst < 6.6e-4);
+
+	worst = 0;
+	for(int i = 0; i < 3600; i++){
+		double r = i * 2 * M_PI / 3600;
+
+		for(double s = 1e-3; s < 1e4; s *= 10){
+			err = fabs(ahrs_atan2((float)(s * sin(r)), (float)(s * cos(r))) - atan2(s * sin(r), s * cos(r)));
+			err = err > M_PI ? 2 * M_PI - err : err;
+			worst = err > worst ? err : worst;
+		}
+	}
+	printf("atan2: max error %.1e rad\n", worst);
+	CHECK(worst < 1e-5);
+	CHECK(ahrs_atan2(0.0f, 0.0f) == 0.0f);
+}
+
+int main(void)
+{
+	sim_init();
+	prof_init();
+	test_replay();
+	test_math();
+	return CHECK_DONE();
+}
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <string.h>
+#include "at_cmd.h"
+#include "check.h"
+
+/*
+ * Wi-Fi bring-up: at_cmd against a scripted Ameba module on the simulated
+ * USART2, one millisecond per step at 38400 baud (3.84 bytes per ms each
+ * way). The wifi task runs at_process when received bytes or a finished
+ * transmission wake it, or when at_next_timeout runs out, as in BSP. The
+ * init table and the done callback are those of BSP_WIFI_Init and
+ * BSP_WIFI_InitDone.
+ *
+ * The module drops what it receives until it has booted, then runs one
+ * command at a time and answers after the scripted time with the Ameba
+ * echo ("[ATPW] OK") and its heap report. The command times are the
+ * script's assumptions, not measurements of a module: the bring-up time
+ * printed is simulated ms, what the engine and the line add on top of
+ * them shows as the difference to the module time. Most of it is the line:
+ * the engine sees an answer at the idle interrupt after the heap report,
+ * about 70 bytes or 18 ms after the command ended.
+ */
+
+#define BYTES_PER_MS 	384						// x 0.01, 38400 baud 8N1
+#define LIMIT_MS 		60000
+#define LINE_MS 		25						// Command and answer on the line
+#define PROBE_MS 		105						// Period of the first command while booting
+
+/* Table of BSP_WIFI_Init */
+static const at_command_t wifi_init_cmds[] = {
+	{AT_CMD("AT\r\n"), 					"OK", 	100, 	9},
+	{AT_CMD("ATPW=2\r\n"), 				"OK", 	1000, 	2},
+	{AT_CMD("ATPA=MICRO2022,,11,0\r\n"), 	"OK", 	5000, 	2},
+	{AT_CMD("ATPH=1,1\r\n"), 				"OK", 	1000, 	2},
+	{AT_CMD("ATPS=0,3001\r\n"), 			"OK", 	2000, 	2},
+	{AT_CMD("ATSW=c\r\n"), 				"OK", 	1000, 	2},
+};
+#define WIFI_INIT_CMDS 	(sizeof(wifi_init_cmds) / sizeof(wifi_init_cmds[0]))
+
+/* Time the module takes for each command, in table order */
+static const struct{
+	const char *name;
+	uint16_t 	ms;
+} steps[WIFI_INIT_CMDS] = {
+	{ "AT", 2 }, { "ATPW", 30 }, { "ATPA", 1200 }, { "ATPH", 20 }, { "ATPS", 60 }, { "ATSW", 40 },
+};
+
+struct module{
+	uint32_t 	ready;						// Tick it starts reading the line
+	char 		line[64];					// Command being received
+	uint8_t 	len;
+	int8_t 		running;					// Step running, -1 none
+	uint32_t 	done_at;
+	uint8_t 	errors[WIFI_INIT_CMDS];		// ERROR answers left per step
+	uint8_t 	lost[WIFI_INIT_CMDS];		// Answers lost per step
+	char 		out[256];					// Answer on the line
+	size_t 		out_len, out_pos;
+	uint32_t 	budget;						// Line bytes x 100 this ms
+	uint32_t 	busy_ms;					// Time spent running commands
+	uint32_t 	collisions;					// Commands received while one ran
+	char 		log[128];					// Commands run, in order
+};
+
+static USART_TypeDef 		usart;
+static DMA_Stream_TypeDef 	stream_rx;
+static DMA_HandleTypeDef 	hdma_rx = { &stream_rx, NULL };
+static UART_HandleTypeDef 	huart = { .Instance = &usart, .hdmarx = &hdma_rx };
+static uint8_t 				rx_buffer[256];
+static uart_rx_t 			wifi_rx;
+static uart_tx_t 			wifi_tx;
+static at_engine_t 			wifi_at;
+static struct module 		mod;
+static uint8_t 				woken;
+static uint32_t 			tx_start;					// Tick the transfer on the line started
+static uint8_t 				tx_running;
+static uint8_t 				init_from, finished;
+static at_result_t 			result;
+static uint32_t 			bringup_ms;
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *h)
+{
+	uart_rx_update(&wifi_rx);
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *h)
+{
+	uart_rx_update(&wifi_rx);
+}
+
+void sim_uart_irq(UART_HandleTypeDef *h)
+{
+	uart_rx_irq_handler(&wifi_rx);
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *h)
+{
+	uart_tx_complete_isr(&wifi_tx);
+	woken = 1;
+}
+
+static void notify(void *ctx)
+{
+	woken = 1;
+}
+
+/* BSP_WIFI_InitDone */
+static void init_done(at_result_t r, uint8_t index)
+{
+	if(r == AT_RESULT_OK){
+		bringup_ms = HAL_GetTick();
+		result 	   = r;
+		finished   = 1;
+		return;
+	}
+	init_from = r == AT_RESULT_ERROR ? init_from + index : 0;
+	at_submit(&wifi_at, &wifi_init_cmds[init_from], WIFI_INIT_CMDS - init_from, init_done);
+}
+
+//a whole command line reached the module
+static void module_command(const char *line)
+{
+	size_t n = strcspn(line, "=?");
+
+	if(mod.running >= 0){
+		mod.collisions++;
+		return;
+	}
+	for(int8_t s = 0; s < (int8_t)WIFI_INIT_CMDS; s++){
+		if(strlen(steps[s].name) == n && strncmp(line, steps[s].name, n) == 0){
+			mod.running = s;
+			mod.done_at = HAL_GetTick() + steps[s].ms;
+			mod.busy_ms += steps[s].ms;
+			strncat(mod.log, steps[s].name, sizeof(mod.log) - strlen(mod.log) - 2);
+			strcat(mod.log, " ");
+		}
+	}
+}
+
+static void module_receive(const uint8_t *data, uint16_t len)
+{
+	if(HAL_GetTick() < mod.ready){
+		return;
+	}
+	for(uint16_t i = 0; i < len; i++){
+		if(data[i] == '\n'){
+			mod.line[mod.len] = '\0';
+			module_command(mod.line);
+			mod.len = 0;
+		}
+		else if(data[i] != '\r' && mod.len < sizeof(mod.line) - 1){
+			mod.line[mod.len++] = (char)data[i];
+		}
+	}
+}
+
+//one millisecond of the line and the module
+static void line_step(void)
+{
+	uint32_t tick = HAL_GetTick(), n;
+	int8_t 	 s = mod.running;
+
+	//command on the line: the module has it once the DMA ends
+	if(huart.gState == HAL_UART_STATE_BUSY_TX &&
+	   (tick - tx_start) * BYTES_PER_MS >= huart.TxXferSize * 100u){
+		module_receive(huart.pTxBuffPtr, huart.TxXferSize);
+		sim_uart_tx_complete(&huart);
+		tx_running = huart.gState == HAL_UART_STATE_BUSY_TX;
+		tx_start   = tick;
+	}
+
+	if(s >= 0 && tick >= mod.done_at){
+		mod.running = -1;
+		if(mod.lost[s] > 0){
+			mod.lost[s]--;
+		}
+		else{
+			mod.out_len = snprintf(mod.out, sizeof(mod.out),
+								   "\r\n[%s] %s\r\n\r\n[MEM] After do cmd, available heap 161240\r\n\r\n\r\n#\r\n",
+								   steps[s].name, mod.errors[s] > 0 ? "ERROR:1" : "OK");
+			mod.out_pos = 0;
+			mod.errors[s] -= mod.errors[s] > 0;
+		}
+	}
+
+	//answer on the line, idle after its last byte
+	if(mod.out_pos < mod.out_len){
+		mod.budget += BYTES_PER_MS;
+		n = mod.budget / 100;
+		n = n < mod.out_len - mod.out_pos ? n : mod.out_len - mod.out_pos;
+		mod.budget -= n * 100;
+		sim_uart_receive(&huart, (const uint8_t *)&mod.out[mod.out_pos], n);
+		mod.out_pos += n;
+		if(mod.out_pos == mod.out_len){
+			mod.budget = 0;
+			sim_uart_idle(&huart);
+		}
+	}
+}
+
+/**
+ * @brief one bring-up from BSP_WIFI_Init to the done callback
+ * @return ms it took, 0 if it did not end
+ */
+static uint32_t bring_up(const char *name, const struct module *setup, const char *expected)
+{
+	uint32_t deadline = 0, next, calls = 0, start;
+	uint64_t cycles = 0;
+
+	mod 		= *setup;
+	mod.running = -1;
+	woken 		= 0;
+	finished 	= 0;
+	tx_running 	= 0;
+	sim_set_tick(0);
+	HAL_UART_Init(&huart);
+	uart_rx_set_notify(&wifi_rx, notify, NULL);
+	uart_rx_start(&wifi_rx, &huart, rx_buffer, sizeof(rx_buffer));
+	uart_tx_init(&wifi_tx, &huart);
+	at_init(&wifi_at, &wifi_tx, &wifi_rx, NULL);
+	init_from = 0;
+	at_submit(&wifi_at, wifi_init_cmds, WIFI_INIT_CMDS, init_done);
+
+	while(!finished && HAL_GetTick() < LIMIT_MS){
+		if(woken || HAL_GetTick() >= deadline){
+			woken = 0;
+			start = DWT->CYCCNT;
+			at_process(&wifi_at);
+			cycles += DWT->CYCCNT - start;
+			calls++;
+			next 	 = at_next_timeout(&wifi_at);
+			deadline = next == AT_WAIT_FOREVER ? LIMIT_MS : HAL_GetTick() + next;
+		}
+		if(huart.gState == HAL_UART_STATE_BUSY_TX && !tx_running){
+			tx_running = 1;
+			tx_start   = HAL_GetTick();
+		}
+		sim_advance_tick(1);
+		line_step();
+	}
+
+	printf("%-44s bring-up %5lu ms, module busy %4lu ms, boot %4lu ms, %lu at_process calls, %.0f host cycles each\n",
+		   name, (unsigned long)bringup_ms, (unsigned long)mod.busy_ms, (unsigned long)mod.ready,
+		   (unsigned long)calls, (double)cycles / calls);
+	printf("  %s\n", mod.log);
+	CHECK(finished && result == AT_RESULT_OK);
+	CHECK(strcmp(mod.log, expected) == 0);
+	CHECK(mod.collisions == 0);
+	CHECK(wifi_tx.failed == 0 && wifi_tx.rejected == 0);
+	return finished ? bringup_ms : 0;
+}
+
+int main(void)
+{
+	static const char all[] = "AT ATPW ATPA ATPH ATPS ATSW ";
+	struct module 	  m;
+	uint32_t 		  t;
+
+	sim_init();
+
+	memset(&m, 0, sizeof(m));
+	t = bring_up("module up, station reset", &m, all);
+	CHECK(t < mod.busy_ms + 6 * LINE_MS);
+
+	//the first command goes every 100 ms until the module answers
+	m.ready = 1000;
+	t = bring_up("both reset, module boots in 1000 ms", &m, all);
+	CHECK(t < m.ready + PROBE_MS + mod.busy_ms + 6 * LINE_MS);
+
+	//backoffs of 100, 200 and 100 ms, the sequence resumes at ATPS
+	m.errors[4] = 3;
+	t = bring_up("boot, ATPS answers ERROR three times", &m,
+				 "AT ATPW ATPA ATPH ATPS ATPS ATPS ATPS ATSW ");
+	CHECK(t < m.ready + PROBE_MS + mod.busy_ms + 9 * LINE_MS + 400);
+
+	//the 5000 ms timeout, then the retry right away
+	m.errors[4] = 0;
+	m.lost[2] 	= 1;
+	t = bring_up("boot, ATPA answer lost once", &m, "AT ATPW ATPA ATPA ATPH ATPS ATSW ");
+	CHECK(t < m.ready + PROBE_MS + mod.busy_ms + 7 * LINE_MS + 5000);
+	return CHECK_DONE();
+}
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <string.h>
+#include "mk_dht11.h"
+#include "check.h"
+
+/*
+ * DHT11 / DHT22 decoding from input capture timestamps, as TIM2 channel 1
+ * takes them on the board: one 1 MHz count per edge, both polarities.
+ *
+ *  - golden: the waveform of the datasheets, built from the five bytes:
+ *    the release edge of the host, 20-40 us until the sensor pulls low,
+ *    80 us low + 80 us high response, then per bit 50 us low and 26 us
+ *    (0) or 70 us (1) high, and the release after the last bit. With and
+ *    without the leading release edge, the timer wrapping on the way;
+ *  - jitter: every pulse off by up to +-J us at random. Inside the
+ *    windows of mk_dht11.c (0 bits are 15..48 us high, the tightest) the
+ *    reading must be exact for any J up to 11 us, past them it must fail
+ *    rather than return other values;
+ *  - missing edges: each edge dropped in turn, the transfer cut short,
+ *    no answer at all. A lost rising edge of one of the last 0 bits can
+ *    still decode right, the release edge closes the last pair; anything
+ *    else must fail;
+ *  - checksum: every single bit flipped;
+ *  - process: dht11_request / dht11_process on the simulated GPIO and
+ *    timer, edges delivered through HAL_TIM_IC_CaptureCallback as in BSP.
+ */
+
+#define EDGES 			85						// Release + response + 40 bits + release
+#define RUNS 			2000
+
+static TIM_TypeDef 			tim2;
+static TIM_HandleTypeDef 	htim2 = { &tim2, HAL_TIM_ACTIVE_CHANNEL_CLEARED };
+static dht11_t 				dht;
+
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+	if(htim->Instance == &tim2){
+		dht11_capture_isr(&dht);
+	}
+}
+
+/* Pulse width off by up to +-jitter us */
+static uint32_t pulse(uint32_t us, uint32_t jitter, uint32_t *seed)
+{
+	return jitter == 0 ? us : us - jitter + check_rand(seed) % (2 * jitter + 1);
+}
+
+/**
+ * @brief edge timestamps of a transfer of data[5]
+ * @return number of edges
+ */
+static uint8_t wave(uint32_t *edges, const uint8_t data[5], uint32_t t0, uint32_t jitter, uint32_t *seed)
+{
+	uint32_t t = t0;
+	uint8_t  n = 0;
+
+	edges[n++] = t;								//host releases the line
+	edges[n++] = t += pulse(30, jitter, seed);
+	edges[n++] = t += pulse(80, jitter, seed);
+	edges[n++] = t += pulse(80, jitter, seed);
+	for(int j = 0; j < 40; j++){
+		edges[n++] = t += pulse(50, jitter, seed);
+		edges[n++] = t += pulse(data[j / 8] & (0x80 >> j % 8) ? 70 : 26, jitter, seed);
+	}
+	edges[n++] = t += pulse(50, jitter, seed);	//sensor releases the line
+	return n;
+}
+
+static void payload(uint8_t data[5], uint32_t *seed)
+{
+	data[4] = 0;
+	for(int i = 0; i < 4; i++){
+		data[i]  = (uint8_t)check_rand(seed);
+		data[4] += data[i];
+	}
+}
+
+/* Datasheet waveforms */
+static void test_golden(void)
+{
+	static const uint8_t dht11_bytes[5] = { 55, 0, 24, 0, 79 };
+	static const uint8_t dht22_bytes[5] = { 0x02, 0x8C, 0x80, 0x65, 0x73 };	// 65.2 %, -10.1 C
+	uint32_t edges[EDGES], seed = 1, start, cycles;
+	uint8_t  data[5], n;
+
+	n = wave(edges, dht11_bytes, 1000, 0, &seed);
+	CHECK(n == EDGES);
+	start  = DWT->CYCCNT;
+	CHECK(dht11_decode(edges, n, data) == DHT11_OK);
+	cycles = DWT->CYCCNT - start;
+	CHECK(memcmp(data, dht11_bytes, 5) == 0);
+	//no leading release edge, no trailing one
+	CHECK(dht11_decode(&edges[1], n - 1, data) == DHT11_OK && memcmp(data, dht11_bytes, 5) == 0);
+	CHECK(dht11_decode(edges, n - 1, data) == DHT11_OK && memcmp(data, dht11_bytes, 5) == 0);
+
+	//the counter wraps in the middle of the transfer
+	n = wave(edges, dht22_bytes, 0xFFFFFFFFu - 2000, 0, &seed);
+	CHECK(edges[n - 1] < edges[0]);
+	CHECK(dht11_decode(edges, n, data) == DHT11_OK && memcmp(data, dht22_bytes, 5) == 0);
+	printf("golden DHT11 and DHT22 waveforms decoded, %lu host cycles per decode\n", (unsigned long)cycles);
+}
+
+/* Random timing error on every pulse */
+static void test_jitter(void)
+{
+	uint32_t edges[EDGES], seed = 2, ok, wrong;
+	uint8_t  sent[5], data[5], n, r;
+
+	for(uint32_t jitter = 0; jitter <= 30; jitter += jitter < 10 ? 5 : jitter < 12 ? 1 : 4){
+		ok = wrong = 0;
+		for(int run = 0; run < RUNS; run++){
+			payload(sent, &seed);
+			n = wave(edges, sent, check_rand(&seed), jitter, &seed);
+			r = dht11_decode(edges, n, data);
+			ok 	  += r == DHT11_OK;
+			wrong += r == DHT11_OK && memcmp(data, sent, 5) != 0;
+		}
+		printf("jitter +-%2lu us: %4lu of %u read, %lu wrong values accepted\n",
+			   (unsigned long)jitter, (unsigned long)ok, RUNS, (unsigned long)wrong);
+		if(jitter <= 11){
+			CHECK(ok == RUNS);
+		}
+		CHECK(wrong == 0);
+	}
+}
+
+/* Edges lost: one at a time, the end of the transfer, all of them */
+static void test_missing(void)
+{
+	uint32_t edges[EDGES], cut[EDGES], seed = 3, codes[5] = {0}, recovered = 0;
+	uint8_t  sent[5], data[5], n, r;
+
+	for(int run = 0; run < RUNS / 20; run++){
+		payload(sent, &seed);
+		n = wave(edges, sent, check_rand(&seed), 5, &seed);
+		for(uint8_t drop = 0; drop < n; drop++){
+			memcpy(cut, edges, drop * sizeof(edges[0]));
+			memcpy(&cut[drop], &edges[drop + 1], (n - drop - 1) * sizeof(edges[0]));
+			r = dht11_decode(cut, n - 1, data);
+			codes[r]++;
+			//the release edges of host and sensor may be missing, any other
+			//loss must fail or still give the bytes sent
+			if(drop == 0 || drop == n - 1){
+				CHECK(r == DHT11_OK && memcmp(data, sent, 5) == 0);
+			}
+			else if(r == DHT11_OK){
+				recovered++;
+				CHECK(memcmp(data, sent, 5) == 0);
+			}
+		}
+		//cut short, the timeout of dht11_process
+		for(uint8_t keep = 4; keep < n - 1; keep += 7){
+			CHECK(dht11_decode(edges, keep, data) == DHT11_ERR_EDGES);
+		}
+	}
+	printf("one edge dropped: %lu read (%lu of them not a release edge), %lu no response, %lu short, %lu timing, %lu checksum\n",
+		   (unsigned long)codes[DHT11_OK], (unsigned long)recovered, (unsigned long)codes[DHT11_ERR_RESPONSE], (unsigned long)codes[DHT11_ERR_EDGES],
+		   (unsigned long)codes[DHT11_ERR_TIMING], (unsigned long)codes[DHT11_ERR_CHECKSUM]);
+
+	//no sensor: only the release edge, or nothing
+	CHECK(dht11_decode(edges, 1, data) == DHT11_ERR_RESPONSE);
+	CHECK(dht11_decode(edges, 0, data) == DHT11_ERR_RESPONSE);
+	//a response that is too short
+	edges[2] = edges[1] + 40;
+	CHECK(dht11_decode(edges, EDGES, data) == DHT11_ERR_RESPONSE);
+}
+
+/* Every single bit flipped */
+static void test_checksum(void)
+{
+	static const uint8_t sent[5] = { 41, 0, 19, 0, 60 };
+	uint32_t edges[EDGES], seed = 4;
+	uint8_t  bad[5], data[5];
+
+	for(int j = 0; j < 40; j++){
+		memcpy(bad, sent, 5);
+		bad[j / 8] ^= 0x80 >> j % 8;
+		wave(edges, bad, 0, 0, &seed);
+		CHECK(dht11_decode(edges, EDGES, data) == DHT11_ERR_CHECKSUM);
+	}
+}
+
+/* Edges through the timer, as the capture interrupt delivers them */
+static void capture(const uint32_t *edges, uint8_t n)
+{
+	for(uint8_t i = 0; i < n; i++){
+		sim_tim_capture(&htim2, TIM_CHANNEL_1, edges[i]);
+	}
+}
+
+/* One read: request, start pulse, capture, result */
+static uint8_t read_sensor(uint8_t type, const uint32_t *edges, uint8_t n, uint32_t *ms)
+{
+	const uint32_t start_ms = type == DHT22 ? 2 : 18;
+	uint32_t 	   t0 		= HAL_GetTick();
+
+	dht.type = type;
+	dht11_request(&dht);
+	CHECK(dht.state == DHT11_START);
+	CHECK((GPIOA->MODER >> 4 & 3) == GPIO_MODE_OUTPUT_PP && (GPIOA->ODR & GPIO_PIN_2) == 0);
+	//nothing is captured during the start pulse
+	CHECK(sim_tim_capture(&htim2, TIM_CHANNEL_1, 5) == 0);
+	for(uint32_t i = 0; i < start_ms; i++){
+		CHECK(dht11_process(&dht) == 0 && dht.state == DHT11_START);
+		sim_advance_tick(1);
+	}
+	//line released to the timer
+	CHECK(dht11_process(&dht) == 0 && dht.state == DHT11_WAIT);
+	CHECK((GPIOA->MODER >> 4 & 3) == GPIO_MODE_AF_PP && (GPIOA->AFR[0] >> 8 & 15) == GPIO_AF1_TIM2);
+	CHECK(tim2.CNT == 0 && dht.n_edges == 0);
+
+	capture(edges, n);
+	while(!dht11_process(&dht)){
+		sim_advance_tick(1);
+	}
+	*ms = HAL_GetTick() - t0;
+	CHECK(dht.state == DHT11_IDLE && (GPIOA->MODER >> 4 & 3) == GPIO_MODE_INPUT);
+	CHECK(sim_tim_capture(&htim2, TIM_CHANNEL_1, 5) == 0);
+	return dht.error;
+}
+
+static void test_process(void)
+{
+	static const uint8_t dht11_bytes[5] = { 55, 0, 24, 0, 79 };
+	static const uint8_t dht22_bytes[5] = { 0x02, 0x8C, 0x80, 0x65, 0x73 };
+	uint32_t edges[EDGES + 10], seed = 5, ms;
+	uint8_t  n;
+
+	sim_init();
+	sim_set_tick(5000);
+	init_dht11(&dht, &htim2, TIM_CHANNEL_1, GPIOA, GPIO_PIN_2, GPIO_AF1_TIM2);
+
+	n = wave(edges, dht11_bytes, 0, 3, &seed);
+	CHECK(read_sensor(DHT11, edges, n, &ms) == DHT11_OK);
+	CHECK(dht.hum_x10 == 550 && dht.temp_x10 == 240 && dht.humidty == 55 && dht.temperature == 24);
+	printf("DHT11 read through the timer: %lu simulated ms from request to result, edges given at once\n", (unsigned long)ms);
+
+	n = wave(edges, dht22_bytes, 0, 3, &seed);
+	CHECK(read_sensor(DHT22, edges, n, &ms) == DHT11_OK);
+	CHECK(dht.hum_x10 == 652 && dht.temp_x10 == -101);
+	printf("DHT22 read through the timer: %lu simulated ms from request to result, edges given at once\n", (unsigned long)ms);
+
+	//transfer cut, the 10 ms timeout ends it
+	n = wave(edges, dht11_bytes, 0, 0, &seed);
+	CHECK(read_sensor(DHT11, edges, 40, &ms) == DHT11_ERR_EDGES && ms == 18 + 11);
+	//no sensor
+	CHECK(read_sensor(DHT11, edges, 1, &ms) == DHT11_ERR_RESPONSE);
+	//glitches after the transfer do not overrun the edge buffer
+	for(int i = 0; i < 10; i++){
+		edges[n + i] = edges[n - 1] + 5 * (i + 1);
+	}
+	CHECK(read_sensor(DHT11, edges, n + 10, &ms) == DHT11_OK && dht.n_edges == DHT11_MAX_EDGES);
+	CHECK(dht.hum_x10 == 550);
+}
+
+int main(void)
+{
+	sim_init();
+	test_golden();
+	test_jitter();
+	test_missing();
+	test_checksum();
+	test_process();
+	return CHECK_DONE();
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <math.h>
+#include "die_temp.h"
+#include "prof.h"
+#include "check.h"
+
+/*
+ * die_temp against the reference-manual formula in double, for factory
+ * calibrations written to the simulated system memory and for an erased
+ * area (typical values). Every sensor reading of the 12 bit range in the
+ * 4 fraction bits of adc_acq_get_fine, VDDA from 2.0 to 3.6 V. Each
+ * conversion is timed with the board_temp probe, as BSP_BOARD_GetTemp does.
+ */
+
+#define FINE 		16								// adc_acq_get_fine scale
+
+struct calibration{
+	uint16_t cal1, cal2, vref;
+	uint8_t  factory;
+};
+
+static double reference(const struct calibration *c, double ts, double vref)
+{
+	double counts = ts * c->vref / vref;
+
+	return 30.0 + (counts - c->cal1) * 80.0 / (c->cal2 - c->cal1);
+}
+
+static void write_calibration(uint16_t cal1, uint16_t cal2, uint16_t vref)
+{
+	sim_set_sysmem(0x1FFF7A2A, &vref, 2);
+	sim_set_sysmem(0x1FFF7A2C, &cal1, 2);
+	sim_set_sysmem(0x1FFF7A2E, &cal2, 2);
+}
+
+/* Two chips and an erased calibration area */
+static void test_accuracy(void)
+{
+	static const struct calibration chips[] = {
+		{ 945, 1203, 1510, 1 },
+		{ 980, 1230, 1480, 1 },
+		{ 0xFFFF, 0xFFFF, 0xFFFF, 0 },
+	};
+	static const struct calibration typical = { 959, 1207, 1502, 0 };
+	const prof_stat_t 	*stat = prof_get(PROF_BOARD_TEMP);
+	const struct calibration *c;
+	die_temp_t 			dt;
+	uint32_t 			vref, start, p50 = 0, seen = 0;
+	double 				err, max_err, vdda;
+	float 				t;
+
+	prof_reset();
+	for(unsigned k = 0; k < sizeof(chips) / sizeof(chips[0]); k++){
+		write_calibration(chips[k].cal1, chips[k].cal2, chips[k].vref);
+		CHECK(die_temp_init(&dt) == chips[k].factory && dt.factory == chips[k].factory);
+		c 		= chips[k].factory ? &chips[k] : &typical;
+		max_err = 0;
+		for(int mv = 2000; mv <= 3600; mv += 100){
+			vdda = mv / 1000.0;
+			vref = lround(c->vref * 3.3 / vdda * FINE);
+			for(uint32_t ts = 0; ts < 4096 * FINE; ts++){
+				start = PROF_BEGIN();
+				t 	  = die_temp_celsius(&dt, ts, vref);
+				PROF_END(PROF_BOARD_TEMP, start);
+				err = fabs(t - reference(c, ts, vref));
+				max_err = err > max_err ? err : max_err;
+			}
+		}
+		printf("calibration %u/%u/%u%s: max error %.5f C\n", chips[k].cal1, chips[k].cal2, chips[k].vref,
+			   chips[k].factory ? "" : " (erased, typical values)", max_err);
+		CHECK(max_err < 0.001);
+	}
+	CHECK(die_temp_celsius(&dt, 1000, 0) == 0.0f);
+
+	for(int b = 0; b < PROF_BUCKETS && seen < stat->count / 2; b++){
+		seen += stat->hist[b];
+		p50   = 1u << b;
+	}
+	printf("board_temp probe: %lu conversions, mean %.1f, min %lu, median below %lu host cycles\n",
+		   (unsigned long)stat->count, (double)stat->total / stat->count,
+		   (unsigned long)stat->min, (unsigned long)p50);
+}
+
+/* What the old typical-value formula, which assumed 3.0 V, read instead */
+static void test_old_formula(void)
+{
+	static const struct calibration chip = { 945, 1203, 1510, 1 };
+	double 	 t, old, lo = 1e9, hi = -1e9, counts;
+	die_temp_t dt;
+
+	write_calibration(chip.cal1, chip.cal2, chip.vref);
+	die_temp_init(&dt);
+	for(t = -40; t <= 85; t += 1){
+		//raw reading of the chip at t with VDDA = 3.0 V
+		counts = (chip.cal1 + (t - 30.0) * (chip.cal2 - chip.cal1) / 80.0) * 3.3 / 3.0;
+		old    = ((float)counts * 3000 / ((1 << 12) - 1) - 760) / 2.5 + 25;
+		lo 	   = old - t < lo ? old - t : lo;
+		hi 	   = old - t > hi ? old - t : hi;
+		CHECK(fabs(die_temp_celsius(&dt, lround(counts * FINE), lround(chip.vref * 1.1 * FINE)) - t) < 0.05);
+	}
+	printf("old formula at 3.0 V, -40..85 C: off by %+.1f to %+.1f C\n", lo, hi);
+}
+
+int main(void)
+{
+	sim_init();
+	prof_init();
+	test_accuracy();
+	test_old_formula();
+	return CHECK_DONE();
+}
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+#include "flash_log.h"
+#include "check.h"
+
+/*
+ * flash_log on the simulated F411 flash. Records carry their sequence
+ * number and a pattern derived from it, so a read back shows order, gaps
+ * and damage. The erase interrupt is served right after flash_log_poll,
+ * like the FLASH_IRQn of the BSP.
+ *
+ * The power cut test runs the store on four 16 KB sectors (so the ring
+ * turns often) and cuts the power on a random flash operation: a torn
+ * program, a torn header, a half erased sector. After every cut it mounts
+ * again and checks that every committed record still in the log reads
+ * back, in order, and that nothing damaged is returned.
+ */
+
+#define CUT_RUNS 		3000
+#define MAX_RECORDS 	(1u << 20)
+
+static CRC_HandleTypeDef hcrc;
+static flash_log_t 		 flog;
+static uint8_t 			 committed[MAX_RECORDS];	// Append returned 1
+static uint32_t 		 next_seq;
+static uint32_t 		 last_committed;
+
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue)
+{
+	if(ReturnValue == 0xFFFFFFFFU){
+		flash_log_erase_done(&flog, 1);
+	}
+}
+
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue)
+{
+	flash_log_erase_done(&flog, 0);
+}
+
+//40 to 128 bytes, the size of the telemetry frames
+static uint16_t record_len(uint32_t seq)
+{
+	return 40 + (uint16_t)(((seq * 2654435761u) >> 20) % 89);
+}
+
+static void record_fill(uint32_t seq, uint8_t *p)
+{
+	uint16_t len = record_len(seq);
+
+	memcpy(p, &seq, 4);
+	for(uint16_t i = 4; i < len; i++){
+		p[i] = (uint8_t)(seq * 31 + i);
+	}
+}
+
+static uint8_t record_ok(const uint8_t *p, uint16_t len, uint32_t *seq)
+{
+	uint8_t expect[FLASH_LOG_RECORD_MAX];
+
+	memcpy(seq, p, 4);
+	if(*seq >= next_seq || len != record_len(*seq)){
+		return 0;
+	}
+	record_fill(*seq, expect);
+	return memcmp(p, expect, len) == 0;
+}
+
+//the task: keep the next sector erased, then append
+static uint8_t append_next(void)
+{
+	uint8_t  data[FLASH_LOG_RECORD_MAX];
+	uint32_t seq = next_seq++;
+
+	flash_log_poll(&flog);
+	if(sim_flash_erase_pending()){
+		HAL_FLASH_IRQHandler();
+	}
+	record_fill(seq, data);
+	if(!flash_log_append(&flog, data, record_len(seq))){
+		return 0;
+	}
+	committed[seq] = 1;
+	last_committed = seq;
+	return 1;
+}
+
+/**
+ * @brief reads the whole log and checks it against what was committed
+ * @return bytes of records read back
+ */
+static uint32_t verify(void)
+{
+	uint8_t 		   data[FLASH_LOG_RECORD_MAX];
+	flash_log_cursor_t cur;
+	uint32_t 		   seq, expect = 0, bytes = 0, bad = 0, missing = 0;
+	uint16_t 		   len;
+	uint8_t 		   first = 1;
+
+	flash_log_rewind(&flog, &cur);
+	while((len = flash_log_read(&flog, &cur, data, sizeof(data))) > 0){
+		if(!record_ok(data, len, &seq) || (!first && seq < expect)){
+			bad++;
+			continue;
+		}
+		//committed records between two read ones must all be there
+		for(uint32_t s = first ? seq : expect; s < seq; s++){
+			missing += committed[s];
+		}
+		first  = 0;
+		expect = seq + 1;
+		bytes += 8 + ((len + 3u) & ~3u);
+	}
+	for(uint32_t s = expect; !first && s <= last_committed; s++){
+		missing += committed[s];
+	}
+	CHECK(bad == 0);
+	CHECK(missing == 0);
+	CHECK(!first || !committed[last_committed]);
+	return bytes;
+}
+
+static void mount(uint8_t sector, uint8_t sectors, uint32_t size)
+{
+	uint32_t base = FLASH_BASE + (sector == FLASH_SECTOR_6 ? 0x40000 : 0);
+
+	CHECK(flash_log_mount(&flog, &hcrc, base, sector, sectors, size));
+}
+
+/* BSP geometry: appends, read back, wrap around the two 128 KB sectors */
+static void test_append_read(void)
+{
+	uint32_t bytes;
+
+	sim_flash_erase_all();
+	memset(committed, 0, sizeof(committed));
+	next_seq = last_committed = 0;
+	mount(FLASH_SECTOR_6, 2, 128 * 1024);
+	CHECK(flog.head == FLASH_LOG_NONE);
+	CHECK(verify() == 0);
+
+	for(int i = 0; i < 1000; i++){
+		CHECK(append_next());
+	}
+	CHECK(verify() > 0);
+
+	//a second mount finds the same end
+	mount(FLASH_SECTOR_6, 2, 128 * 1024);
+	CHECK(append_next());
+	verify();
+
+	//three times around the ring: only erases make room
+	while(flog.erases < 6){
+		CHECK(append_next());
+	}
+	bytes = verify();
+	printf("append/read: %lu appends, %lu erases, %lu bytes kept, lost %lu\n",
+		   (unsigned long)next_seq, (unsigned long)flog.erases, (unsigned long)bytes,
+		   (unsigned long)flog.lost);
+	CHECK(flog.lost == 0);
+	CHECK(bytes >= 128 * 1024 - FLASH_LOG_SPARE_BYTES - FLASH_LOG_BLOCK);
+
+	//bad lengths are refused
+	CHECK(!flash_log_append(&flog, "x", 0));
+	CHECK(!flash_log_append(&flog, committed, FLASH_LOG_RECORD_MAX + 1));
+	CHECK(!flash_log_mount(&flog, &hcrc, FLASH_BASE, 0, 1, 16 * 1024));
+	CHECK(!flash_log_mount(&flog, &hcrc, FLASH_BASE, 0, FLASH_LOG_MAX_SECTORS + 1, 16 * 1024));
+}
+
+/* An erase that has not ended refuses appends, the flash stays unlocked */
+static void test_erase_running(void)
+{
+	uint8_t data[100] = {0};
+
+	sim_flash_erase_all();
+	mount(FLASH_SECTOR_0, 2, 16 * 1024);
+	//no poll: fill the first sector and the second one down to the spare room
+	while(flog.head != 1 || flog.sector_size - flog.offset >= FLASH_LOG_SPARE_BYTES){
+		CHECK(flash_log_append(&flog, data, sizeof(data)));
+	}
+	flash_log_poll(&flog);
+	CHECK(sim_flash_erase_pending() && flog.erasing == 0 && flog.state[0] == FLASH_LOG_DIRTY);
+	CHECK(!flash_log_append(&flog, data, sizeof(data)) && flog.lost == 1);
+	CHECK(!sim_flash_locked());
+	HAL_FLASH_IRQHandler();
+	CHECK(flog.erasing == FLASH_LOG_NONE && flog.state[0] == FLASH_LOG_ERASED && flog.erases == 1);
+	CHECK(sim_flash_locked());
+	CHECK(flash_log_append(&flog, data, sizeof(data)));
+}
+
+/* Random power cuts, remount and check after each one */
+static void test_power_cuts(void)
+{
+	static jmp_buf 	 jump;
+	static uint32_t  seed = 5, run, min_bytes = 0xFFFFFFFF, start_commits;
+	static uint32_t  commits_after = 0;
+	uint32_t 		 bytes;
+
+	sim_flash_erase_all();
+	memset(committed, 0, sizeof(committed));
+	next_seq = last_committed = 0;
+	mount(FLASH_SECTOR_0, 4, 16 * 1024);
+
+	for(run = 0; run < CUT_RUNS; run++){
+		//a few hundred appends, with the cut somewhere in them
+		sim_flash_cut(1 + check_rand(&seed) % 12000, &jump, check_rand(&seed));
+		if(setjmp(jump) == 0){
+			for(;;){
+				append_next();
+			}
+		}
+		mount(FLASH_SECTOR_0, 4, 16 * 1024);
+		bytes = verify();
+		if(next_seq > 4 * 16 * 1024 / 40){
+			min_bytes = bytes < min_bytes ? bytes : min_bytes;
+		}
+		//and the store goes on
+		start_commits = flog.appends;
+		for(int i = 0; i < 20; i++){
+			append_next();
+		}
+		commits_after += flog.appends - start_commits;
+		CHECK(next_seq < MAX_RECORDS - 20000);
+	}
+	sim_flash_cut(0, NULL, 0);
+	printf("power cuts: %lu cuts over %lu appends, %lu committed after a remount of 20 tried each, "
+		   "at least %lu bytes kept\n",
+		   (unsigned long)sim_flash_cuts(), (unsigned long)next_seq, (unsigned long)commits_after,
+		   (unsigned long)min_bytes);
+	CHECK(sim_flash_cuts() == CUT_RUNS);
+	//the ring keeps at least two of its four sectors
+	CHECK(min_bytes >= 2 * (16 * 1024 - FLASH_LOG_SPARE_BYTES - FLASH_LOG_BLOCK));
+}
+
+int main(void)
+{
+	sim_init();
+	test_append_read();
+	test_erase_running();
+	test_power_cuts();
+	return CHECK_DONE();
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <string.h>
+#include "accel_stream.h"
+#include "check.h"
+
+/*
+ * L3GD20 gyroscope on a simulated SPI1 register file, at the ODR the BSP
+ * sets (760 Hz, L3GD20_OUTPUT_DATARATE_4), read in the two ways the
+ * station has read it:
+ *
+ *  - FIFO/DMA, BSP_GYRO_StreamInit: 32 deep FIFO in stream mode, INT2
+ *    high while it holds the watermark (16), its rising edge is EXTI1
+ *    (accel_stream_watermark). L3GD20_FifoRead_DMA sends the address byte
+ *    blocking, then 96 bytes go by DMA and end in HAL_SPI_RxCpltCallback
+ *    (accel_stream_done) with the INT2 level. The address wraps from
+ *    OUT_Z_H back to OUT_X_L, each wrap pops a sample. The sensor task
+ *    runs BSP_GYRO_Read every 10 ms;
+ *  - per byte, L3GD20_ReadXYZAngRate: FIFO bypassed, two chip select
+ *    cycles (CTRL_REG4, then OUT_X_L..OUT_Z_H), 9 blocking one byte
+ *    transfers per call. Called from the 10 ms sensor task, as it was, and
+ *    every 1 ms tick, the fastest a task can poll.
+ *
+ * SPI1 runs at 6 MHz (APB2 48 MHz / 8): a byte is 1333 ns on the bus.
+ * Measured, simulated time: the ODR delivered (new samples per second, in
+ * order, none repeated) and the CPU held waiting on the bus in blocking
+ * transfers. The code of each path is not in that figure, the accel_stream
+ * calls are reported apart in host cycles per sample.
+ * Sample n carries x = n, y = ~n, z = n >> 16, so order and gaps show.
+ */
+
+#define OUT_X_L 		0x28
+#define OUT_Z_H 		0x2D
+#define FIFO_DEPTH 		32
+#define WATERMARK 		16
+#define ODR_HZ 			760
+#define BYTE_NS 		1333
+#define TRANSFER_NS 	(WATERMARK * 6 * BYTE_NS)
+#define TASK_US 		10000
+#define RUN_S 			20
+
+struct sim{
+	uint8_t 	fifo[FIFO_DEPTH][6];
+	uint8_t 	level;
+	uint8_t 	first;
+	uint8_t 	out[6];				// Output registers, FIFO bypassed
+	uint32_t 	produced;
+	uint32_t 	overrun;
+	uint8_t 	stream;				// FIFO in stream mode
+	uint8_t 	line;				// INT2
+	uint8_t 	*dst;				// DMA running: destination
+	uint16_t 	bytes;
+	uint8_t 	addr;
+	uint32_t 	now_us;
+	uint32_t 	end_us;
+	uint64_t 	blocked_ns;			// CPU waiting on blocking transfers
+};
+
+struct result{
+	uint32_t 	samples;			// New samples received
+	uint32_t 	gaps;
+	uint32_t 	disorder;
+	uint64_t 	cycles;				// Host cycles in accel_stream
+};
+
+static struct sim 		sim;
+static accel_stream_t 	gs;
+
+static void sim_produce(void)
+{
+	uint32_t n = sim.produced++;
+	uint8_t  s[6] = { n, n >> 8, ~n, ~n >> 8, n >> 16, n >> 24 };
+
+	memcpy(sim.out, s, 6);
+	if(!sim.stream){
+		return;
+	}
+	if(sim.level == FIFO_DEPTH){
+		sim.first = (sim.first + 1) % FIFO_DEPTH;
+		sim.level--;
+		sim.overrun++;
+	}
+	memcpy(sim.fifo[(sim.first + sim.level) % FIFO_DEPTH], s, 6);
+	sim.level++;
+}
+
+//one register read of the auto-increment burst
+static uint8_t sim_register(void)
+{
+	uint8_t value = sim.level ? sim.fifo[sim.first][sim.addr - OUT_X_L] : 0;
+
+	if(sim.addr++ == OUT_Z_H){
+		sim.addr = OUT_X_L;
+		if(sim.level){
+			sim.first = (sim.first + 1) % FIFO_DEPTH;
+			sim.level--;
+		}
+	}
+	return value;
+}
+
+/* accel_read_t: L3GD20_FifoRead_DMA, the address byte blocking, the rest by DMA */
+static uint8_t sim_read(uint8_t *buffer, uint8_t samples)
+{
+	CHECK(sim.dst == NULL && samples == WATERMARK);
+	sim.blocked_ns += BYTE_NS;
+	sim.dst 		= buffer;
+	sim.bytes 		= samples * 6;
+	sim.addr 		= OUT_X_L;
+	sim.end_us 		= sim.now_us + 1 + TRANSFER_NS / 1000;
+	return 1;
+}
+
+/* L3GD20_ReadXYZAngRate: CTRL_REG4, then the 6 output registers, byte by byte */
+static void sim_read_xyz(int16_t *xyz)
+{
+	sim.blocked_ns += (2 + 7) * BYTE_NS;
+	for(int i = 0; i < 3; i++){
+		xyz[i] = (int16_t)(sim.out[2 * i] | sim.out[2 * i + 1] << 8);
+	}
+}
+
+//the sensor and the bus until us, interrupts included
+static void sim_run(uint32_t until, struct result *r)
+{
+	uint32_t t;
+	uint8_t  line;
+
+	for(; sim.now_us < until; sim.now_us++){
+		sim_set_tick(sim.now_us / 1000);
+		//sample n at n / ODR seconds
+		if((uint64_t)sim.produced * 1000000 / ODR_HZ == sim.now_us){
+			sim_produce();
+		}
+		if(!sim.stream){
+			continue;
+		}
+		line = sim.level >= WATERMARK;
+		if(line && !sim.line){
+			t = DWT->CYCCNT;
+			accel_stream_watermark(&gs, HAL_GetTick());
+			r->cycles += DWT->CYCCNT - t;
+		}
+		sim.line = line;
+		if(sim.dst != NULL && sim.now_us >= sim.end_us){
+			for(uint16_t i = 0; i < sim.bytes; i++){
+				sim.dst[i] = sim_register();
+			}
+			sim.dst  = NULL;
+			sim.line = sim.level >= WATERMARK;
+			t 		 = DWT->CYCCNT;
+			accel_stream_done(&gs, HAL_GetTick(), sim.line);
+			r->cycles += DWT->CYCCNT - t;
+		}
+	}
+}
+
+static void sample(const int16_t *xyz, uint32_t *expect, struct result *r)
+{
+	uint32_t n = (uint16_t)xyz[0] | ((uint32_t)(uint16_t)xyz[2] << 16);
+
+	if((uint16_t)(xyz[0] ^ xyz[1]) != 0xFFFF || n + 1 < *expect){
+		r->disorder++;
+		return;
+	}
+	if(n + 1 == *expect){
+		return;							//read again before the next sample
+	}
+	r->gaps += n - *expect;
+	*expect  = n + 1;
+	r->samples++;
+}
+
+/* FIFO/DMA: the sensor task every 10 ms empties the ring */
+static void run_stream(struct result *r)
+{
+	accel_block_t block;
+	uint32_t 	  expect = 0, t;
+	uint8_t 	  more;
+
+	memset(&sim, 0, sizeof(sim));
+	memset(r, 0, sizeof(*r));
+	sim.stream = 1;
+	accel_stream_init(&gs, sim_read, WATERMARK);
+	while(sim.now_us < RUN_S * 1000000u){
+		sim_run(sim.now_us + TASK_US, r);
+		//BSP_GYRO_Read
+		t = DWT->CYCCNT;
+		if(!gs.busy && sim.line){
+			accel_stream_watermark(&gs, HAL_GetTick());
+		}
+		more = accel_stream_read(&gs, &block);
+		r->cycles += DWT->CYCCNT - t;
+		while(more){
+			CHECK(block.count == WATERMARK);
+			for(uint8_t i = 0; i < block.count; i++){
+				sample(block.xyz[i], &expect, r);
+			}
+			t 	 = DWT->CYCCNT;
+			more = accel_stream_read(&gs, &block);
+			r->cycles += DWT->CYCCNT - t;
+		}
+	}
+}
+
+/* Per byte: one L3GD20_ReadXYZAngRate every period */
+static void run_bytes(uint32_t period_us, struct result *r)
+{
+	int16_t  xyz[3];
+	uint32_t expect = 0;
+
+	memset(&sim, 0, sizeof(sim));
+	memset(r, 0, sizeof(*r));
+	while(sim.now_us < RUN_S * 1000000u){
+		sim_run(sim.now_us + period_us, r);
+		if(sim.produced > 0){
+			sim_read_xyz(xyz);
+			sample(xyz, &expect, r);
+		}
+	}
+}
+
+static void report(const char *name, const struct result *r, double *odr, double *cpu)
+{
+	*odr = (double)r->samples / RUN_S;
+	*cpu = sim.blocked_ns / (RUN_S * 1e9) * 100;
+	printf("%-32s %6.1f Hz delivered of %u, %5.1f %% missed, CPU blocked on SPI %.3f %% (%.0f ns per sample)\n",
+		   name, *odr, ODR_HZ, r->gaps * 100.0 / (r->samples + r->gaps), *cpu,
+		   (double)sim.blocked_ns / (r->samples ? r->samples : 1));
+}
+
+int main(void)
+{
+	struct result rs, r10, r1;
+	double 		  odr_s, cpu_s, odr_10, cpu_10, odr_1, cpu_1;
+
+	sim_init();
+
+	run_stream(&rs);
+	report("fifo/dma, task 10 ms", &rs, &odr_s, &cpu_s);
+	printf("  %lu transfers, lost %lu, overrun %lu, accel_stream %.1f host cycles per sample\n",
+		   (unsigned long)gs.transfers, (unsigned long)gs.lost, (unsigned long)sim.overrun,
+		   (double)rs.cycles / rs.samples);
+	CHECK(rs.disorder == 0 && rs.gaps == 0 && gs.lost == 0 && sim.overrun == 0);
+	CHECK(gs.transfers * WATERMARK == gs.samples && rs.samples == gs.samples);
+	CHECK(rs.samples + sim.level + WATERMARK >= sim.produced);
+
+	run_bytes(TASK_US, &r10);
+	report("per byte, task 10 ms", &r10, &odr_10, &cpu_10);
+	CHECK(r10.disorder == 0);
+
+	run_bytes(1000, &r1);
+	report("per byte, every 1 ms tick", &r1, &odr_1, &cpu_1);
+	CHECK(r1.disorder == 0 && r1.gaps == 0);
+
+	//the full ODR at a fraction of the bus time of either per byte path
+	CHECK(odr_s > ODR_HZ * 0.99 && odr_10 < ODR_HZ / 5);
+	CHECK(cpu_s * 10 < cpu_10 && cpu_s * 50 < cpu_1);
+	return CHECK_DONE();
+}
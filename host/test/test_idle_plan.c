@@ -0,0 +1,395 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+/*
+ * Scheduler model of the sampling plan of src/app.c under tickless idle,
+ * 1 us steps. The tasks block as app.c makes them block (their periods
+ * and priorities are copied from app.c and bsp.c), the interrupts come at
+ * the rates the BSP sets up, and the idle task sleeps as
+ * BSP_SuppressTicksAndSleep does: only with configEXPECTED_IDLE_TIME_
+ * BEFORE_SLEEP (2) ticks or more until the next timed wake-up, until that
+ * tick or the first interrupt. Awake without sleeping, the tick interrupt
+ * runs every ms.
+ *
+ * The CPU cost of each activity is an assumption for a Cortex-M4 at
+ * 96 MHz (cost table below), except the microphone block, which is the
+ * MIC_BLOCK_BUDGET of BSP. What the model measures is what follows from
+ * the plan: the fraction of time asleep, how often and how long it
+ * sleeps, and the wake latency, from a task's deadline tick or from the
+ * interrupt that notified it to the task running. All figures are
+ * simulated time.
+ *
+ * Plans: the whole station; the battery plan without microphone (its DMA
+ * interrupts every ms); the battery plan with the tasks polling as they
+ * did before they blocked until their deadlines (sensor every 10 ms,
+ * telemetry every 5 ms).
+ */
+
+#define SIM_US 				60000000u			// 60 s
+#define TICK_US 			1000u
+#define NEVER 				0xFFFFFFFFu
+#define BINS 				300					// Latency histogram, 10 us bins
+#define SLEEP_MIN_TICKS 	2					// configEXPECTED_IDLE_TIME_BEFORE_SLEEP
+
+/* Cost table, us (assumptions, see above) */
+#define COST_TICK 			2					// SysTick interrupt
+#define COST_WAKE 			3					// WFI exit and tick count step
+#define COST_SWITCH 		1					// Context switch
+#define COST_MIC 			100					// MIC_BLOCK_BUDGET, 9600 cycles
+#define COST_ADC 			10					// adc_acq_process of a half
+#define COST_EXTI 			3					// FIFO watermark, starts the read
+#define COST_READ_DONE 		5					// I2C / SPI read complete
+#define COST_UART 			5					// Idle line
+#define COST_TIMER 			5					// Timer action
+#define COST_SENSOR 		15					// Sensor pass
+#define COST_SAMPLE 		5					// Each sample read and queued
+#define COST_DHT11 			20					// dht11_process with a decode
+#define COST_MIC_FRAME 		1200				// 1024 point spectrum and bands
+#define COST_VIB_FRAME 		400					// 256 point spectrum
+#define COST_IMU 			50					// Orientation of a block
+#define COST_TELEMETRY 		30
+#define COST_FLUSH 			150					// Frame, CRC and AT send
+
+enum task_id{ T_TIMER, T_SENSOR, T_TELEMETRY, TASKS };
+
+struct task{
+	const char *name;
+	uint32_t 	wake;							// Timed wake-up, NEVER blocked forever
+	uint32_t 	notified;						// Time of the first notification pending, NEVER none
+	uint8_t 	ready;
+	uint32_t 	ready_at;						// Deadline or notification it runs for
+	uint8_t 	by_notify;
+	uint32_t 	work;							// us left of its pass
+};
+
+struct irq{
+	const char *name;
+	uint32_t 	period;							// us, 0 off
+	uint32_t 	phase;
+	uint32_t 	cost;
+	uint32_t 	count;
+};
+
+struct plan{
+	const char *name;
+	uint8_t 	mic;
+	uint8_t 	polling;
+};
+
+struct result{
+	double 		asleep;
+	uint32_t 	sleeps;
+	uint32_t 	lat_timed[BINS], lat_notify[BINS];	// Last bin is everything above
+	uint32_t 	max_timed, max_notify;
+	uint32_t 	n_timed, n_notify;
+};
+
+enum{ I_MIC, I_ADC, I_ACCEL, I_ACCEL_DONE, I_GYRO, I_GYRO_DONE, I_UART, IRQS };
+
+static struct task 		tasks[TASKS];
+static struct irq 		irqs[IRQS];
+static const struct plan *plan;
+
+/* Plan state */
+static uint32_t sensor_due[3];					// 1 s sensors, 2 s sensors, DHT11 read
+static uint32_t dht_busy_until;
+static uint32_t led_due, button_due;
+static uint32_t flush_due, metrics_due;
+static uint32_t mic_blocks, accel_blocks, gyro_blocks, spectrum_frames, vib_frames, imu_blocks;
+
+static void notify(enum task_id t, uint32_t now)
+{
+	if(tasks[t].notified == NEVER){
+		tasks[t].notified = now;
+	}
+}
+
+//an interrupt of the plan, cost already accounted
+static void irq_action(uint32_t i, uint32_t now)
+{
+	switch(i){
+	case I_MIC:
+		//a spectrum frame every 64 blocks, a level window every 1000
+		if(++mic_blocks % 64 == 0 || mic_blocks % 1000 == 0){
+			spectrum_frames += mic_blocks % 64 == 0;
+			notify(T_SENSOR, now);
+		}
+		break;
+	case I_ACCEL_DONE:
+		accel_blocks++;
+		notify(T_SENSOR, now);
+		break;
+	case I_GYRO_DONE:
+		gyro_blocks++;
+		notify(T_SENSOR, now);
+		break;
+	case I_UART:
+		notify(T_TELEMETRY, now);
+		break;
+	default:
+		break;
+	}
+}
+
+//one pass of a task: its cost, and the tick it blocks until
+static uint32_t task_pass(enum task_id t, uint32_t now, uint32_t *wake)
+{
+	uint32_t cost = 0, samples = 0;
+
+	switch(t){
+	case T_TIMER:
+		//APP_TimerTask: LED and button timers of 50 ms
+		cost = COST_TIMER;
+		if(now >= led_due){
+			led_due += 50000;
+			cost 	+= COST_TIMER;
+		}
+		if(now >= button_due){
+			button_due += 50000;
+			cost 	   += COST_TIMER;
+		}
+		*wake = led_due < button_due ? led_due : button_due;
+		break;
+
+	case T_SENSOR:
+		//APP_SensorTask: sensors due, DHT11 advanced, blocks of the interrupts
+		cost = COST_SENSOR;
+		if(now >= sensor_due[2] && dht_busy_until == 0){
+			dht_busy_until = now + 22000;			//18 ms start pulse and transfer
+		}
+		if(dht_busy_until != 0 && now >= dht_busy_until){
+			dht_busy_until 	= 0;
+			sensor_due[2]  += 1018000;
+			cost 		   += COST_DHT11;
+		}
+		for(int s = 0; s < 2; s++){
+			if(now >= sensor_due[s]){
+				samples 	  += s == 0 ? 6 : 2;		//six sensors of 1 s, two of 2 s
+				sensor_due[s] += s == 0 ? 1000000 : 2000000;
+			}
+		}
+		cost += samples * COST_SAMPLE;
+		for(; imu_blocks < accel_blocks + gyro_blocks; imu_blocks++){
+			cost += COST_IMU;
+		}
+		//a 256 point vibration frame every 16 accelerometer blocks
+		for(; vib_frames < accel_blocks / 16; vib_frames++){
+			cost += COST_VIB_FRAME;
+		}
+		for(; spectrum_frames > 0; spectrum_frames--){
+			cost += COST_MIC_FRAME;
+		}
+		if(samples > 0){
+			notify(T_TELEMETRY, now);
+		}
+		if(plan->polling){
+			*wake = now + 10000;
+			break;
+		}
+		*wake = sensor_due[0] < sensor_due[1] ? sensor_due[0] : sensor_due[1];
+		//while the DHT11 reads, DHT11_POLL instead of its due time
+		if(dht_busy_until != 0){
+			*wake = now + 10000 < *wake ? now + 10000 : *wake;
+		}
+		else{
+			*wake = sensor_due[2] < *wake ? sensor_due[2] : *wake;
+		}
+		break;
+
+	case T_TELEMETRY:
+		cost = COST_TELEMETRY;
+		if(now >= flush_due){
+			flush_due += 1000000;
+			cost 	  += COST_FLUSH;
+		}
+		if(now >= metrics_due){
+			metrics_due += 1000000;
+			cost 		+= COST_TELEMETRY;
+		}
+		*wake = plan->polling ? now + 5000 : (flush_due < metrics_due ? flush_due : metrics_due);
+		break;
+
+	default:
+		break;
+	}
+	//the kernel wakes on ticks
+	*wake = (*wake + TICK_US - 1) / TICK_US * TICK_US;
+	return cost + COST_SWITCH;
+}
+
+static void latency(uint32_t *hist, uint32_t *max, uint32_t *n, uint32_t us)
+{
+	hist[us / 10 < BINS - 1 ? us / 10 : BINS - 1]++;
+	*max = us > *max ? us : *max;
+	(*n)++;
+}
+
+static uint32_t percentile(const uint32_t *hist, uint32_t n, double p)
+{
+	uint32_t seen = 0;
+
+	for(int b = 0; b < BINS; b++){
+		seen += hist[b];
+		if(seen >= n * p){
+			return (b + 1) * 10;
+		}
+	}
+	return BINS * 10;
+}
+
+static void run(const struct plan *p, struct result *r)
+{
+	uint32_t isr_left = 0, wake_left = 0, next_tick = TICK_US, asleep = 0, sleep_until = 0, timed;
+	uint8_t  sleeping = 0;
+	int 	 running;
+
+	plan = p;
+	memset(r, 0, sizeof(*r));
+	memset(irqs, 0, sizeof(irqs));
+	irqs[I_MIC] 		= (struct irq){ "mic", p->mic ? 1000 : 0, 500, COST_MIC, 0 };
+	irqs[I_ADC] 		= (struct irq){ "adc", 16000, 300, COST_ADC, 0 };
+	irqs[I_ACCEL] 		= (struct irq){ "accel", 40000, 7000, COST_EXTI, 0 };
+	irqs[I_ACCEL_DONE] 	= (struct irq){ "accel read", 40000, 9200, COST_READ_DONE, 0 };		//96 bytes at 400 kHz I2C
+	irqs[I_GYRO] 		= (struct irq){ "gyro", 21053, 3000, COST_EXTI, 0 };
+	irqs[I_GYRO_DONE] 	= (struct irq){ "gyro read", 21053, 3100, COST_READ_DONE, 0 };
+	irqs[I_UART] 		= (struct irq){ "wifi rx", 5000000, 2500000, COST_UART, 0 };
+	for(int t = 0; t < TASKS; t++){
+		tasks[t] = (struct task){ NULL, 0, NEVER, 0, 0, 0, 0 };
+	}
+	sensor_due[0] = sensor_due[1] = 1000000;
+	sensor_due[2] = 1000000;
+	dht_busy_until = 0;
+	led_due = button_due = 50000;
+	flush_due = metrics_due = 1000000;
+	mic_blocks = accel_blocks = gyro_blocks = spectrum_frames = vib_frames = imu_blocks = 0;
+
+	for(uint32_t now = 0; now < SIM_US; now++){
+		//interrupts arriving now
+		for(uint32_t i = 0; i < IRQS; i++){
+			if(irqs[i].period != 0 && now >= irqs[i].phase && (now - irqs[i].phase) % irqs[i].period == 0){
+				isr_left += irqs[i].cost;
+				irq_action(i, now);
+				irqs[i].count++;
+				if(sleeping){
+					sleeping  = 0;
+					wake_left = COST_WAKE;
+					r->sleeps++;
+				}
+			}
+		}
+		//tick: the SysTick interrupt while awake, the wake-up it was set for while asleep
+		if(now == next_tick){
+			next_tick += TICK_US;
+			if(sleeping && now >= sleep_until){
+				sleeping  = 0;
+				wake_left = COST_WAKE;
+				r->sleeps++;
+			}
+			else if(!sleeping){
+				isr_left += COST_TICK;
+			}
+		}
+		if(sleeping){
+			asleep++;
+			continue;
+		}
+		//tasks whose timeout or notification came, at tick granularity for timeouts
+		for(int t = 0; t < TASKS; t++){
+			if(tasks[t].ready){
+				continue;
+			}
+			if(tasks[t].notified != NEVER){
+				tasks[t].ready 	   = 1;
+				tasks[t].ready_at  = tasks[t].notified;
+				tasks[t].by_notify = 1;
+				tasks[t].notified  = NEVER;
+			}
+			else if(tasks[t].wake != NEVER && now >= tasks[t].wake && now % TICK_US == 0){
+				tasks[t].ready 	   = 1;
+				tasks[t].ready_at  = tasks[t].wake;
+				tasks[t].by_notify = 0;
+			}
+		}
+		if(wake_left > 0){
+			wake_left--;
+			continue;
+		}
+		if(isr_left > 0){
+			isr_left--;
+			continue;
+		}
+		//highest priority ready task: timer, sensor, telemetry
+		running = -1;
+		for(int t = 0; t < TASKS && running < 0; t++){
+			running = tasks[t].ready ? t : -1;
+		}
+		if(running >= 0){
+			struct task *tk = &tasks[running];
+
+			if(tk->work == 0){
+				if(tk->by_notify){
+					latency(r->lat_notify, &r->max_notify, &r->n_notify, now - tk->ready_at);
+				}
+				else{
+					latency(r->lat_timed, &r->max_timed, &r->n_timed, now - tk->ready_at);
+				}
+				tk->work = task_pass(running, now, &tk->wake);
+			}
+			if(--tk->work == 0){
+				tk->ready = 0;
+			}
+			continue;
+		}
+		//idle: sleep if the next timed wake-up is 2 ticks away or more
+		timed = NEVER;
+		for(int t = 0; t < TASKS; t++){
+			timed = tasks[t].wake < timed ? tasks[t].wake : timed;
+		}
+		if(timed != NEVER && timed / TICK_US >= now / TICK_US + SLEEP_MIN_TICKS){
+			sleeping 	= 1;
+			sleep_until = timed;
+			asleep++;
+		}
+	}
+	r->asleep = (double)asleep / SIM_US;
+}
+
+static void report(const struct plan *p, const struct result *r)
+{
+	printf("%-44s asleep %5.1f %%, %6.1f sleeps/s of %7.0f us mean\n", p->name, r->asleep * 100,
+		   r->sleeps / (SIM_US / 1e6), r->asleep * SIM_US / (r->sleeps ? r->sleeps : 1));
+	printf("  wake latency, deadline tick to task:    p50 <%4lu us, p99 <%4lu us, max %4lu us (%lu wakes)\n",
+		   (unsigned long)percentile(r->lat_timed, r->n_timed, 0.5), (unsigned long)percentile(r->lat_timed, r->n_timed, 0.99),
+		   (unsigned long)r->max_timed, (unsigned long)r->n_timed);
+	printf("  wake latency, interrupt notify to task: p50 <%4lu us, p99 <%4lu us, max %4lu us (%lu wakes)\n",
+		   (unsigned long)percentile(r->lat_notify, r->n_notify, 0.5), (unsigned long)percentile(r->lat_notify, r->n_notify, 0.99),
+		   (unsigned long)r->max_notify, (unsigned long)r->n_notify);
+}
+
+int main(void)
+{
+	static const struct plan station = { "station, tickless", 1, 0 };
+	static const struct plan battery = { "battery plan (no microphone), tickless", 0, 0 };
+	static const struct plan polling = { "battery plan, tasks polling 10 / 5 ms", 0, 1 };
+	struct result 			 rs, rb, rp;
+
+	run(&station, &rs);
+	report(&station, &rs);
+	run(&battery, &rb);
+	report(&battery, &rb);
+	run(&polling, &rp);
+	report(&polling, &rp);
+
+	//the plan keeps its deadlines: a task runs within the tick it is due, or
+	//after a spectrum pass of the sensor task when that one runs first
+	CHECK(rb.max_timed < TICK_US && rp.max_timed < TICK_US);
+	CHECK(rs.max_timed < TICK_US + COST_MIC_FRAME);
+	//without the microphone it sleeps longer and less often than polling
+	CHECK(rb.asleep > rs.asleep && rb.asleep > rp.asleep);
+	CHECK(rb.sleeps < rp.sleeps);
+	CHECK(rb.n_timed > 0 && rb.n_notify > 0);
+	return CHECK_DONE();
+}
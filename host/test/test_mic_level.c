@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include "pdm2pcm_glo.h"
+#include "mic_level.h"
+#include "prof.h"
+#include "check.h"
+#include "pdm_source.h"
+
+/* BSP configuration: 16 kHz, 1 ms blocks, D = 64, 1 s windows */
+#define FS 				16000
+#define BLOCK 			16
+#define WINDOW_MS 		1000
+#define BLOCK_BUDGET 	9600			// MIC_BLOCK_BUDGET of the BSP
+
+static PDM_Filter_Handler_t handler;
+static PDM_Filter_Config_t 	config;
+static mic_level_t 			mic;
+static uint8_t 				pdm[BLOCK * 64 / 8];
+static int16_t 				pcm[BLOCK];
+
+static void setup(uint16_t leq_windows)
+{
+	handler.bit_order 		 = PDM_FILTER_BIT_ORDER_LSB;
+	handler.endianness 		 = PDM_FILTER_ENDIANNESS_BE;
+	handler.high_pass_tap 	 = 2122358088;
+	handler.in_ptr_channels  = 1;
+	handler.out_ptr_channels = 1;
+	config.decimation_factor 	 = PDM_FILTER_DEC_FACTOR_64;
+	config.output_samples_number = BLOCK;
+	config.mic_gain 			 = 0;
+	CHECK(PDM_Filter_Init(&handler) == 0 && PDM_Filter_setConfig(&handler, &config) == 0);
+	mic_level_init(&mic, FS, WINDOW_MS, leq_windows, 0.0f);
+}
+
+//the BSP block path: PDM through the filter into the level meter, timed
+static void blocks(struct pdm_source *src, uint32_t count, double hz, double amplitude)
+{
+	uint32_t start;
+
+	for(uint32_t b = 0; b < count; b++){
+		pdm_source_sine(src, pdm, sizeof(pdm), hz, amplitude, 0);
+		sim_advance_tick(1);
+		start = PROF_BEGIN();
+		PDM_Filter(pdm, pcm, &handler);
+		mic_level_process(&mic, pcm, BLOCK, HAL_GetTick());
+		PROF_END(PROF_MIC_BLOCK, start);
+	}
+}
+
+//last record of a run, every earlier one dropped
+static uint8_t last_record(mic_record_t *rec)
+{
+	uint8_t got = 0;
+
+	while(mic_level_read(&mic, rec)){
+		got = 1;
+	}
+	return got;
+}
+
+/* 1 kHz at -6 dBFS: -9.0 dB RMS (A weighting is 0 dB there), -6 dB peak */
+static void test_chain_levels(void)
+{
+	struct pdm_source src;
+	mic_record_t 	  rec;
+
+	setup(60);
+	pdm_source_init(&src, FS * 64.0);
+	blocks(&src, 2 * WINDOW_MS, 1000, 0.5);
+	CHECK(last_record(&rec));
+	printf("1 kHz -6 dBFS: LA %.1f dB, peak %.1f dB\n", rec.la_x10 / 10.0, rec.peak_x10 / 10.0);
+	CHECK(rec.la_x10 >= -93 && rec.la_x10 <= -87);
+	CHECK(rec.peak_x10 >= -63 && rec.peak_x10 <= -57);
+	CHECK(rec.tick == HAL_GetTick());
+
+	//100 Hz takes the -19.1 dB A correction
+	blocks(&src, 2 * WINDOW_MS, 100, 0.5);
+	CHECK(last_record(&rec));
+	printf("100 Hz -6 dBFS: LA %.1f dB\n", rec.la_x10 / 10.0);
+	CHECK(rec.la_x10 >= -286 && rec.la_x10 <= -276);
+}
+
+/* Per block cost of the BSP path, host cycles */
+static void test_block_cycles(void)
+{
+	const prof_stat_t *stat = prof_get(PROF_MIC_BLOCK);
+	uint32_t 		   p50 = 0, seen = 0;
+
+	for(int b = 0; b < PROF_BUCKETS && seen < stat->count / 2; b++){
+		seen += stat->hist[b];
+		p50   = 1u << b;
+	}
+	printf("mic_block: %lu blocks, mean %.0f, min %lu, median below %lu host cycles\n",
+		   (unsigned long)stat->count, (double)stat->total / stat->count,
+		   (unsigned long)stat->min, (unsigned long)p50);
+	CHECK(stat->count == 4 * WINDOW_MS);
+	CHECK(p50 <= BLOCK_BUDGET);
+}
+
+/* A weighting against IEC 61672, PCM straight into the meter */
+static void test_a_weighting(void)
+{
+	static const struct{ double hz, db; } iec[] = {
+		{31.5, -39.4}, {63, -26.2}, {125, -16.1}, {250, -8.6}, {500, -3.2}, {1000, 0.0},
+		{2000, 1.2}, {4000, 1.0}, {6300, -0.1},
+	};
+	int16_t 	 block[BLOCK];
+	mic_record_t rec;
+	double 		 la;
+
+	for(unsigned i = 0; i < sizeof(iec) / sizeof(iec[0]); i++){
+		mic_level_init(&mic, FS, WINDOW_MS, 60, 0.0f);
+		for(uint32_t n = 0; n < 3 * FS; n += BLOCK){
+			for(int k = 0; k < BLOCK; k++){
+				block[k] = (int16_t)lrint(16384 * sin(2 * M_PI * iec[i].hz * (n + k) / FS));
+			}
+			mic_level_process(&mic, block, BLOCK, n / BLOCK);
+		}
+		CHECK(last_record(&rec));
+		la = rec.la_x10 / 10.0 + 9.03;
+		printf("A weighting %6.1f Hz: %+.1f dB (IEC %+.1f)\n", iec[i].hz, la, iec[i].db);
+		CHECK(fabs(la - iec[i].db) <= 0.2);
+	}
+}
+
+/* Leq is the energy mean of its windows, one record per window */
+static void test_leq(void)
+{
+	static const int16_t amp[4] = {16384, 8192, 16384, 4096};
+	int16_t 	 block[BLOCK];
+	mic_record_t rec;
+	double 		 power = 0;
+
+	mic_level_init(&mic, FS, WINDOW_MS, 4, 0.0f);
+	for(int w = 0; w < 4; w++){
+		for(uint32_t n = 0; n < FS; n += BLOCK){
+			for(int k = 0; k < BLOCK; k++){
+				block[k] = (int16_t)lrint(amp[w] * sin(2 * M_PI * 1000 * (n + k) / FS));
+			}
+			mic_level_process(&mic, block, BLOCK, w);
+		}
+		CHECK(mic_level_read(&mic, &rec));
+		CHECK(rec.leq_done == (w == 3));
+		power += (double)amp[w] * amp[w] / 2;
+	}
+	printf("Leq %.1f dB, expected %.1f dB\n", rec.leq_x10 / 10.0, 10 * log10(power / 4 / (32768.0 * 32768.0)));
+	CHECK(fabs(rec.leq_x10 / 10.0 - 10 * log10(power / 4 / (32768.0 * 32768.0))) <= 0.2);
+
+	//a reader that never reads loses the windows that do not fit
+	for(int w = 0; w < 6; w++){
+		for(uint32_t n = 0; n < FS; n += BLOCK){
+			mic_level_process(&mic, block, BLOCK, w);
+		}
+	}
+	CHECK(mic.lost == 6 - (MIC_LEVEL_RECORDS - 1));
+}
+
+/* dB conversion against libm */
+static void test_db(void)
+{
+	double worst = 0, err;
+
+	for(double x = 1e-9; x < 10; x *= 1.001){
+		err = fabs(mic_level_db_x10((float)x, 0.0f) - 100 * log10(x));
+		if(err > worst){
+			worst = err;
+		}
+	}
+	//rounding to 0.1 dB plus the 0.01 dB of the cubic fit
+	printf("dB conversion: worst error %.3f x 0.1 dB\n", worst);
+	CHECK(worst <= 0.6);
+	CHECK(mic_level_db_x10(0.0f, 0.0f) == INT16_MIN);
+	CHECK(mic_level_db_x10(1.0f, 120.0f) == 1200);
+}
+
+int main(void)
+{
+	sim_init();
+	prof_init();
+	test_chain_levels();
+	test_block_cycles();
+	test_a_weighting();
+	test_leq();
+	test_db();
+	return CHECK_DONE();
+}
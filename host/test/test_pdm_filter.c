@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include "pdm2pcm_glo.h"
+#include "stm32f4xx_hal.h"
+#include "check.h"
+#include "pdm_source.h"
+
+/* BSP configuration: 16 kHz out, D = 64, 1 ms blocks */
+#define FS 				16000
+#define BLOCK 			16
+#define SETTLE 			2000			// Samples dropped before measuring
+#define MEASURE 		16000
+#define AMPLITUDE 		0.5
+
+static PDM_Filter_Handler_t handler;
+static PDM_Filter_Config_t 	config;
+static int16_t 				pcm[SETTLE + MEASURE];
+static uint8_t 				pdm[BLOCK * 128 / 8];
+
+static void setup(uint16_t decimation, uint32_t high_pass_tap)
+{
+	handler.bit_order 		 = PDM_FILTER_BIT_ORDER_LSB;
+	handler.endianness 		 = PDM_FILTER_ENDIANNESS_BE;
+	handler.high_pass_tap 	 = high_pass_tap;
+	handler.in_ptr_channels  = 1;
+	handler.out_ptr_channels = 1;
+	config.decimation_factor 	 = decimation;
+	config.output_samples_number = BLOCK;
+	config.mic_gain 			 = 0;
+	CHECK(PDM_Filter_Init(&handler) == 0);
+	CHECK(PDM_Filter_setConfig(&handler, &config) == 0);
+}
+
+//runs a sine through the filter, returns the fitted amplitude and SNR in dB
+static double run(uint32_t d, double hz, double amplitude, double offset, double *snr)
+{
+	struct pdm_source src;
+	double 			  fitted, noise;
+
+	pdm_source_init(&src, (double)FS * d);
+	for(uint32_t n = 0; n < SETTLE + MEASURE; n += BLOCK){
+		pdm_source_sine(&src, pdm, BLOCK * d / 8, hz, amplitude, offset);
+		CHECK(PDM_Filter(pdm, &pcm[n], &handler) == 0);
+	}
+	pdm_fit(&pcm[SETTLE], MEASURE, hz, FS, &fitted, &noise);
+	*snr = 10 * log10(fitted * fitted / 2 / noise);
+	return fitted;
+}
+
+/* SNR of a 1 kHz tone at -6 dBFS, BSP configuration */
+static void test_snr(void)
+{
+	double amp, snr;
+
+	setup(PDM_FILTER_DEC_FACTOR_64, 2122358088);
+	amp = run(64, 1000, AMPLITUDE, 0, &snr);
+	printf("D=64 1 kHz -6 dBFS: gain %+.3f dB, SNR %.1f dB\n", 20 * log10(amp / (AMPLITUDE * 32768)), snr);
+	CHECK(snr > 69);
+	CHECK(fabs(20 * log10(amp / (AMPLITUDE * 32768))) < 0.5);
+}
+
+/* Pass band within +-0.3 dB of the nominal gain up to 0.4 fs, high-pass off */
+static void test_response(void)
+{
+	static const double hz[] = {100, 250, 500, 1000, 2000, 3000, 4000, 5000, 5600, 6000, 6400};
+	double 				ref = AMPLITUDE * 32768, amp, snr, worst = 0;
+
+	for(unsigned i = 0; i < sizeof(hz) / sizeof(hz[0]); i++){
+		setup(PDM_FILTER_DEC_FACTOR_64, 0);
+		amp = run(64, hz[i], AMPLITUDE, 0, &snr);
+		printf("D=64 %5.0f Hz: %+.3f dB\n", hz[i], 20 * log10(amp / ref));
+		if(fabs(20 * log10(amp / ref)) > worst){
+			worst = fabs(20 * log10(amp / ref));
+		}
+	}
+	CHECK(worst <= 0.3);
+}
+
+/* Every decimation factor gives the same gain, SNR grows with D */
+static void test_decimations(void)
+{
+	static const struct{ uint16_t code; uint32_t d; double snr; } dec[] = {
+		{PDM_FILTER_DEC_FACTOR_16, 16, 40}, {PDM_FILTER_DEC_FACTOR_24, 24, 49},
+		{PDM_FILTER_DEC_FACTOR_32, 32, 55}, {PDM_FILTER_DEC_FACTOR_48, 48, 63},
+		{PDM_FILTER_DEC_FACTOR_64, 64, 69}, {PDM_FILTER_DEC_FACTOR_80, 80, 74},
+		{PDM_FILTER_DEC_FACTOR_128, 128, 83},
+	};
+	double amp, snr;
+
+	for(unsigned i = 0; i < sizeof(dec) / sizeof(dec[0]); i++){
+		setup(dec[i].code, 0);
+		amp = run(dec[i].d, 1000, AMPLITUDE, 0, &snr);
+		printf("D=%3lu 1 kHz: gain %+.3f dB, SNR %.1f dB\n", (unsigned long)dec[i].d,
+			   20 * log10(amp / (AMPLITUDE * 32768)), snr);
+		CHECK(snr > dec[i].snr);
+		CHECK(fabs(20 * log10(amp / (AMPLITUDE * 32768))) < 0.5);
+	}
+}
+
+/* The high-pass removes an offset, without it the offset goes through */
+static void test_high_pass(void)
+{
+	double amp, snr, mean = 0;
+
+	setup(PDM_FILTER_DEC_FACTOR_64, 2122358088);
+	amp = run(64, 1000, 0.3, 0.2, &snr);
+	for(uint32_t i = SETTLE; i < SETTLE + MEASURE; i++){
+		mean += pcm[i];
+	}
+	mean /= MEASURE;
+	CHECK(fabs(mean) < 20);
+	CHECK(amp > 0.29 * 32768);
+
+	setup(PDM_FILTER_DEC_FACTOR_64, 0);
+	run(64, 1000, 0.3, 0.2, &snr);
+	mean = 0;
+	for(uint32_t i = SETTLE; i < SETTLE + MEASURE; i++){
+		mean += pcm[i];
+	}
+	mean /= MEASURE;
+	CHECK(fabs(mean - 0.2 * 32768) < 0.02 * 32768);
+}
+
+/* Configuration errors */
+static void test_config(void)
+{
+	PDM_Filter_Config_t get;
+
+	setup(PDM_FILTER_DEC_FACTOR_64, 0);
+	CHECK(PDM_Filter_getConfig(&handler, &get) == 0 && get.decimation_factor == PDM_FILTER_DEC_FACTOR_64);
+	config.decimation_factor = 0x55;
+	CHECK(PDM_Filter_setConfig(&handler, &config) & PDM_FILTER_DECIMATION_ERROR);
+	config.decimation_factor = PDM_FILTER_DEC_FACTOR_64;
+	config.mic_gain 		 = 60;
+	CHECK(PDM_Filter_setConfig(&handler, &config) & PDM_FILTER_GAIN_ERROR);
+	config.mic_gain 			 = 0;
+	config.output_samples_number = 0;
+	CHECK(PDM_Filter_setConfig(&handler, &config) & PDM_FILTER_SAMPLES_NUMBER_ERROR);
+}
+
+int main(void)
+{
+	sim_init();
+	test_snr();
+	test_response();
+	test_decimations();
+	test_high_pass();
+	test_config();
+	return CHECK_DONE();
+}
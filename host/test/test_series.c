@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "series.h"
+#include "check.h"
+#include "series_trace.h"
+
+/*
+ * Round trips through series_add / series_finish / series_next. Scaled
+ * integer channels must give back round(value * 10^decimals) / 10^decimals
+ * bit for bit, SERIES_FLOAT channels the float bits themselves, ticks
+ * always exactly.
+ */
+
+#define MAX_BLOCK_SAMPLES 	(SERIES_BLOCK_SIZE * 8)
+
+static uint32_t ticks[MAX_BLOCK_SAMPLES];
+static float 	values[MAX_BLOCK_SAMPLES];
+
+static uint32_t bits_of(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, 4);
+	return u;
+}
+
+//what the decoder must return for value
+static float expected(const series_t *se, float value)
+{
+	if(se->decimals == SERIES_FLOAT){
+		return value;
+	}
+	return (int32_t)(value * se->scale + (value < 0 ? -0.5f : 0.5f)) / se->scale;
+}
+
+/**
+ * @brief decodes a finished block against the samples given to it
+ * @return samples that did not match
+ */
+static uint32_t check_block(const series_t *se, const uint8_t *block, uint16_t len, uint16_t count)
+{
+	series_reader_t rd;
+	uint32_t 		tick, bad = 0;
+	float 			value;
+	uint16_t 		n = 0;
+
+	CHECK(len <= SERIES_BLOCK_SIZE);
+	CHECK(series_open(&rd, block, len));
+	CHECK(rd.id == se->id && rd.decimals == se->decimals && rd.left == count);
+	while(series_next(&rd, &tick, &value)){
+		if(n >= count || tick != ticks[n] || bits_of(value) != bits_of(expected(se, values[n]))){
+			bad++;
+		}
+		n++;
+	}
+	CHECK(n == count);
+	return bad;
+}
+
+/**
+ * @brief encodes samples of a trace in blocks and decodes every block back
+ * @return samples that did not match
+ */
+static uint32_t roundtrip(struct series_trace *tr, uint8_t decimals, uint32_t samples, uint32_t *bytes)
+{
+	static series_t se;
+	const uint8_t 	*block;
+	uint32_t 		bad = 0;
+	uint16_t 		n = 0, len;
+
+	series_init(&se, 7, decimals);
+	*bytes = 0;
+	for(uint32_t i = 0; i < samples; i++){
+		series_trace_next(tr, &ticks[n], &values[n]);
+		if(!series_add(&se, ticks[n], values[n])){
+			//full: the last sample opens the next block
+			uint32_t tick  = ticks[n];
+			float 	 value = values[n];
+
+			CHECK(series_count(&se) == n);
+			len 	= series_finish(&se, &block);
+			bad    += check_block(&se, block, len, n);
+			*bytes += len;
+			ticks[0]  = tick;
+			values[0] = value;
+			n = 0;
+			CHECK(series_add(&se, tick, value));
+		}
+		n++;
+	}
+	len 	= series_finish(&se, &block);
+	bad    += check_block(&se, block, len, n);
+	*bytes += len;
+	CHECK(series_count(&se) == 0);
+	return bad;
+}
+
+/* Station traces, both codings */
+static void test_traces(void)
+{
+	struct series_trace tr;
+	uint32_t 			bytes, bad;
+
+	for(int k = 0; k < TRACE_KINDS; k++){
+		series_trace_init(&tr, k, 123456);
+		bad = roundtrip(&tr, series_trace_decimals[k], 100000, &bytes);
+		printf("%-26s scaled: %5.2f bits/sample, %lu mismatches\n", series_trace_name[k],
+			   bytes * 8.0 / 100000, (unsigned long)bad);
+		CHECK(bad == 0);
+
+		series_trace_init(&tr, k, 123456);
+		bad = roundtrip(&tr, SERIES_FLOAT, 100000, &bytes);
+		printf("%-26s float:  %5.2f bits/sample, %lu mismatches\n", series_trace_name[k],
+			   bytes * 8.0 / 100000, (unsigned long)bad);
+		CHECK(bad == 0);
+	}
+}
+
+/* Every prefix class of ticks and values, tick wrap, odd floats */
+static void test_edges(void)
+{
+	static const int32_t deltas[] = {
+		1000, 1000, 0, 1, -1, 31, -32, 32, 2047, -2048, 2048, 524287, -524288, 524288,
+		0x7FFFFFFF, -0x7FFFFFFF, 5, 0x40000000,
+	};
+	static const float ints[] = {
+		0, -0.1f, 0.7f, -0.8f, 12.7f, -12.8f, 3276.7f, -3276.8f, 1e6f, -2e6f, 1e8f, -1e8f, 0.05f, -0.05f,
+		25.3f, 25.3f, 25.4f, 0,
+	};
+	const float floats[] = {
+		0.0f, -0.0f, 1.0f, 1.0f, -1.0f, INFINITY, -INFINITY, 1e-38f, 1e-45f, 3.4e38f, 25.3f, 25.31f,
+		25.32f, NAN, 7.0f, 7.0f, 1.5f, -1e-10f,
+	};
+	const uint8_t *block;
+	series_t 	   se;
+	uint32_t 	   tick = 0xFFFFF000u;
+	uint16_t 	   len, n = sizeof(deltas) / sizeof(deltas[0]);
+
+	//scaled integers, the tick wraps around 2^32
+	series_init(&se, 3, 1);
+	for(uint16_t i = 0; i < n; i++){
+		tick 	 += deltas[i];
+		ticks[i]  = tick;
+		values[i] = ints[i];
+		CHECK(series_add(&se, ticks[i], values[i]));
+	}
+	len = series_finish(&se, &block);
+	CHECK(block[0] == SERIES_SYNC && block[1] == 3 && block[2] == 1 && (block[3] | block[4] << 8) == n);
+	CHECK(check_block(&se, block, len, n) == 0);
+
+	//float bits, NaN and infinities included
+	series_init(&se, 4, SERIES_FLOAT);
+	for(uint16_t i = 0; i < n; i++){
+		values[i] = floats[i];
+		CHECK(series_add(&se, ticks[i], values[i]));
+	}
+	len = series_finish(&se, &block);
+	CHECK(check_block(&se, block, len, n) == 0);
+
+	//nothing to finish, one sample, bad headers
+	CHECK(series_finish(&se, &block) == 0);
+	ticks[0]  = 42;
+	values[0] = 1.25f;
+	series_add(&se, 42, 1.25f);
+	len = series_finish(&se, &block);
+	CHECK(len == SERIES_HEADER_SIZE + 4 && check_block(&se, block, len, 1) == 0);
+	{
+		series_reader_t rd;
+		uint8_t 		bad[SERIES_HEADER_SIZE] = {0};
+
+		CHECK(!series_open(&rd, block, SERIES_HEADER_SIZE - 1));
+		CHECK(!series_open(&rd, bad, sizeof(bad)));
+	}
+}
+
+/* A truncated block ends early and never returns a damaged sample */
+static void test_truncated(void)
+{
+	struct series_trace tr;
+	series_reader_t 	rd;
+	const uint8_t 		*block;
+	series_t 			se;
+	uint32_t 			tick, bad = 0;
+	uint16_t 			n = 0, len, got;
+	float 				value;
+
+	series_trace_init(&tr, TRACE_MIC_LA, 0);
+	series_init(&se, 1, 1);
+	for(;;){
+		series_trace_next(&tr, &ticks[n], &values[n]);
+		if(!series_add(&se, ticks[n], values[n])){
+			break;
+		}
+		n++;
+	}
+	len = series_finish(&se, &block);
+	for(uint16_t cut = SERIES_HEADER_SIZE; cut < len; cut++){
+		CHECK(series_open(&rd, block, cut));
+		got = 0;
+		while(series_next(&rd, &tick, &value)){
+			if(tick != ticks[got] || bits_of(value) != bits_of(expected(&se, values[got]))){
+				bad++;
+			}
+			got++;
+		}
+		CHECK(got < n);
+	}
+	CHECK(bad == 0);
+}
+
+int main(void)
+{
+	sim_init();
+	test_traces();
+	test_edges();
+	test_truncated();
+	return CHECK_DONE();
+}
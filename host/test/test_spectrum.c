@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <math.h>
+#include "spectrum.h"
+#include "check.h"
+
+/*
+ * Bins against a double precision DFT of the same Hann windowed, shifted
+ * frame. SNR is the power of every reference bin over the power of the
+ * error of every bin, DC and Nyquist included.
+ */
+
+static int16_t 	frame[SPECTRUM_MAX_N];
+static int16_t 	work[SPECTRUM_MAX_N] __attribute__((aligned(4)));
+static double 	ref_re[SPECTRUM_MAX_N / 2 + 1], ref_im[SPECTRUM_MAX_N / 2 + 1];
+
+static void reference(const spectrum_t *sp, const int16_t *x)
+{
+	uint16_t n = sp->n;
+
+	for(uint16_t k = 0; k <= n / 2; k++){
+		double re = 0, im = 0, v;
+
+		for(uint16_t i = 0; i < n; i++){
+			v   = ldexp(x[i], sp->shift) * (1 - cos(2 * M_PI * i / n)) / 2;
+			re += v * cos(2 * M_PI * k * i / n);
+			im -= v * sin(2 * M_PI * k * i / n);
+		}
+		ref_re[k] = re / n;
+		ref_im[k] = im / n;
+	}
+}
+
+//SNR in dB of the bins of sp->work against the reference
+static double snr(const spectrum_t *sp)
+{
+	uint16_t m = sp->n / 2;
+	double 	 signal = 0, err = 0, dre, dim;
+
+	for(uint16_t k = 0; k <= m; k++){
+		if(k == 0){
+			dre = work[0] - ref_re[0];
+			dim = 0;
+		}
+		else if(k == m){
+			dre = work[1] - ref_re[m];
+			dim = 0;
+		}
+		else{
+			dre = work[2 * k] - ref_re[k];
+			dim = work[2 * k + 1] - ref_im[k];
+		}
+		signal += ref_re[k] * ref_re[k] + ref_im[k] * ref_im[k];
+		err += dre * dre + dim * dim;
+	}
+	return 10 * log10(signal / err);
+}
+
+/* Tones from full scale down to the microphone level, every size */
+static void test_accuracy(void)
+{
+	static const double level_db[] = {0, -20, -40, -60, -80};
+	static const double min_snr[] = {50, 46, 44, 40};		// n = 256..2048
+	uint32_t 			seed = 7;
+	double 				worst = 1e9, best = 0, s;
+	spectrum_t 			sp;
+
+	for(uint16_t n = SPECTRUM_MIN_N; n <= SPECTRUM_MAX_N; n *= 2){
+		CHECK(spectrum_init(&sp, n, frame, work));
+		for(unsigned l = 0; l < sizeof(level_db) / sizeof(level_db[0]); l++){
+			double amp = 32767 * pow(10, level_db[l] / 20);
+
+			//tone between two bins plus a little noise, like a mic frame
+			for(uint16_t i = 0; i < n; i++){
+				double noise = ((int32_t)(check_rand(&seed) % 2001) - 1000) / 1000.0 * amp * 0.01;
+
+				frame[i] = (int16_t)lrint(amp * 0.98 * sin(2 * M_PI * 37.3 * i / n) + noise);
+			}
+			spectrum_transform(&sp, frame, 1);
+			reference(&sp, frame);
+			s = snr(&sp);
+			printf("n %4u level %4.0f dBFS shift %2d: SNR %.1f dB\n", n, level_db[l], sp.shift, s);
+			worst = s < worst ? s : worst;
+			best  = s > best ? s : best;
+			CHECK(s >= min_snr[sp.log2n - 8]);
+		}
+	}
+	printf("SNR %.1f to %.1f dB\n", worst, best);
+}
+
+/* spectrum_band matches the dBFS mean square of a sine, with the shift undone */
+static void test_band(void)
+{
+	spectrum_t sp;
+	uint16_t   lo, hi;
+	double 	   ms;
+
+	spectrum_init(&sp, 1024, frame, work);
+	for(uint16_t i = 0; i < 1024; i++){
+		frame[i] = (int16_t)lrint(100 * sin(2 * M_PI * 1000.0 * i / 16000));
+	}
+	spectrum_transform(&sp, frame, 1);
+	lo = spectrum_bin(&sp, 707, 16000);
+	hi = spectrum_bin(&sp, 1414, 16000);
+	ms = spectrum_band(&sp, lo, hi);
+	printf("band 707-1414 Hz, 1 kHz tone: %.2f dB, expected %.2f dB\n",
+		   10 * log10(ms), 10 * log10(100.0 * 100.0 / 2 / (32768.0 * 32768.0)));
+	CHECK(fabs(10 * log10(ms) - 10 * log10(100.0 * 100.0 / 2 / (32768.0 * 32768.0))) < 0.5);
+	CHECK(spectrum_bin(&sp, 16000, 16000) == 512);
+}
+
+/* Feeding: frames complete at n samples, the rest is lost until run */
+static void test_feed(void)
+{
+	int16_t 	xyz[3 * 32];
+	spectrum_t 	sp;
+	uint8_t 	done = 0;
+
+	CHECK(!spectrum_init(&sp, 300, frame, work));
+	CHECK(!spectrum_init(&sp, 4096, frame, work));
+	spectrum_init(&sp, 256, frame, work);
+	for(int i = 0; i < 3 * 32; i++){
+		xyz[i] = (int16_t)i;
+	}
+	for(int b = 0; b < 9; b++){
+		done |= spectrum_feed(&sp, &xyz[2], 32, 3);
+	}
+	CHECK(done && spectrum_ready(&sp));
+	CHECK(sp.lost == 32);
+	CHECK(frame[0] == 2 && frame[1] == 5 && frame[255] == 3 * 31 + 2);
+	spectrum_run(&sp);
+	CHECK(!spectrum_ready(&sp) && sp.fill == 0);
+}
+
+int main(void)
+{
+	sim_init();
+	test_accuracy();
+	test_band();
+	test_feed();
+	return CHECK_DONE();
+}
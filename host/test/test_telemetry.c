@@ -0,0 +1,142 @@
+#include <string.h>
+#include <math.h>
+#include "telemetry.h"
+#include "telemetry_decode.h"
+#include "check.h"
+
+/*
+ * telemetry frames through telemetry_decode (decode/): the CRC against the
+ * simulated CRC unit, random samples out and back, and a full frame with
+ * each bit flipped, each byte changed and cut at each length, all of them
+ * rejected.
+ */
+
+#define SAMPLES 	5000
+
+static CRC_HandleTypeDef hcrc;
+
+/* CRC-32/MPEG-2 over bytes, the byte view of the STM32 CRC unit */
+static uint32_t crc_mpeg2(const uint8_t *data, size_t len)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	for(size_t i = 0; i < len; i++){
+		crc ^= (uint32_t)data[i] << 24;
+		for(int b = 0; b < 8; b++){
+			crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04C11DB7u : crc << 1;
+		}
+	}
+	return crc;
+}
+
+static void test_crc(void)
+{
+	const uint8_t check[] = "123456789";
+	uint8_t 	  bytes[16];
+	uint32_t 	  words[4] = {0x12345678, 0x9ABCDEF0, 0x0BADF00D, 0xFFFFFFFF};
+
+	CHECK(crc_mpeg2(check, 9) == 0x0376E6E7);
+
+	//the unit takes each word most significant byte first
+	for(int i = 0; i < 4; i++){
+		bytes[4 * i] 	 = words[i] >> 24;
+		bytes[4 * i + 1] = words[i] >> 16;
+		bytes[4 * i + 2] = words[i] >> 8;
+		bytes[4 * i + 3] = words[i];
+	}
+	CHECK(HAL_CRC_Calculate(&hcrc, words, 4) == crc_mpeg2(bytes, 16));
+	HAL_CRC_Calculate(&hcrc, words, 2);
+	CHECK(HAL_CRC_Accumulate(&hcrc, &words[2], 2) == crc_mpeg2(bytes, 16));
+	//the decoder's software CRC, over the words as they are in memory
+	CHECK(telemetry_crc((const uint8_t *)words, 16) == crc_mpeg2(bytes, 16));
+}
+
+static void test_round_trip(void)
+{
+	static telemetry_sample_t sent[SAMPLES], got[TELEMETRY_FRAME_SIZE];
+	telemetry_t 		 	  tm;
+	const uint8_t 			 *frame;
+	uint32_t 				  seed = 1, tick = 1000;
+	uint16_t 				  len, sequence = 0, seq;
+	int 					  n, i = 0, j = 0;
+
+	telemetry_init(&tm, &hcrc);
+	while(i < SAMPLES){
+		float value = ((int32_t)(check_rand(&seed) % 200001) - 100000) / 10.0f;
+
+		sent[i].sensor = check_rand(&seed) % TELEMETRY_SENSORS;
+		sent[i].tick   = tick;
+		sent[i].scaled = (int32_t)lroundf(value * 10.0f);
+		tick 		  += check_rand(&seed) % 3000;
+
+		if(telemetry_add(&tm, sent[i].sensor, sent[i].tick, value)){
+			i++;
+			continue;
+		}
+		//full: the frame must hold everything added since the last one
+		CHECK(telemetry_count(&tm) > 0);
+		len = telemetry_finish(&tm, &frame);
+		CHECK(len <= TELEMETRY_FRAME_SIZE);
+		n = telemetry_decode(frame, len, &seq, got, TELEMETRY_FRAME_SIZE);
+		CHECK(n == i - j && seq == sequence++);
+		for(int k = 0; k < n && k < i - j; k++){
+			CHECK(got[k].sensor == sent[j + k].sensor && got[k].tick == sent[j + k].tick &&
+				  got[k].scaled == sent[j + k].scaled);
+		}
+		j = i;
+	}
+	len = telemetry_finish(&tm, &frame);
+	n 	= telemetry_decode(frame, len, &seq, got, TELEMETRY_FRAME_SIZE);
+	CHECK(n == i - j && seq == sequence);
+	//no room for them all
+	CHECK(n < 2 || telemetry_decode(frame, len, NULL, got, n - 1) == -1);
+
+	//empty frame
+	CHECK(telemetry_finish(&tm, &frame) == 0);
+
+	//sensor out of range is ignored, not a full frame
+	CHECK(telemetry_add(&tm, TELEMETRY_SENSORS, tick, 1.0f) == 1);
+	CHECK(telemetry_count(&tm) == 0);
+}
+
+/* Damaged frames: every byte changed, every bit flipped, every length cut */
+static void test_damage(void)
+{
+	telemetry_sample_t got[TELEMETRY_FRAME_SIZE];
+	telemetry_t 	   tm;
+	const uint8_t 	  *frame;
+	uint8_t 		   bad[TELEMETRY_FRAME_SIZE];
+	uint32_t 		   seed = 2, accepted = 0, cases = 0;
+	uint16_t 		   len;
+
+	telemetry_init(&tm, &hcrc);
+	for(uint32_t tick = 0; telemetry_add(&tm, check_rand(&seed) % TELEMETRY_SENSORS, tick,
+										 (int32_t)(check_rand(&seed) % 2001 - 1000) / 10.0f); tick += 1000){
+	}
+	len = telemetry_finish(&tm, &frame);
+	CHECK(telemetry_decode(frame, len, NULL, got, TELEMETRY_FRAME_SIZE) > 0);
+	for(uint16_t i = 0; i < len; i++){
+		for(int b = 0; b < 8; b++){
+			memcpy(bad, frame, len);
+			bad[i] ^= 1 << b;
+			accepted += telemetry_decode(bad, len, NULL, got, TELEMETRY_FRAME_SIZE) >= 0;
+			cases++;
+		}
+		memcpy(bad, frame, len);
+		bad[i] = (uint8_t)check_rand(&seed);
+		accepted += bad[i] != frame[i] && telemetry_decode(bad, len, NULL, got, TELEMETRY_FRAME_SIZE) >= 0;
+		cases++;
+		accepted += telemetry_decode(frame, i, NULL, got, TELEMETRY_FRAME_SIZE) >= 0;
+		cases++;
+	}
+	CHECK(accepted == 0 && cases > 0);
+}
+
+int main(void)
+{
+	sim_init();
+	test_crc();
+	test_round_trip();
+	test_damage();
+	return CHECK_DONE();
+}
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include "timer_wheel.h"
+#include "check.h"
+
+/*
+ * The wheel against a reference model: every timer keeps its expiry tick
+ * and period in a plain array. Random starts (delays beyond
+ * TIMER_WHEEL_RANGE included), stops, and ticks that advance by one or by
+ * thousands, sometimes with starts before the wheel has caught up or while
+ * it is half way through a catch up or a cascade. Each expiry must come
+ * exactly at its tick, and none may be missed.
+ *
+ * Then the bound of an expire call: a full slot coming down and a long
+ * catch up, each call moving at most one timer and advancing at most one
+ * turn of level 0.
+ */
+
+#define TIMERS 		400
+#define STEPS 		3000000				// With 400 timers
+
+struct model{
+	uint8_t  active;
+	uint32_t expires;
+	uint32_t period;
+};
+
+static timer_wheel_t tw;
+static wheel_timer_t timers[TIMERS];
+static struct model  model[TIMERS];
+static uint16_t 	 used;						// Timers of the run
+static uint32_t 	 tick;
+static uint32_t 	 early, late, missed, fired, wrong_next;
+
+static uint32_t random_delay(uint32_t *seed)
+{
+	uint32_t r = check_rand(seed) % 100;
+
+	if(r < 60){
+		return 1 + check_rand(seed) % 64;
+	}
+	if(r < 90){
+		return 1 + check_rand(seed) % 5000;
+	}
+	if(r < 98){
+		return 1 + check_rand(seed) % TIMER_WHEEL_RANGE;
+	}
+	return TIMER_WHEEL_RANGE + check_rand(seed) % (4 * TIMER_WHEEL_RANGE);
+}
+
+//short periods too, but not so many that a long sleep fires thousands of times
+static uint32_t random_period(uint32_t *seed)
+{
+	uint32_t r = check_rand(seed) % 100;
+
+	if(r < 30){
+		return 0;
+	}
+	if(r < 40){
+		return 1 + check_rand(seed) % 64;
+	}
+	return 64 + check_rand(seed) % (2 * TIMER_WHEEL_RANGE);
+}
+
+//wheel towards tick, at most steps expire calls, every expiry checked against the model
+static void catch_up(uint32_t steps)
+{
+	wheel_timer_t *timer;
+	struct model  *m;
+	uint32_t 	   next = timer_wheel_next(&tw), first = TIMER_WHEEL_IDLE, s = 0;
+	uint8_t 	   more = 1;
+
+	//nothing may be due before the next event the wheel announces
+	for(int i = 0; i < used; i++){
+		if(model[i].active && model[i].expires - tw.now < first){
+			first = model[i].expires - tw.now;
+		}
+	}
+	wrong_next += (first == TIMER_WHEEL_IDLE) != (next == TIMER_WHEEL_IDLE) || first < next;
+
+	while(more && s++ < steps){
+		more = timer_wheel_expire(&tw, tick, &timer);
+		if(timer == NULL){
+			continue;
+		}
+		m = &model[timer - timers];
+		fired++;
+		if(!m->active || (int32_t)(m->expires - tw.now) > 0){
+			early++;
+			continue;
+		}
+		if(m->expires != tw.now){
+			late++;
+		}
+		if(m->period > 0){
+			m->expires += m->period;
+		}
+		else{
+			m->active = 0;
+		}
+	}
+	if(more){
+		return;
+	}
+	for(int i = 0; i < used; i++){
+		if(model[i].active && (int32_t)(model[i].expires - tick) <= 0){
+			missed++;
+			model[i].active = 0;
+		}
+	}
+}
+
+/**
+ * @brief random steps on count timers
+ * @note  with few timers level 0 is mostly empty and the wheel skips ahead
+ */
+static void test_model(uint16_t count, uint32_t steps)
+{
+	uint32_t seed = 21, i, r, delay, period, running = 0, max_count = 0;
+
+	//start near the wrap of the tick counter
+	used  = count;
+	early = late = missed = fired = wrong_next = 0;
+	tick  = 0xFFFF0000u;
+	timer_wheel_init(&tw, tick);
+	memset(timers, 0, sizeof(timers));
+	memset(model, 0, sizeof(model));
+
+	for(uint32_t s = 0; s < steps; s++){
+		r = check_rand(&seed) % 100;
+		i = check_rand(&seed) % count;
+		if(r < 35){
+			delay  = random_delay(&seed);
+			period = random_period(&seed);
+			timer_wheel_start(&tw, &timers[i], tick, delay, period);
+			model[i].active  = 1;
+			model[i].expires = tick + delay;
+			model[i].period  = period;
+		}
+		else if(r < 45){
+			timer_wheel_stop(&tw, &timers[i]);
+			model[i].active = 0;
+		}
+		else{
+			//mostly one tick, sometimes a long sleep
+			tick += check_rand(&seed) % 2000 == 0 ? 1 + check_rand(&seed) % 20000 : 1 + check_rand(&seed) % 3;
+			//sometimes the next starts come before the wheel catches up, or half way
+			r = check_rand(&seed) % 8;
+			if(r != 0){
+				catch_up(r == 1 ? 1 + check_rand(&seed) % 8 : 0xFFFFFFFFu);
+			}
+		}
+		if(s % 16 != 0){
+			continue;
+		}
+		running = 0;
+		for(int k = 0; k < count; k++){
+			running += model[k].active;
+			if(timer_wheel_active(&timers[k]) != model[k].active){
+				missed++;
+			}
+		}
+		CHECK(tw.count == running);
+		max_count = running > max_count ? running : max_count;
+	}
+	catch_up(0xFFFFFFFFu);
+	printf("%u timers, %lu steps: %lu expiries, %lu early, %lu late, %lu missed, %lu wrong next, high water %u (%lu)\n",
+		   count, (unsigned long)steps, (unsigned long)fired, (unsigned long)early, (unsigned long)late, (unsigned long)missed,
+		   (unsigned long)wrong_next, tw.high_water, (unsigned long)max_count);
+	CHECK(fired > 0 && early == 0 && late == 0 && missed == 0 && wrong_next == 0);
+	CHECK(tw.high_water >= max_count && tw.high_water <= count);
+}
+
+//expire calls until one returns a timer, NULL if caught up first
+static wheel_timer_t *expire_one(uint32_t now)
+{
+	wheel_timer_t *timer;
+
+	while(timer_wheel_expire(&tw, now, &timer) && timer == NULL){
+	}
+	return timer;
+}
+
+/* Restart and stop of a timer in the due list, start in the past */
+static void test_edges(void)
+{
+	wheel_timer_t a = WHEEL_TIMER_INIT(NULL, NULL), b = WHEEL_TIMER_INIT(NULL, NULL);
+
+	timer_wheel_init(&tw, 100);
+	CHECK(timer_wheel_next(&tw) == TIMER_WHEEL_IDLE);
+	timer_wheel_start(&tw, &a, 100, 5, 0);
+	timer_wheel_start(&tw, &b, 100, 5, 0);
+	CHECK(timer_wheel_next(&tw) == 5);
+	//both due at 105: the first one returned stops the other
+	CHECK(expire_one(105) != NULL);
+	CHECK(timer_wheel_next(&tw) == 0);
+	timer_wheel_stop(&tw, timer_wheel_active(&a) ? &a : &b);
+	CHECK(expire_one(105) == NULL && tw.count == 0);
+	CHECK(!timer_wheel_active(&a) && !timer_wheel_active(&b));
+
+	//a start with a tick the wheel already processed fires on the next one
+	timer_wheel_start(&tw, &a, 90, 3, 0);
+	CHECK(a.expires == 106);
+	CHECK(expire_one(106) == &a && expire_one(106) == NULL);
+
+	//periodic restart from its own expiry, then stop
+	timer_wheel_start(&tw, &a, 106, 1, 10);
+	CHECK(expire_one(107) == &a && timer_wheel_active(&a));
+	CHECK(expire_one(116) == NULL && expire_one(117) == &a);
+	timer_wheel_stop(&tw, &a);
+	timer_wheel_stop(&tw, &a);
+	CHECK(tw.count == 0 && expire_one(1000000) == NULL && tw.now == 1000000);
+}
+
+/**
+ * @brief count timers in one slot of the top level, then a catch up of
+ * 		  far more ticks than that: no call moves more than one timer, or
+ * 		  advances more than one turn of level 0 while timers run
+ */
+static void test_bounded(uint16_t count)
+{
+	static uint8_t level[TIMERS];
+	wheel_timer_t *timer;
+	uint32_t 	   calls = 0, moved, max_moved = 0, max_advance = 0, before, expired = 0;
+	uint8_t 	   more;
+
+	timer_wheel_init(&tw, 0);
+	memset(timers, 0, sizeof(timers));
+	//all in one slot of the top level, ticks 0x18000..0x1FFFF
+	for(uint16_t i = 0; i < count; i++){
+		timer_wheel_start(&tw, &timers[i], 0, 3 * (1u << (TIMER_WHEEL_BITS * 3)) + i * 7, 0);
+		level[i] = timers[i].level;
+	}
+	CHECK(timers[0].level == 3 && timers[count - 1].slot == timers[0].slot);
+	do{
+		before = tw.now;
+		more   = timer_wheel_expire(&tw, 0x20000, &timer);
+		calls++;
+		expired += timer != NULL;
+		moved = 0;
+		for(uint16_t i = 0; i < count; i++){
+			moved 	+= timers[i].level != level[i];
+			level[i] = timers[i].level;
+		}
+		max_moved 	= moved > max_moved ? moved : max_moved;
+		//without timers it jumps to now, nothing to do on the way
+		if(tw.count > 0 && tw.now - before > max_advance){
+			max_advance = tw.now - before;
+		}
+		CHECK(timer == NULL || timer->expires == tw.now);
+	}while(more);
+	printf("bounded: %u timers in one slot, catch up of %lu ticks in %lu calls, at most %lu moved and %lu ticks advanced per call\n",
+		   count, (unsigned long)tw.now, (unsigned long)calls, (unsigned long)max_moved, (unsigned long)max_advance);
+	CHECK(expired == count && tw.count == 0 && tw.now == 0x20000);
+	CHECK(max_moved <= 1 && max_advance <= TIMER_WHEEL_SLOTS);
+}
+
+int main(void)
+{
+	sim_init();
+	test_model(TIMERS, STEPS);
+	test_model(6, STEPS / 3);
+	test_edges();
+	test_bounded(TIMERS);
+	return CHECK_DONE();
+}
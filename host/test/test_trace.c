@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "prof.h"
+#include "trace.h"
+#include "check.h"
+
+/*
+ * trace_dump through the simulated UART: header, task table, probe names
+ * and events oldest first, as inc/trace.h describes them, and the lost
+ * count once the ring overflowed. The scene dump is also written to
+ * trace_dump.bin, which ctest then converts with tools/trace2chrome.py.
+ */
+
+#define HEADER_SIZE 	22
+
+static const TaskStatus_t tasks[] = {
+	{ "IDLE", 1 }, { "sensor", 2 }, { "ui", 5 },
+};
+
+static UART_HandleTypeDef huart;
+
+/* Task table of the stand-in task.h */
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pxTaskStatusArray, UBaseType_t uxArraySize, uint32_t *pulTotalRunTime)
+{
+	UBaseType_t n = sizeof(tasks) / sizeof(tasks[0]);
+
+	n = n < uxArraySize ? n : uxArraySize;
+	memcpy(pxTaskStatusArray, tasks, n * sizeof(tasks[0]));
+	return n;
+}
+
+static uint32_t u32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * @brief checks everything before the events
+ * @return offset of the first event
+ */
+static size_t check_header(const uint8_t *out, size_t len, uint32_t events, uint32_t lost)
+{
+	size_t pos = HEADER_SIZE;
+
+	CHECK(len >= HEADER_SIZE && memcmp(out, "TRC1", 4) == 0);
+	CHECK(u32(&out[4]) == SystemCoreClock && u32(&out[8]) == configTICK_RATE_HZ);
+	CHECK(u32(&out[12]) == events && u32(&out[16]) == lost);
+	CHECK(out[20] == sizeof(tasks) / sizeof(tasks[0]) && out[21] == PROF_PROBES);
+	for(size_t t = 0; t < sizeof(tasks) / sizeof(tasks[0]); t++){
+		CHECK(out[pos] == tasks[t].xTaskNumber);
+		CHECK(strncmp((const char *)&out[pos + 1], tasks[t].pcTaskName, configMAX_TASK_NAME_LEN) == 0);
+		pos += 1 + configMAX_TASK_NAME_LEN;
+	}
+	for(int p = 0; p < PROF_PROBES; p++){
+		CHECK(strcmp((const char *)&out[pos], prof_name(p)) == 0);
+		pos += strlen(prof_name(p)) + 1;
+	}
+	CHECK(len == pos + events * sizeof(trace_event_t));
+	return pos;
+}
+
+/* A few milliseconds of the station, with the cycle counter wrapping */
+static void test_scene(void)
+{
+	static const trace_event_t scene[] = {
+		{ 0, TRACE_TASK_IN, 1, 0 },
+		{ 0, TRACE_SLEEP, 0, 100 },
+		{ 0, TRACE_WAKE, 0, 105 },
+		{ 0, TRACE_ISR_ENTER, 15, 0 },
+		{ 0, TRACE_TASK_READY, 2, 0 },
+		{ 0, TRACE_ISR_EXIT, 15, PROF_SYSTICK_IRQ },
+		{ 0, TRACE_TASK_IN, 2, 0 },
+		{ 0, TRACE_QUEUE_SEND, 1, 0 },
+		{ 0, TRACE_ISR_ENTER, 72, 0 },
+		{ 0, TRACE_ISR_ENTER, 53, 0 },
+		{ 0, TRACE_NOTIFY_GIVE, 5, 0 },
+		{ 0, TRACE_ISR_EXIT, 53, PROF_USART1_IRQ },
+		{ 0, TRACE_ISR_EXIT, 72, PROF_DMA2_S0_IRQ },
+		{ 0, TRACE_TASK_DELAY, 2, 0 },
+		{ 0, TRACE_TASK_IN, 5, 0 },
+		{ 0, TRACE_QUEUE_RECEIVE, 1, 1 },
+		{ 0, TRACE_QUEUE_BLOCK_RECV, 1, 0 },
+		{ 0, TRACE_NOTIFY_BLOCK, 5, 0 },
+		{ 0, TRACE_TASK_IN, 1, 0 },
+	};
+	const uint32_t 		 n = sizeof(scene) / sizeof(scene[0]);
+	const trace_event_t *ev;
+	const uint8_t 		 *out;
+	size_t 				 len, pos;
+	uint32_t 			 wraps = 0;
+	FILE 				 *f;
+
+	sim_uart_clear();
+	trace_start();
+	DWT->CYCCNT = 0xFFFFFF00u;
+	for(uint32_t i = 0; i < n; i++){
+		trace_record(scene[i].type, scene[i].id, scene[i].arg);
+	}
+	trace_dump(&huart);
+	out = sim_uart_output(&len);
+	pos = check_header(out, len, n, 0);
+	ev 	= (const trace_event_t *)&out[pos];
+	for(uint32_t i = 0; i < n; i++){
+		CHECK(ev[i].type == scene[i].type && ev[i].id == scene[i].id && ev[i].arg == scene[i].arg);
+		wraps += i > 0 && ev[i].time < ev[i - 1].time;
+	}
+	CHECK(wraps == 1);
+
+	f = fopen("trace_dump.bin", "wb");
+	CHECK(f != NULL);
+	if(f != NULL){
+		//console text before the dump, as in a real capture
+		fputs("station ready\r\n", f);
+		fwrite(out, 1, len, f);
+		fclose(f);
+	}
+}
+
+/* Overflow keeps the newest TRACE_EVENTS, the dump restarts the ring */
+static void test_overflow(void)
+{
+	const trace_event_t *ev;
+	const uint8_t 		 *out;
+	size_t 				 len, pos;
+	uint32_t 			 bad = 0;
+
+	sim_uart_clear();
+	trace_start();
+	for(uint32_t i = 0; i < TRACE_EVENTS + 100; i++){
+		trace_record(TRACE_TASK_READY, 2, i);
+	}
+	trace_dump(&huart);
+	out = sim_uart_output(&len);
+	pos = check_header(out, len, TRACE_EVENTS, 100);
+	ev 	= (const trace_event_t *)&out[pos];
+	for(uint32_t i = 0; i < TRACE_EVENTS; i++){
+		bad += ev[i].arg != 100 + i;
+	}
+	CHECK(bad == 0);
+
+	//the dump restarted the ring, nothing is recorded while stopped
+	trace_stop();
+	trace_record(TRACE_TASK_READY, 2, 0);
+	sim_uart_clear();
+	trace_dump(&huart);
+	out = sim_uart_output(&len);
+	check_header(out, len, 0, 0);
+}
+
+int main(void)
+{
+	sim_init();
+	prof_init();
+	test_scene();
+	test_overflow();
+	return CHECK_DONE();
+}
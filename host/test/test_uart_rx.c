@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+#include "uart_rx.h"
+#include "check.h"
+
+/*
+ * uart_rx on the simulated USART and circular DMA stream, wired like the
+ * BSP: the half / full transfer callbacks and the idle line interrupt call
+ * uart_rx_update, a reception error restarts the ring.
+ *
+ * Line test: back to back frames of 1 to 200 bytes at 921600 baud 8N1
+ * (10.85 us per byte, one idle character between frames) for one second,
+ * into the 256 byte ring of the BSP. The consumer is the wifi task, woken
+ * every period: it reads every unread byte through uart_rx_peek and
+ * releases them in random pieces with uart_rx_consume. It only sees the
+ * bytes up to the last interrupt, up to half a ring behind the DMA, so a
+ * period must fill less than the other half: below 1.39 ms at this rate
+ * every byte must arrive once and in order, well above it the overruns
+ * must be counted and the ring stay consistent.
+ *
+ * Overrun test: the exact ring state after a consumer that stops reading.
+ */
+
+#define SIZE 			256
+#define BYTE_NS 		10851					// 10 bits at 921600 baud
+#define LINE_NS 		1000000000u
+#define MAX_FRAME 		200
+#define STREAM_BYTES 	(LINE_NS / BYTE_NS + MAX_FRAME)
+
+static USART_TypeDef 		usart;
+static DMA_Stream_TypeDef 	stream;
+static DMA_HandleTypeDef 	hdma_rx = { &stream, NULL };
+static UART_HandleTypeDef 	huart = { .Instance = &usart, .hdmarx = &hdma_rx };
+static uart_rx_t 			rx;
+static uint8_t 				buffer[SIZE];
+static uint8_t 				sent[STREAM_BYTES];
+static uint32_t 			notified;
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *h)
+{
+	uart_rx_update(&rx);
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *h)
+{
+	uart_rx_update(&rx);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *h)
+{
+	uart_rx_restart(&rx);
+}
+
+void sim_uart_irq(UART_HandleTypeDef *h)
+{
+	uart_rx_irq_handler(&rx);
+}
+
+static void notify(void *ctx)
+{
+	notified++;
+}
+
+static void start(void)
+{
+	memset(buffer, 0, sizeof(buffer));
+	HAL_UART_Init(&huart);
+	CHECK(uart_rx_start(&rx, &huart, buffer, SIZE) == HAL_OK);
+	uart_rx_set_notify(&rx, notify, NULL);
+}
+
+/**
+ * @brief reads every unread byte, released in random pieces
+ * @return bytes read, each compared with sent[*pos...]
+ */
+static uint32_t consume(uint32_t *pos, uint32_t *bad, uint32_t *seed)
+{
+	const uint8_t *data;
+	uint16_t 	   span, n;
+	uint32_t 	   got = 0;
+
+	while((span = uart_rx_peek(&rx, &data)) > 0){
+		n = 1 + check_rand(seed) % span;
+		for(uint16_t i = 0; i < n; i++){
+			*bad += data[i] != sent[(*pos)++];
+		}
+		uart_rx_consume(&rx, n);
+		got += n;
+	}
+	return got;
+}
+
+/* One second of a saturated line, consumer every period_us */
+static void line(uint32_t period_us, uint8_t lossless)
+{
+	uint32_t seed = 7, pos = 0, bad = 0, got = 0, frames = 0, ready = 0, max_fill = 0;
+	uint32_t now = 0, wake = period_us * 1000, len, n = 0;
+	uint16_t fill;
+
+	start();
+	notified = 0;
+	for(uint32_t i = 0; i < STREAM_BYTES; i++){
+		sent[i] = (uint8_t)check_rand(&seed);
+	}
+	while(now < LINE_NS){
+		len = 1 + check_rand(&seed) % MAX_FRAME;
+		for(uint32_t i = 0; i < len; i++, n++){
+			sim_uart_receive(&huart, &sent[n], 1);
+			now += BYTE_NS;
+			if(now >= wake){
+				fill 	 = uart_rx_available(&rx);
+				max_fill = fill > max_fill ? fill : max_fill;
+				got 	+= consume(&pos, &bad, &seed);
+				ready 	+= uart_rx_frame_ready(&rx);
+				wake 	+= period_us * 1000;
+			}
+		}
+		sim_uart_idle(&huart);
+		now += BYTE_NS;
+		frames++;
+	}
+	got += consume(&pos, &bad, &seed);
+
+	printf("consumer every %4lu us: %lu bytes in %lu frames, %lu read, max fill %u of %u, %lu overruns, %lu notifies\n",
+		   (unsigned long)period_us, (unsigned long)n, (unsigned long)frames, (unsigned long)got, max_fill, SIZE - 1,
+		   (unsigned long)rx.overruns, (unsigned long)notified);
+	CHECK(rx.frames == frames);
+	CHECK(ready > 0 && notified > 0);
+	CHECK(max_fill < SIZE);
+	if(lossless){
+		CHECK(rx.overruns == 0 && bad == 0 && got == n);
+	}
+	else{
+		CHECK(rx.overruns > 0 && got < n);
+	}
+}
+
+/* Ring state after the consumer stops reading */
+static void test_overrun(void)
+{
+	const uint8_t *data;
+	uint8_t 	   stream_bytes[600];
+	uint32_t 	   pos, bad = 0, seed = 3;
+	uint16_t 	   span;
+
+	for(uint32_t i = 0; i < sizeof(stream_bytes); i++){
+		stream_bytes[i] = (uint8_t)(i * 7 + (i >> 8));
+	}
+	start();
+	//a whole lap unread: head meets tail, the oldest byte is given up
+	sim_uart_receive(&huart, stream_bytes, SIZE);
+	CHECK(rx.overruns == 1 && uart_rx_available(&rx) == SIZE - 1);
+	//half a lap more, then a frame end in the middle of the next half
+	sim_uart_receive(&huart, &stream_bytes[SIZE], SIZE / 2);
+	sim_uart_receive(&huart, &stream_bytes[SIZE * 3 / 2], 16);
+	sim_uart_idle(&huart);
+	CHECK(rx.overruns == 3 && uart_rx_available(&rx) == SIZE - 1);
+	//the newest SIZE - 1 bytes, in order, across the wrap
+	pos = SIZE * 3 / 2 + 16 - (SIZE - 1);
+	span = uart_rx_peek(&rx, &data);
+	CHECK(span == SIZE - (SIZE / 2 + 16 + 1));
+	CHECK(memcmp(data, &stream_bytes[pos], span) == 0);
+	uart_rx_consume(&rx, span);
+	pos += span;
+	span = uart_rx_peek(&rx, &data);
+	CHECK(span == SIZE / 2 + 16 && memcmp(data, &stream_bytes[pos], span) == 0);
+	uart_rx_consume(&rx, SIZE);
+	CHECK(uart_rx_available(&rx) == 0);
+
+	//reading again without loss
+	memcpy(sent, stream_bytes, sizeof(stream_bytes));
+	pos = SIZE * 3 / 2 + 16;
+	sim_uart_receive(&huart, &sent[pos], 100);
+	sim_uart_idle(&huart);
+	consume(&pos, &bad, &seed);
+	CHECK(bad == 0 && pos == SIZE * 3 / 2 + 116 && rx.overruns == 3);
+
+	//an error restarts the ring and keeps the count, a start clears it
+	sim_uart_receive(&huart, sent, 10);
+	sim_uart_error(&huart, HAL_UART_ERROR_ORE);
+	CHECK(huart.RxState == HAL_UART_STATE_BUSY_RX && stream.NDTR == SIZE);
+	CHECK(uart_rx_available(&rx) == 0 && rx.overruns == 3);
+	HAL_UART_Init(&huart);
+	CHECK(uart_rx_start(&rx, &huart, buffer, SIZE) == HAL_OK && rx.overruns == 0);
+}
+
+int main(void)
+{
+	sim_init();
+	line(250, 1);
+	line(500, 1);
+	line(1000, 1);
+	line(1250, 1);
+	line(2000, 0);
+	line(4000, 0);
+	test_overrun();
+	return CHECK_DONE();
+}
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uart_tx.h"
+#include "check.h"
+
+/*
+ * uart_tx on the simulated USART2 DMA, built with AddressSanitizer (see
+ * CMakeLists.txt). Messages are heap buffers freed in their done callback,
+ * as the wifi pools free theirs, mixed with constant buffers and no
+ * callback, as the AT table sends. The line reads each transfer from
+ * pTxBuffPtr when its DMA ends, then raises the completion interrupt: a
+ * buffer given back before its bytes left, freed twice or never, is a
+ * sanitizer error or a failed check.
+ *
+ * Random interleaving of sends and completions, the queue filling up
+ * (refused sends stay with the caller) and the HAL refusing transfers,
+ * both from uart_tx_send and from the completion interrupt (those are
+ * dropped and completed). What leaves the line must be every message
+ * accepted and not dropped, whole and in order.
+ *
+ * Enqueue latency: uart_tx_send, host cycles, against the sprintf into a
+ * stack buffer the old interrupt path did for each command.
+ */
+
+#define STEPS 		200000
+#define MAX_MSGS 	(STEPS + 1)
+#define MAX_LEN 	64
+
+static USART_TypeDef 		usart;
+static UART_HandleTypeDef 	huart = { .Instance = &usart };
+static uart_tx_t 			tx;
+
+static uint8_t 	sent_on_line[MAX_MSGS];			// Message left on the line
+static uint8_t 	done_calls[MAX_MSGS];
+static uint32_t line_order[MAX_MSGS];			// Ids as they left
+static uint32_t accepted_order[MAX_MSGS];
+static uint32_t n_line, n_accepted, n_done, n_freed, n_const;
+static uint32_t latency[STEPS];
+static uint32_t bad_bytes;
+
+static const uint8_t at_probe[] = "AT\r\n";
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *h)
+{
+	uart_tx_complete_isr(&tx);
+}
+
+static uint32_t msg_id(const uint8_t *data)
+{
+	uint32_t id;
+
+	memcpy(&id, data, 4);
+	return id;
+}
+
+/* Done callback of the heap messages: the buffer goes back */
+static void msg_done(const uint8_t *data)
+{
+	uint32_t id = msg_id(data);
+
+	CHECK(id < MAX_MSGS && done_calls[id] == 0);
+	done_calls[id]++;
+	n_done++;
+	n_freed++;
+	free((void *)data);
+}
+
+static uint8_t *msg_new(uint32_t id, uint16_t len)
+{
+	uint8_t *m = malloc(len);
+
+	memcpy(m, &id, 4);
+	for(uint16_t i = 4; i < len; i++){
+		m[i] = (uint8_t)(id * 31 + i);
+	}
+	return m;
+}
+
+/* The DMA of the running transfer ends: its bytes left, then the interrupt */
+static void line_complete(void)
+{
+	const uint8_t *p = huart.pTxBuffPtr;
+	uint32_t 	   id;
+
+	if(huart.gState != HAL_UART_STATE_BUSY_TX){
+		return;
+	}
+	if(p == at_probe){
+		CHECK(huart.TxXferSize == sizeof(at_probe) - 1);
+		n_const++;
+	}
+	else{
+		id = msg_id(p);
+		CHECK(id < MAX_MSGS && !sent_on_line[id] && !done_calls[id]);
+		for(uint16_t i = 4; i < huart.TxXferSize; i++){
+			bad_bytes += p[i] != (uint8_t)(id * 31 + i);
+		}
+		sent_on_line[id]   = 1;
+		line_order[n_line++] = id;
+	}
+	sim_uart_tx_complete(&huart);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(void)
+{
+	uint32_t seed = 11, next_id = 0, full = 0, refused = 0, dropped = 0, n_lat = 0, start, sprintf_cycles;
+	uint32_t l, id;
+	uint16_t len;
+	uint8_t *m, ok;
+	char 	 command[30];
+
+	sim_init();
+	HAL_UART_Init(&huart);
+	uart_tx_init(&tx, &huart);
+
+	for(uint32_t step = 0; step < STEPS; step++){
+		//bursts of sends against a slower line, so the queue fills up
+		if(check_rand(&seed) % 100 < 55){
+			if(check_rand(&seed) % 8 == 0){
+				start = DWT->CYCCNT;
+				ok 	  = uart_tx_send(&tx, at_probe, sizeof(at_probe) - 1, NULL);
+				l 	  = DWT->CYCCNT - start;
+			}
+			else{
+				id 	= next_id++;
+				len = 4 + check_rand(&seed) % (MAX_LEN - 3);
+				m 	= msg_new(id, len);
+				start = DWT->CYCCNT;
+				ok 	  = uart_tx_send(&tx, m, len, msg_done);
+				l 	  = DWT->CYCCNT - start;
+				if(ok){
+					accepted_order[n_accepted++] = id;
+				}
+				else{
+					//refused: done is never called, the caller keeps it
+					CHECK(done_calls[id] == 0);
+					free(m);
+					n_freed++;
+				}
+			}
+			if(ok){
+				latency[n_lat++] = l;
+			}
+		}
+		if(check_rand(&seed) % 100 < 45){
+			line_complete();
+		}
+		//now and then the HAL refuses the next transfers
+		if(check_rand(&seed) % 1000 == 0){
+			sim_uart_tx_refuse(1 + check_rand(&seed) % 3);
+		}
+	}
+	sim_uart_tx_refuse(0);
+	while(huart.gState == HAL_UART_STATE_BUSY_TX){
+		line_complete();
+	}
+	full 	= tx.rejected;
+	refused = tx.failed;
+
+	//every accepted message left whole and in order, or was dropped by a
+	//refusal in the interrupt and still given back
+	for(uint32_t i = 0, j = 0; i < n_accepted; i++){
+		id = accepted_order[i];
+		CHECK(done_calls[id] == 1);
+		if(sent_on_line[id]){
+			CHECK(j < n_line && line_order[j++] == id);
+		}
+		else{
+			dropped++;
+		}
+	}
+	CHECK(bad_bytes == 0);
+	CHECK(n_freed == next_id && n_done == n_accepted);
+	CHECK(tx.head == tx.tail && !tx.busy && uart_tx_free(&tx) == UART_TX_QUEUE_SIZE - 1);
+	CHECK(full > 0 && dropped > 0 && refused >= dropped);
+
+	printf("%lu messages: %lu accepted, %lu refused with the queue full, %lu HAL refusals (%lu dropped in the interrupt), "
+		   "%lu constant sends, high water %u\n", (unsigned long)next_id, (unsigned long)n_accepted, (unsigned long)full,
+		   (unsigned long)refused, (unsigned long)dropped, (unsigned long)n_const, tx.high_water);
+
+	qsort(latency, n_lat, sizeof(latency[0]), cmp_u32);
+	printf("uart_tx_send (AddressSanitizer build): p50 %lu, p99 %lu, max %lu host cycles over %lu sends\n", (unsigned long)latency[n_lat / 2],
+		   (unsigned long)latency[(uint32_t)(n_lat * 0.99)], (unsigned long)latency[n_lat - 1], (unsigned long)n_lat);
+
+	for(uint32_t i = 0; i < 10000; i++){
+		start = DWT->CYCCNT;
+		sprintf(command, "ATPT=%lu,%u:", (unsigned long)(i % 1500), (unsigned)(i % 4));
+		latency[i] = DWT->CYCCNT - start;
+	}
+	qsort(latency, 10000, sizeof(latency[0]), cmp_u32);
+	sprintf_cycles = latency[5000];
+	printf("sprintf of an ATPT header, the old interrupt path: p50 %lu host cycles\n", (unsigned long)sprintf_cycles);
+	return CHECK_DONE();
+}
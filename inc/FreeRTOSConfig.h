@@ -44,8 +44,20 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
  #include <stdint.h>
  extern uint32_t SystemCoreClock;
+ void BSP_SuppressTicksAndSleep(uint32_t idle_ticks);
+ void BSP_RUNTIME_Init(void);
+ uint32_t BSP_RUNTIME_GetCounter(void);
 #endif
 
+/* Static allocation mode: every task, queue, semaphore and timer comes from
+the object table of the application (rtos_static.h), heap_4 stays unused. Set
+to 0 to go back to xTaskCreate / xQueueCreate from the heap. In both modes the
+objects must fit in RTOS_RAM_BUDGET, checked at compile time. */
+#ifndef RTOS_STATIC
+#define RTOS_STATIC                       1
+#endif
+#define RTOS_RAM_BUDGET                   (15 * 1024)
+
 /*  CMSIS-RTOSv2 defines 56 levels of priorities. To be able to use them
  *  all and avoid application misbehavior, configUSE_PORT_OPTIMISED_TASK_SELECTION
  *  must be set to 0 and configMAX_PRIORITIES to 56
@@ -57,23 +69,54 @@
 #define configUSE_IDLE_HOOK               0
 #define configUSE_TICK_HOOK               0
 #define configMAX_PRIORITIES              (7)
-#define configSUPPORT_STATIC_ALLOCATION   0
+#define configSUPPORT_STATIC_ALLOCATION   RTOS_STATIC
 #define configCPU_CLOCK_HZ                (SystemCoreClock)
 #define configTICK_RATE_HZ                ((TickType_t)1000)
 #define configMINIMAL_STACK_SIZE          ((uint16_t)128)
-#define configTOTAL_HEAP_SIZE             ((size_t)(15 * 1024))
+#if RTOS_STATIC
+#define configTOTAL_HEAP_SIZE             ((size_t)256)
+#else
+#define configTOTAL_HEAP_SIZE             ((size_t)RTOS_RAM_BUDGET)
+#endif
 #define configMAX_TASK_NAME_LEN           (16)
 #define configUSE_TRACE_FACILITY          1
 #define configUSE_16_BIT_TICKS            0
 #define configIDLE_SHOULD_YIELD           1
 #define configUSE_MUTEXES                 1
 #define configQUEUE_REGISTRY_SIZE         8
+/* Debug builds check every stack at each context switch (method 2: the
+last 16 words still hold the fill pattern), vApplicationStackOverflowHook */
+#ifdef DEBUG
+#define configCHECK_FOR_STACK_OVERFLOW    2
+#else
 #define configCHECK_FOR_STACK_OVERFLOW    0
+#endif
 #define configUSE_RECURSIVE_MUTEXES       1
-#define configUSE_MALLOC_FAILED_HOOK      0
+#define configUSE_MALLOC_FAILED_HOOK      1
 #define configUSE_APPLICATION_TASK_TAG    0
 #define configUSE_COUNTING_SEMAPHORES     1
-#define configGENERATE_RUN_TIME_STATS     0
+#define configGENERATE_RUN_TIME_STATS     1
+
+/* Run time statistics: TIM3 and TIM4 chained into a 32 bit counter that keeps
+running in sleep and needs no interrupt, so the idle task gets the time slept
+(BSP_RUNTIME_Init). Wraps every 71 minutes at 1 MHz. */
+#define RTOS_RUN_TIME_HZ                          1000000
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()  BSP_RUNTIME_Init()
+#define portGET_RUN_TIME_COUNTER_VALUE()          BSP_RUNTIME_GetCounter()
+
+/* Tickless idle: the idle task stops the SysTick and sleeps (WFI) until the
+next task deadline or any interrupt. BSP_SuppressTicksAndSleep wraps the port
+implementation to account the time spent asleep. */
+#define configUSE_TICKLESS_IDLE                 1
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP   2
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) BSP_SuppressTicksAndSleep( xExpectedIdleTime )
+
+/* Event recorder: trace.h maps the kernel trace hooks (task switches, queue
+operations, notifications, tickless sleep) to trace_record. TRACE_ENABLED 0
+leaves the empty defaults of FreeRTOS.h. */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+ #include "trace.h"
+#endif
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES           0
@@ -92,9 +135,10 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelete            1
 #define INCLUDE_vTaskCleanUpResources  0
 #define INCLUDE_vTaskSuspend           1
-#define INCLUDE_vTaskDelayUntil        0
+#define INCLUDE_vTaskDelayUntil        1
 #define INCLUDE_vTaskDelay             1
 #define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_xTaskGetIdleTaskHandle 1
 
 /*------------- CMSIS-RTOS V2 specific defines -----------*/
 /* When using CMSIS-RTOSv2 set configSUPPORT_STATIC_ALLOCATION to 1
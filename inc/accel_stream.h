@@ -0,0 +1,54 @@
+#ifndef ACCEL_STREAM_H_
+#define ACCEL_STREAM_H_
+
+#include "stm32f4xx_hal.h"
+
+#define ACCEL_BLOCK_SAMPLES 	16			// Largest watermark, samples per block
+#define ACCEL_STREAM_BLOCKS 	4			// Blocks waiting to be read
+
+/* Starts a burst read of samples XYZ samples, 1 if started. ex:LSM303DLHC_AccFifoRead_DMA, L3GD20_FifoRead_DMA */
+typedef uint8_t (*accel_read_t)(uint8_t *buffer, uint8_t samples);
+
+/**
+ * @brief samples drained from the sensor FIFO in one transfer
+ */
+struct _accel_block_t{
+	uint32_t 			 tick;								// Tick of the watermark, newest sample
+	uint8_t 			 count;								// Samples in xyz
+	int16_t 			 xyz[ACCEL_BLOCK_SAMPLES][3];		// Raw X, Y, Z, oldest first
+};
+typedef struct _accel_block_t accel_block_t;
+
+/**
+ * @brief FIFO streaming struct, serves any 3 axis sensor FIFO
+ * (accelerometer over I2C, gyroscope over SPI). The watermark interrupt
+ * starts one burst read of a whole block straight into blocks[head], the
+ * DMA completion publishes it and a task empties the ring with
+ * accel_stream_read. Only the interrupts move head and only
+ * the task moves tail.
+ */
+struct _accel_stream_t{
+	accel_read_t 		 read;								// Burst read of the sensor FIFO
+	uint8_t 			 watermark;							// Samples per block
+	accel_block_t 		 blocks[ACCEL_STREAM_BLOCKS];
+	volatile uint8_t 	 head;
+	volatile uint8_t 	 tail;
+	volatile uint8_t 	 busy;								// Transfer running
+	volatile uint8_t 	 pending;							// Watermark seen while busy
+	volatile uint32_t 	 transfers;							// Bus transactions started
+	volatile uint32_t 	 samples;							// Samples received
+	volatile uint32_t 	 lost;								// Blocks dropped or failed
+};
+typedef struct _accel_stream_t accel_stream_t;
+
+
+void 		accel_stream_init(accel_stream_t *as, accel_read_t read, uint8_t watermark);
+void 		accel_stream_watermark(accel_stream_t *as, uint32_t tick);
+void 		accel_stream_done(accel_stream_t *as, uint32_t tick, uint8_t more);
+void 		accel_stream_error(accel_stream_t *as);
+uint8_t 	accel_stream_claim(accel_stream_t *as);
+void 		accel_stream_release(accel_stream_t *as, uint32_t tick);
+uint8_t 	accel_stream_read(accel_stream_t *as, accel_block_t *block);
+
+
+#endif /* ACCEL_STREAM_H_ */
@@ -0,0 +1,34 @@
+#ifndef ADC_ACQ_H_
+#define ADC_ACQ_H_
+
+#include "stm32f4xx_hal.h"
+
+#define ADC_ACQ_CHANNELS 	3			// Conversions in the scan sequence
+#define ADC_ACQ_SCANS 		16			// Scans in each half of the buffer
+#define ADC_ACQ_HALF 		(ADC_ACQ_SCANS * ADC_ACQ_CHANNELS)
+
+/**
+ * @brief ADC scan acquisition struct
+ * The DMA fills buffer in circular mode. While it writes one half, the
+ * other half is averaged per channel and fed to a first order filter.
+ */
+struct _adc_acq_t{
+	ADC_HandleTypeDef 	*hadc;								// ADC in scan mode ex:&hadc1
+	uint16_t 			 buffer[2 * ADC_ACQ_HALF];			// DMA destination, two halves
+	volatile uint32_t 	 filtered[ADC_ACQ_CHANNELS];		// Filtered value, raw counts << 4
+	uint32_t 			 count[ADC_ACQ_CHANNELS];			// Samples in the current window
+	volatile uint32_t 	 rate[ADC_ACQ_CHANNELS];			// Samples/s of the last window
+	uint32_t 			 window_start;						// Tick of the current window
+	uint8_t 			 primed;							// First block already filtered
+};
+typedef struct _adc_acq_t adc_acq_t;
+
+
+HAL_StatusTypeDef 	adc_acq_start(adc_acq_t *acq, ADC_HandleTypeDef *hadc);
+void 				adc_acq_process(adc_acq_t *acq, const uint16_t *half, uint32_t tick);
+uint16_t 			adc_acq_get(const adc_acq_t *acq, uint8_t channel);
+uint32_t 			adc_acq_get_fine(const adc_acq_t *acq, uint8_t channel);
+uint32_t 			adc_acq_rate(const adc_acq_t *acq, uint8_t channel);
+
+
+#endif /* ADC_ACQ_H_ */
@@ -0,0 +1,54 @@
+#ifndef AHRS_H_
+#define AHRS_H_
+
+#include "stm32f4xx_hal.h"
+
+#define AHRS_BOOT_SECONDS 	2			// Seconds with the boot gain after ahrs_init
+#define AHRS_BOOT_KP 		10.0f		// Fast convergence from the initial attitude
+
+/*
+ * Mahony complementary filter. The gyro is integrated at its own rate, the
+ * gravity (accelerometer) and magnetic field (magnetometer) directions
+ * pull the estimate back through a PI loop on the cross product error.
+ * Single precision only: every constant carries the f suffix and
+ * normalisation uses a fast inverse square root, no libm, no double.
+ *
+ * Earth frame: X magnetic north, Y west, Z up. Both references are taken
+ * in the board frame and only their direction matters, so raw counts are
+ * fine as long as the three axes share the same scale.
+ */
+
+/**
+ * @brief orientation estimator struct
+ * The task that drains the gyro calls ahrs_update once per sample, the
+ * references are refreshed with ahrs_set_acc / ahrs_set_mag whenever the
+ * slower sensors deliver.
+ */
+struct _ahrs_t{
+	float 				 q[4];				// Board to earth quaternion w, x, y, z
+	float 				 bias[3];			// Integral feedback, gyro bias in rad/s
+	float 				 acc[3];			// Gravity direction, unit vector
+	float 				 mag[3];			// Magnetic field direction, unit vector
+	uint8_t 			 has_acc;
+	uint8_t 			 has_mag;
+	float 				 dt;				// Gyro sample period in s
+	float 				 kp;				// Proportional gain in 1/s
+	float 				 ki;				// Integral gain in 1/s^2
+	uint32_t 			 boot;				// Updates left with AHRS_BOOT_KP
+	uint32_t 			 updates;
+};
+typedef struct _ahrs_t ahrs_t;
+
+
+void 		ahrs_init(ahrs_t *ah, float rate, float kp, float ki);
+uint8_t 	ahrs_set_acc(ahrs_t *ah, float x, float y, float z);
+uint8_t 	ahrs_set_mag(ahrs_t *ah, float x, float y, float z);
+void 		ahrs_update(ahrs_t *ah, float gx, float gy, float gz);
+
+float 		ahrs_tilt(const ahrs_t *ah);
+float 		ahrs_heading(const ahrs_t *ah);
+float 		ahrs_inv_sqrt(float x);
+float 		ahrs_atan2(float y, float x);
+
+
+#endif /* AHRS_H_ */
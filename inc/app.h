@@ -0,0 +1,45 @@
+#ifndef APP_H_
+#define APP_H_
+
+#include "stdint.h"
+#include "timer_wheel.h"
+
+/* SENSORES MUESTREADOS */
+typedef enum
+{
+  SENSOR_TEMP_BOARD = 0,
+  SENSOR_HUM_SUELO  = 1,
+  SENSOR_TEMP_DHT11 = 2,
+  SENSOR_HUM_DHT11  = 3,
+  SENSOR_MIC_LA     = 4,			// Nivel ponderado A, dB SPL
+  SENSOR_MIC_PEAK   = 5,			// Pico sin ponderar, dB SPL
+  SENSOR_MIC_LEQ    = 6,			// LAeq del periodo, dB SPL
+  SENSOR_MIC_BAND_125 = 7,		// Bandas de octava 125 Hz a 4 kHz, dB SPL
+  SENSOR_MIC_BAND_250 = 8,
+  SENSOR_MIC_BAND_500 = 9,
+  SENSOR_MIC_BAND_1K  = 10,
+  SENSOR_MIC_BAND_2K  = 11,
+  SENSOR_MIC_BAND_4K  = 12,
+  SENSOR_VIB_Z      = 13,			// Vibracion eje Z 10-200 Hz, dB re 1 mg
+  SENSOR_GYRO_ODR   = 14,			// Tasa sostenida del giroscopo, muestras/s
+  SENSOR_TILT       = 15,			// Inclinacion del mastil, grados
+  SENSOR_HEADING    = 16,			// Rumbo magnetico, grados
+  SENSORn
+} Sensor_TypeDef;
+
+/* Muestra que viaja de la tarea de sensores a la de telemetria */
+typedef struct
+{
+  uint32_t       tick;				// Tick del periodo en que se tomo
+  Sensor_TypeDef sensor;
+  float          value;
+} Sample_TypeDef;
+
+
+void 		APP_Init(void);
+uint32_t 	APP_GetDroppedSamples(void);
+uint32_t 	APP_GetDroppedFrames(void);
+void 		APP_TimerStart(wheel_timer_t *timer, uint32_t delay, uint32_t period);
+void 		APP_TimerStop(wheel_timer_t *timer);
+
+#endif /* APP_H_ */
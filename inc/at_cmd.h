@@ -0,0 +1,94 @@
+#ifndef AT_CMD_H_
+#define AT_CMD_H_
+
+#include "stm32f4xx_hal.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+
+#define AT_LINE_SIZE 		64			// Longest response line kept
+#define AT_QUEUE_SIZE 		4			// Scripts waiting to be sent
+#define AT_SEND_RETRY 		10			// ms before resending a refused command
+#define AT_BACKOFF 			100			// ms before the first retry of an ERROR, doubles on each one
+#define AT_BACKOFF_MAX 		2000		// Longest wait between retries
+
+/* at_next_timeout with nothing pending */
+#define AT_WAIT_FOREVER 	0xFFFFFFFFu
+
+/* Builds the command field of an at_command_t from a string literal */
+#define AT_CMD(str) 		(str), (sizeof(str) - 1)
+
+/**
+ * @brief result reported to the completion callback
+ */
+typedef enum
+{
+  AT_RESULT_OK      = 0,
+  AT_RESULT_ERROR   = 1,
+  AT_RESULT_TIMEOUT = 2
+} at_result_t;
+
+/**
+ * @brief one entry of a constant command table
+ */
+struct _at_command_t{
+	const char 		*cmd;				// Command, lives in flash ex:"ATPW=2\r\n"
+	uint16_t 		 len;				// Command length without terminator
+	const char 		*expect;			// Final result code of success ex:"OK"
+	uint16_t 		 timeout;			// Response timeout in ms
+	uint8_t 		 retries;			// Extra attempts on error or timeout
+};
+typedef struct _at_command_t at_command_t;
+
+/* Called when a script ends. index is the last command run */
+typedef void (*at_done_cb_t)(at_result_t result, uint8_t index);
+/* Called for every line that does not answer the pending command */
+typedef void (*at_urc_cb_t)(const char *line, uint8_t len);
+
+struct _at_script_t{
+	const at_command_t 	*table;
+	uint8_t 			 count;
+	at_done_cb_t 		 done;
+};
+typedef struct _at_script_t at_script_t;
+
+/**
+ * @brief AT engine struct
+ * One command is in flight at a time: the next one is sent when the
+ * previous one answered. Commands are not pipelined, each step of the
+ * bring-up needs the one before it done.
+ */
+struct _at_engine_t{
+	uart_tx_t 			*tx;					// Transmit queue to the module ex:&wifi_tx
+	uart_rx_t 			*rx;					// Receive ring of that UART
+	at_urc_cb_t 		 urc;					// Unsolicited result code handler
+	at_script_t 		 queue[AT_QUEUE_SIZE];	// Pending scripts, queue[q_tail] runs
+	uint8_t 			 q_head;
+	uint8_t 			 q_tail;
+	uint8_t 			 index;					// Command of the running script
+	uint8_t 			 tries;					// Attempts left for that command
+	uint8_t 			 state;
+	uint32_t 			 sent_at;				// Tick of the last transmission
+	uint32_t 			 failed_at;				// Tick of the last error or timeout
+	uint16_t 			 backoff;				// ms from failed_at to the retry
+	char 				 line[AT_LINE_SIZE];	// Line being received
+	uint8_t 			 line_len;
+};
+typedef struct _at_engine_t at_engine_t;
+
+
+void 		at_init(at_engine_t 		*at,
+					uart_tx_t 			*tx,
+					uart_rx_t 			*rx,
+					at_urc_cb_t 		 urc);
+
+uint8_t 	at_submit(at_engine_t 		 *at,
+					  const at_command_t *table,
+					  uint8_t 			  count,
+					  at_done_cb_t 		  done);
+
+void 		at_process(at_engine_t *at);
+uint8_t 	at_busy(const at_engine_t *at);
+uint32_t 	at_next_timeout(const at_engine_t *at);
+
+
+#endif /* AT_CMD_H_ */
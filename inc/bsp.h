@@ -2,6 +2,10 @@
 #define BSP_H_
 
 #include "stdint.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "mic_level.h"
+#include "accel_stream.h"
 
 /* LEDS */
 typedef enum
@@ -12,6 +16,17 @@ typedef enum
   LED_BLUE   = 3
 } Led_TypeDef;
 
+/* CANALES DEL ADC (orden de la secuencia scan) */
+typedef enum
+{
+  ADC_CH_TEMP  = 0,
+  ADC_CH_SUELO = 1,
+  ADC_CH_VREF  = 2
+} AdcChannel_TypeDef;
+
+/* BANDAS DE OCTAVA DEL MICROFONO (125 Hz a 4 kHz) */
+#define MIC_BANDS 	6
+
 /* USER BUTTON */
 typedef enum
 {
@@ -19,16 +34,48 @@ typedef enum
 } Button_TypeDef;
 
 
+uint8_t 	BSP_ACCEL_Read(accel_block_t *block);
+uint32_t 	BSP_ADC_GetRate(AdcChannel_TypeDef channel);
 float 		BSP_BOARD_GetTemp(void);
 void		BSP_Delay(uint32_t ms);
 uint8_t*	BSP_DHT11_Read(void);
+uint8_t 	BSP_DHT11_Busy(void);
+float 		BSP_GYRO_GetRate(void);
+uint8_t 	BSP_GYRO_Read(accel_block_t *block);
+void 		BSP_IMU_Update(void);
+uint8_t 	BSP_IMU_Ready(void);
+float 		BSP_IMU_GetTilt(void);
+float 		BSP_IMU_GetHeading(void);
 void 		BSP_Init(void);
 void     	BSP_LED_On(Led_TypeDef Led);
 void     	BSP_LED_Off(Led_TypeDef Led);
 void     	BSP_LED_Toggle(Led_TypeDef Led);
+void 		BSP_CONSOLE_Attach(TaskHandle_t task);
+uint16_t 	BSP_CONSOLE_Read(uint8_t *data, uint16_t max);
+uint8_t 	BSP_LOG_Append(const uint8_t *data, uint16_t len);
+uint32_t 	BSP_LOG_GetLost(void);
+void 		BSP_LOG_Process(void);
 uint32_t    BSP_LUZ_GetState(void);
+uint8_t 	BSP_MIC_Read(mic_record_t *record);
+uint32_t 	BSP_MIC_GetOverBudget(void);
+void 		BSP_MIC_Spectrum(void);
+uint8_t 	BSP_MIC_ReadBands(int16_t *level_x10);
 uint32_t 	BSP_PB_GetState(Button_TypeDef Button);
+uint32_t 	BSP_PWR_GetSleepCount(void);
+uint32_t 	BSP_PWR_GetSleepTime(void);
+void 		BSP_RUNTIME_Init(void);
+uint32_t 	BSP_RUNTIME_GetCounter(void);
+uint8_t 	BSP_VIB_Read(float *level);
+void 		BSP_SENSOR_Attach(TaskHandle_t task);
 uint32_t    BSP_SUELO_GetHum(void);
 void 		BSP_WIFI_Init(void);
+void 		BSP_WIFI_Process(void);
+void 		BSP_WIFI_Attach(TaskHandle_t task);
+TickType_t 	BSP_WIFI_NextTimeout(void);
+uint32_t 	BSP_WIFI_GetRxErrors(void);
+uint8_t 	BSP_WIFI_Ready(void);
+uint8_t 	BSP_WIFI_Send(const uint8_t *data, uint16_t len);
+uint32_t 	BSP_WIFI_GetBringUpTime(void);
+void 		Error_Handler(void);
 
 #endif /* BSP_H_ */
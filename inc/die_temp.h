@@ -0,0 +1,44 @@
+#ifndef DIE_TEMP_H_
+#define DIE_TEMP_H_
+
+#include "stm32f4xx_hal.h"
+
+/*
+ * Internal temperature sensor with the factory calibration of each chip.
+ * ST measures the sensor at 30 and 110 C and VREFINT at 30 C, all with
+ * VDDA = 3.3 V, and stores the raw 12 bit counts in system memory. The
+ * curve between them is a line; a reading taken at another supply is first
+ * brought back to 3.3 V with the VREFINT reading of the same scan:
+ *
+ *  counts at 3.3 V = ts * VREFINT_CAL / vref
+ *  T = 30 + (counts at 3.3 V - TS_CAL1) * (110 - 30) / (TS_CAL2 - TS_CAL1)
+ *
+ * die_temp_init folds the constants into T = slope * ts / vref + offset,
+ * so a conversion is one single precision divide and one multiply-add.
+ * Only the ratio ts / vref matters: both may be given with extra fraction
+ * bits as long as they share the scale.
+ */
+
+/* Factory calibration in system memory, raw counts at VDDA = 3.3 V */
+#define DIE_TEMP_TS_CAL1 		(*(const uint16_t *)0x1FFF7A2C)		// Sensor at 30 C
+#define DIE_TEMP_TS_CAL2 		(*(const uint16_t *)0x1FFF7A2E)		// Sensor at 110 C
+#define DIE_TEMP_VREFINT_CAL 	(*(const uint16_t *)0x1FFF7A2A)		// VREFINT at 30 C
+#define DIE_TEMP_CAL1_C 		30.0f
+#define DIE_TEMP_CAL2_C 		110.0f
+
+/**
+ * @brief conversion constants
+ */
+struct _die_temp_t{
+	float 		slope;					// C per unit of ts / vref
+	float 		offset;					// C
+	uint8_t 	factory;				// 1 if the calibration came from system memory
+};
+typedef struct _die_temp_t die_temp_t;
+
+
+uint8_t 	die_temp_init(die_temp_t *dt);
+float 		die_temp_celsius(const die_temp_t *dt, uint32_t ts, uint32_t vref);
+
+
+#endif /* DIE_TEMP_H_ */
@@ -0,0 +1,104 @@
+#ifndef FLASH_LOG_H_
+#define FLASH_LOG_H_
+
+#include "stm32f4xx_hal.h"
+
+#define FLASH_LOG_MAX_SECTORS 	4			// Sectors the store can manage
+#define FLASH_LOG_MAGIC 		0x31474F4Cu	// "LOG1"
+#define FLASH_LOG_BLOCK 		1024		// Data bytes covered by one mark
+#define FLASH_LOG_RECORD_MAX 	(FLASH_LOG_BLOCK - 8)	// Largest payload, bytes
+#define FLASH_LOG_SPARE_BYTES 	4096		// Head room left when the next sector gets erased
+#define FLASH_LOG_NONE 			0xFF		// No sector
+
+/* Sector states */
+#define FLASH_LOG_ERASED 		0			// Blank, can be opened
+#define FLASH_LOG_LIVE 			1			// Valid header, holds records
+#define FLASH_LOG_DIRTY 		2			// Anything else, must be erased
+
+/*
+ * Log structured store on equal, consecutive flash sectors used as a ring.
+ * Little endian words, erased flash reads 0xFF.
+ *
+ * Sector layout:
+ *  offset  size  field
+ *  0       4     FLASH_LOG_MAGIC
+ *  4       4     sequence, +1 for every sector opened
+ *  8       4     ~sequence, a torn header does not validate
+ *  12      4     0xFFFFFFFF while the data is live, 0 once retired for erase
+ *  16      2*B   marks, one halfword per FLASH_LOG_BLOCK of data
+ *  data    ...   records
+ *
+ * Record layout, word aligned:
+ *  0       2     payload length N
+ *  2       2     ~N
+ *  4       N     payload, zero padded to a multiple of 4 bytes
+ *  4+N'    4     CRC-32 of every previous word of the record (STM32 CRC unit)
+ *
+ * Mark b holds the word offset, inside data block b, of the first record
+ * header written in that block, 0xFFFF while no record has started there.
+ * Records are shorter than a block so the programmed marks always form a
+ * prefix: mount binary searches them and walks at most two blocks of
+ * records to find the end, the rest of the log is never read.
+ *
+ * Append order is mark, header, payload, CRC. A cut after the header leaves
+ * a record that the length skips and the CRC rejects; a cut inside the
+ * header leaves a word that is neither erased nor a valid length, mount then
+ * closes the sector and appends go on in the next one.
+ *
+ * The ring rotates through every sector so they all wear alike. Once the
+ * head has less than FLASH_LOG_SPARE_BYTES left, flash_log_poll retires the
+ * next sector (oldest data) and erases it with HAL_FLASHEx_Erase_IT; the
+ * flash interrupt reports the end. A sector is blank checked before it is
+ * opened, so one left half erased by a power cut is erased again.
+ * Single bank part: while a sector erases (1 s typical for 128 KB, 2 s at
+ * most) every flash access stalls the CPU, so no handler or task runs. DMA
+ * keeps moving data, but the circular buffers and the sensor FIFOs hold
+ * less than that and wrap around: each erase costs about a second of
+ * samples.
+ */
+
+/**
+ * @brief read position, set with flash_log_rewind
+ */
+struct _flash_log_cursor_t{
+	uint8_t 			 sector;			// Sector being read, FLASH_LOG_NONE at the end
+	uint32_t 			 offset;			// Byte offset of the next record header
+};
+typedef struct _flash_log_cursor_t flash_log_cursor_t;
+
+/**
+ * @brief log store struct
+ * Appends, reads and polls come from one task, the flash interrupt only
+ * ends the erase through flash_log_erase_done.
+ */
+struct _flash_log_t{
+	CRC_HandleTypeDef 	*hcrc;								// CRC unit ex:&hcrc
+	uint32_t 			 base;								// Address of the first sector
+	uint32_t 			 sector_size;						// Bytes per sector
+	uint8_t 			 first_sector;						// FLASH_SECTOR_x of base
+	uint8_t 			 sectors;
+	uint16_t 			 blocks;							// Marks per sector
+	uint32_t 			 data;								// Offset of the first record
+	uint8_t 			 state[FLASH_LOG_MAX_SECTORS];		// FLASH_LOG_ERASED, FLASH_LOG_LIVE...
+	uint32_t 			 sequence[FLASH_LOG_MAX_SECTORS];	// Sequence of each live sector
+	uint8_t 			 head;								// Sector being written
+	uint32_t 			 offset;							// Byte offset of the next record in head
+	int32_t 			 marked;							// Last block of head with its mark set
+	volatile uint8_t 	 erasing;							// Sector being erased
+	uint32_t 			 appends;
+	uint32_t 			 lost;								// Appends refused, no room or flash error
+	volatile uint32_t 	 erases;
+};
+typedef struct _flash_log_t flash_log_t;
+
+
+uint8_t 	flash_log_mount(flash_log_t *log, CRC_HandleTypeDef *hcrc, uint32_t base, uint8_t first_sector, uint8_t sectors, uint32_t sector_size);
+uint8_t 	flash_log_append(flash_log_t *log, const void *data, uint16_t len);
+void 		flash_log_poll(flash_log_t *log);
+void 		flash_log_erase_done(flash_log_t *log, uint8_t ok);
+
+void 		flash_log_rewind(const flash_log_t *log, flash_log_cursor_t *cur);
+uint16_t 	flash_log_read(flash_log_t *log, flash_log_cursor_t *cur, void *data, uint16_t max);
+
+
+#endif /* FLASH_LOG_H_ */
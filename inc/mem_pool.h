@@ -0,0 +1,67 @@
+#ifndef MEM_POOL_H_
+#define MEM_POOL_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Poisoning: free blocks are filled with MEM_POOL_FREE_BYTE and checked
+ * when handed out again, catching writes after free. On in Debug builds */
+#ifndef MEM_POOL_POISON
+#ifdef DEBUG
+#define MEM_POOL_POISON 		1
+#else
+#define MEM_POOL_POISON 		0
+#endif
+#endif
+#define MEM_POOL_FREE_BYTE 		0xDD
+#define MEM_POOL_ALLOC_BYTE 	0xCD
+
+/* Block size rounded up to whole words */
+#define MEM_POOL_WORDS(size) 	(((size) + 3) / 4)
+
+/* Word aligned storage for count blocks of size bytes */
+#define MEM_POOL_BUFFER(name, size, count) \
+	static uint32_t name[MEM_POOL_WORDS(size) * (count)]
+
+/*
+ * Fixed block pools, O(1) allocation and release from tasks and interrupts.
+ *
+ * Free blocks form a singly linked list through their first word. Pop and
+ * push are one LDREX/STREX pair on the list head: Cortex-M clears the
+ * exclusive monitor on every exception entry and return, so an interrupt
+ * that touches the pool between the load and the store makes the store
+ * fail and the loop retry with the new head. The next pointer read in
+ * between can therefore never be stale (no ABA), and interrupts are never
+ * masked.
+ *
+ * Size classes are an array of pools sorted by block size: mem_pool_set_alloc
+ * takes the smallest class that fits and has a free block, mem_pool_set_free
+ * finds the owner from the address.
+ */
+
+/**
+ * @brief one size class
+ */
+struct _mem_pool_t{
+	void 				*volatile free;			// Free list head
+	uint8_t 			*base;					// First block
+	uint8_t 			*end;					// Past the last block
+	uint16_t 			 block_size;			// Bytes, multiple of 4
+	uint16_t 			 blocks;
+	volatile uint32_t 	 used;					// Blocks handed out
+	volatile uint32_t 	 high_water;			// Most blocks ever handed out
+	volatile uint32_t 	 failed;				// Allocations refused, pool empty
+	volatile uint32_t 	 corrupt;				// Poison found damaged, written after free
+};
+typedef struct _mem_pool_t mem_pool_t;
+
+
+uint8_t 	mem_pool_init(mem_pool_t *pool, void *buffer, uint16_t block_size, uint16_t blocks);
+void 		*mem_pool_alloc(mem_pool_t *pool);
+uint8_t 	mem_pool_free(mem_pool_t *pool, void *block);
+uint8_t 	mem_pool_owns(const mem_pool_t *pool, const void *block);
+
+void 		*mem_pool_set_alloc(mem_pool_t *pools, uint8_t count, uint16_t size);
+uint8_t 	mem_pool_set_free(mem_pool_t *pools, uint8_t count, void *block);
+
+
+#endif /* MEM_POOL_H_ */
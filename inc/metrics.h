@@ -0,0 +1,80 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "stm32f4xx_hal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "prof.h"
+
+/*
+ * Station load metrics. metrics_sample, called at a fixed period, keeps
+ * the last METRICS_WINDOW + 1 snapshots of the kernel run time counters
+ * (portGET_RUN_TIME_COUNTER_VALUE, a hardware timer that keeps counting in
+ * sleep) and of the cycles spent in each interrupt (prof probes). Loads are
+ * the difference between two snapshots: over the last period and over the
+ * whole window, which slides one period per call. The time of a task
+ * includes the interrupts that preempted it.
+ *
+ * Metrics frame, version 1. Multi-byte fields are little endian, loads are
+ * in 0.01 % units (10000 = 100 %).
+ *
+ *  offset  size  field
+ *  0       1     METRICS_SYNC
+ *  1       1     METRICS_VERSION
+ *  2       2     sequence number
+ *  4       4     tick in ms
+ *  8       2     CPU load (all but idle), last period
+ *  10      2     CPU load, window
+ *  12      4     heap minimum ever free in bytes
+ *  16      1     task count T
+ *  17      1     interrupt count I
+ *  18      T*7   task number (creation order), load last period, load
+ *                window, minimum free stack in words
+ *  18+T*7  I*5   prof probe, load last period, load window; only the
+ *                interrupts that ran in the window
+ *  ...     0..3  zero padding up to a multiple of 4 bytes
+ *  end-4   4     CRC-32 as in the telemetry frame
+ */
+
+#define METRICS_SYNC 			0x5A
+#define METRICS_VERSION 		1
+#define METRICS_HEADER_SIZE 	18
+#define METRICS_TASKS 			8			// Task numbers 1..8
+#define METRICS_WINDOW 			10			// Periods in the long window
+#define METRICS_FRAME_SIZE 		(METRICS_HEADER_SIZE + METRICS_TASKS * 7 + PROF_ISR_PROBES * 5 + 3 + 4)
+
+/**
+ * @brief counters at one instant
+ */
+struct _metrics_snapshot_t{
+	uint32_t 	time;							// Run time counter
+	uint32_t 	task[METRICS_TASKS];			// Run time of each task number
+	uint32_t 	isr[PROF_ISR_PROBES];			// Cycles in each interrupt, low 32 bits
+	uint8_t 	tasks;							// Bit n-1 set if task n exists
+};
+typedef struct _metrics_snapshot_t metrics_snapshot_t;
+
+/**
+ * @brief metrics struct
+ */
+struct _metrics_t{
+	CRC_HandleTypeDef 	*hcrc;								// CRC unit ex:&hcrc
+	metrics_snapshot_t 	 snap[METRICS_WINDOW + 1];			// Ring of snapshots
+	uint8_t 			 last;								// Newest snapshot
+	uint8_t 			 count;								// Snapshots taken, up to METRICS_WINDOW + 1
+	uint16_t 			 stack[METRICS_TASKS];				// Minimum free stack in words
+	uint8_t 			 idle;								// Task number of the idle task
+	uint16_t 			 sequence;							// Sequence of the next frame
+	TaskStatus_t 		 status[METRICS_TASKS];				// uxTaskGetSystemState scratch
+	uint32_t 			 frame[(METRICS_FRAME_SIZE + 3) / 4];
+};
+typedef struct _metrics_t metrics_t;
+
+
+void 		metrics_init(metrics_t *m, CRC_HandleTypeDef *hcrc);
+void 		metrics_sample(metrics_t *m);
+uint16_t 	metrics_cpu_load(const metrics_t *m, uint8_t periods);
+uint16_t 	metrics_finish(metrics_t *m, uint32_t tick, const uint8_t **frame);
+
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,56 @@
+#ifndef MIC_LEVEL_H_
+#define MIC_LEVEL_H_
+
+#include "stm32f4xx_hal.h"
+
+#define MIC_LEVEL_BIQUADS 	3			// A weighting sections
+#define MIC_LEVEL_RECORDS 	4			// Records waiting to be read
+
+/**
+ * @brief one finished level window
+ */
+struct _mic_record_t{
+	uint32_t 			 tick;				// Tick at the end of the window
+	int16_t 			 la_x10;			// A weighted RMS level in 0.1 dB
+	int16_t 			 peak_x10;			// Unweighted peak level in 0.1 dB
+	int16_t 			 leq_x10;			// LAeq of the last Leq period in 0.1 dB
+	uint8_t 			 leq_done;			// 1 when this window closed a Leq period
+};
+typedef struct _mic_record_t mic_record_t;
+
+/**
+ * @brief microphone level meter struct
+ * mic_level_process runs in the audio DMA interrupt and fills records[],
+ * a task empties it with mic_level_read. Only the ISR moves head and only
+ * the task moves tail.
+ */
+struct _mic_level_t{
+	float 				 z[MIC_LEVEL_BIQUADS][2];	// A weighting state (DF2T)
+	float 				 offset;					// dB added to dBFS ex:120 for dB SPL
+	uint32_t 			 window;					// Samples per level window
+	uint16_t 			 leq_windows;				// Windows per Leq period
+	uint32_t 			 n;							// Samples in the current window
+	float 				 sum;						// Sum of squares, current window
+	int32_t 			 peak;						// Largest |x|, current window
+	uint16_t 			 leq_n;						// Windows in the current Leq period
+	float 				 leq_sum;					// Sum of window mean squares
+	mic_record_t 		 records[MIC_LEVEL_RECORDS];
+	volatile uint8_t 	 head;
+	volatile uint8_t 	 tail;
+	volatile uint32_t 	 lost;						// Records dropped, reader too slow
+};
+typedef struct _mic_level_t mic_level_t;
+
+
+void 		mic_level_init(mic_level_t *mic,
+						   uint32_t 	fs,
+						   uint16_t 	window_ms,
+						   uint16_t 	leq_windows,
+						   float 		offset);
+
+void 		mic_level_process(mic_level_t *mic, const int16_t *pcm, uint16_t count, uint32_t tick);
+uint8_t 	mic_level_read(mic_level_t *mic, mic_record_t *record);
+int16_t 	mic_level_db_x10(float x, float offset);
+
+
+#endif /* MIC_LEVEL_H_ */
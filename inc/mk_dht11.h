@@ -5,6 +5,26 @@
 
 #define OUTPUT 		1
 #define INPUT  		0
+#define CAPTURE 	2
+
+/* Sensor types */
+#define DHT11 		11
+#define DHT22 		22
+
+/* Edges of a full transfer: response (3) + 40 bits (80) + release (1) */
+#define DHT11_MAX_EDGES 	88
+
+/* Read states */
+#define DHT11_IDLE 			0			// No transfer running
+#define DHT11_START 		1			// Start pulse, pin driven low
+#define DHT11_WAIT 			2			// Capturing edges
+
+/* Decoder results */
+#define DHT11_OK 			0
+#define DHT11_ERR_RESPONSE 	1			// No 80us low/high response found
+#define DHT11_ERR_EDGES 	2			// Transfer ended with missing edges
+#define DHT11_ERR_TIMING 	3			// Pulse out of the bit timing window
+#define DHT11_ERR_CHECKSUM 	4			// Parity byte does not match
 
 /**
  * @brief DHT11 struct
@@ -12,20 +32,37 @@
 struct _dht11_t{
 	GPIO_TypeDef* 		port;				// GPIO Port ex:GPIOA
 	uint16_t 	  		pin; 				// GPIO pin ex:GPIO_PIN_2
-	TIM_HandleTypeDef 	*htim;				// Timer for measure time ex:htim3
+	uint8_t 			af;					// Timer alternate function ex:GPIO_AF1_TIM2
+	uint8_t 			type;				// DHT11 or DHT22
+	TIM_HandleTypeDef 	*htim;				// 1MHz input capture timer ex:&htim2
+	uint32_t 			channel;			// Capture channel ex:TIM_CHANNEL_1
 	uint8_t 			temperature; 		// Temperature value
 	uint8_t 			humidty; 			// Humidity value
+	int16_t 			temp_x10;			// Temperature in 0.1 C
+	uint16_t 			hum_x10;			// Humidity in 0.1 %
+	uint8_t 			state;				// DHT11_IDLE, DHT11_START or DHT11_WAIT
+	uint8_t 			error;				// Result of the last decode
+	uint32_t 			tick;				// Tick of the last state change
+	uint32_t 			edges[DHT11_MAX_EDGES];	// Captured edge timestamps in us
+	volatile uint8_t 	n_edges;			// Captured edges
 };
 typedef struct _dht11_t dht11_t;
 
 
 void 		init_dht11(dht11_t 			 *dht,
 					   TIM_HandleTypeDef *htim,
+					   uint32_t 		  channel,
 					   GPIO_TypeDef 	 *port,
-					   uint16_t 	      pin);
+					   uint16_t 	      pin,
+					   uint8_t 			  af);
 
 void 		set_dht11_gpio_mode(dht11_t *dht, uint8_t pMode);
 uint8_t 	readDHT11(dht11_t *dht);
 
+void 		dht11_request(dht11_t *dht);
+uint8_t 	dht11_process(dht11_t *dht);
+void 		dht11_capture_isr(dht11_t *dht);
+uint8_t 	dht11_decode(const uint32_t *edges, uint8_t count, uint8_t data[5]);
+
 
 #endif
@@ -0,0 +1,87 @@
+#ifndef PROF_H_
+#define PROF_H_
+
+#include "stm32f4xx_hal.h"
+#include "trace.h"
+
+/* Set to 0 to compile every probe out */
+#ifndef PROF_ENABLED
+#define PROF_ENABLED 		1
+#endif
+
+/* Histogram bucket i counts durations in [2^(i-1), 2^i) cycles */
+#define PROF_BUCKETS 		24
+
+/* Probes */
+typedef enum
+{
+  PROF_SYSTICK_IRQ = 0,
+  PROF_TIM2_IRQ,
+  PROF_USART1_IRQ,
+  PROF_USART2_IRQ,
+  PROF_DMA1_S5_IRQ,
+  PROF_DMA1_S6_IRQ,
+  PROF_DMA2_S0_IRQ,
+  PROF_DMA1_S3_IRQ,
+  PROF_DMA1_S0_IRQ,
+  PROF_I2C1_IRQ,
+  PROF_EXTI4_IRQ,
+  PROF_DMA2_S2_IRQ,
+  PROF_DMA2_S3_IRQ,
+  PROF_SPI1_IRQ,
+  PROF_EXTI1_IRQ,
+  PROF_FLASH_IRQ,
+  PROF_WIFI_PROCESS,
+  PROF_DHT11_READ,
+  PROF_ADC_BLOCK,
+  PROF_TELEMETRY_FRAME,
+  PROF_MIC_BLOCK,
+  PROF_MIC_SPECTRUM,
+  PROF_VIB_SPECTRUM,
+  PROF_AHRS,
+  PROF_LOG_APPEND,
+  PROF_SERIES,
+  PROF_BOARD_TEMP,
+  PROF_PROBES
+} prof_probe_t;
+
+/* Interrupt probes come first */
+#define PROF_ISR_PROBES 	(PROF_FLASH_IRQ + 1)
+
+/**
+ * @brief statistics of one probe, in CPU cycles
+ */
+struct _prof_stat_t{
+	uint32_t 	count;
+	uint32_t 	min;
+	uint32_t 	max;
+	uint64_t 	total;
+	uint32_t 	hist[PROF_BUCKETS];
+};
+typedef struct _prof_stat_t prof_stat_t;
+
+
+void 		prof_init(void);
+void 		prof_reset(void);
+void 		prof_record(prof_probe_t probe, uint32_t cycles);
+const prof_stat_t *prof_get(prof_probe_t probe);
+const char 	*prof_name(prof_probe_t probe);
+void 		prof_dump(UART_HandleTypeDef *huart);
+
+#if PROF_ENABLED
+/* Scoped markers: uint32_t t = PROF_BEGIN(); ... PROF_END(PROF_X, t); */
+#define PROF_BEGIN() 			(DWT->CYCCNT)
+#define PROF_END(probe, start) 	prof_record((probe), DWT->CYCCNT - (start))
+/* Interrupt handler hooks, first and last statement of the handler. They
+ * also mark the handler in the event recorder (trace.h) */
+#define PROF_ISR_ENTER() 		uint32_t prof_isr_start = DWT->CYCCNT; TRACE_ISR_BEGIN()
+#define PROF_ISR_EXIT(probe) 	prof_record((probe), DWT->CYCCNT - prof_isr_start); TRACE_ISR_END(probe)
+#else
+#define PROF_BEGIN() 			0
+#define PROF_END(probe, start) 	((void)(start))
+#define PROF_ISR_ENTER() 		TRACE_ISR_BEGIN()
+#define PROF_ISR_EXIT(probe) 	TRACE_ISR_END(probe)
+#endif
+
+
+#endif /* PROF_H_ */
@@ -0,0 +1,149 @@
+#ifndef RTOS_STATIC_H_
+#define RTOS_STATIC_H_
+
+#include "stm32f4xx_hal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "timers.h"
+
+/*
+ * Kernel objects declared from one X-macro table. Each row gives its handle,
+ * its storage (RTOS_STATIC, FreeRTOSConfig.h), its creation call and one
+ * line of the RAM budget:
+ *
+ *  TASK(name, function, stack words, priority)          TaskHandle_t name_task
+ *  QUEUE(name, length, item size)                       QueueHandle_t name_queue
+ *  MUTEX(name)                                          SemaphoreHandle_t name_mutex
+ *  SEMAPHORE(name, max count, initial count)            SemaphoreHandle_t name_sem
+ *  TIMER(name, period ms, auto reload, callback)        TimerHandle_t name_timer
+ *
+ *  #define APP_OBJECTS(TASK, QUEUE, MUTEX, SEMAPHORE, TIMER) \
+ *  	TASK(sensor, APP_SensorTask, 256, 3) \
+ *  	QUEUE(sample, 24, sizeof(Sample_TypeDef))
+ *
+ *  RTOS_OBJECTS_DEFINE(APP_OBJECTS)                     file scope, once
+ *  if(!RTOS_OBJECTS_CREATE(APP_OBJECTS)) Error_Handler();
+ *  const rtos_budget_t budget[] = { RTOS_OBJECTS_BUDGET(APP_OBJECTS) };
+ *
+ * In static mode all the storage is one struct in .bss, so the linker map
+ * shows the whole kernel RAM. In both modes the objects plus the idle (and
+ * timer) task are checked against RTOS_RAM_BUDGET when compiling. Creation
+ * order is table order and stops at the first failure.
+ */
+
+#define RTOS_KIND_TASK 			0
+#define RTOS_KIND_QUEUE 		1
+#define RTOS_KIND_MUTEX 		2
+#define RTOS_KIND_SEMAPHORE 	3
+#define RTOS_KIND_TIMER 		4
+
+/* Idle task, plus the timer service task when configUSE_TIMERS */
+#define RTOS_KERNEL_BYTES 		(sizeof(StaticTask_t) + configMINIMAL_STACK_SIZE * sizeof(StackType_t) + \
+								 (configUSE_TIMERS ? sizeof(StaticTask_t) + configTIMER_TASK_STACK_DEPTH * sizeof(StackType_t) : 0))
+
+/**
+ * @brief one line of the RAM budget
+ */
+struct _rtos_budget_t{
+	const char 			*name;
+	uint8_t 			 kind;					// RTOS_KIND_TASK...
+	uint32_t 			 bytes;					// RTOS_TASK_BYTES...
+};
+typedef struct _rtos_budget_t rtos_budget_t;
+
+/* Handles */
+#define RTOS_TASK_HANDLE(name, fn, depth, prio) 		static TaskHandle_t name##_task;
+#define RTOS_QUEUE_HANDLE(name, len, size) 			static QueueHandle_t name##_queue;
+#define RTOS_MUTEX_HANDLE(name) 						static SemaphoreHandle_t name##_mutex;
+#define RTOS_SEMAPHORE_HANDLE(name, max, init) 		static SemaphoreHandle_t name##_sem;
+#define RTOS_TIMER_HANDLE(name, ms, reload, cb) 		static TimerHandle_t name##_timer;
+
+/* Bytes of each object: control block plus stack or items. From the heap
+ * every allocation also carries the heap_4 block header, rounded up */
+#if RTOS_STATIC
+#define RTOS_ALLOC_BYTES 		0
+#else
+#define RTOS_ALLOC_BYTES 		(2 * portBYTE_ALIGNMENT)
+#endif
+#define RTOS_TASK_BYTES(name, fn, depth, prio) 		(sizeof(StaticTask_t) + (depth) * sizeof(StackType_t) + 2 * RTOS_ALLOC_BYTES)
+#define RTOS_QUEUE_BYTES(name, len, size) 			(sizeof(StaticQueue_t) + (len) * (size) + RTOS_ALLOC_BYTES)
+#define RTOS_MUTEX_BYTES(name) 						(sizeof(StaticSemaphore_t) + RTOS_ALLOC_BYTES)
+#define RTOS_SEMAPHORE_BYTES(name, max, init) 		(sizeof(StaticSemaphore_t) + RTOS_ALLOC_BYTES)
+#define RTOS_TIMER_BYTES(name, ms, reload, cb) 		(sizeof(StaticTimer_t) + RTOS_ALLOC_BYTES)
+
+/* Budget lines and their sum */
+#define RTOS_TASK_BUDGET(...) 		{RTOS_NAME(__VA_ARGS__), RTOS_KIND_TASK, RTOS_TASK_BYTES(__VA_ARGS__)},
+#define RTOS_QUEUE_BUDGET(...) 		{RTOS_NAME(__VA_ARGS__), RTOS_KIND_QUEUE, RTOS_QUEUE_BYTES(__VA_ARGS__)},
+#define RTOS_MUTEX_BUDGET(...) 		{RTOS_NAME(__VA_ARGS__), RTOS_KIND_MUTEX, RTOS_MUTEX_BYTES(__VA_ARGS__)},
+#define RTOS_SEMAPHORE_BUDGET(...) 	{RTOS_NAME(__VA_ARGS__), RTOS_KIND_SEMAPHORE, RTOS_SEMAPHORE_BYTES(__VA_ARGS__)},
+#define RTOS_TIMER_BUDGET(...) 		{RTOS_NAME(__VA_ARGS__), RTOS_KIND_TIMER, RTOS_TIMER_BYTES(__VA_ARGS__)},
+#define RTOS_TASK_SUM(...) 			+ RTOS_TASK_BYTES(__VA_ARGS__)
+#define RTOS_QUEUE_SUM(...) 		+ RTOS_QUEUE_BYTES(__VA_ARGS__)
+#define RTOS_MUTEX_SUM(...) 		+ RTOS_MUTEX_BYTES(__VA_ARGS__)
+#define RTOS_SEMAPHORE_SUM(...) 	+ RTOS_SEMAPHORE_BYTES(__VA_ARGS__)
+#define RTOS_TIMER_SUM(...) 		+ RTOS_TIMER_BYTES(__VA_ARGS__)
+#define RTOS_NAME(name, ...) 		#name
+
+#if RTOS_STATIC
+
+/* Storage, fields of rtos_storage */
+#define RTOS_TASK_STORAGE(name, fn, depth, prio) 		StackType_t name##_stack[depth]; StaticTask_t name##_tcb;
+#define RTOS_QUEUE_STORAGE(name, len, size) 			uint8_t name##_items[(len) * (size)]; StaticQueue_t name##_qcb;
+#define RTOS_MUTEX_STORAGE(name) 						StaticSemaphore_t name##_mcb;
+#define RTOS_SEMAPHORE_STORAGE(name, max, init) 		StaticSemaphore_t name##_scb;
+#define RTOS_TIMER_STORAGE(name, ms, reload, cb) 		StaticTimer_t name##_tmcb;
+
+/* Creation, chained with && */
+#define RTOS_TASK_CREATE(name, fn, depth, prio) \
+	&& (name##_task = xTaskCreateStatic(fn, #name, depth, NULL, prio, rtos_storage.name##_stack, &rtos_storage.name##_tcb)) != NULL
+#define RTOS_QUEUE_CREATE(name, len, size) \
+	&& (name##_queue = xQueueCreateStatic(len, size, rtos_storage.name##_items, &rtos_storage.name##_qcb)) != NULL
+#define RTOS_MUTEX_CREATE(name) \
+	&& (name##_mutex = xSemaphoreCreateMutexStatic(&rtos_storage.name##_mcb)) != NULL
+#define RTOS_SEMAPHORE_CREATE(name, max, init) \
+	&& (name##_sem = xSemaphoreCreateCountingStatic(max, init, &rtos_storage.name##_scb)) != NULL
+#define RTOS_TIMER_CREATE(name, ms, reload, cb) \
+	&& (name##_timer = xTimerCreateStatic(#name, pdMS_TO_TICKS(ms), reload, NULL, cb, &rtos_storage.name##_tmcb)) != NULL
+
+#define RTOS_OBJECTS_DEFINE(TABLE) \
+	TABLE(RTOS_TASK_HANDLE, RTOS_QUEUE_HANDLE, RTOS_MUTEX_HANDLE, RTOS_SEMAPHORE_HANDLE, RTOS_TIMER_HANDLE) \
+	static struct{ \
+		TABLE(RTOS_TASK_STORAGE, RTOS_QUEUE_STORAGE, RTOS_MUTEX_STORAGE, RTOS_SEMAPHORE_STORAGE, RTOS_TIMER_STORAGE) \
+	} rtos_storage; \
+	RTOS_BUDGET_CHECK(TABLE)
+
+#else
+
+#define RTOS_TASK_CREATE(name, fn, depth, prio) \
+	&& xTaskCreate(fn, #name, depth, NULL, prio, &name##_task) == pdPASS
+#define RTOS_QUEUE_CREATE(name, len, size) \
+	&& (name##_queue = xQueueCreate(len, size)) != NULL
+#define RTOS_MUTEX_CREATE(name) \
+	&& (name##_mutex = xSemaphoreCreateMutex()) != NULL
+#define RTOS_SEMAPHORE_CREATE(name, max, init) \
+	&& (name##_sem = xSemaphoreCreateCounting(max, init)) != NULL
+#define RTOS_TIMER_CREATE(name, ms, reload, cb) \
+	&& (name##_timer = xTimerCreate(#name, pdMS_TO_TICKS(ms), reload, NULL, cb)) != NULL
+
+#define RTOS_OBJECTS_DEFINE(TABLE) \
+	TABLE(RTOS_TASK_HANDLE, RTOS_QUEUE_HANDLE, RTOS_MUTEX_HANDLE, RTOS_SEMAPHORE_HANDLE, RTOS_TIMER_HANDLE) \
+	RTOS_BUDGET_CHECK(TABLE)
+
+#endif
+
+#define RTOS_OBJECTS_BYTES(TABLE) \
+	(0 TABLE(RTOS_TASK_SUM, RTOS_QUEUE_SUM, RTOS_MUTEX_SUM, RTOS_SEMAPHORE_SUM, RTOS_TIMER_SUM))
+#define RTOS_BUDGET_CHECK(TABLE) \
+	_Static_assert(RTOS_OBJECTS_BYTES(TABLE) + RTOS_KERNEL_BYTES <= RTOS_RAM_BUDGET, "kernel objects over RTOS_RAM_BUDGET");
+#define RTOS_OBJECTS_CREATE(TABLE) \
+	(1 TABLE(RTOS_TASK_CREATE, RTOS_QUEUE_CREATE, RTOS_MUTEX_CREATE, RTOS_SEMAPHORE_CREATE, RTOS_TIMER_CREATE))
+#define RTOS_OBJECTS_BUDGET(TABLE) \
+	TABLE(RTOS_TASK_BUDGET, RTOS_QUEUE_BUDGET, RTOS_MUTEX_BUDGET, RTOS_SEMAPHORE_BUDGET, RTOS_TIMER_BUDGET)
+
+
+void 		rtos_report(UART_HandleTypeDef *huart, const rtos_budget_t *budget, uint8_t count);
+
+
+#endif /* RTOS_STATIC_H_ */
@@ -0,0 +1,89 @@
+#ifndef SERIES_H_
+#define SERIES_H_
+
+#include "stm32f4xx_hal.h"
+
+#define SERIES_SYNC 			0x5E
+#define SERIES_HEADER_SIZE 		9
+#define SERIES_BLOCK_SIZE 		128			// Header + bit stream, one flash record or Wi-Fi send
+#define SERIES_FLOAT 			0xFF		// decimals value for raw float samples
+
+/*
+ * Compressed block of one timestamped series, Gorilla style. Multi-byte
+ * header fields are little endian.
+ *
+ *  offset  size  field
+ *  0       1     SERIES_SYNC
+ *  1       1     series id
+ *  2       1     decimals: values are sent as round(value * 10^decimals),
+ *                SERIES_FLOAT for the raw float bits
+ *  3       2     sample count
+ *  5       4     tick of the first sample in ms
+ *  9       ...   bit stream, MSB first, zero padded to a byte
+ *
+ * First sample: 32 bit value (scaled integer or float bits), its tick is
+ * the header one. Every next sample:
+ *  time    zig-zag delta of delta of the tick
+ *          0             0
+ *          10   + 6      below 64
+ *          110  + 12     below 4096
+ *          1110 + 20     below 2^20
+ *          1111 + 32     anything else
+ *  value   integer series: zig-zag delta, same prefixes with 4, 8, 16 and
+ *          32 bit payloads
+ *          float series: XOR with the previous bits
+ *          0                     same value
+ *          10 + meaningful bits  inside the previous leading/trailing zeros
+ *          11 + 5 bit leading zeros + 5 bit length - 1 + meaningful bits
+ * A block is self contained, a lost block does not break the next one.
+ */
+
+/**
+ * @brief series encoder struct, fixed RAM per channel
+ */
+struct _series_t{
+	uint8_t 			 block[SERIES_BLOCK_SIZE];		// Block being built
+	uint16_t 			 bits;							// Bits used in block, header included
+	uint16_t 			 count;							// Samples in block
+	uint8_t 			 id;
+	uint8_t 			 decimals;						// SERIES_FLOAT or digits kept
+	float 				 scale;							// 10^decimals
+	uint32_t 			 last_tick;
+	int32_t 			 last_delta;					// Previous tick delta
+	uint32_t 			 last_value;					// Scaled integer or float bits
+	uint8_t 			 lead;							// XOR window of the previous float
+	uint8_t 			 trail;
+};
+typedef struct _series_t series_t;
+
+/**
+ * @brief series decoder struct, reads one block in place
+ */
+struct _series_reader_t{
+	const uint8_t 		*block;
+	uint16_t 			 len;							// Block bytes
+	uint16_t 			 bits;							// Bits read, header included
+	uint16_t 			 left;							// Samples still to read
+	uint8_t 			 id;
+	uint8_t 			 decimals;
+	float 				 scale;
+	uint8_t 			 first;							// Next sample is the first
+	uint32_t 			 last_tick;
+	int32_t 			 last_delta;
+	uint32_t 			 last_value;
+	uint8_t 			 lead;
+	uint8_t 			 trail;
+};
+typedef struct _series_reader_t series_reader_t;
+
+
+void 		series_init(series_t *se, uint8_t id, uint8_t decimals);
+uint8_t 	series_add(series_t *se, uint32_t tick, float value);
+uint16_t 	series_finish(series_t *se, const uint8_t **block);
+uint16_t 	series_count(const series_t *se);
+
+uint8_t 	series_open(series_reader_t *rd, const uint8_t *block, uint16_t len);
+uint8_t 	series_next(series_reader_t *rd, uint32_t *tick, float *value);
+
+
+#endif /* SERIES_H_ */
@@ -0,0 +1,60 @@
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include "stm32f4xx_hal.h"
+
+#define SPECTRUM_MIN_N 		256			// Smallest frame, real samples
+#define SPECTRUM_MAX_N 		2048		// Largest frame, sets the table size
+
+/*
+ * Work per frame size. The real FFT runs as an n/2 point complex FFT,
+ * radix-2^2 (radix-4 butterflies, bit reversed order) plus one radix-2
+ * stage when log2(n/2) is odd, then a split step that rebuilds the n/2
+ * real bins. On the board the PROF_MIC_SPECTRUM (n = 1024) and
+ * PROF_VIB_SPECTRUM (n = 256) probes report the cycles. The last column is spectrum_transform as measured by the host benchmark
+ * (host/bench/bench_spectrum, median of the scalar path in host TSC
+ * cycles). Use it to compare sizes and code versions; it is not a count
+ * of M4 cycles.
+ *
+ *  n      radix-4   radix-2   twiddle   frame + work   host
+ *         bfly      bfly      cmul      RAM            cycles
+ *  256    96        64        352       1 KB           10200
+ *  512    256       0         896       2 KB           22400
+ *  1024   512       256       1792      4 KB           48100
+ *  2048   1280      0         4352      8 KB           101300
+ *
+ * The 2048 entry cosine table (4 KB) lives in flash and serves every size.
+ */
+
+/**
+ * @brief spectrum engine struct
+ * spectrum_feed runs in the producer interrupt and fills frame[], a task
+ * calls spectrum_run once spectrum_ready reports a full frame. The frame
+ * is not touched by the interrupt again until spectrum_run releases it.
+ */
+struct _spectrum_t{
+	uint16_t 			 n;					// Real samples per frame, power of 2
+	uint8_t 			 log2n;
+	int16_t 			*frame;				// n samples, filled by spectrum_feed
+	int16_t 			*work;				// n values, re/im of bins 0..n/2-1
+	int8_t 				 shift;				// Left shift applied before the FFT
+	volatile uint16_t 	 fill;				// Samples in frame
+	volatile uint8_t 	 ready;				// 1 while a full frame waits
+	volatile uint32_t 	 lost;				// Samples dropped, reader too slow
+};
+typedef struct _spectrum_t spectrum_t;
+
+
+uint8_t 	spectrum_init(spectrum_t *sp, uint16_t n, int16_t *frame, int16_t *work);
+
+uint8_t 	spectrum_feed(spectrum_t *sp, const int16_t *x, uint16_t count, uint8_t stride);
+uint8_t 	spectrum_ready(const spectrum_t *sp);
+void 		spectrum_run(spectrum_t *sp);
+void 		spectrum_transform(spectrum_t *sp, const int16_t *x, uint8_t stride);
+
+uint16_t 	spectrum_bin(const spectrum_t *sp, uint32_t hz, uint32_t fs);
+float 		spectrum_band(const spectrum_t *sp, uint16_t first, uint16_t last);
+void 		spectrum_magnitude(const spectrum_t *sp, uint16_t *mag);
+
+
+#endif /* SPECTRUM_H_ */
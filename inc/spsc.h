@@ -0,0 +1,59 @@
+#ifndef SPSC_H_
+#define SPSC_H_
+
+#include "stm32f4xx_hal.h"
+
+/*
+ * Lock-free single producer / single consumer channel, typically one
+ * interrupt feeding one task. Items have a fixed size: 1 byte for a byte
+ * stream, sizeof(record) for records, sizeof(void *) for pointers.
+ *
+ * head and tail are free running item counters. Only the producer writes
+ * head and only the consumer writes tail, so no critical section is taken.
+ * The producer copies the items, issues a DMB and then publishes head; the
+ * consumer reads head, issues a DMB, copies, issues a DMB and then frees the
+ * slots through tail. The DMBs keep the compiler (and the bus, for DMA or a
+ * second master reading the buffer) from reordering data and index.
+ *
+ * Optional notify callback: called by the producer when a write makes the
+ * channel go from empty to not empty, ex:vTaskNotifyGiveFromISR. The
+ * consumer drains until empty before it waits again, so one notification
+ * per burst is enough.
+ */
+
+typedef void (*spsc_notify_t)(void *ctx);
+
+/**
+ * @brief channel struct
+ */
+struct _spsc_t{
+	uint8_t 			*buffer;				// size * item bytes
+	uint16_t 			 item;					// Bytes per item
+	uint16_t 			 size;					// Items, power of 2
+	volatile uint32_t 	 head;					// Items written (producer)
+	volatile uint32_t 	 tail;					// Items read (consumer)
+	spsc_notify_t 		 notify;				// May be NULL
+	void 				*ctx;
+	uint16_t 			 high_water;			// Most items ever waiting
+	uint32_t 			 dropped;				// Items refused, channel full
+};
+typedef struct _spsc_t spsc_t;
+
+
+uint8_t 	spsc_init(spsc_t *ch, void *buffer, uint16_t item, uint16_t size);
+void 		spsc_set_notify(spsc_t *ch, spsc_notify_t notify, void *ctx);
+
+/* Producer side */
+uint16_t 	spsc_write(spsc_t *ch, const void *items, uint16_t count);
+uint16_t 	spsc_space(const spsc_t *ch);
+uint8_t 	spsc_push_ptr(spsc_t *ch, void *ptr);
+
+/* Consumer side */
+uint16_t 	spsc_read(spsc_t *ch, void *items, uint16_t max);
+uint16_t 	spsc_peek(const spsc_t *ch, void **items);
+void 		spsc_consume(spsc_t *ch, uint16_t count);
+uint16_t 	spsc_count(const spsc_t *ch);
+void 		*spsc_pop_ptr(spsc_t *ch);
+
+
+#endif /* SPSC_H_ */
@@ -82,6 +82,12 @@
 #define DISCOVERY_I2Cx_EV_IRQn                  I2C1_EV_IRQn
 #define DISCOVERY_I2Cx_ER_IRQn                  I2C1_ER_IRQn
 
+/* I2C RX DMA, burst reads of the accelerometer FIFO */
+#define DISCOVERY_I2Cx_DMA_CLK_ENABLE()         __HAL_RCC_DMA1_CLK_ENABLE()
+#define DISCOVERY_I2Cx_RX_DMA_STREAM            DMA1_Stream0
+#define DISCOVERY_I2Cx_RX_DMA_CHANNEL           DMA_CHANNEL_1
+#define DISCOVERY_I2Cx_RX_DMA_IRQn              DMA1_Stream0_IRQn
+
 /* I2C speed and timeout max */
 #define I2Cx_TIMEOUT_MAX                        0xA000 /*<! The value of the maximal timeout for I2C waiting loops */
 #define I2Cx_MAX_COMMUNICATION_FREQ             ((uint32_t) 100000)
@@ -96,6 +102,16 @@
 #define DISCOVERY_SPIx_SCK_PIN                  GPIO_PIN_5                 /* PA.05 */
 #define DISCOVERY_SPIx_MISO_PIN                 GPIO_PIN_6                 /* PA.06 */
 #define DISCOVERY_SPIx_MOSI_PIN                 GPIO_PIN_7                 /* PA.07 */
+#define DISCOVERY_SPIx_IRQn                     SPI1_IRQn
+
+/* SPI DMA, burst reads of the gyroscope FIFO. DMA2 Stream0 belongs to the ADC */
+#define DISCOVERY_SPIx_DMA_CLK_ENABLE()         __HAL_RCC_DMA2_CLK_ENABLE()
+#define DISCOVERY_SPIx_RX_DMA_STREAM            DMA2_Stream2
+#define DISCOVERY_SPIx_RX_DMA_CHANNEL           DMA_CHANNEL_3
+#define DISCOVERY_SPIx_RX_DMA_IRQn              DMA2_Stream2_IRQn
+#define DISCOVERY_SPIx_TX_DMA_STREAM            DMA2_Stream3
+#define DISCOVERY_SPIx_TX_DMA_CHANNEL           DMA_CHANNEL_3
+#define DISCOVERY_SPIx_TX_DMA_IRQn              DMA2_Stream3_IRQn
 /* Maximum Timeout values for flags waiting loops. These timeouts are not based
    on accurate values, they just guarantee that the application will not remain
    stuck if the SPI communication is corrupted.
@@ -175,6 +191,8 @@
 
 #define DHT11_USART_PORT						GPIOA
 #define DHT11_USART_Tx_PIN						GPIO_PIN_15
+#define DHT11_TIM_CHANNEL						TIM_CHANNEL_1
+#define DHT11_TIM_AF							GPIO_AF1_TIM2
 
 
 
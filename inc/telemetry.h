@@ -0,0 +1,59 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "stm32f4xx_hal.h"
+
+/*
+ * Telemetry frame, version 1. Multi-byte fields are little endian.
+ *
+ *  offset  size  field
+ *  0       1     TELEMETRY_SYNC
+ *  1       1     TELEMETRY_VERSION
+ *  2       2     sequence number
+ *  4       4     tick of the first sample in ms
+ *  8       1     payload length N
+ *  9       1     sample count
+ *  10      N     samples
+ *  10+N    0..3  zero padding up to a multiple of 4 bytes
+ *  end-4   4     CRC-32 of every previous byte, fed to the STM32 CRC unit
+ *                as little endian words (poly 0x04C11DB7, init 0xFFFFFFFF,
+ *                no reflection, no final xor)
+ *
+ * Each sample is:
+ *  1 byte    sensor id
+ *  varint    ms since the previous sample of the frame (0 for the first)
+ *  varint    zig-zag of value*10 minus the previous value*10 of the same
+ *            sensor in this frame (the absolute value the first time)
+ * Frames are self contained, a lost frame does not break the next one.
+ */
+
+#define TELEMETRY_SYNC 			0xA5
+#define TELEMETRY_VERSION 		1
+#define TELEMETRY_HEADER_SIZE 	10
+#define TELEMETRY_FRAME_SIZE 	128			// Header + payload + padding + CRC
+#define TELEMETRY_SENSORS 		32			// Sensor ids 0..31
+#define TELEMETRY_SAMPLE_MAX 	11			// id + two 5 byte varints
+
+/**
+ * @brief telemetry frame builder struct
+ */
+struct _telemetry_t{
+	CRC_HandleTypeDef 	*hcrc;								// CRC unit ex:&hcrc
+	uint32_t 			 frame[TELEMETRY_FRAME_SIZE / 4];	// Frame being built, word aligned
+	uint8_t 			 len;								// Bytes used in frame
+	uint8_t 			 count;								// Samples in frame
+	uint16_t 			 sequence;							// Sequence of the next frame
+	uint32_t 			 last_tick;							// Tick of the previous sample
+	int32_t 			 last_value[TELEMETRY_SENSORS];		// Previous value*10 per sensor
+	uint32_t 			 seen;								// Sensors already in the frame
+};
+typedef struct _telemetry_t telemetry_t;
+
+
+void 		telemetry_init(telemetry_t *tm, CRC_HandleTypeDef *hcrc);
+uint8_t 	telemetry_add(telemetry_t *tm, uint8_t sensor, uint32_t tick, float value);
+uint16_t 	telemetry_finish(telemetry_t *tm, const uint8_t **frame);
+uint8_t 	telemetry_count(const telemetry_t *tm);
+
+
+#endif /* TELEMETRY_H_ */
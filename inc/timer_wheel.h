@@ -0,0 +1,75 @@
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include "stm32f4xx_hal.h"
+
+#define TIMER_WHEEL_LEVELS 		4
+#define TIMER_WHEEL_BITS 		5							// Slots per level = 2^bits
+#define TIMER_WHEEL_SLOTS 		(1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_RANGE 		(1u << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))	// Ticks, longer delays cascade again
+#define TIMER_WHEEL_IDLE 		0xFFFFFFFFu					// timer_wheel_next with no timer
+
+/*
+ * Hierarchical timing wheel. Level 0 has one slot per tick, level L one slot
+ * per 32^L ticks. A timer goes to the lowest level whose span covers its
+ * delay; each time level 0 wraps, the next slot of level 1 is moved down
+ * (and so on up), so every timer is touched at most once per level.
+ * A delay beyond TIMER_WHEEL_RANGE sits in the farthest top slot and is
+ * placed again when it comes down.
+ *
+ * Start and stop are O(1). Each timer_wheel_expire call does one step of
+ * bounded work: it returns one expired timer, moves one timer of a slot
+ * coming down, or advances one tick (up to the next wrap of level 0 when
+ * it is empty) and returns the first timer due there. A slot of K
+ * timers cascading, or a catch up over many ticks, takes more calls, not
+ * a longer one; the work of a tick still grows with the timers it moves.
+ *
+ * The wheel is not locked: the owner serialises start, stop and expire (the
+ * service task runs each expire call in a critical section and the
+ * callback outside of it).
+ */
+
+typedef void (*wheel_timer_cb_t)(void *arg);
+
+/**
+ * @brief one timer, owned by the caller, no allocation
+ */
+struct _wheel_timer_t{
+	struct _wheel_timer_t 	*next;
+	struct _wheel_timer_t 	**prev_next;			// Link pointing to this timer, NULL if stopped
+	uint32_t 				 expires;				// Tick
+	uint32_t 				 period;				// Ticks, 0 for one shot
+	uint8_t 				 level;					// Slot holding the timer
+	uint8_t 				 slot;
+	wheel_timer_cb_t 		 callback;				// Called by the owner of the wheel
+	void 					*arg;
+};
+typedef struct _wheel_timer_t wheel_timer_t;
+
+#define WHEEL_TIMER_INIT(cb, a) 	{ .callback = (cb), .arg = (a) }
+
+/**
+ * @brief timing wheel struct
+ */
+struct _timer_wheel_t{
+	wheel_timer_t 		*slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	uint32_t 			 bitmap[TIMER_WHEEL_LEVELS];	// Non empty slots
+	wheel_timer_t 		*due;							// Expired at now, not yet returned
+	wheel_timer_t 		*cascade[TIMER_WHEEL_LEVELS];	// Slots coming down, one timer per call
+	uint8_t 			 collect;						// Level 0 slot of now not taken yet
+	uint32_t 			 now;							// Last tick processed
+	uint16_t 			 count;							// Running timers
+	uint16_t 			 high_water;
+};
+typedef struct _timer_wheel_t timer_wheel_t;
+
+
+void 			timer_wheel_init(timer_wheel_t *tw, uint32_t now);
+void 			timer_wheel_start(timer_wheel_t *tw, wheel_timer_t *timer, uint32_t now, uint32_t delay, uint32_t period);
+void 			timer_wheel_stop(timer_wheel_t *tw, wheel_timer_t *timer);
+uint8_t 		timer_wheel_active(const wheel_timer_t *timer);
+uint8_t 		timer_wheel_expire(timer_wheel_t *tw, uint32_t now, wheel_timer_t **expired);
+uint32_t 		timer_wheel_next(const timer_wheel_t *tw);
+
+
+#endif /* TIMER_WHEEL_H_ */
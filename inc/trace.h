@@ -0,0 +1,107 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "stm32f4xx_hal.h"
+
+/*
+ * RTOS event recorder. The FreeRTOS trace macros (below, included from
+ * FreeRTOSConfig.h) and the interrupt hooks of prof.h append 8 byte events
+ * to a RAM ring: DWT cycle counter, type, id and one argument. Appending is
+ * a few loads and stores with interrupts masked, so events keep the order
+ * of their timestamps even across nested interrupts.
+ *
+ * The ring is a flight recorder: it keeps the last TRACE_EVENTS events and
+ * counts the overwritten ones. trace_dump stops recording, sends the ring
+ * over the UART in binary and starts again with an empty ring:
+ *
+ *  header 	"TRC1", cpu hz, tick hz, events, lost				uint32 each
+ *  		tasks, probes 										uint8 each
+ *  		tasks * (number uint8, name configMAX_TASK_NAME_LEN bytes)
+ *  		probes * (name, NUL terminated)
+ *  events 	events * trace_event_t, oldest first, little endian
+ *
+ * Ids: tasks by their TCB number (the "tasks" table), queues, mutexes and
+ * semaphores by the number given at creation, interrupts by their exception
+ * number (IPSR) with the prof probe as argument of the exit. The cycle
+ * counter stops in sleep: TRACE_SLEEP and TRACE_WAKE carry the low 16 bits
+ * of the tick count so the host can put the slept time back.
+ */
+
+/* Set to 0 to compile every hook out */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 		1
+#endif
+
+/* Events kept, power of 2 */
+#define TRACE_EVENTS 		512
+
+/* Event types */
+#define TRACE_TASK_IN 			0		// id task
+#define TRACE_TASK_READY 		1		// id task
+#define TRACE_TASK_DELAY 		2		// id task
+#define TRACE_QUEUE_SEND 		3		// id queue, arg items waiting
+#define TRACE_QUEUE_RECEIVE 	4		// id queue, arg items waiting
+#define TRACE_QUEUE_BLOCK_SEND 	5		// id queue, arg items waiting
+#define TRACE_QUEUE_BLOCK_RECV 	6		// id queue, arg items waiting
+#define TRACE_QUEUE_FAILED 		7		// id queue, arg items waiting
+#define TRACE_NOTIFY_BLOCK 		8		// id task
+#define TRACE_NOTIFY_GIVE 		9		// id task notified
+#define TRACE_ISR_ENTER 		10		// id exception number
+#define TRACE_ISR_EXIT 			11		// id exception number, arg prof probe
+#define TRACE_SLEEP 			12		// arg tick count
+#define TRACE_WAKE 				13		// arg tick count
+
+/**
+ * @brief one event, 8 bytes
+ */
+struct _trace_event_t{
+	uint32_t 	time;					// DWT->CYCCNT
+	uint8_t 	type;					// TRACE_TASK_IN...
+	uint8_t 	id;
+	uint16_t 	arg;
+};
+typedef struct _trace_event_t trace_event_t;
+
+
+void 		trace_start(void);
+void 		trace_stop(void);
+void 		trace_record(uint8_t type, uint8_t id, uint16_t arg);
+uint8_t 	trace_queue_number(void);
+void 		trace_dump(UART_HandleTypeDef *huart);
+
+#if TRACE_ENABLED
+/* Interrupt handler hooks, used through PROF_ISR_ENTER / PROF_ISR_EXIT */
+#define TRACE_ISR_BEGIN() 		trace_record(TRACE_ISR_ENTER, __get_IPSR(), 0)
+#define TRACE_ISR_END(probe) 	trace_record(TRACE_ISR_EXIT, __get_IPSR(), (probe))
+
+/* Kernel hooks, expanded inside tasks.c and queue.c */
+#define traceTASK_SWITCHED_IN() 				trace_record(TRACE_TASK_IN, pxCurrentTCB->uxTCBNumber, 0)
+#define traceMOVED_TASK_TO_READY_STATE(tcb) 	trace_record(TRACE_TASK_READY, (tcb)->uxTCBNumber, 0)
+#define traceTASK_DELAY() 						trace_record(TRACE_TASK_DELAY, pxCurrentTCB->uxTCBNumber, 0)
+#define traceTASK_DELAY_UNTIL(wake) 			trace_record(TRACE_TASK_DELAY, pxCurrentTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_TAKE_BLOCK() 			trace_record(TRACE_NOTIFY_BLOCK, pxCurrentTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_WAIT_BLOCK() 			trace_record(TRACE_NOTIFY_BLOCK, pxCurrentTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY() 						trace_record(TRACE_NOTIFY_GIVE, pxTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_FROM_ISR() 			trace_record(TRACE_NOTIFY_GIVE, pxTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR() 		trace_record(TRACE_NOTIFY_GIVE, pxTCB->uxTCBNumber, 0)
+#define traceLOW_POWER_IDLE_BEGIN() 			trace_record(TRACE_SLEEP, 0, (uint16_t)xTickCount)
+#define traceLOW_POWER_IDLE_END() 				trace_record(TRACE_WAKE, 0, (uint16_t)xTickCount)
+
+#define traceQUEUE_CREATE(q) 					((q)->uxQueueNumber = trace_queue_number())
+#define TRACE_QUEUE(type, q) 					trace_record((type), (q)->uxQueueNumber, (q)->uxMessagesWaiting)
+#define traceQUEUE_SEND(q) 						TRACE_QUEUE(TRACE_QUEUE_SEND, q)
+#define traceQUEUE_SEND_FROM_ISR(q) 			TRACE_QUEUE(TRACE_QUEUE_SEND, q)
+#define traceQUEUE_RECEIVE(q) 					TRACE_QUEUE(TRACE_QUEUE_RECEIVE, q)
+#define traceQUEUE_RECEIVE_FROM_ISR(q) 			TRACE_QUEUE(TRACE_QUEUE_RECEIVE, q)
+#define traceBLOCKING_ON_QUEUE_SEND(q) 			TRACE_QUEUE(TRACE_QUEUE_BLOCK_SEND, q)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(q) 		TRACE_QUEUE(TRACE_QUEUE_BLOCK_RECV, q)
+#define traceQUEUE_SEND_FAILED(q) 				TRACE_QUEUE(TRACE_QUEUE_FAILED, q)
+#define traceQUEUE_SEND_FROM_ISR_FAILED(q) 		TRACE_QUEUE(TRACE_QUEUE_FAILED, q)
+#define traceQUEUE_RECEIVE_FAILED(q) 			TRACE_QUEUE(TRACE_QUEUE_FAILED, q)
+#else
+#define TRACE_ISR_BEGIN()
+#define TRACE_ISR_END(probe)
+#endif
+
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,48 @@
+#ifndef UART_RX_H_
+#define UART_RX_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Called from the interrupt that found new bytes in the ring */
+typedef void (*uart_rx_notify_t)(void *ctx);
+
+/**
+ * @brief UART circular DMA receive struct
+ * The DMA writes the buffer continuously. Only the ISR moves head (from the
+ * DMA counter) and the consumer moves tail, so no critical section is
+ * needed to read data. On an overrun the ISR also moves tail, to the
+ * oldest byte the DMA did not overwrite, and uart_rx_consume releases with
+ * LDREX/STREX so it does not undo that.
+ */
+struct _uart_rx_t{
+	UART_HandleTypeDef	*huart;			// UART with DMA Rx ex:&huart2
+	uint8_t				*buffer;		// DMA destination buffer
+	uint16_t			 size;			// Buffer size in bytes
+	volatile uint16_t	 head;			// Write index (ISR)
+	volatile uint16_t	 tail;			// Read index (consumer)
+	volatile uint32_t	 frames;		// Frames ended by idle line
+	uint32_t			 frames_read;	// Frames already reported
+	volatile uint32_t	 overruns;		// Unread data overwritten by DMA
+	uart_rx_notify_t	 notify;		// New data callback, may be NULL
+	void 				*ctx;			// Passed to notify
+};
+typedef struct _uart_rx_t uart_rx_t;
+
+
+HAL_StatusTypeDef	uart_rx_start(uart_rx_t 		 *rx,
+								  UART_HandleTypeDef *huart,
+								  uint8_t 			 *buffer,
+								  uint16_t 			  size);
+
+HAL_StatusTypeDef	uart_rx_restart(uart_rx_t *rx);
+void 		uart_rx_set_notify(uart_rx_t *rx, uart_rx_notify_t notify, void *ctx);
+void 		uart_rx_update(uart_rx_t *rx);
+void 		uart_rx_irq_handler(uart_rx_t *rx);
+
+uint16_t 	uart_rx_available(const uart_rx_t *rx);
+uint16_t 	uart_rx_peek(const uart_rx_t *rx, const uint8_t **data);
+void 		uart_rx_consume(uart_rx_t *rx, uint16_t len);
+uint8_t 	uart_rx_frame_ready(uart_rx_t *rx);
+
+
+#endif /* UART_RX_H_ */
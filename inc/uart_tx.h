@@ -0,0 +1,45 @@
+#ifndef UART_TX_H_
+#define UART_TX_H_
+
+#include "stm32f4xx_hal.h"
+
+#define UART_TX_QUEUE_SIZE 		8			// Descriptors, one slot is kept free
+
+/* Called from the UART interrupt once the buffer may be reused */
+typedef void (*uart_tx_done_t)(const uint8_t *data);
+
+/**
+ * @brief transmit descriptor, the buffer is not copied
+ */
+struct _uart_tx_desc_t{
+	const uint8_t 	*data;					// Buffer in flash or owned until done
+	uint16_t 		 len;
+	uart_tx_done_t 	 done;					// May be NULL
+};
+typedef struct _uart_tx_desc_t uart_tx_desc_t;
+
+/**
+ * @brief UART DMA transmit queue struct
+ * Tasks only move head and the transmit complete interrupt only moves
+ * tail, so enqueueing never disables interrupts.
+ */
+struct _uart_tx_t{
+	UART_HandleTypeDef 	*huart;						// UART with DMA Tx ex:&huart2
+	uart_tx_desc_t 		 queue[UART_TX_QUEUE_SIZE];
+	volatile uint8_t 	 head;						// Next free slot (task)
+	volatile uint8_t 	 tail;						// Slot being sent (ISR)
+	volatile uint8_t 	 busy;						// DMA transfer running
+	uint8_t 			 high_water;				// Most descriptors ever queued
+	uint32_t 			 rejected;					// Sends refused with a full queue
+	uint32_t 			 failed;					// Transfers the HAL refused to start
+};
+typedef struct _uart_tx_t uart_tx_t;
+
+
+void 		uart_tx_init(uart_tx_t *tx, UART_HandleTypeDef *huart);
+uint8_t 	uart_tx_send(uart_tx_t *tx, const uint8_t *data, uint16_t len, uart_tx_done_t done);
+uint8_t 	uart_tx_free(const uart_tx_t *tx);
+void 		uart_tx_complete_isr(uart_tx_t *tx);
+
+
+#endif /* UART_TX_H_ */
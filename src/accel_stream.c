@@ -0,0 +1,132 @@
+#include "accel_stream.h"
+
+static void accel_stream_start(accel_stream_t *as, uint32_t tick)
+{
+	accel_block_t *block = &as->blocks[as->head];
+
+	block->tick  = tick;
+	block->count = as->watermark;
+	as->busy 	 = 1;
+	as->pending  = 0;
+	as->transfers++;
+	if(!as->read((uint8_t *)block->xyz, as->watermark)){
+		as->busy = 0;
+		as->lost++;
+	}
+}
+
+/**
+ * @brief configure FIFO streaming
+ * @param as:			struct to configure ex:&accel
+ * @param read:			starts the burst read ex:LSM303DLHC_AccFifoRead_DMA
+ * @param watermark:	FIFO level of the watermark interrupt, up to ACCEL_BLOCK_SAMPLES
+ */
+void accel_stream_init(accel_stream_t *as, accel_read_t read, uint8_t watermark)
+{
+	as->read 	  = read;
+	as->watermark = watermark > ACCEL_BLOCK_SAMPLES ? ACCEL_BLOCK_SAMPLES : watermark;
+	as->head 	  = 0;
+	as->tail 	  = 0;
+	as->busy 	  = 0;
+	as->pending   = 0;
+	as->transfers = 0;
+	as->samples   = 0;
+	as->lost 	  = 0;
+}
+
+/**
+ * @brief watermark reached, call from the sensor interrupt line handler
+ * @param as:	stream struct
+ * @param tick:	current tick, stamps the newest sample of the block
+ */
+void accel_stream_watermark(accel_stream_t *as, uint32_t tick)
+{
+	if(as->busy){
+		as->pending = 1;
+		return;
+	}
+	accel_stream_start(as, tick);
+}
+
+/**
+ * @brief burst read finished, call from the transfer complete callback
+ * @note  the FIFO keeps the watermark line high while a full block is
+ * 		  still stored, without a new edge, so pass its level in more
+ * @param as:	stream struct
+ * @param tick:	current tick, stamps the next block if one is started
+ * @param more:	1 if the watermark line is still active
+ */
+void accel_stream_done(accel_stream_t *as, uint32_t tick, uint8_t more)
+{
+	uint8_t next = (as->head + 1) % ACCEL_STREAM_BLOCKS;
+
+	as->busy = 0;
+	as->samples += as->blocks[as->head].count;
+	//with the ring full the block is read anyway to free the FIFO, then dropped
+	if(next == as->tail){
+		as->lost++;
+	}
+	else{
+		as->head = next;
+	}
+	if(more || as->pending){
+		accel_stream_start(as, tick);
+	}
+}
+
+/**
+ * @brief burst read failed, call from the bus error callback
+ * @param as:	stream struct
+ */
+void accel_stream_error(accel_stream_t *as)
+{
+	as->busy = 0;
+	as->lost++;
+}
+
+/**
+ * @brief takes the bus between two burst reads, so a task can talk to
+ * 		  another device on it. Call inside a critical section
+ * @note  a watermark seen meanwhile is kept pending until the release
+ * @param as:	stream struct
+ * @return 1 if taken, 0 if a transfer is running
+ */
+uint8_t accel_stream_claim(accel_stream_t *as)
+{
+	if(as->busy){
+		return 0;
+	}
+	as->busy = 1;
+	return 1;
+}
+
+/**
+ * @brief gives back the bus taken with accel_stream_claim and starts the
+ * 		  block whose watermark arrived meanwhile. Call inside a critical
+ * 		  section
+ * @param as:	stream struct
+ * @param tick:	current tick, stamps the block if one is started
+ */
+void accel_stream_release(accel_stream_t *as, uint32_t tick)
+{
+	as->busy = 0;
+	if(as->pending){
+		accel_stream_start(as, tick);
+	}
+}
+
+/**
+ * @brief takes the oldest block, call from a task (never from an ISR)
+ * @param as:		stream struct
+ * @param block:	copy of the block
+ * @return 1 if there was a block, 0 otherwise
+ */
+uint8_t accel_stream_read(accel_stream_t *as, accel_block_t *block)
+{
+	if(as->tail == as->head){
+		return 0;
+	}
+	*block 	 = as->blocks[as->tail];
+	as->tail = (as->tail + 1) % ACCEL_STREAM_BLOCKS;
+	return 1;
+}
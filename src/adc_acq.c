@@ -0,0 +1,95 @@
+#include "adc_acq.h"
+
+/* Filter weight: filtered += (new - filtered) / 2^ADC_ACQ_FILTER_SHIFT */
+#define ADC_ACQ_FILTER_SHIFT 	2
+
+/**
+ * @brief start DMA acquisition, conversions are paced by the ADC trigger
+ * @param acq:	struct to configure ex:&adc_acq
+ * @param hadc:	ADC configured in scan mode with ADC_ACQ_CHANNELS ranks and
+ * 				a circular DMA stream ex:&hadc1
+ * @return HAL status of HAL_ADC_Start_DMA
+ */
+HAL_StatusTypeDef adc_acq_start(adc_acq_t *acq, ADC_HandleTypeDef *hadc)
+{
+	acq->hadc 		  = hadc;
+	acq->primed 	  = 0;
+	acq->window_start = HAL_GetTick();
+	for(int i = 0; i < ADC_ACQ_CHANNELS; i++){
+		acq->filtered[i] = 0;
+		acq->count[i] 	 = 0;
+		acq->rate[i] 	 = 0;
+	}
+	return HAL_ADC_Start_DMA(hadc, (uint32_t *)acq->buffer, 2 * ADC_ACQ_HALF);
+}
+
+/**
+ * @brief consumes one finished half of the DMA buffer
+ * @note  call from the DMA half/full complete callbacks, the DMA is
+ * 		  writing the other half meanwhile
+ * @param acq:	acquisition struct
+ * @param half:	first sample of the finished half
+ * @param tick:	current tick in ms, used for the samples/s window
+ */
+void adc_acq_process(adc_acq_t *acq, const uint16_t *half, uint32_t tick)
+{
+	uint32_t sum[ADC_ACQ_CHANNELS] = {0};
+	uint32_t value;
+
+	for(int s = 0; s < ADC_ACQ_SCANS; s++){
+		for(int ch = 0; ch < ADC_ACQ_CHANNELS; ch++){
+			sum[ch] += half[s * ADC_ACQ_CHANNELS + ch];
+		}
+	}
+
+	for(int ch = 0; ch < ADC_ACQ_CHANNELS; ch++){
+		//block average in raw counts << 4
+		value = (sum[ch] << 4) / ADC_ACQ_SCANS;
+		if(acq->primed){
+			value = acq->filtered[ch] + (int32_t)(value - acq->filtered[ch]) / (1 << ADC_ACQ_FILTER_SHIFT);
+		}
+		acq->filtered[ch] = value;
+		acq->count[ch] 	 += ADC_ACQ_SCANS;
+	}
+	acq->primed = 1;
+
+	if(tick - acq->window_start >= 1000){
+		for(int ch = 0; ch < ADC_ACQ_CHANNELS; ch++){
+			acq->rate[ch]  = acq->count[ch] * 1000 / (tick - acq->window_start);
+			acq->count[ch] = 0;
+		}
+		acq->window_start = tick;
+	}
+}
+
+/**
+ * @brief latest filtered value of a channel, never blocks
+ * @param acq:		acquisition struct
+ * @param channel:	rank of the channel in the scan, starting at 0
+ * @return value in raw ADC counts
+ */
+uint16_t adc_acq_get(const adc_acq_t *acq, uint8_t channel)
+{
+	return (uint16_t)((acq->filtered[channel] + 8) >> 4);
+}
+
+/**
+ * @brief like adc_acq_get, keeping the 4 fraction bits of the filter
+ * @param acq:		acquisition struct
+ * @param channel:	rank of the channel in the scan, starting at 0
+ * @return value in raw ADC counts * 16
+ */
+uint32_t adc_acq_get_fine(const adc_acq_t *acq, uint8_t channel)
+{
+	return acq->filtered[channel];
+}
+
+/**
+ * @brief samples per second measured on a channel during the last second
+ * @param acq:		acquisition struct
+ * @param channel:	rank of the channel in the scan, starting at 0
+ */
+uint32_t adc_acq_rate(const adc_acq_t *acq, uint8_t channel)
+{
+	return acq->rate[channel];
+}
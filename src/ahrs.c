@@ -0,0 +1,214 @@
+#include "ahrs.h"
+
+#define AHRS_PI 		3.14159265f
+#define AHRS_RAD2DEG 	57.2957795f
+
+/**
+ * @brief 1 / sqrt(x) in 6 multiply-adds, VSQRT plus VDIV take 28 cycles
+ * @note  magic constant and single Newton step from Moroz et al., relative
+ * 		  error below 6.5e-4
+ */
+float ahrs_inv_sqrt(float x)
+{
+	union { float f; uint32_t u; } v = { .f = x };
+	float y;
+
+	v.u = 0x5F1FFFF9u - (v.u >> 1);
+	y 	= v.f;
+	return 0.703952253f * y * (2.38924456f - x * y * y);
+}
+
+/**
+ * @brief atan2 without libm, in rad
+ * @note  odd minimax polynomial on [0, 1] plus octant folding, error below
+ * 		  1e-5 rad
+ */
+float ahrs_atan2(float y, float x)
+{
+	float ax = x < 0.0f ? -x : x;
+	float ay = y < 0.0f ? -y : y;
+	float a, s, r;
+
+	if(ax == 0.0f && ay == 0.0f){
+		return 0.0f;
+	}
+	a = ax > ay ? ay / ax : ax / ay;
+	s = a * a;
+	r = ((((((-0.0117212f * s + 0.05265332f) * s - 0.11643287f) * s + 0.19354346f) * s
+		   - 0.33262347f) * s + 0.99997726f) * a);
+	if(ay > ax){
+		r = 0.5f * AHRS_PI - r;
+	}
+	if(x < 0.0f){
+		r = AHRS_PI - r;
+	}
+	return y < 0.0f ? -r : r;
+}
+
+static uint8_t ahrs_normalize(float *v, float x, float y, float z)
+{
+	float n = x * x + y * y + z * z;
+
+	if(n == 0.0f){
+		return 0;
+	}
+	n 	 = ahrs_inv_sqrt(n);
+	v[0] = x * n;
+	v[1] = y * n;
+	v[2] = z * n;
+	return 1;
+}
+
+/**
+ * @brief configure the estimator, level and facing north
+ * @param ah:	struct to configure ex:&ahrs
+ * @param rate:	gyro sample rate in Hz ex:760
+ * @param kp:	proportional gain, how fast the references correct the
+ * 				gyro, in 1/s ex:1.0
+ * @param ki:	integral gain, gyro bias tracking, in 1/s^2 ex:0.02, 0 to
+ * 				turn it off
+ */
+void ahrs_init(ahrs_t *ah, float rate, float kp, float ki)
+{
+	ah->q[0] 	= 1.0f;
+	ah->q[1] 	= 0.0f;
+	ah->q[2] 	= 0.0f;
+	ah->q[3] 	= 0.0f;
+	for(int i = 0; i < 3; i++){
+		ah->bias[i] = 0.0f;
+		ah->acc[i] 	= 0.0f;
+		ah->mag[i] 	= 0.0f;
+	}
+	ah->has_acc = 0;
+	ah->has_mag = 0;
+	ah->dt 		= 1.0f / rate;
+	ah->kp 		= kp;
+	ah->ki 		= ki;
+	ah->boot 	= (uint32_t)(rate * AHRS_BOOT_SECONDS);
+	ah->updates = 0;
+}
+
+/**
+ * @brief new gravity reference, accelerometer reading in the board frame
+ * @return 1 if accepted, 0 for a null vector
+ */
+uint8_t ahrs_set_acc(ahrs_t *ah, float x, float y, float z)
+{
+	ah->has_acc = ahrs_normalize(ah->acc, x, y, z);
+	return ah->has_acc;
+}
+
+/**
+ * @brief new magnetic field reference, magnetometer reading in the board
+ * 		  frame with the hard iron offset already removed
+ * @return 1 if accepted, 0 for a null vector
+ */
+uint8_t ahrs_set_mag(ahrs_t *ah, float x, float y, float z)
+{
+	ah->has_mag = ahrs_normalize(ah->mag, x, y, z);
+	return ah->has_mag;
+}
+
+/**
+ * @brief one gyro sample, call at the rate given to ahrs_init
+ * @param ah:	estimator
+ * @param gx:	angular rate around X in rad/s (gy, gz likewise)
+ */
+void ahrs_update(ahrs_t *ah, float gx, float gy, float gz)
+{
+	float q0 = ah->q[0], q1 = ah->q[1], q2 = ah->q[2], q3 = ah->q[3];
+	float q0q0 = q0 * q0, q0q1 = q0 * q1, q0q2 = q0 * q2, q0q3 = q0 * q3;
+	float q1q1 = q1 * q1, q1q2 = q1 * q2, q1q3 = q1 * q3;
+	float q2q2 = q2 * q2, q2q3 = q2 * q3, q3q3 = q3 * q3;
+	float ex = 0.0f, ey = 0.0f, ez = 0.0f;
+	float vx, vy, vz, wx, wy, wz, hx, hy, bx, bz, n, kp;
+	const float *a = ah->acc;
+	const float *m = ah->mag;
+
+	if(ah->has_acc){
+		/* Gravity as the current estimate sees it, halved */
+		vx = q1q3 - q0q2;
+		vy = q0q1 + q2q3;
+		vz = q0q0 - 0.5f + q3q3;
+		ex = a[1] * vz - a[2] * vy;
+		ey = a[2] * vx - a[0] * vz;
+		ez = a[0] * vy - a[1] * vx;
+
+		if(ah->has_mag){
+			/* Field in the earth frame, its horizontal part folded onto X */
+			hx = 2.0f * (m[0] * (0.5f - q2q2 - q3q3) + m[1] * (q1q2 - q0q3) + m[2] * (q1q3 + q0q2));
+			hy = 2.0f * (m[0] * (q1q2 + q0q3) + m[1] * (0.5f - q1q1 - q3q3) + m[2] * (q2q3 - q0q1));
+			n  = hx * hx + hy * hy;
+			bx = n * ahrs_inv_sqrt(n);
+			bz = 2.0f * (m[0] * (q1q3 - q0q2) + m[1] * (q2q3 + q0q1) + m[2] * (0.5f - q1q1 - q2q2));
+
+			/* And back to the board frame, halved */
+			wx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+			wy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+			wz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+			ex += m[1] * wz - m[2] * wy;
+			ey += m[2] * wx - m[0] * wz;
+			ez += m[0] * wy - m[1] * wx;
+		}
+
+		/* PI correction, e holds half the error so the gains are doubled */
+		if(ah->ki > 0.0f){
+			ah->bias[0] += 2.0f * ah->ki * ex * ah->dt;
+			ah->bias[1] += 2.0f * ah->ki * ey * ah->dt;
+			ah->bias[2] += 2.0f * ah->ki * ez * ah->dt;
+		}
+		kp  = ah->boot > 0 ? AHRS_BOOT_KP : ah->kp;
+		gx += 2.0f * kp * ex + ah->bias[0];
+		gy += 2.0f * kp * ey + ah->bias[1];
+		gz += 2.0f * kp * ez + ah->bias[2];
+	}
+	if(ah->boot > 0){
+		ah->boot--;
+	}
+
+	/* q' = q * (0, g) / 2 */
+	gx *= 0.5f * ah->dt;
+	gy *= 0.5f * ah->dt;
+	gz *= 0.5f * ah->dt;
+	q0 += -ah->q[1] * gx - ah->q[2] * gy - ah->q[3] * gz;
+	q1 +=  ah->q[0] * gx + ah->q[2] * gz - ah->q[3] * gy;
+	q2 +=  ah->q[0] * gy - ah->q[1] * gz + ah->q[3] * gx;
+	q3 +=  ah->q[0] * gz + ah->q[1] * gy - ah->q[2] * gx;
+
+	n 		 = ahrs_inv_sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	ah->q[0] = q0 * n;
+	ah->q[1] = q1 * n;
+	ah->q[2] = q2 * n;
+	ah->q[3] = q3 * n;
+	ah->updates++;
+}
+
+/**
+ * @brief angle between the board Z axis and the vertical
+ * @return degrees, 0 to 180
+ */
+float ahrs_tilt(const ahrs_t *ah)
+{
+	const float *q = ah->q;
+	float xy = q[1] * q[1] + q[2] * q[2];
+	float wz = q[0] * q[0] + q[3] * q[3];
+	float s  = 4.0f * xy * wz;
+
+	//sin = 2 sqrt(xy wz), cos = wz - xy, both scale with |q|^2
+	return ahrs_atan2(s * ahrs_inv_sqrt(s + 1e-30f), wz - xy) * AHRS_RAD2DEG;
+}
+
+/**
+ * @brief compass heading of the board X axis, clockwise from magnetic north
+ * @return degrees, 0 to 360
+ */
+float ahrs_heading(const ahrs_t *ah)
+{
+	const float *q = ah->q;
+	float yaw = ahrs_atan2(2.0f * (q[0] * q[3] + q[1] * q[2]),
+						   q[0] * q[0] + q[1] * q[1] - q[2] * q[2] - q[3] * q[3]);
+
+	//yaw turns from X (north) towards Y (west)
+	yaw = -yaw * AHRS_RAD2DEG;
+	return yaw < 0.0f ? yaw + 360.0f : yaw;
+}
@@ -0,0 +1,569 @@
+/* Includes ------------------------------------------------------------------*/
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "rtos_static.h"
+#include "timer_wheel.h"
+#include "bsp.h"
+#include "telemetry.h"
+#include "metrics.h"
+#include "series.h"
+#include "prof.h"
+#include "trace.h"
+#include "app.h"
+
+/* Periodos de las tareas en ms */
+#define DHT11_POLL 				10			// Sondeo de una lectura del DHT11 en curso
+#define LED_PERIOD 				50			// Parpadeo del LED azul
+#define BUTTON_POLL 			50			// Lectura del boton
+#define BUTTON_REPEAT 			200			// Cambio del LED verde con el boton apretado
+#define TELEMETRY_FLUSH 		1000		// Envio de una trama cada 1 s
+#define METRICS_PERIOD 			1000		// Muestra de la carga cada 1 s, trama cada METRICS_WINDOW
+#define HISTORY_FLUSH 			600000		// Bloques incompletos al registro cada 10 min
+
+/* El plazo mas cercano de dos */
+#define APP_MIN(a, b) 			((a) < (b) ? (a) : (b))
+
+/* Prioridades: el muestreo no debe esperar a nadie salvo a los temporizadores,
+   cuyas acciones son cortas */
+#define TIMER_TASK_PRIO 		(tskIDLE_PRIORITY + 4)
+#define SENSOR_TASK_PRIO 		(tskIDLE_PRIORITY + 3)
+#define TELEMETRY_TASK_PRIO 	(tskIDLE_PRIORITY + 2)
+#define UI_TASK_PRIO 			(tskIDLE_PRIORITY + 1)
+
+/* Pilas en palabras */
+#define TIMER_TASK_STACK 		configMINIMAL_STACK_SIZE
+#define SENSOR_TASK_STACK 		(configMINIMAL_STACK_SIZE * 2)
+#define TELEMETRY_TASK_STACK 	(configMINIMAL_STACK_SIZE * 2)
+#define UI_TASK_STACK 			(configMINIMAL_STACK_SIZE * 2)	// Volcados por consola
+
+#define SAMPLE_QUEUE_LEN 		24
+#define CONSOLE_BATCH 			8			// Comandos de consola leidos de una vez
+
+/* Objetos del sistema operativo, estaticos o del heap segun RTOS_STATIC */
+#define APP_OBJECTS(TASK, QUEUE, MUTEX, SEMAPHORE, TIMER) \
+	TASK(timer, APP_TimerTask, TIMER_TASK_STACK, TIMER_TASK_PRIO) \
+	TASK(sensor, APP_SensorTask, SENSOR_TASK_STACK, SENSOR_TASK_PRIO) \
+	TASK(telemetry, APP_TelemetryTask, TELEMETRY_TASK_STACK, TELEMETRY_TASK_PRIO) \
+	TASK(ui, APP_UITask, UI_TASK_STACK, UI_TASK_PRIO) \
+	QUEUE(sample, SAMPLE_QUEUE_LEN, sizeof(Sample_TypeDef))
+
+/* Periodo de muestreo de cada sensor en ms. En 0 los que llegan por su
+   cuenta: el microfono publica una muestra por ventana */
+static const uint16_t sensor_period[SENSORn] = {
+	[SENSOR_TEMP_BOARD] = 1000,
+	[SENSOR_HUM_SUELO]  = 1000,
+	[SENSOR_TEMP_DHT11] = 2000,
+	[SENSOR_HUM_DHT11]  = 2000,
+	[SENSOR_MIC_LA]     = 0,
+	[SENSOR_MIC_PEAK]   = 0,
+	[SENSOR_MIC_LEQ]    = 0,
+	[SENSOR_GYRO_ODR]   = 1000,
+	[SENSOR_TILT]       = 1000,
+	[SENSOR_HEADING]    = 1000,
+};
+
+/* Decimales que se guardan en el historial de cada sensor */
+static const uint8_t history_decimals[SENSORn] = {
+	[SENSOR_TEMP_BOARD] = 1,
+	[SENSOR_HUM_SUELO]  = 0,
+	[SENSOR_TEMP_DHT11] = 0,
+	[SENSOR_HUM_DHT11]  = 0,
+	[SENSOR_MIC_LA]     = 1,
+	[SENSOR_MIC_PEAK]   = 1,
+	[SENSOR_MIC_LEQ]    = 1,
+	[SENSOR_MIC_BAND_125] = 1,
+	[SENSOR_MIC_BAND_250] = 1,
+	[SENSOR_MIC_BAND_500] = 1,
+	[SENSOR_MIC_BAND_1K]  = 1,
+	[SENSOR_MIC_BAND_2K]  = 1,
+	[SENSOR_MIC_BAND_4K]  = 1,
+	[SENSOR_VIB_Z]      = 1,
+	[SENSOR_GYRO_ODR]   = 0,
+	[SENSOR_TILT]       = 1,
+	[SENSOR_HEADING]    = 1,
+};
+
+extern uint8_t 			 init_wifi;
+extern CRC_HandleTypeDef hcrc;
+extern UART_HandleTypeDef huart1;
+
+/* Definiciones del modulo */
+static void APP_TimerTask(void *argument);
+static void APP_SensorTask(void *argument);
+static void APP_TelemetryTask(void *argument);
+static void APP_UITask(void *argument);
+static void APP_SendTelemetry(void);
+static void APP_SampleMetrics(void);
+static void APP_SendMetrics(void);
+static void APP_QueueSample(Sensor_TypeDef sensor, uint32_t tick, float value);
+static TickType_t APP_Until(TickType_t since, TickType_t period, TickType_t now);
+static void APP_StoreSample(const Sample_TypeDef *sample);
+static void APP_StoreHistory(Sensor_TypeDef sensor);
+static void APP_LedBlink(void *arg);
+static void APP_ButtonPoll(void *arg);
+
+/* Objetos del sistema operativo */
+RTOS_OBJECTS_DEFINE(APP_OBJECTS)
+static const rtos_budget_t app_budget[] = { RTOS_OBJECTS_BUDGET(APP_OBJECTS) };
+
+/* Ultimo valor recibido de cada sensor */
+static Sample_TypeDef last_sample[SENSORn];
+static uint32_t 	  dropped_samples = 0;
+
+/* Tramas de telemetria */
+static telemetry_t 	  telemetry;
+static uint32_t 	  dropped_frames = 0;
+
+/* Carga de CPU, pilas y heap. La trama espera hasta que el wifi la acepta */
+static metrics_t 	  metrics;
+static const uint8_t *metrics_frame;
+static uint16_t 	  metrics_len = 0;
+
+/* Historial comprimido por sensor, un bloque por registro en flash */
+static series_t 	  history[SENSORn];
+
+/* Temporizadores, sus acciones corren en la tarea de temporizadores */
+static timer_wheel_t  wheel;
+static wheel_timer_t  led_timer = WHEEL_TIMER_INIT(APP_LedBlink, NULL);
+static wheel_timer_t  button_timer = WHEEL_TIMER_INIT(APP_ButtonPoll, NULL);
+
+/******************************************************************************
+ * 				     	     	INICIALIZACION 					      		  *
+ *****************************************************************************/
+
+/**
+ * @brief	Crea la cola de muestras y las tareas de la aplicacion.
+ * 			Se llama antes de vTaskStartScheduler.
+ */
+void APP_Init(void){
+	telemetry_init(&telemetry, &hcrc);
+	metrics_init(&metrics, &hcrc);
+	timer_wheel_init(&wheel, xTaskGetTickCount());
+	for(int i = 0; i < SENSORn; i++){
+		series_init(&history[i], i, history_decimals[i]);
+	}
+
+	if(!RTOS_OBJECTS_CREATE(APP_OBJECTS)){
+		Error_Handler();
+	}
+
+	BSP_CONSOLE_Attach(ui_task);
+	BSP_SENSOR_Attach(sensor_task);
+	BSP_WIFI_Attach(telemetry_task);
+	APP_TimerStart(&led_timer, LED_PERIOD, LED_PERIOD);
+	APP_TimerStart(&button_timer, BUTTON_POLL, BUTTON_POLL);
+}
+
+/**
+ * @brief	Muestras descartadas porque la cola estaba llena.
+ */
+uint32_t APP_GetDroppedSamples(void){
+	return dropped_samples;
+}
+
+/**
+ * @brief	Tramas de telemetria y de metricas descartadas por no tener
+ * 			conexion.
+ */
+uint32_t APP_GetDroppedFrames(void){
+	return dropped_frames;
+}
+
+/******************************************************************************
+ * 				     	     	TEMPORIZADORES 					      		  *
+ *****************************************************************************/
+
+/**
+ * @brief	Arranca (o rearranca) un temporizador. Su accion corre en la tarea
+ * 			de temporizadores y no debe bloquear.
+ * @param	timer: temporizador con su accion, ver WHEEL_TIMER_INIT
+ * @param	delay: ms hasta la primera vez
+ * @param	period: ms entre las siguientes, 0 para una sola vez
+ */
+void APP_TimerStart(wheel_timer_t *timer, uint32_t delay, uint32_t period){
+	taskENTER_CRITICAL();
+	timer_wheel_start(&wheel, timer, xTaskGetTickCount(), pdMS_TO_TICKS(delay), pdMS_TO_TICKS(period));
+	taskEXIT_CRITICAL();
+	/* Puede vencer antes de lo que la tarea esperaba dormir */
+	xTaskNotifyGive(timer_task);
+}
+
+/**
+ * @brief	Detiene un temporizador. Si ya vencio y su accion esta por correr,
+ * 			corre igual una ultima vez.
+ */
+void APP_TimerStop(wheel_timer_t *timer){
+	taskENTER_CRITICAL();
+	timer_wheel_stop(&wheel, timer);
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief	Parpadeo del LED azul: sin wifi o sin luz.
+ */
+static void APP_LedBlink(void *arg){
+	if (init_wifi == 0){
+		BSP_LED_Toggle(LED_BLUE);
+	}
+	if (!BSP_LUZ_GetState()) {
+		BSP_LED_Toggle(LED_BLUE);
+	}
+}
+
+/**
+ * @brief	Con el boton apretado el LED verde cambia cada BUTTON_REPEAT ms.
+ */
+static void APP_ButtonPoll(void *arg){
+	static uint8_t button_hold = 0;
+
+	if (button_hold > 0){
+		button_hold--;
+	}
+	else if (BSP_PB_GetState(BUTTON_KEY)){
+		BSP_LED_Toggle(LED_GREEN);
+		button_hold = BUTTON_REPEAT / BUTTON_POLL - 1;
+	}
+}
+
+/**
+ * @brief	Cierra la trama en curso y la envia por wifi.
+ */
+static void APP_SendTelemetry(void){
+	const uint8_t *frame;
+	uint16_t 	   len;
+	uint32_t 	   t = PROF_BEGIN();
+
+	len = telemetry_finish(&telemetry, &frame);
+	if(len > 0 && !BSP_WIFI_Send(frame, len)){
+		dropped_frames++;
+	}
+	PROF_END(PROF_TELEMETRY_FRAME, t);
+}
+
+/**
+ * @brief	Toma una muestra de la carga; cada METRICS_WINDOW muestras arma
+ * 			la trama de metricas. Si la anterior no salio se descarta.
+ */
+static void APP_SampleMetrics(void){
+	static uint8_t samples = 0;
+
+	metrics_sample(&metrics);
+	if(++samples < METRICS_WINDOW){
+		return;
+	}
+	samples = 0;
+	if(metrics_len > 0){
+		dropped_frames++;
+	}
+	metrics_len = metrics_finish(&metrics, xTaskGetTickCount(), &metrics_frame);
+}
+
+/**
+ * @brief	Envia la trama de metricas pendiente cuando el wifi esta libre.
+ */
+static void APP_SendMetrics(void){
+	if(metrics_len > 0 && BSP_WIFI_Send(metrics_frame, metrics_len)){
+		metrics_len = 0;
+	}
+}
+
+/**
+ * @brief	Agrega la muestra al historial de su sensor. Un bloque lleno
+ * 			va al registro en flash y la muestra abre el siguiente.
+ */
+static void APP_StoreSample(const Sample_TypeDef *sample){
+	series_t *se = &history[sample->sensor];
+	uint32_t  t  = PROF_BEGIN();
+	uint8_t   ok = series_add(se, sample->tick, sample->value);
+
+	PROF_END(PROF_SERIES, t);
+	if(!ok){
+		APP_StoreHistory(sample->sensor);
+		series_add(se, sample->tick, sample->value);
+	}
+}
+
+/**
+ * @brief	Cierra el bloque del historial de un sensor y lo guarda en el
+ * 			registro en flash, haya o no wifi.
+ */
+static void APP_StoreHistory(Sensor_TypeDef sensor){
+	const uint8_t *block;
+	uint16_t 	   len;
+
+	len = series_finish(&history[sensor], &block);
+	if(len > 0){
+		BSP_LOG_Append(block, len);
+	}
+}
+
+/**
+ * @brief	Encola una muestra para telemetria sin bloquear.
+ * 			Si la cola esta llena se descarta.
+ */
+static void APP_QueueSample(Sensor_TypeDef sensor, uint32_t tick, float value){
+	Sample_TypeDef sample;
+
+	sample.tick   = tick;
+	sample.sensor = sensor;
+	sample.value  = value;
+	if(xQueueSend(sample_queue, &sample, 0) != pdPASS){
+		dropped_samples++;
+	}
+}
+
+/**
+ * @brief	Ticks que faltan para que venza un plazo, 0 si ya vencio.
+ * @param	since: Inicio del plazo.
+ * @param	period: Duracion en ticks.
+ * @param	now: Tick actual.
+ */
+static TickType_t APP_Until(TickType_t since, TickType_t period, TickType_t now){
+	TickType_t elapsed = now - since;
+
+	return elapsed >= period ? 0 : period - elapsed;
+}
+
+/******************************************************************************
+ * 				     	     	    TAREAS 					      	  		  *
+ *****************************************************************************/
+
+/**
+ * @brief	Corre las acciones de los temporizadores vencidos y duerme hasta el
+ * 			proximo vencimiento (o hasta que se arranque otro), asi no impide
+ * 			el modo tickless.
+ */
+static void APP_TimerTask(void *argument){
+	wheel_timer_t *timer;
+	TickType_t 	   now;
+	uint32_t 	   wait;
+	uint8_t 	   more;
+
+	for(;;){
+		now = xTaskGetTickCount();
+		/* Un paso de la rueda por seccion critica: un temporizador vencido,
+		   uno de una cascada o el avance al proximo tick con trabajo. No
+		   depende de cuantos venzan, bajen o de cuantos ticks se atrase */
+		do{
+			taskENTER_CRITICAL();
+			more = timer_wheel_expire(&wheel, now, &timer);
+			taskEXIT_CRITICAL();
+			if(timer != NULL){
+				timer->callback(timer->arg);
+			}
+		}while(more);
+
+		taskENTER_CRITICAL();
+		wait = timer_wheel_next(&wheel);
+		taskEXIT_CRITICAL();
+		ulTaskNotifyTake(pdTRUE, wait == TIMER_WHEEL_IDLE ? portMAX_DELAY : wait);
+	}
+}
+
+/**
+ * @brief	Muestrea cada sensor a su periodo y envia las muestras a telemetria.
+ * 			Duerme hasta el primer sensor que vence; los bloques del
+ * 			microfono y de la IMU la despiertan desde su interrupcion. Los
+ * 			plazos avanzan de a un periodo, sin acumular deriva.
+ */
+static void APP_SensorTask(void *argument){
+	TickType_t 	   now = xTaskGetTickCount();
+	TickType_t 	   due[SENSORn];
+	TickType_t 	   wait;
+	uint8_t 	  *dht11_measures;
+	mic_record_t   level;
+	int16_t 	   bands[MIC_BANDS];
+	float 		   value;
+
+	for(int i = 0; i < SENSORn; i++){
+		due[i] = now + pdMS_TO_TICKS(sensor_period[i]);
+	}
+
+	for(;;){
+		now = xTaskGetTickCount();
+
+		/* La lectura del DHT11 avanza en cada llamada sin bloquear */
+		dht11_measures = BSP_DHT11_Read();
+
+		for(int i = 0; i < SENSORn; i++){
+			if(sensor_period[i] == 0 || (int32_t)(now - due[i]) < 0){
+				continue;
+			}
+			/* Si se perdio mas de un periodo se sigue desde ahora */
+			due[i] += pdMS_TO_TICKS(sensor_period[i]);
+			if((int32_t)(now - due[i]) >= 0){
+				due[i] = now + pdMS_TO_TICKS(sensor_period[i]);
+			}
+
+			switch((Sensor_TypeDef)i){
+			case SENSOR_TEMP_BOARD:
+				value = BSP_BOARD_GetTemp();
+				break;
+			case SENSOR_HUM_SUELO:
+				value = BSP_SUELO_GetHum();
+				break;
+			case SENSOR_TEMP_DHT11:
+				value = dht11_measures[0];
+				break;
+			case SENSOR_HUM_DHT11:
+				value = dht11_measures[1];
+				break;
+			case SENSOR_GYRO_ODR:
+				value = BSP_GYRO_GetRate();
+				break;
+			case SENSOR_TILT:
+				if(!BSP_IMU_Ready()){
+					continue;
+				}
+				value = BSP_IMU_GetTilt();
+				break;
+			case SENSOR_HEADING:
+				if(!BSP_IMU_Ready()){
+					continue;
+				}
+				value = BSP_IMU_GetHeading();
+				break;
+			default:
+				continue;
+			}
+
+			/* Nunca bloqueamos el muestreo: si la cola esta llena se descarta */
+			APP_QueueSample((Sensor_TypeDef)i, now, value);
+		}
+
+		/* Bloques del acelerometro y del giroscopo: orientacion y vibracion */
+		BSP_IMU_Update();
+
+		/* Vibracion: un nivel por cada trama del acelerometro analizada */
+		if(BSP_VIB_Read(&value)){
+			APP_QueueSample(SENSOR_VIB_Z, now, value);
+		}
+
+		/* Trama de espectro pendiente: se promedia hasta la proxima ventana */
+		BSP_MIC_Spectrum();
+
+		/* Ventanas del monitor de ruido terminadas desde el ultimo periodo */
+		while(BSP_MIC_Read(&level)){
+			APP_QueueSample(SENSOR_MIC_LA, now, level.la_x10 / 10.0f);
+			APP_QueueSample(SENSOR_MIC_PEAK, now, level.peak_x10 / 10.0f);
+			if(level.leq_done){
+				APP_QueueSample(SENSOR_MIC_LEQ, now, level.leq_x10 / 10.0f);
+			}
+			if(BSP_MIC_ReadBands(bands)){
+				for(int b = 0; b < MIC_BANDS; b++){
+					APP_QueueSample((Sensor_TypeDef)(SENSOR_MIC_BAND_125 + b), now, bands[b] / 10.0f);
+				}
+			}
+		}
+
+		/* Una sola notificacion por vuelta para todas las muestras */
+		if(uxQueueMessagesWaiting(sample_queue) > 0){
+			xTaskNotifyGive(telemetry_task);
+		}
+
+		/* Hasta el primer sensor que vence, o de a DHT11_POLL mientras el
+		   DHT11 esta leyendo */
+		now  = xTaskGetTickCount();
+		wait = BSP_DHT11_Busy() ? pdMS_TO_TICKS(DHT11_POLL) : portMAX_DELAY;
+		for(int i = 0; i < SENSORn; i++){
+			if(sensor_period[i] == 0){
+				continue;
+			}
+			if((int32_t)(due[i] - now) <= 0){
+				wait = 0;
+			}
+			else if(due[i] - now < wait){
+				wait = due[i] - now;
+			}
+		}
+		ulTaskNotifyTake(pdTRUE, wait);
+	}
+}
+
+/**
+ * @brief	Agrupa las muestras en tramas binarias y atiende al modulo wifi.
+ * 			Duerme hasta el proximo envio o vencimiento de un comando AT; la
+ * 			despiertan antes la tarea de muestreo y las interrupciones del
+ * 			wifi y de la flash.
+ */
+static void APP_TelemetryTask(void *argument){
+	Sample_TypeDef sample;
+	TickType_t 	   now = xTaskGetTickCount();
+	TickType_t 	   last_flush = now;
+	TickType_t 	   last_history = now;
+	TickType_t 	   last_metrics = now;
+	TickType_t 	   wait;
+
+	for(;;){
+		while(xQueueReceive(sample_queue, &sample, 0) == pdPASS){
+			last_sample[sample.sensor] = sample;
+			/* Trama llena: la enviamos y la muestra abre la siguiente */
+			if(!telemetry_add(&telemetry, sample.sensor, sample.tick, sample.value)){
+				APP_SendTelemetry();
+				telemetry_add(&telemetry, sample.sensor, sample.tick, sample.value);
+			}
+			APP_StoreSample(&sample);
+		}
+
+		now = xTaskGetTickCount();
+		if(now - last_flush >= pdMS_TO_TICKS(TELEMETRY_FLUSH)){
+			last_flush = now;
+			APP_SendTelemetry();
+		}
+		if(now - last_metrics >= pdMS_TO_TICKS(METRICS_PERIOD)){
+			last_metrics = now;
+			APP_SampleMetrics();
+		}
+		/* Los bloques a medio llenar tambien se guardan, de a ratos */
+		if(now - last_history >= pdMS_TO_TICKS(HISTORY_FLUSH)){
+			last_history = now;
+			for(int i = 0; i < SENSORn; i++){
+				APP_StoreHistory((Sensor_TypeDef)i);
+			}
+		}
+		/* El fin de un envio libera el wifi para la trama de metricas */
+		BSP_WIFI_Process();
+		APP_SendMetrics();
+		BSP_LOG_Process();
+
+		wait = BSP_WIFI_NextTimeout();
+		wait = APP_MIN(wait, APP_Until(last_flush, pdMS_TO_TICKS(TELEMETRY_FLUSH), now));
+		wait = APP_MIN(wait, APP_Until(last_metrics, pdMS_TO_TICKS(METRICS_PERIOD), now));
+		wait = APP_MIN(wait, APP_Until(last_history, pdMS_TO_TICKS(HISTORY_FLUSH), now));
+		ulTaskNotifyTake(pdTRUE, wait);
+	}
+}
+
+/**
+ * @brief	Consola de depuracion por USART1. Duerme hasta que la interrupcion
+ * 			avisa que llegaron comandos y los atiende todos. Los volcados
+ * 			bloquean, por eso corren aca con la menor prioridad. Los LEDs y
+ * 			el boton van por temporizadores.
+ */
+static void APP_UITask(void *argument){
+	uint8_t  cmd[CONSOLE_BATCH];
+	uint16_t n;
+
+	for(;;){
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		while((n = BSP_CONSOLE_Read(cmd, sizeof(cmd))) > 0){
+			for(uint16_t i = 0; i < n; i++){
+				switch(cmd[i]){
+				case 'p':	/* Volcado del profiler */
+					prof_dump(&huart1);
+					break;
+				case 'm':	/* Presupuesto de RAM del sistema operativo */
+					rtos_report(&huart1, app_budget, sizeof(app_budget) / sizeof(app_budget[0]));
+					break;
+				case 't':	/* Volcado binario del registro de eventos */
+					trace_dump(&huart1);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,250 @@
+#include <string.h>
+#include "at_cmd.h"
+
+#define AT_STATE_IDLE 		0			// Nothing running
+#define AT_STATE_SEND 		1			// Command ready to be transmitted
+#define AT_STATE_WAIT 		2			// Waiting for the expected response
+
+
+/**
+ * @brief configure AT engine
+ * @param at:		struct to configure ex:&wifi_at
+ * @param tx:		transmit queue of the UART connected to the module ex:&wifi_tx
+ * @param rx:		receive ring already started on that UART
+ * @param urc:		handler for unsolicited lines, may be NULL
+ */
+void at_init(at_engine_t 		*at,
+			 uart_tx_t 			*tx,
+			 uart_rx_t 			*rx,
+			 at_urc_cb_t 		 urc){
+	at->tx 		 = tx;
+	at->rx 		 = rx;
+	at->urc 	 = urc;
+	at->q_head 	 = 0;
+	at->q_tail 	 = 0;
+	at->state 	 = AT_STATE_IDLE;
+	at->line_len = 0;
+	at->backoff  = 0;
+}
+
+/**
+ * @brief queue a command table, it runs right after the previous one ends
+ * @param at:		AT engine
+ * @param table:	constant command table
+ * @param count:	number of commands in table
+ * @param done:		completion callback, may be NULL
+ * @return 1 if queued, 0 if the queue is full
+ */
+uint8_t at_submit(at_engine_t 		 *at,
+				  const at_command_t *table,
+				  uint8_t 			  count,
+				  at_done_cb_t 		  done){
+	uint8_t next = (at->q_head + 1) % AT_QUEUE_SIZE;
+
+	if(next == at->q_tail || count == 0){
+		return 0;
+	}
+	at->queue[at->q_head].table = table;
+	at->queue[at->q_head].count = count;
+	at->queue[at->q_head].done  = done;
+	at->q_head = next;
+	return 1;
+}
+
+/**
+ * @brief checks if there is a script running or queued
+ * @param at:	AT engine
+ */
+uint8_t at_busy(const at_engine_t *at)
+{
+	return at->q_head != at->q_tail;
+}
+
+/**
+ * @brief how long at_process may go uncalled when nothing arrives, for
+ * 		  callers that sleep between calls. Received data and finished
+ * 		  transmissions must wake them too
+ * @param at:	AT engine
+ * @return ms until the pending command times out, 0 if at_process has
+ * 		   work now, AT_WAIT_FOREVER with nothing pending
+ */
+uint32_t at_next_timeout(const at_engine_t *at)
+{
+	const at_command_t *cmd;
+	uint32_t 			elapsed;
+
+	if(at->state == AT_STATE_IDLE){
+		return at_busy(at) ? 0 : AT_WAIT_FOREVER;
+	}
+	//waiting out the backoff of a retry, then a full transmit queue wakes
+	//the caller when it drains and a refused transfer is retried after a while
+	if(at->state == AT_STATE_SEND){
+		elapsed = HAL_GetTick() - at->failed_at;
+		if(elapsed < at->backoff){
+			return at->backoff - elapsed;
+		}
+		return uart_tx_free(at->tx) == 0 ? AT_WAIT_FOREVER : AT_SEND_RETRY;
+	}
+	cmd 	= &at->queue[at->q_tail].table[at->index];
+	elapsed = HAL_GetTick() - at->sent_at;
+	//at_process fails the command once more than timeout ms went by
+	return elapsed > cmd->timeout ? 0 : cmd->timeout - elapsed + 1;
+}
+
+static void at_finish(at_engine_t *at, at_result_t result)
+{
+	at_script_t *script = &at->queue[at->q_tail];
+	at_done_cb_t done   = script->done;
+	uint8_t 	 index  = at->index;
+
+	at->q_tail = (at->q_tail + 1) % AT_QUEUE_SIZE;
+	at->state  = AT_STATE_IDLE;
+	if(done != NULL){
+		done(result, index);
+	}
+}
+
+static void at_load(at_engine_t *at)
+{
+	at->tries 	= at->queue[at->q_tail].table[at->index].retries + 1;
+	at->backoff = 0;
+	at->state 	= AT_STATE_SEND;
+}
+
+//retries an ERROR after a wait that doubles each time, so a busy module
+//is not flooded. A timeout already waited the command timeout in silence
+//and is retried right away: that is how the first command polls a module
+//that is still booting
+static void at_fail(at_engine_t *at, at_result_t result)
+{
+	const at_command_t *cmd = &at->queue[at->q_tail].table[at->index];
+	uint8_t 			retry = cmd->retries + 1 - at->tries;
+
+	if(at->tries == 0){
+		at_finish(at, result);
+		return;
+	}
+	at->failed_at = HAL_GetTick();
+	at->backoff   = 0;
+	if(result == AT_RESULT_ERROR){
+		at->backoff = AT_BACKOFF;
+		while(--retry > 0 && at->backoff < AT_BACKOFF_MAX){
+			at->backoff *= 2;
+		}
+		if(at->backoff > AT_BACKOFF_MAX){
+			at->backoff = AT_BACKOFF_MAX;
+		}
+	}
+	at->state 	  = AT_STATE_SEND;
+}
+
+//length of the command name, "ATPW=2\r\n" -> 4
+static uint8_t at_name_len(const at_command_t *cmd)
+{
+	uint8_t n = 0;
+
+	while(n < cmd->len && cmd->cmd[n] != '=' && cmd->cmd[n] != '?' && cmd->cmd[n] != '\r'){
+		n++;
+	}
+	return n;
+}
+
+//checks if the received line is the result code for cmd: the whole line,
+//or all of it after the "[<command name>] " echo of some modules. Payloads
+//and unsolicited lines that merely contain the code do not match. With
+//detail the code may be followed by ":<anything>" ex:"ERROR:2"
+static uint8_t at_is_result(const at_engine_t *at, const at_command_t *cmd, const char *code, uint8_t detail)
+{
+	const char *line = at->line;
+	uint8_t 	name = at_name_len(cmd);
+	size_t 		len  = strlen(code);
+
+	if(line[0] == '[' && strncmp(&line[1], cmd->cmd, name) == 0 &&
+	   line[name + 1] == ']' && line[name + 2] == ' '){
+		line += name + 3;
+	}
+	if(strncmp(line, code, len) != 0){
+		return 0;
+	}
+	return line[len] == '\0' || (detail && line[len] == ':');
+}
+
+static void at_line(at_engine_t *at)
+{
+	const at_command_t *cmd;
+
+	if(at->state == AT_STATE_WAIT){
+		cmd = &at->queue[at->q_tail].table[at->index];
+		if(at_is_result(at, cmd, cmd->expect, 0)){
+			at->index++;
+			if(at->index == at->queue[at->q_tail].count){
+				at_finish(at, AT_RESULT_OK);
+			}
+			else{
+				at_load(at);
+			}
+			return;
+		}
+		if(at_is_result(at, cmd, "ERROR", 1)){
+			at_fail(at, AT_RESULT_ERROR);
+			return;
+		}
+	}
+
+	if(at->urc != NULL){
+		at->urc(at->line, at->line_len);
+	}
+}
+
+/**
+ * @brief runs the engine, call from the main loop (never from an ISR)
+ * @note  responses are matched line by line, so a reply split across
+ * 		  several DMA spans or mixed with other traffic is still detected
+ * @param at:	AT engine
+ */
+void at_process(at_engine_t *at)
+{
+	const uint8_t 		*data;
+	const at_command_t 	*cmd;
+	uint16_t 			 len;
+
+	/* Incremental line assembly straight from the receive ring */
+	while((len = uart_rx_peek(at->rx, &data)) > 0){
+		for(uint16_t i = 0; i < len; i++){
+			if(data[i] == '\n'){
+				at->line[at->line_len] = '\0';
+				if(at->line_len > 0){
+					at_line(at);
+				}
+				at->line_len = 0;
+			}
+			else if(data[i] != '\r' && at->line_len < AT_LINE_SIZE - 1){
+				at->line[at->line_len++] = (char)data[i];
+			}
+		}
+		uart_rx_consume(at->rx, len);
+	}
+
+	if(at->state == AT_STATE_IDLE && at_busy(at)){
+		at->index = 0;
+		at_load(at);
+	}
+
+	if(at->state == AT_STATE_SEND && HAL_GetTick() - at->failed_at >= at->backoff){
+		cmd = &at->queue[at->q_tail].table[at->index];
+		/* Commands live in flash, the buffer outlives the transmission.
+		   With the transmit queue full or the transfer refused it is
+		   retried on the next call */
+		if(uart_tx_send(at->tx, (const uint8_t *)cmd->cmd, cmd->len, NULL)){
+			at->sent_at = HAL_GetTick();
+			at->tries--;
+			at->state = AT_STATE_WAIT;
+		}
+	}
+	else if(at->state == AT_STATE_WAIT){
+		cmd = &at->queue[at->q_tail].table[at->index];
+		if(HAL_GetTick() - at->sent_at > cmd->timeout){
+			at_fail(at, AT_RESULT_TIMEOUT);
+		}
+	}
+}
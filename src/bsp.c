@@ -1,8 +1,26 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f411e_discovery.h"
+#include "stm32f411e_discovery_audio.h"
+#include "pdm2pcm_glo.h"
+#include "FreeRTOS.h"
+#include "task.h"
 #include "mk_dht11.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+#include "at_cmd.h"
+#include "adc_acq.h"
+#include "die_temp.h"
+#include "mic_level.h"
+#include "spectrum.h"
+#include "accel_stream.h"
+#include "ahrs.h"
+#include "flash_log.h"
+#include "lsm303dlhc.h"
+#include "l3gd20.h"
+#include "prof.h"
+#include "spsc.h"
+#include "mem_pool.h"
 #include "bsp.h"
-#include "stdio.h"
 
 
 /* Estructuras que facilitan el manejo de los LEDS */
@@ -29,37 +47,205 @@ GPIO_TypeDef* 	BUTTON_PORT[BUTTONn] = {KEY_BUTTON_GPIO_PORT};
 const uint16_t 	BUTTON_PIN[BUTTONn]  = {KEY_BUTTON_PIN};
 const uint8_t 	BUTTON_IRQn[BUTTONn] = {KEY_BUTTON_EXTI_IRQn};
 
-/* Tamaño del buffer rx de wifi */
-#define BUFFER_SIZE 200
+/* Tamaño del buffer circular rx de wifi */
+#define BUFFER_SIZE 256
+
+/* Reintento en ms de la recepcion wifi detenida por un error */
+#define WIFI_RX_RETRY 10
+
+/* Bytes de la consola de depuracion esperando a su tarea (potencia de 2) */
+#define CONSOLE_RX_SIZE 16
+
+/* Prioridades de las interrupciones que llaman a funciones FromISR del
+   sistema operativo: nunca mas urgentes (menor numero) que
+   configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY o configASSERT salta */
+#define IRQ_PRIO_CAPTURE 	(configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY)		// Flancos del DHT11
+#define IRQ_PRIO_STREAM 	(configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1)	// DMA del ADC y del wifi
+#define IRQ_PRIO_CONSOLE 	(configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 2)	// Consola de depuracion
 
 
 /* Definiciones del modulo */
 void 		SystemClock_Config(void);
 void    	ADC1_Init(void);
+void 		BSP_TIM5_Init(void);
 void    	BSP_LUZ_Init(void);
 void 		BSP_LED_Init(Led_TypeDef Led);
 void 		BSP_DHT11_Init(void);
+void 		BSP_TIM2_Init(void);
 void 		BSP_TIM3_Init(void);
+void 		BSP_TIM4_Init(void);
 void 		BSP_USART1_Init(void);
 void 		BSP_USART2_Init(void);
 void 		BSP_PB_Init(Button_TypeDef 	   Button,
 						ButtonMode_TypeDef ButtonMode);
 void 		HAL_UART_RxCpltCallback ( UART_HandleTypeDef *huart);
+void 		HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void 		HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void 		HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
 void 		Error_Handler(void);
+static void BSP_WIFI_InitDone(at_result_t result, uint8_t index);
+static void BSP_WIFI_SendDone(at_result_t result, uint8_t index);
+static void BSP_WIFI_Urc(const char *line, uint8_t len);
+void 		BSP_CRC_Init(void);
+void 		BSP_PWR_Init(void);
+void 		BSP_MIC_Init(void);
+static void BSP_MIC_Block(uint16_t *half);
+void 		BSP_ACCEL_Init(void);
+void 		BSP_GYRO_StreamInit(void);
+void 		BSP_LOG_Init(void);
+static void BSP_CONSOLE_Notify(void *ctx);
+static void BSP_WIFI_Notify(void *ctx);
+static void BSP_Wake(TaskHandle_t task);
+static void BSP_MAG_Read(void);
+void 		vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
 
 
 /* Handlers necesarios */
 ADC_HandleTypeDef 	hadc1;
+CRC_HandleTypeDef 	hcrc;
+DMA_HandleTypeDef 	hdma_adc1;
+TIM_HandleTypeDef 	htim2;
 TIM_HandleTypeDef 	htim3;
+TIM_HandleTypeDef 	htim4;
+TIM_HandleTypeDef 	htim5;
 UART_HandleTypeDef 	huart1;
 UART_HandleTypeDef 	huart2;
+DMA_HandleTypeDef 	hdma_usart2_rx;
+DMA_HandleTypeDef 	hdma_usart2_tx;
 dht11_t 			dht;
+uart_rx_t 			wifi_rx;
+uart_tx_t 			wifi_tx;
+adc_acq_t 			adc_acq;
+die_temp_t 			die_temp;
+at_engine_t 		wifi_at;
+mic_level_t 		mic;
+accel_stream_t 		accel;
+accel_stream_t 		gyro;
 
 /* Buffer de datos wifi */
-uint8_t rx_data;					// Byte de destino
-uint8_t rx_buffer[BUFFER_SIZE];		// Buffer de destino
+uint8_t rx_buffer[BUFFER_SIZE];		// Buffer circular destino del DMA
 uint8_t init_wifi = 0;				// Flag de control de inicializacion
-uint8_t check_ok  = 0;				// Flag de control de comando correcto
+uint32_t wifi_start_tick = 0;		// Tick de inicio de la inicializacion
+uint32_t wifi_bringup_ms = 0;		// Duracion de la inicializacion
+uint8_t  wifi_init_from = 0;		// Primer comando del intento de inicializacion en curso
+uint8_t  wifi_con_id = 0xFF;		// Conexion TCP del cliente, 0xFF sin cliente
+uint8_t  debug_cmd;				// Comando recibido por USART1
+uint32_t wifi_rx_errors = 0;		// Errores de recepcion del USART2
+uint8_t  wifi_rx_down = 0;			// Recepcion detenida, se reintenta desde la tarea
+
+/* Canal de la consola: interrupcion de USART1 -> tarea de consola */
+static spsc_t 		console_rx;
+static uint8_t 		console_buffer[CONSOLE_RX_SIZE];
+static TaskHandle_t console_task = NULL;
+
+/* Tareas que duermen hasta que una interrupcion trae datos */
+static TaskHandle_t sensor_task = NULL;		// Bloques del microfono y de la IMU
+static TaskHandle_t wifi_task = NULL;		// Datos del wifi y borrados de la flash
+uint32_t sleep_count = 0;			// Veces que el micro entro en sleep
+uint32_t sleep_ticks = 0;			// Ticks de sistema pasados en sleep
+
+extern __IO uint32_t uwTick;
+
+/* Microfono MEMS (MP45DT02): 1 ms de PDM por mitad del buffer del DMA */
+#define MIC_PCM_SIZE 		(DEFAULT_AUDIO_IN_FREQ / 1000)	// Muestras por mitad
+#define MIC_WINDOW_MS 		1000			// Ventana de nivel y pico
+#define MIC_LEQ_WINDOWS 	60				// Ventanas por LAeq (1 minuto)
+#define MIC_SPL_OFFSET 		120.0f			// -26 dBFS a 94 dB SPL, sin ganancia
+/* Presupuesto por bloque de 1 ms: 10% de CPU a 96 MHz */
+#define MIC_BLOCK_BUDGET 	9600
+
+static uint16_t 			 mic_pdm[INTERNAL_BUFF_SIZE];	// Destino del DMA del I2S2
+static int16_t 				 mic_pcm[MIC_PCM_SIZE];
+static PDM_Filter_Handler_t  mic_filter;
+static PDM_Filter_Config_t 	 mic_filter_config;
+static uint32_t 			 mic_over_budget = 0;		// Bloques fuera de presupuesto
+
+/* Espectro del microfono: tramas de 64 ms, 15.6 Hz por bin */
+#define MIC_FFT_SIZE 		1024
+/* Limites de las bandas de octava, fc / sqrt(2) */
+static const uint16_t 		 mic_band_hz[MIC_BANDS + 1] = {88, 177, 354, 707, 1414, 2828, 5657};
+static uint16_t 			 mic_band_bin[MIC_BANDS + 1];
+static int16_t 				 mic_fft_frame[MIC_FFT_SIZE];
+static int16_t 				 mic_fft_work[MIC_FFT_SIZE] __attribute__((aligned(4)));
+static spectrum_t 			 mic_spectrum;
+static float 				 mic_band_sum[MIC_BANDS];	// Energia acumulada por banda
+static uint16_t 			 mic_band_frames = 0;		// Tramas acumuladas
+
+/* Acelerometro (LSM303DLHC): FIFO en modo stream, un bloque por marca de agua */
+#define ACCEL_WATERMARK 	16				// 40 ms a 400 Hz
+/* Vibracion: tramas de 256 muestras del eje Z (0.64 s, 1.56 Hz por bin) */
+#define VIB_FFT_SIZE 		256
+#define VIB_RATE 			400				// Hz, LSM303DLHC_ODR_400_HZ
+#define VIB_BAND_LOW 		10				// Banda de vibracion en Hz
+#define VIB_BAND_HIGH 		200
+#define VIB_MG_OFFSET 		66.2f			// 2 g a fondo de escala (2048 mg): dB re 1 mg
+static uint8_t 				 accel_ok = 0;				// Sensor presente y en stream
+static int16_t 				 vib_frame[VIB_FFT_SIZE];
+static int16_t 				 vib_work[VIB_FFT_SIZE] __attribute__((aligned(4)));
+static spectrum_t 			 vib_spectrum;
+
+/* Giroscopo (L3GD20): FIFO en modo stream a 760 Hz, un bloque por marca de agua */
+#define GYRO_WATERMARK 		16				// 21 ms a 760 Hz
+static uint8_t 				 gyro_ok = 0;				// Sensor presente y en stream
+static uint32_t 			 gyro_rate_tick = 0;		// Ultima medicion de la tasa
+static uint32_t 			 gyro_rate_samples = 0;
+
+/* Orientacion (Mahony): se integra el giroscopo, la gravedad y el campo
+   magnetico corrigen la deriva */
+#define GYRO_RATE 			760				// Hz, L3GD20_OUTPUT_DATARATE_4
+#define GYRO_RAD_PER_LSB 	(0.0175f * 0.0174532925f)	// 500 dps: 17.5 mdps por cuenta
+#define AHRS_KP 			2.0f
+#define AHRS_KI 			0.1f
+#define MAG_Z_GAIN 			(1100.0f / 980.0f)	// Iguala la sensibilidad del eje Z a 1.3 Ga
+#define MAG_OFFSET_X 		0				// Hierro duro, medir en el mastil
+#define MAG_OFFSET_Y 		0
+#define MAG_OFFSET_Z 		0
+static uint8_t 				 mag_ok = 0;				// Magnetometro presente
+static ahrs_t 				 ahrs;
+
+/* Registro de telemetria en flash: sectores 6 y 7, region LOG del
+   LinkerScript.ld, fuera del codigo */
+#define LOG_BASE 			0x08040000
+#define LOG_FIRST_SECTOR 	FLASH_SECTOR_6
+#define LOG_SECTORS 		2
+#define LOG_SECTOR_SIZE 	(128 * 1024)
+static uint8_t 				 log_ok = 0;				// Registro montado
+static flash_log_t 			 flog;
+
+/* Envio de datos por la conexion TCP: "ATPT=<len>,<con_id>:<datos>". Cada
+   envio es un bloque de los pools con su comando AT adelante, asi una trama
+   no espera a que termine la anterior */
+#define WIFI_MSG_HEADER 	20			// "ATPT=<len>,<con_id>:" como maximo
+#define WIFI_MSG_SMALL 		96			// Tramas cortas
+#define WIFI_MSG_LARGE 		224			// Trama de telemetria o de metricas llena
+#define WIFI_POOLS 			2
+typedef struct{
+	at_command_t 	cmd;				// Comando AT, apunta a data
+	uint8_t 		data[];
+}WifiMsg_TypeDef;
+MEM_POOL_BUFFER(wifi_small_buffer, WIFI_MSG_SMALL, 4);
+MEM_POOL_BUFFER(wifi_large_buffer, WIFI_MSG_LARGE, 2);
+static mem_pool_t 		 wifi_pools[WIFI_POOLS];
+static WifiMsg_TypeDef 	*wifi_sent[AT_QUEUE_SIZE];	// Envios en curso, en orden
+static uint8_t 			 wifi_sent_head = 0;
+static uint8_t 			 wifi_sent_tail = 0;
+
+/* Secuencia de inicializacion del modulo wifi */
+static const at_command_t wifi_init_cmds[] = {
+	/* Verificamos que el modulo responda: cada 100 ms mientras arranca */
+	{AT_CMD("AT\r\n"), 					"OK", 	100, 	9},
+	/* Seteamos el modo wifi del modulo */
+	{AT_CMD("ATPW=2\r\n"), 				"OK", 	1000, 	2},
+	/* Configuramos el Acess Point */
+	{AT_CMD("ATPA=MICRO2022,,11,0\r\n"), 	"OK", 	5000, 	2},
+	/* Configuramos para que la asignacion de IP sea dinamica DHCP*/
+	{AT_CMD("ATPH=1,1\r\n"), 				"OK", 	1000, 	2},
+	/* Creamos un servidor TCP en el puerto 3001 */
+	{AT_CMD("ATPS=0,3001\r\n"), 			"OK", 	2000, 	2},
+	/* Iniciamos el Web Server */
+	{AT_CMD("ATSW=c\r\n"), 				"OK", 	1000, 	2},
+};
+#define WIFI_INIT_CMDS (sizeof(wifi_init_cmds) / sizeof(wifi_init_cmds[0]))
 
 /******************************************************************************
  * 				     	     MANIPULACION DE LEDS 					      	  *
@@ -115,30 +301,18 @@ void BSP_LED_Toggle(Led_TypeDef Led)
  *****************************************************************************/
 
 /**
- * @brief	Obtiene una lectura del sensor de temperatura de la placa
+ * @brief	Obtiene una lectura del sensor de temperatura de la placa, con
+ * 			la calibracion de fabrica y compensada por la tension de
+ * 			alimentacion (VREFINT de la misma secuencia del ADC).
  * @retval	Temp: Temperatura en Celsius de la placa
  */
 float BSP_BOARD_GetTemp(void){
-	ADC_ChannelConfTypeDef sConfig = {0};
-	uint32_t ADCValue;
-	float Vsense, Temp;
-
-	sConfig.Channel = ADC_CHANNEL_TEMPSENSOR;
-	sConfig.Rank    = 1;
-	sConfig.SamplingTime = ADC_SAMPLETIME_3CYCLES;
-	if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK) {
-			Error_Handler();
-	}
+	uint32_t t = PROF_BEGIN();
+	float Temp;
 
-	HAL_ADC_Start(&hadc1);
-
-	if(HAL_ADC_PollForConversion(&hadc1, 100) != HAL_OK){
-		return 0;
-	}
-
-	ADCValue = HAL_ADC_GetValue(&hadc1);
-	Vsense   = (float)ADCValue * 3000 / ((1<<12) - 1);
-	Temp     = (Vsense - 760) / 2.5 + 25;
+	Temp = die_temp_celsius(&die_temp, adc_acq_get_fine(&adc_acq, ADC_CH_TEMP),
+							adc_acq_get_fine(&adc_acq, ADC_CH_VREF));
+	PROF_END(PROF_BOARD_TEMP, t);
 	return Temp;
 }
 
@@ -147,21 +321,9 @@ float BSP_BOARD_GetTemp(void){
  * @retval	Hum: Devuelve la humedad del suelo medida.
  */
 uint32_t BSP_SUELO_GetHum(void){
-	ADC_ChannelConfTypeDef sConfig = {0};
 	float ADCValue, Hum;
-	sConfig.Channel = ADC_CHANNEL_1;
-	sConfig.Rank    = 1;
-	sConfig.SamplingTime = ADC_SAMPLETIME_3CYCLES;
 
-	if(HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK){
-		Error_Handler();
-	}
-
-	HAL_ADC_Start(&hadc1);
-	if(HAL_ADC_PollForConversion(&hadc1, 100) != HAL_OK){
-			return 0;
-	}
-	ADCValue = HAL_ADC_GetValue(&hadc1);
+	ADCValue = adc_acq_get(&adc_acq, ADC_CH_SUELO);
 	Hum = 1 - ADCValue/4095;
 	Hum = (Hum - 0.25) * 400;
 	if (Hum < 0)
@@ -173,20 +335,49 @@ uint32_t BSP_SUELO_GetHum(void){
 }
 
 
+/**
+ * @brief	Muestras por segundo que adquiere el ADC en un canal.
+ * @param	channel: ADC_CH_TEMP, ADC_CH_SUELO o ADC_CH_VREF
+ * @retval	Muestras por segundo medidas en el ultimo segundo.
+ */
+uint32_t BSP_ADC_GetRate(AdcChannel_TypeDef channel){
+	return adc_acq_rate(&adc_acq, channel);
+}
+
+
 uint8_t res[2];
 /**
- * @brief	Obtiene una lectura del sensor DHT11.
+ * @brief	Obtiene la ultima lectura valida del sensor DHT11.
+ * 			No bloquea: lanza una lectura por segundo y la avanza en cada
+ * 			llamada, los flancos los registra TIM2 por captura.
  * @retval	res[0]: Temperatura medida con el sensor.
  * @retval  res[1]: Humedad del ambiente medida con el sensor.
  */
 uint8_t *BSP_DHT11_Read(){
-	readDHT11(&dht);
-	res[0] = dht.temperature;
-	res[1] = dht.humidty;
+	uint32_t t = PROF_BEGIN();
+
+	/* El sensor admite como maximo una lectura por segundo */
+	if(dht.state == DHT11_IDLE && HAL_GetTick() - dht.tick >= 1000){
+		dht11_request(&dht);
+	}
+	if(dht11_process(&dht) && dht.error == DHT11_OK){
+		res[0] = dht.temperature;
+		res[1] = dht.humidty;
+	}
+	PROF_END(PROF_DHT11_READ, t);
 	return res;
 }
 
 
+/**
+ * @brief	Indica si hay una lectura del DHT11 en curso: hasta que termine
+ * 			BSP_DHT11_Read debe llamarse cada pocos ms.
+ */
+uint8_t BSP_DHT11_Busy(void){
+	return dht.state != DHT11_IDLE;
+}
+
+
 /**
  * @brief	Obtiene una lectura del sensor de luz
  * @retval	luz_state: Devuelve el estado del sensor de luz
@@ -219,78 +410,798 @@ uint32_t BSP_PB_GetState(Button_TypeDef Button)
  * @param	ms: Indica la cantidad en ms del delay
  */
 void BSP_Delay(uint32_t ms){
-	HAL_Delay(ms);
+	/* Con el scheduler corriendo cedemos el micro en lugar de esperar activos */
+	if(xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED){
+		vTaskDelay(pdMS_TO_TICKS(ms));
+	}
+	else{
+		HAL_Delay(ms);
+	}
+}
+
+/******************************************************************************
+ * 				     	   MANEJO DEL MODULO WIFI 						      *
+ *****************************************************************************/
+
+/**
+ * @brief	Procesa la comunicacion con el modulo wifi.
+ * 			Se llama desde el lazo principal, nunca desde una interrupcion.
+ */
+void BSP_WIFI_Process(void){
+	uint32_t t = PROF_BEGIN();
+
+	/* La recepcion no pudo relanzarse en la interrupcion del error */
+	if(wifi_rx_down){
+		taskENTER_CRITICAL();
+		if(uart_rx_restart(&wifi_rx) == HAL_OK){
+			wifi_rx_down = 0;
+		}
+		taskEXIT_CRITICAL();
+	}
+	at_process(&wifi_at);
+	PROF_END(PROF_WIFI_PROCESS, t);
+}
+
+/**
+ * @brief	Tarea que llama a BSP_WIFI_Process y a BSP_LOG_Process. Se
+ * 			despierta cuando llegan datos del modulo, termina un envio o
+ * 			termina un borrado de la flash.
+ * @param	task: Tarea de telemetria, NULL para ninguna.
+ */
+void BSP_WIFI_Attach(TaskHandle_t task){
+	wifi_task = task;
+}
+
+/**
+ * @brief	Cuanto puede dormir la tarea del wifi si no llega nada.
+ * @retval	Ticks hasta que vence el comando AT en curso, portMAX_DELAY si
+ * 			no hay ninguno.
+ */
+TickType_t BSP_WIFI_NextTimeout(void){
+	uint32_t ms = at_next_timeout(&wifi_at);
+
+	if(wifi_rx_down && ms > WIFI_RX_RETRY){
+		ms = WIFI_RX_RETRY;
+	}
+	return ms == AT_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(ms);
+}
+
+/* Llegaron bytes del modulo */
+static void BSP_WIFI_Notify(void *ctx){
+	BSP_Wake(wifi_task);
+}
+
+/**
+ * @brief	Errores de recepcion del USART2 (ruido, trama, desborde o DMA).
+ */
+uint32_t BSP_WIFI_GetRxErrors(void){
+	return wifi_rx_errors;
+}
+
+/**
+ * @brief	Tiempo que tomo la inicializacion del modulo wifi.
+ * @retval	Tiempo en ms desde BSP_WIFI_Init hasta el ultimo OK, 0 si no termino.
+ */
+uint32_t BSP_WIFI_GetBringUpTime(void){
+	return wifi_bringup_ms;
+}
+
+/**
+ * @brief	Indica si el modulo termino de inicializarse y hay un cliente TCP.
+ */
+uint8_t BSP_WIFI_Ready(void){
+	return init_wifi == 0 && wifi_con_id != 0xFF;
+}
+
+/**
+ * @brief	Escribe un entero sin signo en decimal.
+ * @retval	Cantidad de caracteres escritos.
+ */
+static uint8_t BSP_Utoa(uint8_t *out, uint32_t value){
+	uint8_t digits[10];
+	uint8_t n = 0, len = 0;
+
+	do{
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	}while(value > 0);
+	while(n > 0){
+		out[len++] = digits[--n];
+	}
+	return len;
+}
+
+/**
+ * @brief	Envia datos binarios al cliente TCP del servidor creado con ATPS.
+ * 			Los datos se copian, el buffer puede reutilizarse al retornar.
+ * @param	data: Datos a enviar.
+ * @param	len: Cantidad de bytes.
+ * @retval	1 si se encolo el envio, 0 si no hay bloque libre, la cola de
+ * 			comandos esta llena o no hay cliente.
+ */
+uint8_t BSP_WIFI_Send(const uint8_t *data, uint16_t len){
+	WifiMsg_TypeDef *msg;
+	uint16_t 		 pos = 0;
+
+	if(!BSP_WIFI_Ready() || sizeof(WifiMsg_TypeDef) + WIFI_MSG_HEADER + len > WIFI_MSG_LARGE){
+		return 0;
+	}
+	msg = mem_pool_set_alloc(wifi_pools, WIFI_POOLS, sizeof(WifiMsg_TypeDef) + WIFI_MSG_HEADER + len);
+	if(msg == NULL){
+		return 0;
+	}
+
+	msg->data[pos++] = 'A';
+	msg->data[pos++] = 'T';
+	msg->data[pos++] = 'P';
+	msg->data[pos++] = 'T';
+	msg->data[pos++] = '=';
+	pos += BSP_Utoa(&msg->data[pos], len);
+	msg->data[pos++] = ',';
+	pos += BSP_Utoa(&msg->data[pos], wifi_con_id);
+	msg->data[pos++] = ':';
+	for(uint16_t i = 0; i < len; i++){
+		msg->data[pos++] = data[i];
+	}
+	msg->cmd.cmd 	 = (const char *)msg->data;
+	msg->cmd.len 	 = pos;
+	msg->cmd.expect  = "OK";
+	msg->cmd.timeout = 1000;
+	msg->cmd.retries = 0;
+
+	if(!at_submit(&wifi_at, &msg->cmd, 1, BSP_WIFI_SendDone)){
+		mem_pool_set_free(wifi_pools, WIFI_POOLS, msg);
+		return 0;
+	}
+	/* Entran tantos como scripts en la cola AT, nunca se llena antes */
+	wifi_sent[wifi_sent_head] = msg;
+	wifi_sent_head = (wifi_sent_head + 1) % AT_QUEUE_SIZE;
+	return 1;
+}
+
+/**
+ * @brief	Fin de un envio, libera su bloque. Los envios terminan en el
+ * 			orden en que se encolaron.
+ */
+static void BSP_WIFI_SendDone(at_result_t result, uint8_t index){
+	mem_pool_set_free(wifi_pools, WIFI_POOLS, wifi_sent[wifi_sent_tail]);
+	wifi_sent_tail = (wifi_sent_tail + 1) % AT_QUEUE_SIZE;
+}
+
+/**
+ * @brief	Lineas del modulo que no responden a un comando.
+ * 			Toma el identificador de conexion de los avisos "con_id".
+ */
+static void BSP_WIFI_Urc(const char *line, uint8_t len){
+	uint32_t id = 0;
+	uint8_t  i;
+
+	for(i = 0; i + 7 < len; i++){
+		if(line[i] == 'c' && line[i+1] == 'o' && line[i+2] == 'n' && line[i+3] == '_' &&
+		   line[i+4] == 'i' && line[i+5] == 'd' && (line[i+6] == '=' || line[i+6] == ':')){
+			break;
+		}
+	}
+	if(i + 7 >= len || line[i+7] < '0' || line[i+7] > '9'){
+		return;
+	}
+	for(i += 7; i < len && line[i] >= '0' && line[i] <= '9'; i++){
+		id = id * 10 + (line[i] - '0');
+	}
+	wifi_con_id = (uint8_t)id;
+}
+
+/**
+ * @brief	Fin de la secuencia de inicializacion del modulo wifi.
+ * 			Si un comando termina en ERROR el modulo esta andando y se
+ * 			retoma desde ese comando, los anteriores ya quedaron hechos. Si
+ * 			no respondio pudo haberse reiniciado y se repite la secuencia
+ * 			completa.
+ */
+static void BSP_WIFI_InitDone(at_result_t result, uint8_t index){
+	if(result == AT_RESULT_OK){
+		wifi_bringup_ms = HAL_GetTick() - wifi_start_tick;
+		init_wifi = 0;
+		return;
+	}
+	wifi_init_from = result == AT_RESULT_ERROR ? wifi_init_from + index : 0;
+	at_submit(&wifi_at, &wifi_init_cmds[wifi_init_from], WIFI_INIT_CMDS - wifi_init_from, BSP_WIFI_InitDone);
+}
+
+/******************************************************************************
+ * 				     	     	MONITOR DE RUIDO 					      	  *
+ *****************************************************************************/
+
+/**
+ * @brief	Procesa una mitad del buffer del microfono.
+ * 			Se filtra directo desde el buffer del DMA (el filtro acepta las
+ * 			palabras del I2S sin invertir bytes) y el PCM pasa al medidor
+ * 			de nivel, sin copias intermedias.
+ * @param	half: Primera palabra de la mitad que termino el DMA.
+ */
+static void BSP_MIC_Block(uint16_t *half){
+	uint32_t start = DWT->CYCCNT;
+	uint8_t  head  = mic.head;
+	uint8_t  frame;
+
+	PDM_Filter(half, mic_pcm, &mic_filter);
+	mic_level_process(&mic, mic_pcm, MIC_PCM_SIZE, HAL_GetTick());
+	frame = spectrum_feed(&mic_spectrum, mic_pcm, MIC_PCM_SIZE, 1);
+
+	/* Una ventana de nivel o una trama de espectro terminada */
+	if(frame || mic.head != head){
+		BSP_Wake(sensor_task);
+	}
+
+	if(DWT->CYCCNT - start > MIC_BLOCK_BUDGET){
+		mic_over_budget++;
+	}
+	PROF_END(PROF_MIC_BLOCK, start);
+}
+
+/**
+ * @brief	Obtiene la proxima ventana de nivel terminada.
+ * 			Se llama desde una tarea, nunca desde una interrupcion.
+ * @param	record: Copia de la ventana.
+ * @retval	1 si habia una ventana, 0 si no.
+ */
+uint8_t BSP_MIC_Read(mic_record_t *record){
+	return mic_level_read(&mic, record);
+}
+
+/**
+ * @brief	Bloques de 1 ms que superaron MIC_BLOCK_BUDGET ciclos.
+ */
+uint32_t BSP_MIC_GetOverBudget(void){
+	return mic_over_budget;
+}
+
+/**
+ * @brief	Analiza la trama de espectro pendiente, si la hay, y suma la
+ * 			energia de cada banda. Se llama desde una tarea: la FFT no
+ * 			entra en el presupuesto del bloque de 1 ms.
+ */
+void BSP_MIC_Spectrum(void){
+	uint32_t t;
+
+	if(!spectrum_ready(&mic_spectrum)){
+		return;
+	}
+	t = PROF_BEGIN();
+	spectrum_run(&mic_spectrum);
+	for(int b = 0; b < MIC_BANDS; b++){
+		mic_band_sum[b] += spectrum_band(&mic_spectrum, mic_band_bin[b], mic_band_bin[b + 1]);
+	}
+	mic_band_frames++;
+	PROF_END(PROF_MIC_SPECTRUM, t);
+}
+
+/**
+ * @brief	Nivel medio de cada banda de octava desde la ultima lectura.
+ * @param	level_x10: MIC_BANDS niveles en 0.1 dB SPL.
+ * @retval	1 si habia tramas analizadas, 0 si no.
+ */
+uint8_t BSP_MIC_ReadBands(int16_t *level_x10){
+	if(mic_band_frames == 0){
+		return 0;
+	}
+	for(int b = 0; b < MIC_BANDS; b++){
+		level_x10[b] 	= mic_level_db_x10(mic_band_sum[b] / mic_band_frames, MIC_SPL_OFFSET);
+		mic_band_sum[b] = 0.0f;
+	}
+	mic_band_frames = 0;
+	return 1;
+}
+
+/******************************************************************************
+ * 				     	     	  VIBRACION 					      	      	  *
+ *****************************************************************************/
+
+/**
+ * @brief	Obtiene el proximo bloque de muestras del acelerometro.
+ * 			Se llama desde una tarea, nunca desde una interrupcion.
+ * @param	block: Copia del bloque, muestras crudas X, Y, Z.
+ * @retval	1 si habia un bloque, 0 si no.
+ */
+uint8_t BSP_ACCEL_Read(accel_block_t *block){
+	if(!accel_ok){
+		return 0;
+	}
+	/* Si se perdio una lectura la FIFO queda llena con la linea en alto y
+	   sin flancos nuevos: la relanzamos desde aca */
+	taskENTER_CRITICAL();
+	if(!accel.busy && HAL_GPIO_ReadPin(ACCELERO_INT_GPIO_PORT, ACCELERO_INT1_PIN) == GPIO_PIN_SET){
+		accel_stream_watermark(&accel, HAL_GetTick());
+	}
+	taskEXIT_CRITICAL();
+	return accel_stream_read(&accel, block);
+}
+
+/**
+ * @brief	Analiza la trama de vibracion cuando BSP_IMU_Update la completa.
+ * @param	level: Nivel de vibracion del eje Z entre VIB_BAND_LOW y
+ * 			VIB_BAND_HIGH, en dB re 1 mg.
+ * @retval	1 si hay un nivel nuevo, 0 si no.
+ */
+uint8_t BSP_VIB_Read(float *level){
+	uint32_t t;
+	float 	 ms;
+
+	if(!spectrum_ready(&vib_spectrum)){
+		return 0;
+	}
+	t = PROF_BEGIN();
+	spectrum_run(&vib_spectrum);
+	ms = spectrum_band(&vib_spectrum, spectrum_bin(&vib_spectrum, VIB_BAND_LOW, VIB_RATE),
+					   spectrum_bin(&vib_spectrum, VIB_BAND_HIGH, VIB_RATE));
+	*level = mic_level_db_x10(ms, VIB_MG_OFFSET) / 10.0f;
+	PROF_END(PROF_VIB_SPECTRUM, t);
+	return 1;
+}
+
+/******************************************************************************
+ * 				     	     	  GIROSCOPO 					      	      	  *
+ *****************************************************************************/
+
+/**
+ * @brief	Obtiene el proximo bloque de muestras crudas del giroscopo.
+ * 			Se llama desde una tarea, nunca desde una interrupcion.
+ * @param	block: Copia del bloque, muestras crudas X, Y, Z.
+ * @retval	1 si habia un bloque, 0 si no.
+ */
+uint8_t BSP_GYRO_Read(accel_block_t *block){
+	if(!gyro_ok){
+		return 0;
+	}
+	/* Igual que en el acelerometro: una lectura perdida deja la linea
+	   INT2 en alto sin flancos nuevos */
+	taskENTER_CRITICAL();
+	if(!gyro.busy && HAL_GPIO_ReadPin(GYRO_INT_GPIO_PORT, GYRO_INT2_PIN) == GPIO_PIN_SET){
+		accel_stream_watermark(&gyro, HAL_GetTick());
+	}
+	taskEXIT_CRITICAL();
+	return accel_stream_read(&gyro, block);
+}
+
+/**
+ * @brief	Tasa de datos sostenida del giroscopo: muestras que llegaron
+ * 			por DMA desde la llamada anterior.
+ * @retval	Muestras por segundo.
+ */
+float BSP_GYRO_GetRate(void){
+	uint32_t now 	 = HAL_GetTick();
+	uint32_t samples = gyro.samples;
+	float 	 rate 	 = 0.0f;
+
+	if(now != gyro_rate_tick){
+		rate = (samples - gyro_rate_samples) * 1000.0f / (now - gyro_rate_tick);
+	}
+	gyro_rate_tick 	  = now;
+	gyro_rate_samples = samples;
+	return rate;
+}
+
+/******************************************************************************
+ * 				     	     	  ORIENTACION 					      	      	  *
+ *****************************************************************************/
+
+/**
+ * @brief	Lee el magnetometro y actualiza la referencia de la orientacion.
+ * 			Comparte el I2C1 con las rafagas del acelerometro: se toma el
+ * 			bus entre dos transferencias y la marca de agua que llegue
+ * 			mientras tanto se atiende al soltarlo.
+ */
+static void BSP_MAG_Read(void){
+	int16_t xyz[3];
+	uint8_t claimed;
+
+	if(!mag_ok){
+		return;
+	}
+	taskENTER_CRITICAL();
+	claimed = accel_stream_claim(&accel);
+	taskEXIT_CRITICAL();
+	if(!claimed){
+		return;
+	}
+	LSM303DLHC_MagReadXYZ(xyz);
+	taskENTER_CRITICAL();
+	accel_stream_release(&accel, HAL_GetTick());
+	taskEXIT_CRITICAL();
+
+	ahrs_set_mag(&ahrs, (float)(xyz[0] - MAG_OFFSET_X), (float)(xyz[1] - MAG_OFFSET_Y),
+				 (float)(xyz[2] - MAG_OFFSET_Z) * MAG_Z_GAIN);
+}
+
+/**
+ * @brief	Vacia los bloques del acelerometro y del giroscopo.
+ * 			El acelerometro alimenta el espectro de vibracion y su promedio
+ * 			por bloque es la referencia de gravedad; cada muestra del
+ * 			giroscopo es un paso de la orientacion. Se llama desde una
+ * 			tarea, nunca desde una interrupcion.
+ */
+void BSP_IMU_Update(void){
+	accel_block_t block;
+	int32_t 	  sum[3];
+	uint8_t 	  mag_read = 0;
+	uint32_t 	  t;
+
+	while(BSP_ACCEL_Read(&block)){
+		spectrum_feed(&vib_spectrum, &block.xyz[0][2], block.count, 3);
+		sum[0] = sum[1] = sum[2] = 0;
+		for(int i = 0; i < block.count; i++){
+			sum[0] += block.xyz[i][0];
+			sum[1] += block.xyz[i][1];
+			sum[2] += block.xyz[i][2];
+		}
+		ahrs_set_acc(&ahrs, (float)sum[0], (float)sum[1], (float)sum[2]);
+	}
+
+	while(BSP_GYRO_Read(&block)){
+		/* El campo magnetico cambia despacio: una lectura por llamada */
+		if(!mag_read){
+			BSP_MAG_Read();
+			mag_read = 1;
+		}
+		for(int i = 0; i < block.count; i++){
+			t = PROF_BEGIN();
+			ahrs_update(&ahrs, block.xyz[i][0] * GYRO_RAD_PER_LSB,
+						block.xyz[i][1] * GYRO_RAD_PER_LSB,
+						block.xyz[i][2] * GYRO_RAD_PER_LSB);
+			PROF_END(PROF_AHRS, t);
+		}
+	}
+}
+
+/**
+ * @brief	Indica si la orientacion ya tiene datos del giroscopo y una
+ * 			referencia de gravedad.
+ */
+uint8_t BSP_IMU_Ready(void){
+	return ahrs.updates > 0 && ahrs.has_acc;
+}
+
+/**
+ * @brief	Inclinacion del mastil: angulo entre el eje Z de la placa y la
+ * 			vertical.
+ * @retval	Grados, 0 a 180.
+ */
+float BSP_IMU_GetTilt(void){
+	return ahrs_tilt(&ahrs);
+}
+
+/**
+ * @brief	Rumbo del eje X de la placa respecto del norte magnetico.
+ * @retval	Grados en sentido horario, 0 a 360.
+ */
+float BSP_IMU_GetHeading(void){
+	return ahrs_heading(&ahrs);
+}
+
+/******************************************************************************
+ * 				     	   CONSOLA DE DEPURACION 						      *
+ *****************************************************************************/
+
+/**
+ * @brief	Tarea que se despierta cuando llegan comandos por USART1.
+ * @param	task: Tarea de consola, NULL para ninguna.
+ */
+void BSP_CONSOLE_Attach(TaskHandle_t task){
+	console_task = task;
+}
+
+/**
+ * @brief	Saca los comandos recibidos por USART1, en orden.
+ * @param	data: Destino de los bytes.
+ * @param	max:  Bytes como maximo.
+ * @retval	Bytes leidos, 0 si no habia ninguno.
+ */
+uint16_t BSP_CONSOLE_Read(uint8_t *data, uint16_t max){
+	return spsc_read(&console_rx, data, max);
+}
+
+/**
+ * @brief	Tarea que se despierta cuando hay bloques nuevos del microfono,
+ * 			del acelerometro o del giroscopo.
+ * @param	task: Tarea de muestreo, NULL para ninguna.
+ */
+void BSP_SENSOR_Attach(TaskHandle_t task){
+	sensor_task = task;
+}
+
+/* Avisa a una tarea desde una interrupcion */
+static void BSP_Wake(TaskHandle_t task){
+	BaseType_t woken = pdFALSE;
+
+	if(task != NULL){
+		vTaskNotifyGiveFromISR(task, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+}
+
+/* Llega un comando con el canal vacio: despertamos a la tarea de consola */
+static void BSP_CONSOLE_Notify(void *ctx){
+	BSP_Wake(console_task);
+}
+
+/******************************************************************************
+ * 				     	     	REGISTRO EN FLASH 					      	      *
+ *****************************************************************************/
+
+/**
+ * @brief	Agrega un bloque de datos al registro en flash, en orden de
+ * 			llegada. Lo programa en el momento (unos 16 us por palabra).
+ * @param	data: Datos a guardar.
+ * @param	len:  Cantidad de bytes, hasta FLASH_LOG_RECORD_MAX.
+ * @retval	1 si se guardo, 0 si no habia lugar o fallo la flash.
+ */
+uint8_t BSP_LOG_Append(const uint8_t *data, uint16_t len){
+	uint32_t t = PROF_BEGIN();
+	uint8_t  ok;
+
+	if(!log_ok){
+		return 0;
+	}
+	ok = flash_log_append(&flog, data, len);
+	PROF_END(PROF_LOG_APPEND, t);
+	return ok;
+}
+
+/**
+ * @brief	Mantiene borrado el proximo sector del registro.
+ * 			Se llama desde la misma tarea que BSP_LOG_Append. El borrado
+ * 			lo termina la interrupcion de la flash; mientras dura (1 s
+ * 			por sector de 128 KB) la CPU se frena en cada acceso a flash.
+ * 			Los DMA siguen andando pero sus buffers circulares y las FIFO
+ * 			de los sensores se pisan: se pierde ese segundo de muestras.
+ */
+void BSP_LOG_Process(void){
+	if(log_ok){
+		flash_log_poll(&flog);
+	}
+}
+
+/**
+ * @brief	Tramas que no se pudieron guardar.
+ */
+uint32_t BSP_LOG_GetLost(void){
+	return flog.lost;
+}
+
+/******************************************************************************
+ * 				     	     	  BAJO CONSUMO 					      	      *
+ *****************************************************************************/
+
+/**
+ * @brief	Base de tiempo de la HAL.
+ * 			Con tickless idle el SysTick no interrumpe mientras el micro
+ * 			duerme, asi que uwTick atrasa. Una vez arrancado el scheduler
+ * 			usamos su cuenta, que se corrige al despertar.
+ * @retval	Tiempo en ms desde el arranque.
+ */
+uint32_t HAL_GetTick(void){
+	if(xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED){
+		return xTaskGetTickCount();
+	}
+	return uwTick;
+}
+
+/**
+ * @brief	Duerme el micro hasta la proxima tarea a despertar.
+ * 			La llama la tarea idle (portSUPPRESS_TICKS_AND_SLEEP) con el
+ * 			scheduler suspendido: el SysTick se reprograma al proximo
+ * 			vencimiento y cualquier interrupcion (DMA del ADC, USART, TIM)
+ * 			despierta antes.
+ * @param	idle_ticks: Ticks hasta la proxima tarea bloqueada por tiempo.
+ */
+void BSP_SuppressTicksAndSleep(uint32_t idle_ticks){
+	TickType_t start = xTaskGetTickCount();
+
+	/* El clock de la interfaz de flash se apaga en sleep: no dormimos
+	   con un borrado en curso */
+	if(log_ok && flog.erasing != FLASH_LOG_NONE){
+		return;
+	}
+	vPortSuppressTicksAndSleep(idle_ticks);
+	sleep_ticks += xTaskGetTickCount() - start;
+	sleep_count++;
+}
+
+/**
+ * @brief	Tiempo total que el micro paso dormido.
+ * @retval	Tiempo en ms.
+ */
+uint32_t BSP_PWR_GetSleepTime(void){
+	return sleep_ticks;
+}
+
+/**
+ * @brief	Cantidad de veces que el micro entro en sleep.
+ */
+uint32_t BSP_PWR_GetSleepCount(void){
+	return sleep_count;
+}
+
+/**
+ * @brief	Apaga en sleep los clocks que nadie usa mientras el micro duerme.
+ * 			La SRAM, los GPIO, el DMA y los perifericos con DMA siguen
+ * 			andando; el acceso a flash y la CRC solo los usa la CPU.
+ */
+void BSP_PWR_Init(){
+	__HAL_RCC_FLITF_CLK_SLEEP_DISABLE();
+	__HAL_RCC_CRC_CLK_SLEEP_DISABLE();
+}
+
+/******************************************************************************
+ * 				     	ESTADISTICAS DE EJECUCION 							  *
+ *****************************************************************************/
+
+/**
+ * @brief	Arranca el contador de las estadisticas de ejecucion: TIM3 cuenta
+ * 			a RTOS_RUN_TIME_HZ y cada desborde suyo avanza TIM4, juntos son
+ * 			un contador de 32 bits que sigue andando mientras el micro duerme
+ * 			y no genera interrupciones. Lo llama vTaskStartScheduler
+ * 			(portCONFIGURE_TIMER_FOR_RUN_TIME_STATS).
+ */
+void BSP_RUNTIME_Init(void){
+	BSP_TIM4_Init();
+	BSP_TIM3_Init();
+	HAL_TIM_Base_Start(&htim4);
+	HAL_TIM_Base_Start(&htim3);
+}
+
+/**
+ * @brief	Valor del contador de las estadisticas de ejecucion.
+ * @retval	Cuentas de RTOS_RUN_TIME_HZ, vuelve a 0 cada ~71 minutos.
+ */
+uint32_t BSP_RUNTIME_GetCounter(void){
+	uint16_t high, low;
+
+	/* Lo llama el cambio de contexto: una lectura de cada parte y se repite
+	   solo en un desborde de TIM3, si TIM4 cambio entre sus dos lecturas o
+	   si la parte baja quedo en 0 (TIM4 avanza unos ciclos despues del
+	   desborde y puede no haberlo hecho todavia). Una vez cada 65 ms */
+	do{
+		high = TIM4->CNT;
+		low  = TIM3->CNT;
+	}while(TIM4->CNT != high || low == 0);
+	return ((uint32_t)high << 16) | low;
 }
 
 /******************************************************************************
  * 				     	CALLBACKS DE INTERRUPCIONES 						  *
  *****************************************************************************/
 
+/* El DMA avanzo media vuelta o una vuelta completa del buffer circular */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart){
+	if(huart->Instance == USART2){
+		uart_rx_update(&wifi_rx);
+	}
+}
+
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart){
 	if(huart->Instance == USART2){
-		/* Shift de bytes */
-		for(uint8_t i=BUFFER_SIZE - 1; i>0; i--){
-			rx_buffer[i] = rx_buffer[i-1];
-		}
-		rx_buffer[0] = rx_data;
-
-		/* Verificamos si llego un OK */
-		if(rx_data == 79 && check_ok == 0)
-			check_ok = 1;
-		else if (rx_data == 75 && check_ok == 1)
-			check_ok = 2;
-
-		/* Checkeamos si hay que inicializar el Access Point */
-		if(check_ok == 2){
-			check_ok = 0;
-			uint8_t command[30];
-			if(init_wifi == 1){
-				/* Seteamos el modo wifi del modulo */
-				sprintf((char *)command, "ATPW=2\r\n");
-				HAL_UART_Transmit_IT(&huart2, command, 8);
-
-				/* Pasamos a la siguiente etapa*/
-				init_wifi++;
-			}
-			else if (init_wifi == 2){
-				/* Configuramos el Acess Point */
-				sprintf((char *)command, "ATPA=MICRO2022,,11,0\r\n");
-				HAL_UART_Transmit_IT(&huart2, command, 23);
-
-				/* Pasamos a la siguiente etapa*/
-				init_wifi++;
-			}
-			else if (init_wifi == 3){
-				/* Configuramos para que la asignacion de IP sea dinamica DHCP*/
-				sprintf((char *)command, "ATPH=1,1\r\n");
-				HAL_UART_Transmit_IT(&huart2, command, 10);
-
-				/* Pasamos a la siguiente etapa*/
-				init_wifi++;
-			}
-			else if (init_wifi == 4){
-				/* Creamos un servidor TCP en el puerto 3000 */
-				sprintf((char *)command, "ATPS=0,3001\r\n");
-				HAL_UART_Transmit_IT(&huart2, command, 13);
-				/* Pasamos a la siguiente etapa*/
-				init_wifi++;
-			}
-			else if (init_wifi == 5){
-				/* Iniciamos el Web Server */
-				sprintf((char *)command, "ATSW=c\r\n");
-				HAL_UART_Transmit_IT(&huart2, command, 8);
-
-				/* Pasamos a la siguiente etapa*/
-				init_wifi++;
-			}
-			else if (init_wifi == 6){
-				/* Finalizamos la inicializacion */
-				init_wifi = 0;
-			}
-		}
+		uart_rx_update(&wifi_rx);
+	}
+	/* Consola de depuracion: el comando pasa a su tarea sin copiar en cola */
+	else if(huart->Instance == USART1){
+		spsc_write(&console_rx, &debug_cmd, 1);
+		HAL_UART_Receive_IT(&huart1, &debug_cmd, 1);
+	}
+}
+
+/* El DMA del ADC lleno una mitad del buffer: la procesamos mientras llena la otra */
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc){
+	uint32_t t = PROF_BEGIN();
 
-		/* Recibimos el siguiente byte */
-		HAL_UART_Receive_IT(&huart2, &rx_data, 1);
+	if(hadc->Instance == ADC1){
+		adc_acq_process(&adc_acq, &adc_acq.buffer[0], HAL_GetTick());
+	}
+	PROF_END(PROF_ADC_BLOCK, t);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc){
+	uint32_t t = PROF_BEGIN();
+
+	if(hadc->Instance == ADC1){
+		adc_acq_process(&adc_acq, &adc_acq.buffer[ADC_ACQ_HALF], HAL_GetTick());
+	}
+	PROF_END(PROF_ADC_BLOCK, t);
+}
+
+/* Flanco en la linea del DHT11 */
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim){
+	if(htim->Instance == TIM2){
+		dht11_capture_isr(&dht);
+	}
+}
+
+/* Termino un envio por DMA: liberamos el descriptor y seguimos con la cola */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart){
+	if(huart->Instance == USART2){
+		uart_tx_complete_isr(&wifi_tx);
+		BSP_Wake(wifi_task);
+	}
+}
+
+/* El DMA del I2S2 lleno una mitad del buffer del microfono */
+void BSP_AUDIO_IN_HalfTransfer_CallBack(void){
+	BSP_MIC_Block(&mic_pdm[0]);
+}
+
+void BSP_AUDIO_IN_TransferComplete_CallBack(void){
+	BSP_MIC_Block(&mic_pdm[INTERNAL_BUFF_SIZE / 2]);
+}
+
+/* La FIFO del acelerometro o del giroscopo llego a la marca de agua */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin){
+	if(GPIO_Pin == ACCELERO_INT1_PIN){
+		accel_stream_watermark(&accel, HAL_GetTick());
+	}
+	else if(GPIO_Pin == GYRO_INT2_PIN){
+		accel_stream_watermark(&gyro, HAL_GetTick());
+	}
+}
+
+/* Termino la lectura en rafaga de la FIFO: si la linea sigue en alto
+   quedo otro bloque completo y se lee enseguida */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c){
+	if(hi2c->Instance == DISCOVERY_I2Cx){
+		accel_stream_done(&accel, HAL_GetTick(),
+						  HAL_GPIO_ReadPin(ACCELERO_INT_GPIO_PORT, ACCELERO_INT1_PIN) == GPIO_PIN_SET);
+		BSP_Wake(sensor_task);
+	}
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c){
+	if(hi2c->Instance == DISCOVERY_I2Cx){
+		accel_stream_error(&accel);
+	}
+}
+
+/* Lo mismo para el giroscopo por SPI: primero se libera el chip select */
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi){
+	if(hspi->Instance == DISCOVERY_SPIx){
+		GYRO_IO_ReadDone();
+		accel_stream_done(&gyro, HAL_GetTick(),
+						  HAL_GPIO_ReadPin(GYRO_INT_GPIO_PORT, GYRO_INT2_PIN) == GPIO_PIN_SET);
+		BSP_Wake(sensor_task);
+	}
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi){
+	if(hspi->Instance == DISCOVERY_SPIx){
+		GYRO_IO_ReadDone();
+		accel_stream_error(&gyro);
+	}
+}
+
+/* Termino el borrado de un sector del registro: la HAL avisa cada sector
+   y al final de la operacion con 0xFFFFFFFF */
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue){
+	if(ReturnValue == 0xFFFFFFFFU){
+		flash_log_erase_done(&flog, 1);
+		BSP_Wake(wifi_task);
+	}
+}
+
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue){
+	flash_log_erase_done(&flog, 0);
+	BSP_Wake(wifi_task);
+}
+
+/* Un error de recepcion puede abortar el DMA: lo volvemos a lanzar y si
+   no arranca lo reintenta la tarea del wifi */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart){
+	if(huart->Instance == USART2){
+		wifi_rx_errors++;
+		if(uart_rx_restart(&wifi_rx) != HAL_OK){
+			wifi_rx_down = 1;
+			BSP_Wake(wifi_task);
+		}
+	}
+	else if(huart->Instance == USART1){
+		HAL_UART_Receive_IT(&huart1, &debug_cmd, 1);
 	}
 }
 
@@ -306,6 +1217,13 @@ void BSP_Init(){
 	/* Configuracion de los clocks */
 	SystemClock_Config();
 
+	/* Contador de ciclos para el profiler y el registro de eventos */
+	prof_init();
+	trace_start();
+
+	/* Clocks que se apagan mientras el micro duerme */
+	BSP_PWR_Init();
+
 	/* Inicializacion de los LEDS */
 	BSP_LED_Init(LED_RED);
 	BSP_LED_Init(LED_GREEN);
@@ -314,23 +1232,49 @@ void BSP_Init(){
 
 	/* Inicializamos el sensor de luz */
 	BSP_LUZ_Init();
-	/* Inicializamos el conversor ADC */
+	/* Inicializamos el conversor ADC y su disparo por timer */
+	die_temp_init(&die_temp);
 	ADC1_Init();
-	/* Inicializamos el timer 3 */
-	BSP_TIM3_Init();
+	BSP_TIM5_Init();
+	if (adc_acq_start(&adc_acq, &hadc1) != HAL_OK) {
+		Error_Handler();
+	}
+	HAL_TIM_PWM_Start(&htim5, TIM_CHANNEL_1);
+	/* Inicializamos el timer 2, captura de flancos del DHT11 */
+	BSP_TIM2_Init();
+
+	/* Inicializamos la unidad de CRC, la usa la telemetria */
+	BSP_CRC_Init();
 
 	/* Inicializamos usart */
 	BSP_USART1_Init();
 	BSP_USART2_Init();
+	/* USART1 queda como consola de depuracion */
+	spsc_init(&console_rx, console_buffer, 1, CONSOLE_RX_SIZE);
+	spsc_set_notify(&console_rx, BSP_CONSOLE_Notify, NULL);
+	HAL_UART_Receive_IT(&huart1, &debug_cmd, 1);
 
 	/* Inicializamos el sensor de temperatura y humedad DHT11 */
 	BSP_DHT11_Init();
 
+	/* Inicializamos el microfono y el monitor de ruido */
+	BSP_MIC_Init();
+
+	/* Inicializamos el acelerometro en modo stream */
+	BSP_ACCEL_Init();
+
+	/* Inicializamos el giroscopo en modo stream */
+	BSP_GYRO_StreamInit();
+
+	/* Montamos el registro en flash, usa la unidad de CRC */
+	BSP_LOG_Init();
+
 	BSP_PB_Init(BUTTON_KEY, BUTTON_MODE_GPIO);
 }
 
 void BSP_DHT11_Init(){
-	init_dht11(&dht, &htim3, DHT11_USART_PORT, DHT11_USART_Tx_PIN);
+	init_dht11(&dht, &htim2, DHT11_TIM_CHANNEL, DHT11_USART_PORT,
+			   DHT11_USART_Tx_PIN, DHT11_TIM_AF);
 }
 
 void BSP_LUZ_Init(){
@@ -414,31 +1358,117 @@ void BSP_PB_Init(Button_TypeDef Button, ButtonMode_TypeDef ButtonMode)
   }
 }
 
+/*
+ * ADC1 en modo scan: cada flanco de TIM5 CC1 convierte la secuencia
+ * completa y el DMA la guarda en el buffer circular de adc_acq.
+ */
 void ADC1_Init(){
+	ADC_ChannelConfTypeDef sConfig = {0};
+
 	hadc1.Instance = ADC1;
 	hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV2;
 	hadc1.Init.Resolution = ADC_RESOLUTION_12B;
-	hadc1.Init.ScanConvMode = DISABLE;
+	hadc1.Init.ScanConvMode = ENABLE;
 	hadc1.Init.ContinuousConvMode = DISABLE;
 	hadc1.Init.DiscontinuousConvMode = DISABLE;
-	hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
-	hadc1.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+	hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+	hadc1.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T5_CC1;
 	hadc1.Init.DataAlign = ADC_DATAALIGN_RIGHT;
-	hadc1.Init.NbrOfConversion = 1;
-	hadc1.Init.DMAContinuousRequests = DISABLE;
-	hadc1.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
+	hadc1.Init.NbrOfConversion = ADC_ACQ_CHANNELS;
+	hadc1.Init.DMAContinuousRequests = ENABLE;
+	hadc1.Init.EOCSelection = ADC_EOC_SEQ_CONV;
 	if (HAL_ADC_Init(&hadc1) != HAL_OK) {
 		Error_Handler();
 	}
+
+	/* El sensor de temperatura necesita al menos 10us de muestreo */
+	sConfig.Channel = ADC_CHANNEL_TEMPSENSOR;
+	sConfig.Rank    = ADC_CH_TEMP + 1;
+	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+	if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK) {
+		Error_Handler();
+	}
+
+	sConfig.Channel = ADC_CHANNEL_1;
+	sConfig.Rank    = ADC_CH_SUELO + 1;
+	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+	if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK) {
+		Error_Handler();
+	}
+
+	/* VREFINT compensa la temperatura por la tension de alimentacion,
+	   tambien necesita 10us de muestreo */
+	sConfig.Channel = ADC_CHANNEL_VREFINT;
+	sConfig.Rank    = ADC_CH_VREF + 1;
+	sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+	if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK) {
+		Error_Handler();
+	}
 }
 
+/*
+ * TIM5 marca el ritmo de muestreo del ADC: 1 MHz / 1000 = 1 kHz por canal.
+ * CC1 no tiene pin asignado, solo dispara la conversion.
+ */
+void BSP_TIM5_Init(){
+	TIM_OC_InitTypeDef sConfigOC = {0};
+
+	htim5.Instance = TIM5;
+	htim5.Init.Prescaler = 47;
+	htim5.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim5.Init.Period = 999;
+	htim5.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	htim5.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	if (HAL_TIM_PWM_Init(&htim5) != HAL_OK)
+	{
+		Error_Handler();
+	}
+	sConfigOC.OCMode = TIM_OCMODE_PWM1;
+	sConfigOC.Pulse = 500;
+	sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+	sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+	if (HAL_TIM_PWM_ConfigChannel(&htim5, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
+
+
+/*
+ * TIM2 cuenta a 1 MHz y captura ambos flancos de la linea del DHT11 (PA15),
+ * asi la lectura no necesita deshabilitar interrupciones.
+ */
+void BSP_TIM2_Init(){
+	TIM_IC_InitTypeDef sConfigIC = {0};
+
+	htim2.Instance = TIM2;
+	htim2.Init.Prescaler = 47;
+	htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim2.Init.Period = 0xFFFFFFFF;
+	htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	if (HAL_TIM_IC_Init(&htim2) != HAL_OK)
+	{
+		Error_Handler();
+	}
+	sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_BOTHEDGE;
+	sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
+	sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
+	sConfigIC.ICFilter = 4;
+	if (HAL_TIM_IC_ConfigChannel(&htim2, &sConfigIC, DHT11_TIM_CHANNEL) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
 
 void BSP_TIM3_Init(){
 	  TIM_SlaveConfigTypeDef sSlaveConfig = {0};
 	  TIM_MasterConfigTypeDef sMasterConfig = {0};
 
+	  /* Parte baja del contador de ejecucion, el clock de los timers de
+	     APB1 es el doble de PCLK1 */
 	  htim3.Instance = TIM3;
-	  htim3.Init.Prescaler = 48;
+	  htim3.Init.Prescaler = HAL_RCC_GetPCLK1Freq() * 2 / RTOS_RUN_TIME_HZ - 1;
 	  htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
 	  htim3.Init.Period = 65535;
 	  htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
@@ -453,7 +1483,7 @@ void BSP_TIM3_Init(){
 	  {
 	    Error_Handler();
 	  }
-	  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+	  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
 	  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
 	  if (HAL_TIMEx_MasterConfigSynchronization(&htim3, &sMasterConfig) != HAL_OK)
 	  {
@@ -461,6 +1491,28 @@ void BSP_TIM3_Init(){
 	  }
 }
 
+void BSP_TIM4_Init(){
+	TIM_SlaveConfigTypeDef sSlaveConfig = {0};
+
+	/* Parte alta: cuenta los desbordes de TIM3 (ITR2) */
+	htim4.Instance = TIM4;
+	htim4.Init.Prescaler = 0;
+	htim4.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim4.Init.Period = 65535;
+	htim4.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	htim4.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	if (HAL_TIM_Base_Init(&htim4) != HAL_OK)
+	{
+		Error_Handler();
+	}
+	sSlaveConfig.SlaveMode = TIM_SLAVEMODE_EXTERNAL1;
+	sSlaveConfig.InputTrigger = TIM_TS_ITR2;
+	if (HAL_TIM_SlaveConfigSynchro(&htim4, &sSlaveConfig) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
+
 
 void BSP_USART1_Init(){
 	huart1.Instance = USART1;
@@ -492,14 +1544,114 @@ void BSP_USART2_Init(){
 	}
 }
 
-void BSP_WIFI_Init(){
-	uint8_t command[8];
-	sprintf((char *)command, "AT\r\n");
-	HAL_UART_Receive_IT(&huart2, &rx_data, 1);
-	HAL_UART_Transmit(&huart2, command, 4, 100);
+void BSP_CRC_Init(){
+	hcrc.Instance = CRC;
+	if (HAL_CRC_Init(&hcrc) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
 
-	/* Iniciamos la secuencia de comandos AT */
+void BSP_WIFI_Init(){
+	uart_rx_set_notify(&wifi_rx, BSP_WIFI_Notify, NULL);
+	uart_rx_start(&wifi_rx, &huart2, rx_buffer, BUFFER_SIZE);
+	uart_tx_init(&wifi_tx, &huart2);
+	at_init(&wifi_at, &wifi_tx, &wifi_rx, BSP_WIFI_Urc);
+	mem_pool_init(&wifi_pools[0], wifi_small_buffer, WIFI_MSG_SMALL, 4);
+	mem_pool_init(&wifi_pools[1], wifi_large_buffer, WIFI_MSG_LARGE, 2);
+
+	/* Iniciamos la secuencia de comandos AT, avanza en BSP_WIFI_Process */
 	init_wifi = 1;
+	wifi_start_tick = HAL_GetTick();
+	wifi_init_from = 0;
+	at_submit(&wifi_at, wifi_init_cmds, WIFI_INIT_CMDS, BSP_WIFI_InitDone);
+}
+
+void BSP_MIC_Init(){
+	/* Reloj del I2S, pines y DMA del microfono */
+	BSP_AUDIO_IN_Init(DEFAULT_AUDIO_IN_FREQ, DEFAULT_AUDIO_IN_BIT_RESOLUTION,
+					  DEFAULT_AUDIO_IN_CHANNEL_NBR);
+
+	/* Filtro PDM propio: lee las palabras del I2S tal como las deja el DMA */
+	mic_filter.bit_order 		= PDM_FILTER_BIT_ORDER_LSB;
+	mic_filter.endianness 		= PDM_FILTER_ENDIANNESS_BE;
+	mic_filter.high_pass_tap 	= 2122358088;
+	mic_filter.in_ptr_channels 	= 1;
+	mic_filter.out_ptr_channels = 1;
+	mic_filter_config.decimation_factor 	= PDM_FILTER_DEC_FACTOR_64;
+	mic_filter_config.output_samples_number = MIC_PCM_SIZE;
+	mic_filter_config.mic_gain 				= 0;
+	if (PDM_Filter_Init(&mic_filter) != 0 ||
+		PDM_Filter_setConfig(&mic_filter, &mic_filter_config) != 0) {
+		Error_Handler();
+	}
+
+	mic_level_init(&mic, DEFAULT_AUDIO_IN_FREQ, MIC_WINDOW_MS, MIC_LEQ_WINDOWS, MIC_SPL_OFFSET);
+	spectrum_init(&mic_spectrum, MIC_FFT_SIZE, mic_fft_frame, mic_fft_work);
+	for(int b = 0; b <= MIC_BANDS; b++){
+		mic_band_bin[b] = spectrum_bin(&mic_spectrum, mic_band_hz[b], DEFAULT_AUDIO_IN_FREQ);
+	}
+	BSP_AUDIO_IN_Record(mic_pdm, INTERNAL_BUFF_SIZE);
+}
+
+void BSP_ACCEL_Init(){
+	uint16_t ctrl;
+
+	/* 400 Hz, alta resolucion, +-2 g; inicializa el I2C1 y su DMA */
+	ctrl = LSM303DLHC_NORMAL_MODE | LSM303DLHC_ODR_400_HZ | LSM303DLHC_AXES_ENABLE;
+	ctrl |= (LSM303DLHC_BlockUpdate_Continous | LSM303DLHC_BLE_LSB |
+			 LSM303DLHC_FULLSCALE_2G | LSM303DLHC_HR_ENABLE) << 8;
+	LSM303DLHC_AccInit(ctrl);
+	if (LSM303DLHC_AccReadID() != I_AM_LMS303DLHC) {
+		return;
+	}
+
+	/* Magnetometro del mismo chip: 75 Hz, +-1.3 Ga, conversion continua */
+	LSM303DLHC_MagInit(LSM303DLHC_TEMPSENSOR_DISABLE | LSM303DLHC_ODR_75_HZ |
+					   (LSM303DLHC_FS_1_3_GA << 8) | ((uint32_t)LSM303DLHC_CONTINUOS_CONVERSION << 16));
+	mag_ok = LSM303DLHC_MagReadID() == I_AM_LSM303DLHC_M;
+
+	accel_stream_init(&accel, LSM303DLHC_AccFifoRead_DMA, ACCEL_WATERMARK);
+	spectrum_init(&vib_spectrum, VIB_FFT_SIZE, vib_frame, vib_work);
+
+	/* Marca de agua de la FIFO por INT1 (PE4, EXTI4) */
+	COMPASSACCELERO_IO_ITConfig();
+	LSM303DLHC_AccFifoConfig(LSM303DLHC_FIFOMODE_STREAM, ACCEL_WATERMARK);
+	LSM303DLHC_AccIT1Enable(LSM303DLHC_IT1_WTM);
+	accel_ok = 1;
+}
+
+void BSP_GYRO_StreamInit(){
+	uint16_t ctrl;
+	uint8_t  id;
+
+	/* 760 Hz, corte de 100 Hz, 500 dps; inicializa el SPI1 y su DMA */
+	ctrl = L3GD20_MODE_ACTIVE | L3GD20_OUTPUT_DATARATE_4 | L3GD20_AXES_ENABLE | L3GD20_BANDWIDTH_4;
+	ctrl |= (L3GD20_BlockDataUpdate_Continous | L3GD20_BLE_LSB | L3GD20_FULLSCALE_500) << 8;
+	L3GD20_Init(ctrl);
+	id = L3GD20_ReadID();
+	if (id != I_AM_L3GD20 && id != I_AM_L3GD20_TR) {
+		return;
+	}
+
+	accel_stream_init(&gyro, L3GD20_FifoRead_DMA, GYRO_WATERMARK);
+	ahrs_init(&ahrs, GYRO_RATE, AHRS_KP, AHRS_KI);
+
+	/* Marca de agua de la FIFO por INT2 (PE1, EXTI1) */
+	GYRO_IO_ITConfig();
+	L3GD20_FifoConfig(L3GD20_FIFOMODE_STREAM, GYRO_WATERMARK);
+	L3GD20_INT2InterruptConfig(L3GD20_INT2_WTM);
+	gyro_ok = 1;
+}
+
+void BSP_LOG_Init(){
+	/* Solo lee los encabezados: los sectores a borrar los atiende
+	   BSP_LOG_Process desde su tarea */
+	log_ok = flash_log_mount(&flog, &hcrc, LOG_BASE, LOG_FIRST_SECTOR, LOG_SECTORS, LOG_SECTOR_SIZE);
+
+	/* Fin del borrado por interrupcion */
+	HAL_NVIC_SetPriority(FLASH_IRQn, 0x0F, 0x00);
+	HAL_NVIC_EnableIRQ(FLASH_IRQn);
 }
 
 /******************************************************************************
@@ -521,6 +1673,30 @@ void HAL_ADC_MspInit(ADC_HandleTypeDef* adcHandle) {
     GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    /*
+     * ADC1 DMA Init
+     * ADC1 ------> DMA2 Stream0 Channel0 (circular)
+     */
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    hdma_adc1.Instance = DMA2_Stream0;
+    hdma_adc1.Init.Channel = DMA_CHANNEL_0;
+    hdma_adc1.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_adc1.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_adc1.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_adc1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_adc1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_adc1.Init.Mode = DMA_CIRCULAR;
+    hdma_adc1.Init.Priority = DMA_PRIORITY_MEDIUM;
+    hdma_adc1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_adc1) != HAL_OK) {
+      Error_Handler();
+    }
+    __HAL_LINKDMA(adcHandle, DMA_Handle, hdma_adc1);
+
+    /* DMA2 Stream0 interrupt Init */
+    HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, IRQ_PRIO_STREAM, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
   }
 }
 
@@ -534,20 +1710,86 @@ void HAL_ADC_MspDeInit(ADC_HandleTypeDef* adcHandle){
      * PA1 ------> ADC1_IN1
     */
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_1);
+
+    /* ADC1 DMA DeInit */
+    HAL_DMA_DeInit(adcHandle->DMA_Handle);
+    HAL_NVIC_DisableIRQ(DMA2_Stream0_IRQn);
   }
 }
 
 
+void HAL_CRC_MspInit(CRC_HandleTypeDef* crcHandle)
+{
+  if(crcHandle->Instance==CRC)
+  {
+    /* CRC clock enable */
+    __HAL_RCC_CRC_CLK_ENABLE();
+  }
+}
+
+void HAL_CRC_MspDeInit(CRC_HandleTypeDef* crcHandle)
+{
+  if(crcHandle->Instance==CRC)
+  {
+    /* Peripheral clock disable */
+    __HAL_RCC_CRC_CLK_DISABLE();
+  }
+}
+
 void HAL_TIM_Base_MspInit(TIM_HandleTypeDef* tim_baseHandle)
 {
   if(tim_baseHandle->Instance==TIM3)
   {
-    /* TIM3 clock enable */
+    /* TIM3 clock enable, sin interrupcion: solo se lee el contador */
     __HAL_RCC_TIM3_CLK_ENABLE();
+  }
+  else if(tim_baseHandle->Instance==TIM4)
+  {
+    /* TIM4 clock enable */
+    __HAL_RCC_TIM4_CLK_ENABLE();
+  }
+}
 
-    /* TIM3 interrupt Init */
-    HAL_NVIC_SetPriority(TIM3_IRQn, 0, 0);
-    HAL_NVIC_EnableIRQ(TIM3_IRQn);
+void HAL_TIM_IC_MspInit(TIM_HandleTypeDef* tim_icHandle)
+{
+  if(tim_icHandle->Instance==TIM2)
+  {
+    /* TIM2 clock enable */
+    __HAL_RCC_TIM2_CLK_ENABLE();
+
+    /* TIM2 interrupt Init */
+    HAL_NVIC_SetPriority(TIM2_IRQn, IRQ_PRIO_CAPTURE, 0);
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+  }
+}
+
+void HAL_TIM_IC_MspDeInit(TIM_HandleTypeDef* tim_icHandle)
+{
+  if(tim_icHandle->Instance==TIM2)
+  {
+    /* Peripheral clock disable */
+    __HAL_RCC_TIM2_CLK_DISABLE();
+
+    /* TIM2 interrupt Deinit */
+    HAL_NVIC_DisableIRQ(TIM2_IRQn);
+  }
+}
+
+void HAL_TIM_PWM_MspInit(TIM_HandleTypeDef* tim_pwmHandle)
+{
+  if(tim_pwmHandle->Instance==TIM5)
+  {
+    /* TIM5 clock enable */
+    __HAL_RCC_TIM5_CLK_ENABLE();
+  }
+}
+
+void HAL_TIM_PWM_MspDeInit(TIM_HandleTypeDef* tim_pwmHandle)
+{
+  if(tim_pwmHandle->Instance==TIM5)
+  {
+    /* Peripheral clock disable */
+    __HAL_RCC_TIM5_CLK_DISABLE();
   }
 }
 
@@ -557,9 +1799,11 @@ void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef* tim_baseHandle)
   {
     /* Peripheral clock disable */
     __HAL_RCC_TIM3_CLK_DISABLE();
-
-    /* TIM3 interrupt Deinit */
-    HAL_NVIC_DisableIRQ(TIM3_IRQn);
+  }
+  else if(tim_baseHandle->Instance==TIM4)
+  {
+    /* Peripheral clock disable */
+    __HAL_RCC_TIM4_CLK_DISABLE();
   }
 }
 
@@ -573,10 +1817,10 @@ void HAL_UART_MspInit(UART_HandleTypeDef* uartHandle) {
     __HAL_RCC_GPIOB_CLK_ENABLE();
     /*
     USART1 GPIO Configuration
-    PA15  ------> USART1_TX
+    PA9   ------> USART1_TX
     PB7   ------> USART1_RX
     */
-    GPIO_InitStruct.Pin = GPIO_PIN_15;
+    GPIO_InitStruct.Pin = GPIO_PIN_9;
     GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
@@ -591,7 +1835,7 @@ void HAL_UART_MspInit(UART_HandleTypeDef* uartHandle) {
     HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
     /* USART1 interrupt Init */
-    HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(USART1_IRQn, IRQ_PRIO_CONSOLE, 0);
     HAL_NVIC_EnableIRQ(USART1_IRQn);
   }
   else if(uartHandle->Instance==USART2) {
@@ -610,8 +1854,50 @@ void HAL_UART_MspInit(UART_HandleTypeDef* uartHandle) {
     GPIO_InitStruct.Alternate = GPIO_AF7_USART2;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    /*
+     * USART2 DMA Init
+     * USART2_RX ------> DMA1 Stream5 Channel4 (circular)
+     */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    hdma_usart2_rx.Instance = DMA1_Stream5;
+    hdma_usart2_rx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_usart2_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK) {
+      Error_Handler();
+    }
+    __HAL_LINKDMA(uartHandle, hdmarx, hdma_usart2_rx);
+
+    /* USART2_TX ------> DMA1 Stream6 Channel4 */
+    hdma_usart2_tx.Instance = DMA1_Stream6;
+    hdma_usart2_tx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_usart2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK) {
+      Error_Handler();
+    }
+    __HAL_LINKDMA(uartHandle, hdmatx, hdma_usart2_tx);
+
+    /* DMA1 Stream5 and Stream6 interrupt Init */
+    HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, IRQ_PRIO_STREAM, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, IRQ_PRIO_STREAM, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
     /* USART2 interrupt Init */
-    HAL_NVIC_SetPriority(USART2_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(USART2_IRQn, IRQ_PRIO_STREAM, 0);
     HAL_NVIC_EnableIRQ(USART2_IRQn);
     }
 }
@@ -622,10 +1908,10 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle) {
 	  __HAL_RCC_USART1_CLK_DISABLE();
 	  /*
     	USART1 GPIO Configuration
-    	PA15  ------> USART1_TX
+    	PA9   ------> USART1_TX
     	PB7   ------> USART1_RX
 	   */
-	  HAL_GPIO_DeInit(GPIOA, GPIO_PIN_15);
+	  HAL_GPIO_DeInit(GPIOA, GPIO_PIN_9);
 	  HAL_GPIO_DeInit(GPIOB, GPIO_PIN_7);
 
 	  /* USART1 interrupt DeInit */
@@ -640,6 +1926,11 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle) {
   	  	  PA3     ------> USART2_RX
 	   */
 	  HAL_GPIO_DeInit(GPIOA, GPIO_PIN_2|GPIO_PIN_3);
+	  /* USART2 DMA DeInit */
+	  HAL_DMA_DeInit(uartHandle->hdmarx);
+	  HAL_DMA_DeInit(uartHandle->hdmatx);
+	  HAL_NVIC_DisableIRQ(DMA1_Stream5_IRQn);
+	  HAL_NVIC_DisableIRQ(DMA1_Stream6_IRQn);
 	  /* USART2 interrupt DeInit */
 	  HAL_NVIC_DisableIRQ(USART2_IRQn);
   }
@@ -0,0 +1,48 @@
+#include "die_temp.h"
+
+/* Datasheet typical values as counts at 3.3 V: 0.76 V at 25 C, 2.5 mV/C and
+   VREFINT 1.21 V. Used when the calibration area does not look programmed */
+#define DIE_TEMP_TYP_CAL1 		959
+#define DIE_TEMP_TYP_CAL2 		1207
+#define DIE_TEMP_TYP_VREFINT 	1502
+
+/**
+ * @brief reads the factory calibration and folds it into slope and offset
+ * @param dt:	struct to configure ex:&die_temp
+ * @return 1 with the calibration of the chip, 0 with typical values
+ */
+uint8_t die_temp_init(die_temp_t *dt)
+{
+	uint16_t cal1 = DIE_TEMP_TS_CAL1;
+	uint16_t cal2 = DIE_TEMP_TS_CAL2;
+	uint16_t vref = DIE_TEMP_VREFINT_CAL;
+	float 	 per_count;
+
+	//erased or out of range: 12 bit counts, VREFINT between 1.1 and 1.3 V
+	dt->factory = cal1 < cal2 && cal2 < 4096 && vref > 1365 && vref < 1614;
+	if(!dt->factory){
+		cal1 = DIE_TEMP_TYP_CAL1;
+		cal2 = DIE_TEMP_TYP_CAL2;
+		vref = DIE_TEMP_TYP_VREFINT;
+	}
+
+	per_count 	= (DIE_TEMP_CAL2_C - DIE_TEMP_CAL1_C) / (float)(cal2 - cal1);
+	dt->slope 	= per_count * (float)vref;
+	dt->offset 	= DIE_TEMP_CAL1_C - per_count * (float)cal1;
+	return dt->factory;
+}
+
+/**
+ * @brief converts one reading
+ * @param dt:	conversion constants
+ * @param ts:	sensor reading
+ * @param vref:	VREFINT reading of the same scan, same scale as ts
+ * @return temperature in C, 0 without a VREFINT reading
+ */
+float die_temp_celsius(const die_temp_t *dt, uint32_t ts, uint32_t vref)
+{
+	if(vref == 0){
+		return 0.0f;
+	}
+	return dt->slope * ((float)ts / (float)vref) + dt->offset;
+}
@@ -0,0 +1,365 @@
+#include <string.h>
+#include "flash_log.h"
+
+#define FLASH_LOG_WORD(addr) 	(*(volatile const uint32_t *)(uintptr_t)(addr))
+#define FLASH_LOG_HALF(addr) 	(*(volatile const uint16_t *)(uintptr_t)(addr))
+#define FLASH_LOG_ERASED_WORD 	0xFFFFFFFFu
+#define FLASH_LOG_MARKS 		16			// Offset of the marks in a sector
+
+static uint32_t flash_log_addr(const flash_log_t *log, uint8_t sector, uint32_t offset)
+{
+	return log->base + sector * log->sector_size + offset;
+}
+
+static uint8_t flash_log_header_ok(uint32_t word)
+{
+	uint16_t len = word & 0xFFFF;
+
+	return len > 0 && len <= FLASH_LOG_RECORD_MAX && (uint16_t)~len == (word >> 16);
+}
+
+//header + payload padded to words + CRC
+static uint32_t flash_log_size(uint16_t len)
+{
+	return 8 + ((len + 3u) & ~3u);
+}
+
+static uint8_t flash_log_program(uint32_t addr, uint32_t word)
+{
+	return HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, word) == HAL_OK;
+}
+
+static uint8_t flash_log_next(const flash_log_t *log)
+{
+	return log->head == FLASH_LOG_NONE ? 0 : (log->head + 1) % log->sectors;
+}
+
+/**
+ * @brief end of the records of a sector, from its marks
+ * @param marked:	last block with its mark set
+ * @return offset after the last record, sector_size if a torn header closed it
+ */
+static uint32_t flash_log_end(const flash_log_t *log, uint8_t sector, int32_t *marked)
+{
+	uint32_t marks = flash_log_addr(log, sector, FLASH_LOG_MARKS);
+	int32_t  lo = 0, hi = log->blocks - 1, last = -1, mid;
+	uint32_t offset, word;
+
+	//programmed marks are a prefix
+	while(lo <= hi){
+		mid = (lo + hi) / 2;
+		if(FLASH_LOG_HALF(marks + 2 * mid) != 0xFFFF){
+			last = mid;
+			lo 	 = mid + 1;
+		}
+		else{
+			hi = mid - 1;
+		}
+	}
+	*marked = last;
+
+	//a torn mark points past its block, walk from the previous one
+	while(last >= 0 && FLASH_LOG_HALF(marks + 2 * last) >= FLASH_LOG_BLOCK / 4){
+		last--;
+	}
+	offset = log->data;
+	if(last >= 0){
+		offset += last * FLASH_LOG_BLOCK + FLASH_LOG_HALF(marks + 2 * last) * 4;
+	}
+
+	while(offset + 8 <= log->sector_size){
+		word = FLASH_LOG_WORD(flash_log_addr(log, sector, offset));
+		if(word == FLASH_LOG_ERASED_WORD){
+			return offset;
+		}
+		if(!flash_log_header_ok(word)){
+			break;
+		}
+		offset += flash_log_size(word & 0xFFFF);
+	}
+	return log->sector_size;
+}
+
+/**
+ * @brief opens the next sector as head: blank check and header
+ * @return 1 if opened, 0 if it still has to be erased
+ */
+static uint8_t flash_log_open(flash_log_t *log)
+{
+	uint8_t  sector = flash_log_next(log);
+	uint32_t seq 	= log->head == FLASH_LOG_NONE ? 0 : log->sequence[log->head] + 1;
+	uint32_t addr 	= flash_log_addr(log, sector, 0);
+	uint8_t  ok;
+
+	if(log->state[sector] != FLASH_LOG_ERASED){
+		return 0;
+	}
+	for(uint32_t a = addr; a < addr + log->sector_size; a += 4){
+		if(FLASH_LOG_WORD(a) != FLASH_LOG_ERASED_WORD){
+			log->state[sector] = FLASH_LOG_DIRTY;
+			return 0;
+		}
+	}
+
+	HAL_FLASH_Unlock();
+	ok = flash_log_program(addr, FLASH_LOG_MAGIC) && flash_log_program(addr + 4, seq) &&
+		 flash_log_program(addr + 8, ~seq);
+	HAL_FLASH_Lock();
+	if(!ok){
+		log->state[sector] = FLASH_LOG_DIRTY;
+		return 0;
+	}
+
+	log->state[sector] 	  = FLASH_LOG_LIVE;
+	log->sequence[sector] = seq;
+	log->head 			  = sector;
+	log->offset 		  = log->data;
+	log->marked 		  = -1;
+	return 1;
+}
+
+/**
+ * @brief retires a sector and starts its erase, flash_log_erase_done ends it
+ */
+static void flash_log_erase(flash_log_t *log, uint8_t sector)
+{
+	FLASH_EraseInitTypeDef erase;
+
+	erase.TypeErase 	= FLASH_TYPEERASE_SECTORS;
+	erase.Sector 		= log->first_sector + sector;
+	erase.NbSectors 	= 1;
+	erase.VoltageRange 	= FLASH_VOLTAGE_RANGE_3;
+
+	HAL_FLASH_Unlock();
+	//a cut during the erase must not leave a header that still validates
+	if(log->state[sector] == FLASH_LOG_LIVE){
+		flash_log_program(flash_log_addr(log, sector, 12), 0);
+	}
+	log->state[sector] = FLASH_LOG_DIRTY;
+	log->erasing 	   = sector;
+	if(HAL_FLASHEx_Erase_IT(&erase) != HAL_OK){
+		log->erasing = FLASH_LOG_NONE;
+		HAL_FLASH_Lock();
+	}
+}
+
+/**
+ * @brief mounts the store, reads the sector headers and finds the end of
+ * 		  the newest one. Never erases, flash_log_poll does
+ * @param log:			struct to configure ex:&flog
+ * @param hcrc:			initialized CRC unit ex:&hcrc
+ * @param base:			address of the first sector ex:0x08040000
+ * @param first_sector:	number of that sector ex:FLASH_SECTOR_6
+ * @param sectors:		equal consecutive sectors, 2 to FLASH_LOG_MAX_SECTORS
+ * @param sector_size:	bytes per sector ex:128*1024
+ * @return 1 if mounted, 0 for a bad geometry
+ */
+uint8_t flash_log_mount(flash_log_t *log, CRC_HandleTypeDef *hcrc, uint32_t base, uint8_t first_sector, uint8_t sectors, uint32_t sector_size)
+{
+	uint32_t addr, magic, seq, inv, live;
+
+	if(sectors < 2 || sectors > FLASH_LOG_MAX_SECTORS || sector_size < 2 * FLASH_LOG_BLOCK){
+		return 0;
+	}
+	log->hcrc 		  = hcrc;
+	log->base 		  = base;
+	log->sector_size  = sector_size;
+	log->first_sector = first_sector;
+	log->sectors 	  = sectors;
+	log->blocks 	  = sector_size / FLASH_LOG_BLOCK;
+	log->data 		  = (FLASH_LOG_MARKS + 2 * log->blocks + 3) & ~3u;
+	log->head 		  = FLASH_LOG_NONE;
+	log->offset 	  = 0;
+	log->marked 	  = -1;
+	log->erasing 	  = FLASH_LOG_NONE;
+	log->appends 	  = 0;
+	log->lost 		  = 0;
+	log->erases 	  = 0;
+
+	for(uint8_t s = 0; s < sectors; s++){
+		addr  = flash_log_addr(log, s, 0);
+		magic = FLASH_LOG_WORD(addr);
+		seq   = FLASH_LOG_WORD(addr + 4);
+		inv   = FLASH_LOG_WORD(addr + 8);
+		live  = FLASH_LOG_WORD(addr + 12);
+		log->sequence[s] = 0;
+		if((magic & seq & inv & live) == FLASH_LOG_ERASED_WORD){
+			log->state[s] = FLASH_LOG_ERASED;
+		}
+		else if(magic == FLASH_LOG_MAGIC && inv == ~seq && live == FLASH_LOG_ERASED_WORD){
+			log->state[s] 	 = FLASH_LOG_LIVE;
+			log->sequence[s] = seq;
+			if(log->head == FLASH_LOG_NONE || (int32_t)(seq - log->sequence[log->head]) > 0){
+				log->head = s;
+			}
+		}
+		else{
+			log->state[s] = FLASH_LOG_DIRTY;
+		}
+	}
+
+	if(log->head != FLASH_LOG_NONE){
+		log->offset = flash_log_end(log, log->head, &log->marked);
+	}
+	return 1;
+}
+
+/**
+ * @brief appends one record, O(1): programs it at the write offset
+ * @param log:	store
+ * @param data:	payload
+ * @param len:	payload bytes, 1 to FLASH_LOG_RECORD_MAX
+ * @return 1 if stored, 0 if refused (no erased sector yet, erase running or
+ * 		   flash error)
+ */
+uint8_t flash_log_append(flash_log_t *log, const void *data, uint16_t len)
+{
+	const uint8_t *p 	= data;
+	uint32_t 	   size = flash_log_size(len);
+	uint32_t 	   addr, word, crc, rel;
+	uint8_t 	   ok 	= 1;
+
+	if(len == 0 || len > FLASH_LOG_RECORD_MAX || log->erasing != FLASH_LOG_NONE ||
+	   ((log->head == FLASH_LOG_NONE || log->offset + size > log->sector_size) && !flash_log_open(log))){
+		log->lost++;
+		return 0;
+	}
+	addr = flash_log_addr(log, log->head, log->offset);
+	rel  = log->offset - log->data;
+
+	HAL_FLASH_Unlock();
+	if((int32_t)(rel / FLASH_LOG_BLOCK) != log->marked){
+		log->marked = rel / FLASH_LOG_BLOCK;
+		ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, flash_log_addr(log, log->head, FLASH_LOG_MARKS + 2 * log->marked),
+							   (rel % FLASH_LOG_BLOCK) / 4) == HAL_OK;
+	}
+	word = len | ((uint32_t)(uint16_t)~len << 16);
+	crc  = HAL_CRC_Calculate(log->hcrc, &word, 1);
+	ok 	 = ok && flash_log_program(addr, word);
+	for(uint16_t i = 0; ok && i < len; i += 4){
+		word = 0;
+		memcpy(&word, p + i, len - i < 4 ? len - i : 4);
+		crc  = HAL_CRC_Accumulate(log->hcrc, &word, 1);
+		addr += 4;
+		ok 	 = flash_log_program(addr, word);
+	}
+	ok = ok && flash_log_program(addr + 4, crc);
+	HAL_FLASH_Lock();
+
+	if(!ok){
+		//whatever reached the flash, the rest of the sector is not trusted
+		log->offset = log->sector_size;
+		log->lost++;
+		return 0;
+	}
+	log->offset += size;
+	log->appends++;
+	return 1;
+}
+
+/**
+ * @brief keeps the next sector erased, call from the task that appends
+ * @note  starts at most one erase, the head keeps FLASH_LOG_SPARE_BYTES
+ * 		  of room for the appends until the erase ends
+ */
+void flash_log_poll(flash_log_t *log)
+{
+	uint8_t next;
+
+	if(log->erasing != FLASH_LOG_NONE){
+		return;
+	}
+	next = flash_log_next(log);
+	if(log->state[next] == FLASH_LOG_DIRTY ||
+	   (log->state[next] == FLASH_LOG_LIVE && log->sector_size - log->offset < FLASH_LOG_SPARE_BYTES)){
+		flash_log_erase(log, next);
+	}
+}
+
+/**
+ * @brief erase finished, call from HAL_FLASH_EndOfOperationCallback (ok = 1)
+ * 		  or HAL_FLASH_OperationErrorCallback (ok = 0)
+ */
+void flash_log_erase_done(flash_log_t *log, uint8_t ok)
+{
+	if(log->erasing == FLASH_LOG_NONE){
+		return;
+	}
+	log->state[log->erasing] = ok ? FLASH_LOG_ERASED : FLASH_LOG_DIRTY;
+	log->erasing 			 = FLASH_LOG_NONE;
+	log->erases++;
+	HAL_FLASH_Lock();
+}
+
+/**
+ * @brief places the cursor on the oldest record
+ */
+void flash_log_rewind(const flash_log_t *log, flash_log_cursor_t *cur)
+{
+	cur->sector = FLASH_LOG_NONE;
+	cur->offset = log->data;
+	for(uint8_t s = 0; s < log->sectors; s++){
+		if(log->state[s] == FLASH_LOG_LIVE &&
+		   (cur->sector == FLASH_LOG_NONE || (int32_t)(log->sequence[s] - log->sequence[cur->sector]) < 0)){
+			cur->sector = s;
+		}
+	}
+}
+
+/**
+ * @brief reads the next record, oldest first. Records that fail the CRC or
+ * 		  do not fit in data are skipped
+ * @param log:	store
+ * @param cur:	cursor from flash_log_rewind, moved past the record
+ * @param data:	payload copy
+ * @param max:	size of data
+ * @return payload bytes, 0 at the end of the log
+ */
+uint16_t flash_log_read(flash_log_t *log, flash_log_cursor_t *cur, void *data, uint16_t max)
+{
+	uint8_t *p = data;
+	uint32_t addr, end, word, crc;
+	uint16_t len;
+	uint8_t  next;
+
+	while(cur->sector != FLASH_LOG_NONE){
+		//erased under the cursor, continue with what is left
+		if(log->state[cur->sector] != FLASH_LOG_LIVE){
+			flash_log_rewind(log, cur);
+			continue;
+		}
+		end  = cur->sector == log->head ? log->offset : log->sector_size;
+		addr = flash_log_addr(log, cur->sector, cur->offset);
+		word = cur->offset + 8 <= end ? FLASH_LOG_WORD(addr) : FLASH_LOG_ERASED_WORD;
+
+		if(!flash_log_header_ok(word) || cur->offset + flash_log_size(word & 0xFFFF) > end){
+			//end of this sector, go on with the following sequence
+			next = FLASH_LOG_NONE;
+			for(uint8_t s = 0; s < log->sectors; s++){
+				if(log->state[s] == FLASH_LOG_LIVE && log->sequence[s] == log->sequence[cur->sector] + 1){
+					next = s;
+				}
+			}
+			cur->sector = next;
+			cur->offset = log->data;
+			continue;
+		}
+
+		len 		 = word & 0xFFFF;
+		cur->offset += flash_log_size(len);
+		if(len > max){
+			continue;
+		}
+		crc = HAL_CRC_Calculate(log->hcrc, &word, 1);
+		for(uint16_t i = 0; i < len; i += 4){
+			addr += 4;
+			word  = FLASH_LOG_WORD(addr);
+			crc   = HAL_CRC_Accumulate(log->hcrc, &word, 1);
+			memcpy(p + i, &word, len - i < 4 ? len - i : 4);
+		}
+		if(crc == FLASH_LOG_WORD(addr + 4)){
+			return len;
+		}
+	}
+	return 0;
+}
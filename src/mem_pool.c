@@ -0,0 +1,218 @@
+#include <string.h>
+#include "mem_pool.h"
+
+struct _mem_pool_block_t{
+	struct _mem_pool_block_t *next;
+};
+typedef struct _mem_pool_block_t mem_pool_block_t;
+
+//atomic add on a counter, returns the new value
+static uint32_t mem_pool_add(volatile uint32_t *counter, int32_t n)
+{
+	uint32_t value;
+
+	do{
+		value = __LDREXW(counter) + n;
+	}while(__STREXW(value, counter));
+	return value;
+}
+
+static void mem_pool_peak(volatile uint32_t *peak, uint32_t value)
+{
+	do{
+		if(__LDREXW(peak) >= value){
+			__CLREX();
+			return;
+		}
+	}while(__STREXW(value, peak));
+}
+
+//exclusive access to a free list head: one word on the target, plain
+//pointer access where pointers are wider (single threaded host build)
+static mem_pool_block_t *mem_pool_ldrex(void *volatile *head)
+{
+#if UINTPTR_MAX == 0xFFFFFFFFu
+	return (mem_pool_block_t *)__LDREXW((volatile uint32_t *)head);
+#else
+	return *head;
+#endif
+}
+
+static uint32_t mem_pool_strex(void *value, void *volatile *head)
+{
+#if UINTPTR_MAX == 0xFFFFFFFFu
+	return __STREXW((uint32_t)value, (volatile uint32_t *)head);
+#else
+	*head = value;
+	return 0;
+#endif
+}
+
+/**
+ * @brief sets up one pool, every block free
+ * @param pool:			struct to configure
+ * @param buffer:		word aligned storage of blocks * block_size bytes ex:MEM_POOL_BUFFER
+ * @param block_size:	bytes per block, rounded up to a multiple of 4
+ * @param blocks:		number of blocks
+ * @return 1 if configured
+ */
+uint8_t mem_pool_init(mem_pool_t *pool, void *buffer, uint16_t block_size, uint16_t blocks)
+{
+	mem_pool_block_t *block;
+
+	if(buffer == NULL || ((uintptr_t)buffer & 3) != 0 || blocks == 0){
+		return 0;
+	}
+	block_size = MEM_POOL_WORDS(block_size) * 4;
+	if(block_size == 0){
+		block_size = 4;
+	}
+	pool->base 		 = buffer;
+	pool->end 		 = pool->base + (uint32_t)block_size * blocks;
+	pool->block_size = block_size;
+	pool->blocks 	 = blocks;
+	pool->used 		 = 0;
+	pool->high_water = 0;
+	pool->failed 	 = 0;
+	pool->corrupt 	 = 0;
+
+	//list in address order, block i points to block i + 1
+	for(uint16_t i = 0; i < blocks; i++){
+		block = (mem_pool_block_t *)(pool->base + (uint32_t)block_size * i);
+#if MEM_POOL_POISON
+		memset(block, MEM_POOL_FREE_BYTE, block_size);
+#endif
+		block->next = i + 1 < blocks ? (mem_pool_block_t *)((uint8_t *)block + block_size) : NULL;
+	}
+	pool->free = pool->base;
+	return 1;
+}
+
+//pops the free list head, NULL if empty. Refusals are counted by the callers
+static void *mem_pool_pop(mem_pool_t *pool)
+{
+	mem_pool_block_t *block, *next;
+
+	do{
+		block = mem_pool_ldrex(&pool->free);
+		if(block == NULL){
+			__CLREX();
+			return NULL;
+		}
+		next = block->next;
+	}while(mem_pool_strex(next, &pool->free));
+
+	mem_pool_peak(&pool->high_water, mem_pool_add(&pool->used, 1));
+#if MEM_POOL_POISON
+	for(uint16_t i = sizeof(mem_pool_block_t); i < pool->block_size; i++){
+		if(((uint8_t *)block)[i] != MEM_POOL_FREE_BYTE){
+			mem_pool_add(&pool->corrupt, 1);
+			break;
+		}
+	}
+	memset(block, MEM_POOL_ALLOC_BYTE, pool->block_size);
+#endif
+	return block;
+}
+
+/**
+ * @brief takes one block, from a task or an interrupt
+ * @param pool:	pool struct
+ * @return the block, NULL if the pool is empty
+ */
+void *mem_pool_alloc(mem_pool_t *pool)
+{
+	void *block = mem_pool_pop(pool);
+
+	if(block == NULL){
+		mem_pool_add(&pool->failed, 1);
+	}
+	return block;
+}
+
+/**
+ * @brief gives a block back, from a task or an interrupt
+ * @param pool:		pool the block came from
+ * @param block:	block from mem_pool_alloc
+ * @return 1 if released, 0 if block does not belong to the pool
+ */
+uint8_t mem_pool_free(mem_pool_t *pool, void *block)
+{
+	mem_pool_block_t *b = block;
+
+	if(!mem_pool_owns(pool, block)){
+		return 0;
+	}
+#if MEM_POOL_POISON
+	memset(b, MEM_POOL_FREE_BYTE, pool->block_size);
+#endif
+	do{
+		b->next = mem_pool_ldrex(&pool->free);
+	}while(mem_pool_strex(b, &pool->free));
+	mem_pool_add(&pool->used, -1);
+	return 1;
+}
+
+/**
+ * @brief checks that block is the start of one of the pool blocks
+ * @param pool:		pool struct
+ * @param block:	address to check
+ */
+uint8_t mem_pool_owns(const mem_pool_t *pool, const void *block)
+{
+	const uint8_t *b = block;
+
+	return b >= pool->base && b < pool->end && (uint32_t)(b - pool->base) % pool->block_size == 0;
+}
+
+/**
+ * @brief takes a block from the smallest size class that fits and still
+ * 		  has one free
+ * @param pools:	size classes sorted by block size ex:app_pools
+ * @param count:	number of classes
+ * @param size:		bytes needed
+ * @return the block, NULL if no class can give one
+ */
+void *mem_pool_set_alloc(mem_pool_t *pools, uint8_t count, uint16_t size)
+{
+	mem_pool_t *fit = NULL;
+	void 		*block;
+
+	for(uint8_t i = 0; i < count; i++){
+		if(pools[i].block_size < size){
+			continue;
+		}
+		if(fit == NULL){
+			fit = &pools[i];
+		}
+		if(pools[i].free == NULL){
+			continue;
+		}
+		block = mem_pool_pop(&pools[i]);
+		if(block != NULL){
+			return block;
+		}
+	}
+	//refusal charged to the class that should have served it
+	if(fit != NULL){
+		mem_pool_add(&fit->failed, 1);
+	}
+	return NULL;
+}
+
+/**
+ * @brief gives a block back to the class that owns it
+ * @param pools:	size classes given to mem_pool_set_alloc
+ * @param count:	number of classes
+ * @param block:	block from mem_pool_set_alloc
+ * @return 1 if released, 0 if no class owns block
+ */
+uint8_t mem_pool_set_free(mem_pool_t *pools, uint8_t count, void *block)
+{
+	for(uint8_t i = 0; i < count; i++){
+		if(mem_pool_owns(&pools[i], block)){
+			return mem_pool_free(&pools[i], block);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,188 @@
+#include <string.h>
+#include "metrics.h"
+
+#define METRICS_SNAPS 	(METRICS_WINDOW + 1)
+
+static void metrics_u16(uint8_t *out, uint16_t value)
+{
+	out[0] = (uint8_t)(value);
+	out[1] = (uint8_t)(value >> 8);
+}
+
+static void metrics_u32(uint8_t *out, uint32_t value)
+{
+	out[0] = (uint8_t)(value);
+	out[1] = (uint8_t)(value >> 8);
+	out[2] = (uint8_t)(value >> 16);
+	out[3] = (uint8_t)(value >> 24);
+}
+
+//part of total in 0.01 % units
+static uint16_t metrics_ratio(uint64_t part, uint64_t total)
+{
+	if(total == 0){
+		return 0;
+	}
+	if(part >= total){
+		return 10000;
+	}
+	return (uint16_t)(part * 10000 / total);
+}
+
+//snapshot some periods before the newest one, at most the oldest kept
+static const metrics_snapshot_t *metrics_back(const metrics_t *m, uint8_t periods)
+{
+	if(periods > m->count - 1){
+		periods = m->count - 1;
+	}
+	return &m->snap[(m->last + METRICS_SNAPS - periods) % METRICS_SNAPS];
+}
+
+//run time of a task number between two snapshots, from 0 if it was created in between
+static uint32_t metrics_task_time(const metrics_snapshot_t *now, const metrics_snapshot_t *old, uint8_t number)
+{
+	uint32_t before = old->tasks & (1u << (number - 1)) ? old->task[number - 1] : 0;
+
+	return now->task[number - 1] - before;
+}
+
+/**
+ * @brief configure metrics struct
+ * @param m:	struct to configure ex:&metrics
+ * @param hcrc:	initialized CRC unit ex:&hcrc
+ */
+void metrics_init(metrics_t *m, CRC_HandleTypeDef *hcrc)
+{
+	memset(m, 0, sizeof(*m));
+	m->hcrc = hcrc;
+	m->last = METRICS_SNAPS - 1;
+}
+
+/**
+ * @brief takes a snapshot of the counters, sliding the window one period
+ * @note  call at a fixed period from a task, takes the scheduler for a
+ * 		  walk of every task
+ * @param m:	metrics struct
+ */
+void metrics_sample(metrics_t *m)
+{
+	metrics_snapshot_t *s;
+	TaskHandle_t 		idle = xTaskGetIdleTaskHandle();
+	UBaseType_t 		n;
+	uint32_t 			total;
+	uint8_t 			number;
+
+	m->last = (m->last + 1) % METRICS_SNAPS;
+	s = &m->snap[m->last];
+
+	//0 tasks if there are more than METRICS_TASKS
+	n = uxTaskGetSystemState(m->status, METRICS_TASKS, &total);
+	s->time  = total;
+	s->tasks = 0;
+	for(UBaseType_t i = 0; i < n; i++){
+		number = m->status[i].xTaskNumber;
+		if(number == 0 || number > METRICS_TASKS){
+			continue;
+		}
+		s->task[number - 1]   = m->status[i].ulRunTimeCounter;
+		s->tasks 			 |= 1u << (number - 1);
+		m->stack[number - 1]  = m->status[i].usStackHighWaterMark;
+		if(m->status[i].xHandle == idle){
+			m->idle = number;
+		}
+	}
+	for(int p = 0; p < PROF_ISR_PROBES; p++){
+		s->isr[p] = (uint32_t)prof_get(p)->total;
+	}
+
+	if(m->count < METRICS_SNAPS){
+		m->count++;
+	}
+}
+
+/**
+ * @brief CPU load, every task but idle
+ * @param m:		metrics struct
+ * @param periods:	1 for the last period, up to METRICS_WINDOW
+ * @return load in 0.01 % units, 0 before two snapshots
+ */
+uint16_t metrics_cpu_load(const metrics_t *m, uint8_t periods)
+{
+	const metrics_snapshot_t *now = &m->snap[m->last], *old;
+
+	if(m->count < 2 || m->idle == 0){
+		return 0;
+	}
+	old = metrics_back(m, periods);
+	return 10000 - metrics_ratio(metrics_task_time(now, old, m->idle), now->time - old->time);
+}
+
+/**
+ * @brief builds the metrics frame (format in metrics.h) from the newest
+ * 		  snapshot
+ * @param m:		metrics struct
+ * @param tick:		current time in ms
+ * @param frame:	set to the frame, valid until the next metrics_finish
+ * @return frame length in bytes, 0 before two snapshots
+ */
+uint16_t metrics_finish(metrics_t *m, uint32_t tick, const uint8_t **frame)
+{
+	const metrics_snapshot_t *now = &m->snap[m->last], *prev, *old;
+	uint8_t 	*buf = (uint8_t *)m->frame;
+	uint16_t 	 len = METRICS_HEADER_SIZE;
+	uint32_t 	 span_prev, span_old;
+	uint32_t 	 cycles = SystemCoreClock / RTOS_RUN_TIME_HZ;
+	size_t 		 heap_free = xPortGetFreeHeapSize();
+	uint8_t 	 tasks = 0, isrs = 0;
+
+	*frame = buf;
+	if(m->count < 2){
+		return 0;
+	}
+	prev 	  = metrics_back(m, 1);
+	old 	  = metrics_back(m, METRICS_WINDOW);
+	span_prev = now->time - prev->time;
+	span_old  = now->time - old->time;
+
+	buf[0] = METRICS_SYNC;
+	buf[1] = METRICS_VERSION;
+	metrics_u16(&buf[2], m->sequence);
+	metrics_u32(&buf[4], tick);
+	metrics_u16(&buf[8], metrics_cpu_load(m, 1));
+	metrics_u16(&buf[10], metrics_cpu_load(m, METRICS_WINDOW));
+	//heap_4 reports 0 free until the first allocation initialises it
+	metrics_u32(&buf[12], heap_free == 0 ? configTOTAL_HEAP_SIZE : xPortGetMinimumEverFreeHeapSize());
+
+	for(uint8_t number = 1; number <= METRICS_TASKS; number++){
+		if(!(now->tasks & (1u << (number - 1)))){
+			continue;
+		}
+		buf[len++] = number;
+		metrics_u16(&buf[len], metrics_ratio(metrics_task_time(now, prev, number), span_prev));
+		metrics_u16(&buf[len + 2], metrics_ratio(metrics_task_time(now, old, number), span_old));
+		metrics_u16(&buf[len + 4], m->stack[number - 1]);
+		len += 6;
+		tasks++;
+	}
+	for(uint8_t p = 0; p < PROF_ISR_PROBES; p++){
+		if(now->isr[p] == old->isr[p]){
+			continue;
+		}
+		buf[len++] = p;
+		metrics_u16(&buf[len], metrics_ratio(now->isr[p] - prev->isr[p], (uint64_t)span_prev * cycles));
+		metrics_u16(&buf[len + 2], metrics_ratio(now->isr[p] - old->isr[p], (uint64_t)span_old * cycles));
+		len += 4;
+		isrs++;
+	}
+	buf[16] = tasks;
+	buf[17] = isrs;
+	while(len % 4){
+		buf[len++] = 0;
+	}
+
+	m->frame[len / 4] = HAL_CRC_Calculate(m->hcrc, m->frame, len / 4);
+	len += 4;
+
+	m->sequence++;
+	return len;
+}
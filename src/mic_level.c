@@ -0,0 +1,178 @@
+#include "mic_level.h"
+
+/*
+ * A weighting for fs = 16 kHz: two bilinear sections for the 20.6 Hz and
+ * 107.7/737.9 Hz poles plus a high shelf fitted in place of the 12.2 kHz
+ * poles, which sit above Nyquist. Within 0.04 dB of IEC 61672 from 20 Hz
+ * to 7 kHz, 0 dB at 1 kHz. {b0, b1, b2, a1, a2}
+ */
+static const float mic_a_weight[MIC_LEVEL_BIQUADS][5] = {
+	{1.24291902f,  -2.48583804f,  1.24291902f,   -1.98388676f,  0.983951666f},
+	{0.855374302f, -1.71074860f,  0.855374302f,  -1.70550963f,  0.715987575f},
+	{0.885299770f,  0.269278755f, 0.0194694582f,  0.168154192f, 0.00589379145f},
+};
+
+/* Full scale 16 bit sample squared */
+#define MIC_FULL_SCALE_SQ 	(32768.0f * 32768.0f)
+
+/**
+ * @brief 10 * log10(x) + offset in 0.1 dB, without libm
+ * @note  log2 of the mantissa from a cubic fit, error below 0.01 dB
+ */
+int16_t mic_level_db_x10(float x, float offset)
+{
+	union { float f; uint32_t u; } v = { .f = x };
+	float 	m, log2x;
+	int32_t e;
+
+	if(x <= 0.0f){
+		return INT16_MIN;
+	}
+	e 	  = (int32_t)((v.u >> 23) & 0xFF) - 127;
+	v.u   = (v.u & 0x007FFFFF) | 0x3F800000;		//mantissa in [1, 2)
+	m 	  = v.f;
+	log2x = (float)e + (-2.1341964f + (3.0113843f + (-1.0298483f + 0.15397370f * m) * m) * m);
+
+	//10 * log10(2) = 3.0103
+	return (int16_t)((log2x * 3.0103f + offset) * 10.0f + (log2x >= 0.0f ? 0.5f : -0.5f));
+}
+
+/**
+ * @brief configure the level meter
+ * @param mic:			struct to configure ex:&mic
+ * @param fs:			sample rate in Hz, the A weighting is designed for 16000
+ * @param window_ms:	RMS and peak window ex:1000
+ * @param leq_windows:	windows averaged into each Leq ex:60 for 1 minute
+ * @param offset:		dB added to dBFS, the mic sensitivity ex:120 for dB SPL
+ */
+void mic_level_init(mic_level_t *mic,
+					uint32_t 	 fs,
+					uint16_t 	 window_ms,
+					uint16_t 	 leq_windows,
+					float 		 offset){
+	for(int s = 0; s < MIC_LEVEL_BIQUADS; s++){
+		mic->z[s][0] = 0.0f;
+		mic->z[s][1] = 0.0f;
+	}
+	mic->offset 	 = offset;
+	mic->window 	 = fs / 1000 * window_ms;
+	mic->leq_windows = leq_windows;
+	mic->n 			 = 0;
+	mic->sum 		 = 0.0f;
+	mic->peak 		 = 0;
+	mic->leq_n 		 = 0;
+	mic->leq_sum 	 = 0.0f;
+	mic->head 		 = 0;
+	mic->tail 		 = 0;
+	mic->lost 		 = 0;
+}
+
+static void mic_level_close(mic_level_t *mic, uint32_t tick)
+{
+	mic_record_t *rec;
+	float 		  mean = mic->sum / (float)mic->n;
+	uint8_t 	  next = (mic->head + 1) % MIC_LEVEL_RECORDS;
+
+	mic->leq_sum += mean;
+	mic->leq_n++;
+
+	if(next == mic->tail){
+		mic->lost++;
+	}
+	else{
+		rec 		  = &mic->records[mic->head];
+		rec->tick 	  = tick;
+		rec->la_x10   = mic_level_db_x10(mean / MIC_FULL_SCALE_SQ, mic->offset);
+		rec->peak_x10 = mic_level_db_x10((float)mic->peak * (float)mic->peak / MIC_FULL_SCALE_SQ, mic->offset);
+		rec->leq_done = (mic->leq_n >= mic->leq_windows);
+		rec->leq_x10  = rec->leq_done ?
+						mic_level_db_x10(mic->leq_sum / (float)mic->leq_n / MIC_FULL_SCALE_SQ, mic->offset) : 0;
+		__DMB();
+		mic->head = next;
+	}
+
+	if(mic->leq_n >= mic->leq_windows){
+		mic->leq_n 	 = 0;
+		mic->leq_sum = 0.0f;
+	}
+	mic->n 	  = 0;
+	mic->sum  = 0.0f;
+	mic->peak = 0;
+}
+
+/**
+ * @brief consumes one PCM block in place
+ * @note  call from the audio DMA half/full complete callback. About 30
+ * 		  cycles per sample on the M4F (0.5% CPU at 16 kHz, 96 MHz)
+ * @param mic:		level meter
+ * @param pcm:		samples, read only
+ * @param count:	number of samples
+ * @param tick:		current tick in ms, stamped on finished windows
+ */
+void mic_level_process(mic_level_t *mic, const int16_t *pcm, uint16_t count, uint32_t tick)
+{
+	const float (*c)[5] = mic_a_weight;
+	float 		z00 = mic->z[0][0], z01 = mic->z[0][1];
+	float 		z10 = mic->z[1][0], z11 = mic->z[1][1];
+	float 		z20 = mic->z[2][0], z21 = mic->z[2][1];
+	float 		sum = mic->sum;
+	int32_t 	peak = mic->peak;
+	float 		x, y;
+	int32_t 	a;
+
+	for(uint16_t i = 0; i < count; i++){
+		a = pcm[i] < 0 ? -pcm[i] : pcm[i];
+		if(a > peak){
+			peak = a;
+		}
+
+		//three transposed direct form II sections, state kept in registers
+		x 	= (float)pcm[i];
+		y 	= c[0][0] * x + z00;
+		z00 = c[0][1] * x - c[0][3] * y + z01;
+		z01 = c[0][2] * x - c[0][4] * y;
+		x 	= y;
+		y 	= c[1][0] * x + z10;
+		z10 = c[1][1] * x - c[1][3] * y + z11;
+		z11 = c[1][2] * x - c[1][4] * y;
+		x 	= y;
+		y 	= c[2][0] * x + z20;
+		z20 = c[2][1] * x - c[2][3] * y + z21;
+		z21 = c[2][2] * x - c[2][4] * y;
+		sum += y * y;
+
+		if(++mic->n >= mic->window){
+			mic->sum  = sum;
+			mic->peak = peak;
+			mic_level_close(mic, tick);
+			sum  = 0.0f;
+			peak = 0;
+		}
+	}
+
+	mic->z[0][0] = z00;
+	mic->z[0][1] = z01;
+	mic->z[1][0] = z10;
+	mic->z[1][1] = z11;
+	mic->z[2][0] = z20;
+	mic->z[2][1] = z21;
+	mic->sum 	 = sum;
+	mic->peak 	 = peak;
+}
+
+/**
+ * @brief takes the oldest finished window, never from an ISR
+ * @param mic:		level meter
+ * @param record:	copy of the record
+ * @return 1 if a record was copied, 0 if there is none
+ */
+uint8_t mic_level_read(mic_level_t *mic, mic_record_t *record)
+{
+	if(mic->tail == mic->head){
+		return 0;
+	}
+	*record 	= mic->records[mic->tail];
+	__DMB();
+	mic->tail 	= (mic->tail + 1) % MIC_LEVEL_RECORDS;
+	return 1;
+}
@@ -1,25 +1,46 @@
 #include "mk_dht11.h"
 
+/* Edges needed to decode: response (3) + 40 bits (80) + release (1) */
+#define DHT11_EDGES 		84
+
+/* Pulse widths in us */
+#define DHT11_RESP_MIN 		60			// 80us response low/high
+#define DHT11_RESP_MAX 		100
+#define DHT11_LOW_MIN 		30			// 50us low before every bit
+#define DHT11_LOW_MAX 		90
+#define DHT11_HIGH_MIN 		15			// 26-28us high for 0, 70us for 1
+#define DHT11_HIGH_MAX 		100
+#define DHT11_BIT_THRESHOLD 48
+
 /**
  * @brief configure dht11 struct with given parameter
- * @param htim: 	TIMER for calculate delays ex:&htim2
+ * @param htim: 	TIMER running at 1MHz for input capture ex:&htim2
+ * @param channel:	capture channel wired to the pin ex:TIM_CHANNEL_1
  * @param port: 	GPIO port ex:GPIOA
  * @param pin:  	GPIO pin ex:GPIO_PIN_2
+ * @param af:		pin alternate function for the timer ex:GPIO_AF1_TIM2
  * @param dht:		struct to configure ex:&dht
  */
 void init_dht11(dht11_t 		  	*dht,
 				TIM_HandleTypeDef 	*htim,
+				uint32_t 			channel,
 				GPIO_TypeDef	  	*port,
-				uint16_t 			pin){
-	dht->htim = htim;
-	dht->port = port;
-	dht->pin  = pin;
+				uint16_t 			pin,
+				uint8_t 			af){
+	dht->htim 	 = htim;
+	dht->channel = channel;
+	dht->port 	 = port;
+	dht->pin  	 = pin;
+	dht->af 	 = af;
+	dht->type 	 = DHT11;
+	dht->state 	 = DHT11_IDLE;
+	dht->n_edges = 0;
 }
 
 /**
  * @brief set DHT pin direction with given parameter
  * @param dht:	 	 struct for dht
- * @param pMode:	 GPIO Mode ex:INPUT or OUTPUT
+ * @param pMode:	 GPIO Mode ex:INPUT, OUTPUT or CAPTURE
  */
 void set_dht11_gpio_mode(dht11_t *dht, uint8_t pMode)
 {
@@ -40,133 +61,161 @@ void set_dht11_gpio_mode(dht11_t *dht, uint8_t pMode)
 	  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
 	  HAL_GPIO_Init(dht->port, &GPIO_InitStruct);
 	}
-}
 
+	//the capture channel is an input, the timer never drives the pin
+	else if(pMode == CAPTURE){
+	  GPIO_InitStruct.Pin   	  = dht->pin;
+	  GPIO_InitStruct.Mode  	  = GPIO_MODE_AF_PP;
+	  GPIO_InitStruct.Pull  	  = GPIO_NOPULL;
+	  GPIO_InitStruct.Speed 	  = GPIO_SPEED_FREQ_VERY_HIGH;
+	  GPIO_InitStruct.Alternate = dht->af;
+	  HAL_GPIO_Init(dht->port, &GPIO_InitStruct);
+	}
+}
 
 /**
- * @brief reads dht11 value
- * @param dht: 	struct for dht11
- * @return 1 if read it's ok 0, if there is something wrong in read.
+ * @brief starts a read, drives the start pulse without blocking
+ * @param dht:	struct for dht11
  */
-uint8_t readDHT11(dht11_t *dht)
+void dht11_request(dht11_t *dht)
 {
-	uint16_t mTime1 = 0, mTime2  = 0, mBit = 0;
-	uint8_t  humVal = 0, tempVal = 0, parityVal = 0, genParity = 0;
-	uint8_t  mData[40];
-
-	/* Communication starts*/
-	set_dht11_gpio_mode(dht, OUTPUT);			//set pin direction as input
+	set_dht11_gpio_mode(dht, OUTPUT);
 	HAL_GPIO_WritePin(dht->port, dht->pin, GPIO_PIN_RESET);
-	HAL_Delay(18);					// wait 18 ms in Low state
-	__disable_irq();				// disable all interupts to do only read dht otherwise miss timer
-	HAL_TIM_Base_Start(dht->htim); 	// start timer
-	set_dht11_gpio_mode(dht, INPUT);
+	dht->tick  = HAL_GetTick();
+	dht->state = DHT11_START;
+}
 
-	/* Check dht answer */
-	__HAL_TIM_SET_COUNTER(dht->htim, 0); //set timer counter to zero
-	while(HAL_GPIO_ReadPin(dht->port, dht->pin) == GPIO_PIN_SET){
-		if((uint16_t)__HAL_TIM_GET_COUNTER(dht->htim) > 500){
-			__enable_irq();
-			return 0;
-		}
-	}
-	__HAL_TIM_SET_COUNTER(dht->htim, 0);
-	while(HAL_GPIO_ReadPin(dht->port, dht->pin) == GPIO_PIN_RESET){
-		if((uint16_t)__HAL_TIM_GET_COUNTER(dht->htim) > 500){
-			__enable_irq();
-			return 0;
-		}
+/**
+ * @brief stores one edge timestamp, call from HAL_TIM_IC_CaptureCallback
+ * @param dht:	struct for dht11
+ */
+void dht11_capture_isr(dht11_t *dht)
+{
+	if(dht->n_edges < DHT11_MAX_EDGES){
+		dht->edges[dht->n_edges++] = HAL_TIM_ReadCapturedValue(dht->htim, dht->channel);
 	}
+}
 
-	mTime1 = (uint16_t)__HAL_TIM_GET_COUNTER(dht->htim);
-	__HAL_TIM_SET_COUNTER(dht->htim, 0);
-	while(HAL_GPIO_ReadPin(dht->port, dht->pin) == GPIO_PIN_SET){
-		if((uint16_t)__HAL_TIM_GET_COUNTER(dht->htim) > 500){
-			__enable_irq();
+/**
+ * @brief advances a read started with dht11_request, never blocks
+ * @param dht:	struct for dht11
+ * @return 1 when a read just finished (check dht->error), 0 otherwise
+ */
+uint8_t dht11_process(dht11_t *dht)
+{
+	uint8_t  data[5] = {0};
+	uint32_t now 	 = HAL_GetTick();
+	uint32_t raw;
+
+	if(dht->state == DHT11_START){
+		//DHT11 needs at least 18ms low, DHT22 at least 1ms
+		if(now - dht->tick < (dht->type == DHT22 ? 2 : 18)){
 			return 0;
 		}
+		dht->n_edges = 0;
+		__HAL_TIM_SET_COUNTER(dht->htim, 0);
+		HAL_TIM_IC_Start_IT(dht->htim, dht->channel);
+		set_dht11_gpio_mode(dht, CAPTURE);			//release the line
+		dht->tick  = now;
+		dht->state = DHT11_WAIT;
+		return 0;
 	}
-	mTime2 = (uint16_t)__HAL_TIM_GET_COUNTER(dht->htim);
 
-	//if answer is wrong return
-	if(mTime1 < 75 && mTime1 > 85 && mTime2 < 75 && mTime2 > 85)
-	{
-		__enable_irq();
+	if(dht->state != DHT11_WAIT){
 		return 0;
 	}
 
-//	HAL_GPIO_WritePin(LD2_GPIO_Port, LD2_Pin, GPIO_PIN_SET);
-	for(int j = 0; j < 40; j++)
-	{
-		__HAL_TIM_SET_COUNTER(dht->htim, 0);
-		while(HAL_GPIO_ReadPin(dht->port, dht->pin) == GPIO_PIN_RESET){
-			if((uint16_t)__HAL_TIM_GET_COUNTER(dht->htim) > 500){
-				__enable_irq();
-				return 0;
-			}
+	//a full transfer takes about 5ms
+	if(dht->n_edges < DHT11_EDGES && now - dht->tick <= 10){
+		return 0;
+	}
+	HAL_TIM_IC_Stop_IT(dht->htim, dht->channel);
+	set_dht11_gpio_mode(dht, INPUT);
+	dht->state = DHT11_IDLE;
 
-		}
-		__HAL_TIM_SET_COUNTER(dht->htim, 0);
-		while(HAL_GPIO_ReadPin(dht->port, dht->pin) == GPIO_PIN_SET){
-			if((uint16_t)__HAL_TIM_GET_COUNTER(dht->htim) > 500){
-				__enable_irq();
-				return 0;
-			}
+	dht->error = dht11_decode(dht->edges, dht->n_edges, data);
+	if(dht->error != DHT11_OK){
+		return 1;
+	}
 
-		}
-		mTime1 = (uint16_t)__HAL_TIM_GET_COUNTER(dht->htim);
+	if(dht->type == DHT22){
+		dht->hum_x10  = (uint16_t)((data[0] << 8) | data[1]);
+		raw 		  = ((data[2] & 0x7F) << 8) | data[3];
+		dht->temp_x10 = (data[2] & 0x80) ? -(int16_t)raw : (int16_t)raw;
+	}
+	else{
+		dht->hum_x10  = data[0] * 10 + data[1];
+		dht->temp_x10 = data[2] * 10 + data[3];
+	}
+	dht->temperature = (uint8_t)(dht->temp_x10 / 10);
+	dht->humidty 	 = (uint8_t)(dht->hum_x10 / 10);
+	return 1;
+}
 
-		//check pass time in high state
-		//if pass time 25uS set as LOW
-		if(mTime1 > 20 && mTime1 < 30)
-		{
-			mBit = 0;
-		}
-		else if(mTime1 > 60 && mTime1 < 80) //if pass time 70 uS set as HIGH
-		{
-			 mBit = 1;
+/**
+ * @brief decodes a transfer from its edge timestamps
+ * @param edges:	timestamps in us of every edge, both polarities
+ * @param count:	number of timestamps
+ * @param data:		the five received bytes
+ * @return DHT11_OK or the DHT11_ERR_ code of the first problem found
+ */
+uint8_t dht11_decode(const uint32_t *edges, uint8_t count, uint8_t data[5])
+{
+	uint32_t low, high;
+	uint8_t  start = 0;
+	uint8_t  sum;
+
+	//find the 80us low + 80us high response, the release edge may be missing
+	for(uint8_t k = 0; k < 4 && k + 2 < count; k++){
+		low  = edges[k + 1] - edges[k];
+		high = edges[k + 2] - edges[k + 1];
+		if(low  >= DHT11_RESP_MIN && low  <= DHT11_RESP_MAX &&
+		   high >= DHT11_RESP_MIN && high <= DHT11_RESP_MAX){
+			start = k + 2;
+			break;
 		}
-
-		//set i th data in data buffer
-		mData[j] = mBit;
-
 	}
-
-	HAL_TIM_Base_Stop(dht->htim); //stop timer
-	__enable_irq(); //enable all interrupts
-
-	//get hum value from data buffer
-	for(int i = 0; i < 8; i++)
-	{
-		humVal += mData[i];
-		humVal = humVal << 1;
+	if(start == 0){
+		return DHT11_ERR_RESPONSE;
 	}
-
-	//get temp value from data buffer
-	for(int i = 16; i < 24; i++)
-	{
-		tempVal += mData[i];
-		tempVal = tempVal << 1;
+	if(count < start + 81){
+		return DHT11_ERR_EDGES;
 	}
 
-	//get parity value from data buffer
-	for(int i = 32; i < 40; i++)
-	{
-		parityVal += mData[i];
-		parityVal = parityVal << 1;
+	for(int i = 0; i < 5; i++){
+		data[i] = 0;
 	}
 
-	parityVal = parityVal >> 1;
-	humVal = humVal >> 1;
-	tempVal = tempVal >> 1;
-
-	genParity = humVal + tempVal;
-
-//	if(genParity == parityVal)
+	for(int j = 0; j < 40; j++)
+	{
+		low  = edges[start + 2 * j + 1] - edges[start + 2 * j];
+		high = edges[start + 2 * j + 2] - edges[start + 2 * j + 1];
 
-	dht->temperature = tempVal;
-	dht->humidty = humVal;
+		//a missing edge merges two pulses and lands out of the window
+		if(low  < DHT11_LOW_MIN  || low  > DHT11_LOW_MAX ||
+		   high < DHT11_HIGH_MIN || high > DHT11_HIGH_MAX){
+			return DHT11_ERR_TIMING;
+		}
+		data[j / 8] = (uint8_t)((data[j / 8] << 1) | (high > DHT11_BIT_THRESHOLD));
+	}
 
+	sum = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+	if(sum != data[4]){
+		return DHT11_ERR_CHECKSUM;
+	}
+	return DHT11_OK;
+}
 
-	return 1;
+/**
+ * @brief reads dht11 value
+ * @note  interrupts stay enabled, the edges are timestamped by the timer
+ * @param dht: 	struct for dht11
+ * @return 1 if read it's ok 0, if there is something wrong in read.
+ */
+uint8_t readDHT11(dht11_t *dht)
+{
+	dht11_request(dht);
+	while(!dht11_process(dht)){
+	}
+	return dht->error == DHT11_OK;
 }
@@ -0,0 +1,394 @@
+#include <stddef.h>
+#include "stm32f4xx.h"
+#include "pdm2pcm_glo.h"
+
+/*
+ * In-tree implementation of the PDM_Filter API declared in pdm2pcm_glo.h.
+ *
+ * Chain, per channel:
+ *   PDM bits -> CIC order 4, decimation R = D/2 (4 bits per step)
+ *            -> half-band FIR 47 taps, decimation 2
+ *            -> 3 tap CIC droop compensator (+-0.3 dB up to 0.4 fs)
+ *            -> DC high-pass (high_pass_tap, Q31) -> mic_gain -> int16
+ *
+ * Input bytes follow the BSP driver: with PDM_FILTER_BIT_ORDER_LSB the
+ * MSB of every byte is the oldest bit, PDM_FILTER_BIT_ORDER_MSB is the
+ * opposite. PDM_FILTER_ENDIANNESS_BE takes the raw I2S halfwords (bytes
+ * swapped in pairs). Channel c of in_ptr_channels starts at byte c.
+ *
+ * The Cortex-M4 DSP extension is used when the compiler reports it;
+ * define PDM_FILTER_SCALAR to force the portable path.
+ */
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1) && !defined(PDM_FILTER_SCALAR)
+#define PDM_USE_DSP 		1
+#else
+#define PDM_USE_DSP 		0
+#endif
+
+#define PDM_FILTER_CHANNELS 2			// Filters that can be initialised
+#define PDM_CIC_ORDER 		4
+#define PDM_HB_HALF 		12			// Half-band: 2*12 taps + center
+#define PDM_HB_TAPS 		(2 * PDM_HB_HALF)
+#define PDM_COMP_A 			2359		// Compensator, 0.072 in Q15
+#define PDM_GAIN_SHIFT 		12			// mic_gain kept in Q12
+#define PDM_GAIN_MIN 		(-12)		// dB
+#define PDM_GAIN_MAX 		51
+#define PDM_STATE_TAG 		0x50444D00	// "PDM" + pool index in pInternalMemory[0]
+
+/**
+ * @brief filter state, pInternalMemory[0] selects one of these
+ */
+struct _pdm_state_t{
+	uint32_t 		 integ[PDM_CIC_ORDER];	// Integrators, wrap around on purpose
+	uint32_t 		 comb[PDM_CIC_ORDER];	// Comb delays
+	const int8_t 	 (*lut)[16];			// Integrator step for 4 bits
+	uint8_t 		 first_shift;			// Nibble holding the oldest bits
+	uint8_t 		 swap;					// 1 for big endian halfwords
+	uint8_t 		 nibbles;				// Nibbles per CIC output (R / 4)
+	uint8_t 		 configured;
+	int32_t 		 cic_scale;				// CIC gain normalisation to Q15
+	uint8_t 		 cic_shift;
+	uint8_t 		 hb_pos;
+	uint8_t 		 odd_pos;
+	int16_t 		 hb_hist[2 * PDM_HB_TAPS];// Even phase, stored twice
+	int16_t 		 hb_odd[PDM_HB_HALF];	// Odd phase delay line (center tap)
+	int16_t 		 comp[2];				// Compensator history
+	int16_t 		 hp_in;					// High-pass previous input
+	int32_t 		 hp_out;				// High-pass previous output, Q8
+	int32_t 		 gain;					// mic_gain, Q12
+	PDM_Filter_Config_t config;
+};
+typedef struct _pdm_state_t pdm_state_t;
+
+static pdm_state_t 	pdm_pool[PDM_FILTER_CHANNELS];
+static uint8_t 		pdm_used = 0;
+
+/*
+ * Integrator cascade advanced 4 bits at once. Entry [m][nibble] is the
+ * contribution of the 4 inputs (+1/-1) to integrator m+1. Generated for
+ * the oldest bit in bit 3 (MSB first) and in bit 0 (LSB first).
+ */
+static const int8_t pdm_lut_msb_first[PDM_CIC_ORDER][16] = {
+	{ -4,  -2,  -2,   0,  -2,   0,   0,   2,  -2,   0,   0,   2,   0,   2,   2,   4},
+	{-10,  -8,  -6,  -4,  -4,  -2,   0,   2,  -2,   0,   2,   4,   4,   6,   8,  10},
+	{-20, -18, -14, -12,  -8,  -6,  -2,   0,   0,   2,   6,   8,  12,  14,  18,  20},
+	{-35, -33, -27, -25, -15, -13,  -7,  -5,   5,   7,  13,  15,  25,  27,  33,  35},
+};
+
+static const int8_t pdm_lut_lsb_first[PDM_CIC_ORDER][16] = {
+	{ -4,  -2,  -2,   0,  -2,   0,   0,   2,  -2,   0,   0,   2,   0,   2,   2,   4},
+	{-10,  -2,  -4,   4,  -6,   2,   0,   8,  -8,   0,  -2,   6,  -4,   4,   2,  10},
+	{-20,   0,  -8,  12, -14,   6,  -2,  18, -18,   2,  -6,  14, -12,   8,   0,  20},
+	{-35,   5, -15,  25, -27,  13,  -7,  33, -33,   7, -13,  27, -25,  15,  -5,  35},
+};
+
+/* Half-band even phase taps (Kaiser, beta 7): 0.002 dB ripple to 0.2 fs,
+   -70 dB from 0.3 fs. The odd phase is the 0.5 center tap */
+static const int16_t pdm_hb_coef[PDM_HB_TAPS] __attribute__((aligned(4))) = {
+	   -3,    13,   -35,    77,  -148,   261,  -433,   693,
+	-1096,  1787, -3290, 10366, 10366, -3290,  1787, -1096,
+	  693,  -433,   261,  -148,    77,   -35,    13,    -3,
+};
+
+static pdm_state_t *pdm_state(PDM_Filter_Handler_t *pHandler)
+{
+	uint32_t tag = pHandler->pInternalMemory[0];
+
+	if((tag & 0xFFFFFF00) != PDM_STATE_TAG || (tag & 0xFF) >= pdm_used){
+		return NULL;
+	}
+	return &pdm_pool[tag & 0xFF];
+}
+
+static inline int32_t pdm_sat16(int32_t value)
+{
+#if PDM_USE_DSP
+	return __SSAT(value, 16);
+#else
+	if(value > 32767){
+		return 32767;
+	}
+	if(value < -32768){
+		return -32768;
+	}
+	return value;
+#endif
+}
+
+/**
+ * @brief runs the CIC over R input bits of one channel
+ * @param st:		filter state
+ * @param in:		channel input, first byte
+ * @param stride:	bytes between two bytes of the channel
+ * @param nib:		nibble position in the channel stream, advanced
+ * @return CIC output normalised to Q15
+ */
+static int32_t pdm_cic(pdm_state_t *st, const uint8_t *in, uint16_t stride, uint32_t *nib)
+{
+	const int8_t (*lut)[16] = st->lut;
+	uint32_t 	 i1 = st->integ[0], i2 = st->integ[1];
+	uint32_t 	 i3 = st->integ[2], i4 = st->integ[3];
+	uint32_t 	 n = *nib, v, t;
+	uint8_t 	 bits;
+
+	for(uint8_t k = 0; k < st->nibbles; k++, n++){
+		bits = in[((n >> 1) * stride) ^ st->swap];
+		bits = (bits >> (st->first_shift ^ ((n & 1) << 2))) & 0x0F;
+
+		//closed form of 4 single bit steps, older integrators first
+		i4 += 4 * i3 + 10 * i2 + 20 * i1 + (uint32_t)(int32_t)lut[3][bits];
+		i3 += 4 * i2 + 10 * i1 + (uint32_t)(int32_t)lut[2][bits];
+		i2 += 4 * i1 + (uint32_t)(int32_t)lut[1][bits];
+		i1 += (uint32_t)(int32_t)lut[0][bits];
+	}
+	st->integ[0] = i1;
+	st->integ[1] = i2;
+	st->integ[2] = i3;
+	st->integ[3] = i4;
+	*nib = n;
+
+	v = i4;
+	for(int s = 0; s < PDM_CIC_ORDER; s++){
+		t 			= v - st->comb[s];
+		st->comb[s] = v;
+		v 			= t;
+	}
+
+	//|v| <= R^4 <= 2^24, the modular arithmetic leaves it exact
+	return pdm_sat16((int32_t)(((int64_t)(int32_t)v * st->cic_scale
+							   + ((int64_t)1 << (st->cic_shift - 1))) >> st->cic_shift));
+}
+
+/**
+ * @brief half-band decimation by 2
+ * @param st:		filter state
+ * @param older:	first CIC output of the pair
+ * @param newer:	second CIC output of the pair
+ */
+static int32_t pdm_halfband(pdm_state_t *st, int16_t older, int16_t newer)
+{
+	const int16_t *x;
+	int32_t 	   acc;
+
+	//center tap: odd phase sample from PDM_HB_HALF - 1 pairs ago
+	st->hb_odd[st->odd_pos] = older;
+	st->odd_pos = (st->odd_pos + 1) % PDM_HB_HALF;
+	acc = (int32_t)st->hb_odd[st->odd_pos] << 14;
+
+	//even phase, newest first and contiguous thanks to the double copy
+	st->hb_pos = (st->hb_pos == 0) ? PDM_HB_TAPS - 1 : st->hb_pos - 1;
+	st->hb_hist[st->hb_pos] 			  = newer;
+	st->hb_hist[st->hb_pos + PDM_HB_TAPS] = newer;
+	x = &st->hb_hist[st->hb_pos];
+
+#if PDM_USE_DSP
+	const uint32_t *c = (const uint32_t *)pdm_hb_coef;
+
+	for(int i = 0; i < PDM_HB_TAPS / 2; i++){
+		acc = (int32_t)__SMLAD(__UNALIGNED_UINT32_READ(&x[2 * i]), c[i], (uint32_t)acc);
+	}
+#else
+	for(int i = 0; i < PDM_HB_TAPS; i++){
+		acc += (int32_t)x[i] * pdm_hb_coef[i];
+	}
+#endif
+
+	return pdm_sat16((acc + (1 << 14)) >> 15);
+}
+
+/**
+ * @brief CIC droop compensator, high-pass and gain for one output sample
+ */
+static int16_t pdm_output(pdm_state_t *st, int32_t x, uint32_t hp_tap)
+{
+	int32_t y;
+
+	//x[n-1] + a * (2 x[n-1] - x[n] - x[n-2])
+	y = st->comp[0] + ((PDM_COMP_A * (2 * st->comp[0] - x - st->comp[1]) + (1 << 14)) >> 15);
+	st->comp[1] = st->comp[0];
+	st->comp[0] = (int16_t)x;
+	y = pdm_sat16(y);
+
+	if(hp_tap != 0){
+		st->hp_out = ((y - st->hp_in) << 8) + (int32_t)(((int64_t)hp_tap * st->hp_out) >> 31);
+		st->hp_in  = (int16_t)y;
+		y 		   = st->hp_out >> 8;
+	}
+
+	return (int16_t)pdm_sat16((int32_t)(((int64_t)y * st->gain + (1 << (PDM_GAIN_SHIFT - 1)))
+										>> PDM_GAIN_SHIFT));
+}
+
+/**
+ * @brief attaches a filter state to the handler and clears it
+ * @param pHandler:	bit_order, endianness, channels and high_pass_tap set
+ * @return 0 or PDM_FILTER_ error flags
+ */
+uint32_t PDM_Filter_Init(PDM_Filter_Handler_t *pHandler)
+{
+	pdm_state_t *st 	= pdm_state(pHandler);
+	uint32_t 	 status = 0;
+
+	if(pHandler->bit_order != PDM_FILTER_BIT_ORDER_LSB &&
+	   pHandler->bit_order != PDM_FILTER_BIT_ORDER_MSB){
+		status |= PDM_FILTER_BIT_ORDER_ERROR;
+	}
+	if(pHandler->endianness != PDM_FILTER_ENDIANNESS_LE &&
+	   pHandler->endianness != PDM_FILTER_ENDIANNESS_BE){
+		status |= PDM_FILTER_ENDIANNESS_ERROR;
+	}
+	if(pHandler->in_ptr_channels == 0 || pHandler->out_ptr_channels == 0){
+		status |= PDM_FILTER_INIT_ERROR;
+	}
+
+	//a handler initialised twice keeps its state
+	if(st == NULL){
+		if(pdm_used == PDM_FILTER_CHANNELS){
+			return status | PDM_FILTER_INIT_ERROR;
+		}
+		pHandler->pInternalMemory[0] = PDM_STATE_TAG | pdm_used;
+		st = &pdm_pool[pdm_used++];
+	}
+	if(status != 0){
+		return status;
+	}
+
+	*st = (pdm_state_t){0};
+	st->lut 		= (pHandler->bit_order == PDM_FILTER_BIT_ORDER_LSB) ?
+					  pdm_lut_msb_first : pdm_lut_lsb_first;
+	st->first_shift = (pHandler->bit_order == PDM_FILTER_BIT_ORDER_LSB) ? 4 : 0;
+	st->swap 		= (pHandler->endianness == PDM_FILTER_ENDIANNESS_BE);
+	return 0;
+}
+
+/**
+ * @brief sets decimation, block size and gain
+ * @param pHandler:	handler already passed to PDM_Filter_Init
+ * @param pConfig:	decimation_factor (PDM_FILTER_DEC_FACTOR_x),
+ * 					output_samples_number per call and mic_gain in dB
+ * @return 0 or PDM_FILTER_ error flags
+ */
+uint32_t PDM_Filter_setConfig(PDM_Filter_Handler_t *pHandler, PDM_Filter_Config_t *pConfig)
+{
+	pdm_state_t *st 	= pdm_state(pHandler);
+	uint32_t 	 status = 0;
+	uint32_t 	 r, r4;
+	uint8_t 	 e = 0;
+	float 		 gain = 1.0f;
+
+	if(st == NULL){
+		return PDM_FILTER_INIT_ERROR;
+	}
+
+	switch(pConfig->decimation_factor){
+	case PDM_FILTER_DEC_FACTOR_16:  r = 8;  break;
+	case PDM_FILTER_DEC_FACTOR_24:  r = 12; break;
+	case PDM_FILTER_DEC_FACTOR_32:  r = 16; break;
+	case PDM_FILTER_DEC_FACTOR_48:  r = 24; break;
+	case PDM_FILTER_DEC_FACTOR_64:  r = 32; break;
+	case PDM_FILTER_DEC_FACTOR_80:  r = 40; break;
+	case PDM_FILTER_DEC_FACTOR_128: r = 64; break;
+	default:
+		r = 0;
+		status |= PDM_FILTER_DECIMATION_ERROR;
+		break;
+	}
+	if(pConfig->mic_gain < PDM_GAIN_MIN || pConfig->mic_gain > PDM_GAIN_MAX){
+		status |= PDM_FILTER_GAIN_ERROR;
+	}
+	if(pConfig->output_samples_number == 0){
+		status |= PDM_FILTER_SAMPLES_NUMBER_ERROR;
+	}
+	if(status != 0){
+		return status;
+	}
+
+	//normalise the CIC gain R^4 to Q15: scale in [2^30, 2^31), 2^e >= R^4
+	r4 = r * r * r * r;
+	while(((uint32_t)1 << e) < r4){
+		e++;
+	}
+	st->cic_scale = (int32_t)((((uint64_t)1 << (30 + e)) + r4 / 2) / r4);
+	st->cic_shift = 30 + e - 15;
+	st->nibbles   = r / 4;
+
+	//only at configuration time, 1 dB = 10^(1/20)
+	for(int16_t db = 0; db < pConfig->mic_gain; db++){
+		gain *= 1.12201845f;
+	}
+	for(int16_t db = 0; db > pConfig->mic_gain; db--){
+		gain /= 1.12201845f;
+	}
+	st->gain 		= (int32_t)(gain * (1 << PDM_GAIN_SHIFT) + 0.5f);
+	st->config 		= *pConfig;
+	st->configured 	= 1;
+	return 0;
+}
+
+/**
+ * @brief reads back the configuration
+ */
+uint32_t PDM_Filter_getConfig(PDM_Filter_Handler_t *pHandler, PDM_Filter_Config_t *pConfig)
+{
+	pdm_state_t *st = pdm_state(pHandler);
+
+	if(st == NULL || !st->configured){
+		return PDM_FILTER_CONFIG_ERROR;
+	}
+	*pConfig = st->config;
+	return 0;
+}
+
+/**
+ * @brief splits in_ptr_channels interleaved bytes into one block per
+ * 		  channel, each one output_samples_number * D / 8 bytes long
+ */
+uint32_t PDM_Filter_deInterleave(void *pDataIn, void *pDataOut, PDM_Filter_Handler_t *pHandler)
+{
+	pdm_state_t   *st 	= pdm_state(pHandler);
+	const uint8_t *in 	= pDataIn;
+	uint8_t 	  *out 	= pDataOut;
+	uint16_t 	   channels = pHandler->in_ptr_channels;
+	uint32_t 	   bytes;
+
+	if(st == NULL || !st->configured){
+		return PDM_FILTER_CONFIG_ERROR;
+	}
+	bytes = (uint32_t)st->config.output_samples_number * st->nibbles;	// 2 CIC outputs * R/8
+	for(uint16_t c = 0; c < channels; c++){
+		for(uint32_t b = 0; b < bytes; b++){
+			out[c * bytes + b] = in[b * channels + c];
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief converts one block: output_samples_number * D PDM bits of a
+ * 		  channel into output_samples_number PCM samples
+ * @param pDataIn:	first byte of the channel
+ * @param pDataOut:	first sample, written every out_ptr_channels
+ * @param pHandler:	configured handler
+ * @return 0 or PDM_FILTER_CONFIG_ERROR
+ */
+uint32_t PDM_Filter(void *pDataIn, void *pDataOut, PDM_Filter_Handler_t *pHandler)
+{
+	pdm_state_t   *st 	= pdm_state(pHandler);
+	const uint8_t *in 	= pDataIn;
+	int16_t 	  *out 	= pDataOut;
+	uint32_t 	   nib 	= 0;
+	int32_t 	   older, newer;
+
+	if(st == NULL || !st->configured){
+		return PDM_FILTER_CONFIG_ERROR;
+	}
+
+	for(uint16_t n = 0; n < st->config.output_samples_number; n++){
+		older = pdm_cic(st, in, pHandler->in_ptr_channels, &nib);
+		newer = pdm_cic(st, in, pHandler->in_ptr_channels, &nib);
+		out[n * pHandler->out_ptr_channels] =
+			pdm_output(st, pdm_halfband(st, (int16_t)older, (int16_t)newer), pHandler->high_pass_tap);
+	}
+	return 0;
+}
@@ -0,0 +1,181 @@
+#include <string.h>
+#include "prof.h"
+
+static const char *const prof_names[PROF_PROBES] = {
+	[PROF_SYSTICK_IRQ] 		= "systick_irq",
+	[PROF_TIM2_IRQ] 		= "tim2_irq",
+	[PROF_USART1_IRQ] 		= "usart1_irq",
+	[PROF_USART2_IRQ] 		= "usart2_irq",
+	[PROF_DMA1_S5_IRQ] 		= "dma1_s5_irq",
+	[PROF_DMA1_S6_IRQ] 		= "dma1_s6_irq",
+	[PROF_DMA2_S0_IRQ] 		= "dma2_s0_irq",
+	[PROF_DMA1_S3_IRQ] 		= "dma1_s3_irq",
+	[PROF_DMA1_S0_IRQ] 		= "dma1_s0_irq",
+	[PROF_I2C1_IRQ] 		= "i2c1_irq",
+	[PROF_EXTI4_IRQ] 		= "exti4_irq",
+	[PROF_DMA2_S2_IRQ] 		= "dma2_s2_irq",
+	[PROF_DMA2_S3_IRQ] 		= "dma2_s3_irq",
+	[PROF_SPI1_IRQ] 		= "spi1_irq",
+	[PROF_EXTI1_IRQ] 		= "exti1_irq",
+	[PROF_FLASH_IRQ] 		= "flash_irq",
+	[PROF_WIFI_PROCESS] 	= "wifi_process",
+	[PROF_DHT11_READ] 		= "dht11_read",
+	[PROF_ADC_BLOCK] 		= "adc_block",
+	[PROF_TELEMETRY_FRAME] 	= "telemetry_frame",
+	[PROF_MIC_BLOCK] 		= "mic_block",
+	[PROF_MIC_SPECTRUM] 	= "mic_spectrum",
+	[PROF_VIB_SPECTRUM] 	= "vib_spectrum",
+	[PROF_AHRS] 			= "ahrs",
+	[PROF_LOG_APPEND] 		= "log_append",
+	[PROF_SERIES] 			= "series",
+	[PROF_BOARD_TEMP] 		= "board_temp",
+};
+
+static prof_stat_t 		prof_stats[PROF_PROBES];
+
+/**
+ * @brief enables the DWT cycle counter and clears every probe
+ */
+void prof_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT 	  = 0;
+	DWT->CTRL 		 |= DWT_CTRL_CYCCNTENA_Msk;
+	prof_reset();
+}
+
+/**
+ * @brief clears every probe
+ */
+void prof_reset(void)
+{
+	for(int p = 0; p < PROF_PROBES; p++){
+		prof_stats[p].count = 0;
+		prof_stats[p].min 	= 0xFFFFFFFF;
+		prof_stats[p].max 	= 0;
+		prof_stats[p].total = 0;
+		for(int b = 0; b < PROF_BUCKETS; b++){
+			prof_stats[p].hist[b] = 0;
+		}
+	}
+}
+
+/**
+ * @brief adds one measurement to a probe
+ * @note  each probe must be recorded from a single context
+ * @param probe:	probe id
+ * @param cycles:	measured duration in CPU cycles
+ */
+void prof_record(prof_probe_t probe, uint32_t cycles)
+{
+	prof_stat_t *stat = &prof_stats[probe];
+	uint32_t 	 bucket = 32 - __CLZ(cycles);
+
+	if(bucket >= PROF_BUCKETS){
+		bucket = PROF_BUCKETS - 1;
+	}
+	stat->hist[bucket]++;
+	stat->count++;
+	stat->total += cycles;
+	if(cycles < stat->min){
+		stat->min = cycles;
+	}
+	if(cycles > stat->max){
+		stat->max = cycles;
+	}
+}
+
+/**
+ * @brief statistics of a probe
+ * @param probe:	probe id
+ */
+const prof_stat_t *prof_get(prof_probe_t probe)
+{
+	return &prof_stats[probe];
+}
+
+/**
+ * @brief name of a probe, as printed by prof_dump
+ * @param probe:	probe id
+ */
+const char *prof_name(prof_probe_t probe)
+{
+	return prof_names[probe];
+}
+
+static uint8_t prof_utoa(char *out, uint32_t value)
+{
+	char 	digits[10];
+	uint8_t n = 0, len = 0;
+
+	do{
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	}while(value > 0);
+	while(n > 0){
+		out[len++] = digits[--n];
+	}
+	return len;
+}
+
+static uint8_t prof_str(char *out, const char *str)
+{
+	uint8_t len = 0;
+
+	while(*str){
+		out[len++] = *str++;
+	}
+	return len;
+}
+
+//sends name followed by value in decimal
+static void prof_field(UART_HandleTypeDef *huart, const char *name, uint32_t value)
+{
+	char 	field[16];
+	uint8_t len = prof_str(field, name);
+
+	len += prof_utoa(&field[len], value);
+	HAL_UART_Transmit(huart, (uint8_t *)field, len, 1000);
+}
+
+/**
+ * @brief writes one line per probe with samples: count, min, max and
+ * 		  average cycles, then the non empty buckets as <bucket>:<count>
+ * @note  blocking, call from a low priority task
+ * @param huart:	debug UART ex:&huart1
+ */
+void prof_dump(UART_HandleTypeDef *huart)
+{
+	const prof_stat_t *stat;
+	uint32_t 		   count;
+	char 			   bucket[5];
+	uint8_t 		   len;
+
+	//fields are read in place, one at a time, to keep this off the stack of
+	//the calling task: a probe recorded while printing mixes two states
+	for(int p = 0; p < PROF_PROBES; p++){
+		stat  = &prof_stats[p];
+		count = stat->count;
+		if(count == 0){
+			continue;
+		}
+
+		HAL_UART_Transmit(huart, (uint8_t *)prof_names[p], strlen(prof_names[p]), 1000);
+		prof_field(huart, " n=", count);
+		prof_field(huart, " min=", stat->min);
+		prof_field(huart, " max=", stat->max);
+		prof_field(huart, " avg=", (uint32_t)(stat->total / count));
+		HAL_UART_Transmit(huart, (uint8_t *)" |", 2, 1000);
+		for(int b = 0; b < PROF_BUCKETS; b++){
+			if(stat->hist[b] == 0){
+				continue;
+			}
+			bucket[0] 		= ' ';
+			len 			= 1 + prof_utoa(&bucket[1], b);
+			bucket[len++] 	= ':';
+			bucket[len] 	= '\0';
+			prof_field(huart, bucket, stat->hist[b]);
+		}
+		HAL_UART_Transmit(huart, (uint8_t *)"\r\n", 2, 1000);
+	}
+}
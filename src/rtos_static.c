@@ -0,0 +1,131 @@
+#include "rtos_static.h"
+
+static const char *const rtos_kind_names[] = {
+	[RTOS_KIND_TASK] 		= "task",
+	[RTOS_KIND_QUEUE] 		= "queue",
+	[RTOS_KIND_MUTEX] 		= "mutex",
+	[RTOS_KIND_SEMAPHORE] 	= "semaphore",
+	[RTOS_KIND_TIMER] 		= "timer",
+};
+
+#if RTOS_STATIC
+
+static StaticTask_t rtos_idle_tcb;
+static StackType_t 	rtos_idle_stack[configMINIMAL_STACK_SIZE];
+
+/**
+ * @brief idle task storage, called by vTaskStartScheduler
+ */
+void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *depth)
+{
+	*tcb 	= &rtos_idle_tcb;
+	*stack 	= rtos_idle_stack;
+	*depth 	= configMINIMAL_STACK_SIZE;
+}
+
+#if configUSE_TIMERS
+
+static StaticTask_t rtos_timer_tcb;
+static StackType_t 	rtos_timer_stack[configTIMER_TASK_STACK_DEPTH];
+
+/**
+ * @brief timer service task storage, called by xTimerCreateTimerTask
+ */
+void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *depth)
+{
+	*tcb 	= &rtos_timer_tcb;
+	*stack 	= rtos_timer_stack;
+	*depth 	= configTIMER_TASK_STACK_DEPTH;
+}
+
+#endif
+#endif
+
+/**
+ * @brief heap exhausted: in static mode nothing should allocate, otherwise
+ * 		  the budget check was beaten by fragmentation. Stops like configASSERT
+ */
+void vApplicationMallocFailedHook(void)
+{
+	configASSERT(0);
+}
+
+#if configCHECK_FOR_STACK_OVERFLOW
+/**
+ * @brief a task went past its stack, found when it was switched out. The
+ * 		  TCB may be corrupted already: stops like configASSERT, the name
+ * 		  is in the debugger
+ */
+void vApplicationStackOverflowHook(TaskHandle_t task, char *name)
+{
+	(void)task;
+	(void)name;
+	configASSERT(0);
+}
+#endif
+
+static uint8_t rtos_utoa(char *out, uint32_t value)
+{
+	char 	digits[10];
+	uint8_t n = 0, len = 0;
+
+	do{
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	}while(value > 0);
+	while(n > 0){
+		out[len++] = digits[--n];
+	}
+	return len;
+}
+
+static uint8_t rtos_str(char *out, const char *str)
+{
+	uint8_t len = 0;
+
+	while(*str){
+		out[len++] = *str++;
+	}
+	return len;
+}
+
+static void rtos_line(UART_HandleTypeDef *huart, const char *kind, const char *name, uint32_t bytes)
+{
+	char 	 line[80];
+	uint16_t len;
+
+	len  = rtos_str(line, kind);
+	line[len++] = ' ';
+	len += rtos_str(&line[len], name);
+	line[len++] = ' ';
+	len += rtos_utoa(&line[len], bytes);
+	line[len++] = '\r';
+	line[len++] = '\n';
+	HAL_UART_Transmit(huart, (uint8_t *)line, len, 1000);
+}
+
+/**
+ * @brief writes the RAM budget: one line per object with its bytes, the
+ * 		  kernel tasks, the total against RTOS_RAM_BUDGET and the heap use
+ * @note  blocking, call from a low priority task
+ * @param huart:	debug UART ex:&huart1
+ * @param budget:	table from RTOS_OBJECTS_BUDGET
+ * @param count:	lines in budget
+ */
+void rtos_report(UART_HandleTypeDef *huart, const rtos_budget_t *budget, uint8_t count)
+{
+	uint32_t total = RTOS_KERNEL_BYTES;
+	size_t 	 heap_free = xPortGetFreeHeapSize();
+
+	for(uint8_t i = 0; i < count; i++){
+		rtos_line(huart, rtos_kind_names[budget[i].kind], budget[i].name, budget[i].bytes);
+		total += budget[i].bytes;
+	}
+	rtos_line(huart, "kernel", configUSE_TIMERS ? "idle+timer" : "idle", RTOS_KERNEL_BYTES);
+	rtos_line(huart, RTOS_STATIC ? "static" : "heap", "total", total);
+	rtos_line(huart, "budget", "max", RTOS_RAM_BUDGET);
+	//heap_4 reports 0 free until the first allocation initialises it
+	rtos_line(huart, "heap", "size", configTOTAL_HEAP_SIZE);
+	rtos_line(huart, "heap", "used", heap_free == 0 ? 0 : configTOTAL_HEAP_SIZE - heap_free);
+	rtos_line(huart, "heap", "peak", heap_free == 0 ? 0 : configTOTAL_HEAP_SIZE - xPortGetMinimumEverFreeHeapSize());
+}
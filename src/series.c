@@ -0,0 +1,330 @@
+#include <string.h>
+#include "series.h"
+
+#define SERIES_NONE 	0xFF
+
+/* Payload bits of the prefix classes 10, 110, 1110 and 1111 */
+static const uint8_t series_time_width[4]  = {6, 12, 20, 32};
+static const uint8_t series_value_width[4] = {4, 8, 16, 32};
+
+static uint32_t series_zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t series_unzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+//prefix class of a zig-zag value, 0 for zero
+static uint8_t series_class(uint32_t zz, const uint8_t *width)
+{
+	uint8_t c = 1;
+
+	if(zz == 0){
+		return 0;
+	}
+	while(c < 4 && zz >= (1u << width[c - 1])){
+		c++;
+	}
+	return c;
+}
+
+static uint8_t series_class_bits(uint8_t c, const uint8_t *width)
+{
+	return c == 0 ? 1 : (c < 4 ? c + 1 : 4) + width[c - 1];
+}
+
+static void series_put(series_t *se, uint32_t value, uint8_t bits)
+{
+	uint8_t room, n;
+
+	while(bits > 0){
+		room = 8 - (se->bits & 7);
+		n 	 = bits < room ? bits : room;
+		se->block[se->bits >> 3] |= (uint8_t)(((value >> (bits - n)) & ((1u << n) - 1)) << (room - n));
+		se->bits += n;
+		bits 	 -= n;
+	}
+}
+
+static void series_put_class(series_t *se, uint32_t zz, uint8_t c, const uint8_t *width)
+{
+	if(c == 0){
+		series_put(se, 0, 1);
+		return;
+	}
+	series_put(se, c < 4 ? (1u << (c + 1)) - 2 : 0xF, c < 4 ? c + 1 : 4);
+	series_put(se, zz, width[c - 1]);
+}
+
+//an overrun ends the block: left drops to 0
+static uint32_t series_get(series_reader_t *rd, uint8_t bits)
+{
+	uint32_t value = 0;
+	uint8_t  room, n;
+
+	if(rd->bits + bits > rd->len * 8){
+		rd->left = 0;
+		return 0;
+	}
+	while(bits > 0){
+		room  = 8 - (rd->bits & 7);
+		n 	  = bits < room ? bits : room;
+		value = (value << n) | ((rd->block[rd->bits >> 3] >> (room - n)) & ((1u << n) - 1));
+		rd->bits += n;
+		bits 	 -= n;
+	}
+	return value;
+}
+
+static uint32_t series_get_class(series_reader_t *rd, const uint8_t *width)
+{
+	uint8_t c = 0;
+
+	while(c < 4 && series_get(rd, 1)){
+		c++;
+	}
+	return c == 0 ? 0 : series_get(rd, width[c - 1]);
+}
+
+static float series_scale(uint8_t decimals)
+{
+	float scale = 1.0f;
+
+	for(uint8_t i = 0; decimals != SERIES_FLOAT && i < decimals; i++){
+		scale *= 10.0f;
+	}
+	return scale;
+}
+
+static void series_reset(series_t *se)
+{
+	se->bits  = SERIES_HEADER_SIZE * 8;
+	se->count = 0;
+}
+
+/**
+ * @brief configure one channel
+ * @param se:		struct to configure ex:&history[SENSOR_TEMP_BOARD]
+ * @param id:		series id, copied to every block
+ * @param decimals:	digits kept after the point ex:1, SERIES_FLOAT to keep
+ * 					the float bits (XOR coding)
+ */
+void series_init(series_t *se, uint8_t id, uint8_t decimals)
+{
+	se->id 		 = id;
+	se->decimals = decimals;
+	se->scale 	 = series_scale(decimals);
+	series_reset(se);
+}
+
+/**
+ * @brief appends one sample to the block being built
+ * @param se:		series struct
+ * @param tick:		sample time in ms
+ * @param value:	sample value
+ * @return 1 if added, 0 if the block is full and must be finished first
+ */
+uint8_t series_add(series_t *se, uint32_t tick, float value)
+{
+	union { float f; uint32_t u; } v = { .f = value };
+	int32_t  delta;
+	uint32_t tz, vz = 0, x = 0;
+	uint8_t  tc, vc = 0, lead = 0, trail = 0;
+	uint16_t need;
+
+	if(se->decimals != SERIES_FLOAT){
+		v.u = (uint32_t)(int32_t)(value * se->scale + (value < 0 ? -0.5f : 0.5f));
+	}
+
+	//first sample: tick in the header, value in full
+	if(se->count == 0){
+		memset(&se->block[SERIES_HEADER_SIZE], 0, SERIES_BLOCK_SIZE - SERIES_HEADER_SIZE);
+		se->block[5] 	= (uint8_t)(tick);
+		se->block[6] 	= (uint8_t)(tick >> 8);
+		se->block[7] 	= (uint8_t)(tick >> 16);
+		se->block[8] 	= (uint8_t)(tick >> 24);
+		series_put(se, v.u, 32);
+		se->last_tick 	= tick;
+		se->last_delta 	= 0;
+		se->last_value 	= v.u;
+		se->lead 		= SERIES_NONE;
+		se->count 		= 1;
+		return 1;
+	}
+	if(se->count == 0xFFFF){
+		return 0;
+	}
+
+	delta = (int32_t)(tick - se->last_tick);
+	tz 	  = series_zigzag(delta - se->last_delta);
+	tc 	  = series_class(tz, series_time_width);
+	need  = series_class_bits(tc, series_time_width);
+	if(se->decimals == SERIES_FLOAT){
+		x = v.u ^ se->last_value;
+		if(x == 0){
+			need += 1;
+		}
+		else{
+			lead  = __CLZ(x);
+			trail = __CLZ(__RBIT(x));
+			if(se->lead != SERIES_NONE && lead >= se->lead && trail >= se->trail){
+				need += 2 + 32 - se->lead - se->trail;
+			}
+			else{
+				need += 12 + 32 - lead - trail;
+			}
+		}
+	}
+	else{
+		vz 	  = series_zigzag((int32_t)(v.u - se->last_value));
+		vc 	  = series_class(vz, series_value_width);
+		need += series_class_bits(vc, series_value_width);
+	}
+	if(se->bits + need > SERIES_BLOCK_SIZE * 8){
+		return 0;
+	}
+
+	series_put_class(se, tz, tc, series_time_width);
+	if(se->decimals != SERIES_FLOAT){
+		series_put_class(se, vz, vc, series_value_width);
+	}
+	else if(x == 0){
+		series_put(se, 0, 1);
+	}
+	else if(se->lead != SERIES_NONE && lead >= se->lead && trail >= se->trail){
+		series_put(se, 2, 2);
+		series_put(se, x >> se->trail, 32 - se->lead - se->trail);
+	}
+	else{
+		series_put(se, 3, 2);
+		series_put(se, lead, 5);
+		series_put(se, 31 - lead - trail, 5);
+		series_put(se, x >> trail, 32 - lead - trail);
+		se->lead  = lead;
+		se->trail = trail;
+	}
+	se->last_tick 	= tick;
+	se->last_delta 	= delta;
+	se->last_value 	= v.u;
+	se->count++;
+	return 1;
+}
+
+/**
+ * @brief samples waiting in the block being built
+ * @param se:	series struct
+ */
+uint16_t series_count(const series_t *se)
+{
+	return se->count;
+}
+
+/**
+ * @brief closes the block, the next sample starts a new one
+ * @param se:		series struct
+ * @param block:	set to the finished block, valid until the next series_add
+ * @return block length in bytes, 0 if there were no samples
+ */
+uint16_t series_finish(series_t *se, const uint8_t **block)
+{
+	uint16_t len = (se->bits + 7) / 8;
+
+	*block = se->block;
+	if(se->count == 0){
+		return 0;
+	}
+	se->block[0] = SERIES_SYNC;
+	se->block[1] = se->id;
+	se->block[2] = se->decimals;
+	se->block[3] = (uint8_t)(se->count);
+	se->block[4] = (uint8_t)(se->count >> 8);
+	series_reset(se);
+	return len;
+}
+
+/**
+ * @brief starts reading a block
+ * @param rd:		reader struct
+ * @param block:	block from series_finish, read in place
+ * @param len:		block length in bytes
+ * @return 1 if the header is valid
+ */
+uint8_t series_open(series_reader_t *rd, const uint8_t *block, uint16_t len)
+{
+	if(len < SERIES_HEADER_SIZE || block[0] != SERIES_SYNC){
+		return 0;
+	}
+	rd->block 		= block;
+	rd->len 		= len;
+	rd->bits 		= SERIES_HEADER_SIZE * 8;
+	rd->id 			= block[1];
+	rd->decimals 	= block[2];
+	rd->scale 		= series_scale(rd->decimals);
+	rd->left 		= block[3] | (block[4] << 8);
+	rd->first 		= 1;
+	rd->last_tick 	= block[5] | (block[6] << 8) | (block[7] << 16) | ((uint32_t)block[8] << 24);
+	rd->last_delta 	= 0;
+	rd->lead 		= SERIES_NONE;
+	return 1;
+}
+
+/**
+ * @brief decodes the next sample of the block
+ * @param rd:		reader from series_open
+ * @param tick:		sample time in ms
+ * @param value:	sample value
+ * @return 1 if there was a sample, 0 at the end of the block or if it is
+ * 		   truncated
+ */
+uint8_t series_next(series_reader_t *rd, uint32_t *tick, float *value)
+{
+	union { float f; uint32_t u; } v;
+	uint32_t x = 0;
+	uint8_t  lead, len;
+
+	if(rd->left == 0){
+		return 0;
+	}
+	if(rd->first){
+		v.u 	  = series_get(rd, 32);
+		rd->first = 0;
+	}
+	else{
+		rd->last_delta += series_unzigzag(series_get_class(rd, series_time_width));
+		rd->last_tick  += rd->last_delta;
+		if(rd->decimals != SERIES_FLOAT){
+			v.u = rd->last_value + series_unzigzag(series_get_class(rd, series_value_width));
+		}
+		else{
+			if(series_get(rd, 1)){
+				if(series_get(rd, 1)){
+					lead = series_get(rd, 5);
+					len  = series_get(rd, 5) + 1;
+					if(lead + len > 32){
+						rd->left = 0;
+					}
+					rd->lead  = lead;
+					rd->trail = 32 - lead - len;
+				}
+				else if(rd->lead == SERIES_NONE){
+					rd->left = 0;
+				}
+				if(rd->left > 0){
+					x = series_get(rd, 32 - rd->lead - rd->trail) << rd->trail;
+				}
+			}
+			v.u = rd->last_value ^ x;
+		}
+	}
+	if(rd->left == 0){
+		return 0;
+	}
+	rd->left--;
+	rd->last_value = v.u;
+	*tick 		   = rd->last_tick;
+	*value 		   = rd->decimals == SERIES_FLOAT ? v.f : (int32_t)v.u / rd->scale;
+	return 1;
+}
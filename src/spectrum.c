@@ -0,0 +1,572 @@
+#include "stm32f4xx.h"
+#include "spectrum.h"
+
+/*
+ * Fixed point (q15) real FFT with block floating point input.
+ *
+ * Each frame is shifted left until its peak uses the full 16 bit range,
+ * Hann windowed and packed as n/2 complex values (even samples real, odd
+ * samples imaginary). Every butterfly halves its result, so the complex
+ * FFT never overflows and the bins come out as DFT / n. The split step
+ * leaves bin 0 (DC) in work[0] and bin n/2 (Nyquist) in work[1].
+ *
+ * The Cortex-M4 DSP extension is used when the compiler reports it;
+ * define SPECTRUM_SCALAR to force the portable path. Both give the same
+ * bits.
+ */
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1) && !defined(SPECTRUM_SCALAR)
+#define SPECTRUM_USE_DSP 	1
+#else
+#define SPECTRUM_USE_DSP 	0
+#endif
+
+#define SPECTRUM_TABLE 		SPECTRUM_MAX_N
+#define SPECTRUM_QUARTER 	(SPECTRUM_TABLE / 4)
+
+/* Hann: mean of w^2 is 3/8 */
+#define SPECTRUM_HANN_POWER (8.0f / 3.0f)
+
+/* cos(2*pi*k/2048) in q15, sin is read a quarter turn behind */
+static const int16_t spectrum_cos[SPECTRUM_TABLE] = {
+	 32767,  32767,  32767,  32767,  32766,  32764,  32762,  32760,  32758,  32756,  32753,  32749,
+	 32746,  32742,  32738,  32733,  32729,  32723,  32718,  32712,  32706,  32700,  32693,  32686,
+	 32679,  32672,  32664,  32656,  32647,  32638,  32629,  32620,  32610,  32600,  32590,  32579,
+	 32568,  32557,  32546,  32534,  32522,  32509,  32496,  32483,  32470,  32456,  32442,  32428,
+	 32413,  32398,  32383,  32368,  32352,  32336,  32319,  32303,  32286,  32268,  32251,  32233,
+	 32214,  32196,  32177,  32158,  32138,  32119,  32099,  32078,  32058,  32037,  32015,  31994,
+	 31972,  31950,  31927,  31904,  31881,  31858,  31834,  31810,  31786,  31761,  31737,  31711,
+	 31686,  31660,  31634,  31608,  31581,  31554,  31527,  31499,  31471,  31443,  31415,  31386,
+	 31357,  31328,  31298,  31268,  31238,  31207,  31177,  31146,  31114,  31082,  31050,  31018,
+	 30986,  30953,  30920,  30886,  30853,  30819,  30784,  30750,  30715,  30680,  30644,  30608,
+	 30572,  30536,  30499,  30462,  30425,  30388,  30350,  30312,  30274,  30235,  30196,  30157,
+	 30118,  30078,  30038,  29997,  29957,  29916,  29875,  29833,  29792,  29750,  29707,  29665,
+	 29622,  29579,  29535,  29492,  29448,  29404,  29359,  29314,  29269,  29224,  29178,  29132,
+	 29086,  29040,  28993,  28946,  28899,  28851,  28803,  28755,  28707,  28658,  28610,  28560,
+	 28511,  28461,  28411,  28361,  28311,  28260,  28209,  28158,  28106,  28054,  28002,  27950,
+	 27897,  27844,  27791,  27738,  27684,  27630,  27576,  27522,  27467,  27412,  27357,  27301,
+	 27246,  27190,  27133,  27077,  27020,  26963,  26906,  26848,  26791,  26733,  26674,  26616,
+	 26557,  26498,  26439,  26379,  26320,  26259,  26199,  26139,  26078,  26017,  25956,  25894,
+	 25833,  25771,  25708,  25646,  25583,  25520,  25457,  25394,  25330,  25266,  25202,  25138,
+	 25073,  25008,  24943,  24878,  24812,  24746,  24680,  24614,  24548,  24481,  24414,  24347,
+	 24279,  24212,  24144,  24076,  24008,  23939,  23870,  23801,  23732,  23663,  23593,  23523,
+	 23453,  23383,  23312,  23241,  23170,  23099,  23028,  22956,  22884,  22812,  22740,  22668,
+	 22595,  22522,  22449,  22375,  22302,  22228,  22154,  22080,  22006,  21931,  21856,  21781,
+	 21706,  21631,  21555,  21479,  21403,  21327,  21251,  21174,  21097,  21020,  20943,  20865,
+	 20788,  20710,  20632,  20554,  20475,  20397,  20318,  20239,  20160,  20081,  20001,  19921,
+	 19841,  19761,  19681,  19601,  19520,  19439,  19358,  19277,  19195,  19114,  19032,  18950,
+	 18868,  18786,  18703,  18621,  18538,  18455,  18372,  18288,  18205,  18121,  18037,  17953,
+	 17869,  17785,  17700,  17616,  17531,  17446,  17361,  17275,  17190,  17104,  17018,  16932,
+	 16846,  16760,  16673,  16587,  16500,  16413,  16326,  16239,  16151,  16064,  15976,  15888,
+	 15800,  15712,  15624,  15535,  15447,  15358,  15269,  15180,  15091,  15002,  14912,  14823,
+	 14733,  14643,  14553,  14463,  14373,  14282,  14192,  14101,  14010,  13919,  13828,  13737,
+	 13646,  13554,  13463,  13371,  13279,  13187,  13095,  13003,  12910,  12818,  12725,  12633,
+	 12540,  12447,  12354,  12261,  12167,  12074,  11980,  11887,  11793,  11699,  11605,  11511,
+	 11417,  11323,  11228,  11134,  11039,  10945,  10850,  10755,  10660,  10565,  10469,  10374,
+	 10279,  10183,  10088,   9992,   9896,   9800,   9704,   9608,   9512,   9416,   9319,   9223,
+	  9127,   9030,   8933,   8836,   8740,   8643,   8546,   8449,   8351,   8254,   8157,   8059,
+	  7962,   7864,   7767,   7669,   7571,   7473,   7376,   7278,   7180,   7081,   6983,   6885,
+	  6787,   6688,   6590,   6491,   6393,   6294,   6195,   6097,   5998,   5899,   5800,   5701,
+	  5602,   5503,   5404,   5305,   5205,   5106,   5007,   4907,   4808,   4709,   4609,   4510,
+	  4410,   4310,   4211,   4111,   4011,   3911,   3812,   3712,   3612,   3512,   3412,   3312,
+	  3212,   3112,   3012,   2912,   2811,   2711,   2611,   2511,   2411,   2310,   2210,   2110,
+	  2009,   1909,   1809,   1708,   1608,   1507,   1407,   1307,   1206,   1106,   1005,    905,
+	   804,    704,    603,    503,    402,    302,    201,    101,      0,   -101,   -201,   -302,
+	  -402,   -503,   -603,   -704,   -804,   -905,  -1005,  -1106,  -1206,  -1307,  -1407,  -1507,
+	 -1608,  -1708,  -1809,  -1909,  -2009,  -2110,  -2210,  -2310,  -2411,  -2511,  -2611,  -2711,
+	 -2811,  -2912,  -3012,  -3112,  -3212,  -3312,  -3412,  -3512,  -3612,  -3712,  -3812,  -3911,
+	 -4011,  -4111,  -4211,  -4310,  -4410,  -4510,  -4609,  -4709,  -4808,  -4907,  -5007,  -5106,
+	 -5205,  -5305,  -5404,  -5503,  -5602,  -5701,  -5800,  -5899,  -5998,  -6097,  -6195,  -6294,
+	 -6393,  -6491,  -6590,  -6688,  -6787,  -6885,  -6983,  -7081,  -7180,  -7278,  -7376,  -7473,
+	 -7571,  -7669,  -7767,  -7864,  -7962,  -8059,  -8157,  -8254,  -8351,  -8449,  -8546,  -8643,
+	 -8740,  -8836,  -8933,  -9030,  -9127,  -9223,  -9319,  -9416,  -9512,  -9608,  -9704,  -9800,
+	 -9896,  -9992, -10088, -10183, -10279, -10374, -10469, -10565, -10660, -10755, -10850, -10945,
+	-11039, -11134, -11228, -11323, -11417, -11511, -11605, -11699, -11793, -11887, -11980, -12074,
+	-12167, -12261, -12354, -12447, -12540, -12633, -12725, -12818, -12910, -13003, -13095, -13187,
+	-13279, -13371, -13463, -13554, -13646, -13737, -13828, -13919, -14010, -14101, -14192, -14282,
+	-14373, -14463, -14553, -14643, -14733, -14823, -14912, -15002, -15091, -15180, -15269, -15358,
+	-15447, -15535, -15624, -15712, -15800, -15888, -15976, -16064, -16151, -16239, -16326, -16413,
+	-16500, -16587, -16673, -16760, -16846, -16932, -17018, -17104, -17190, -17275, -17361, -17446,
+	-17531, -17616, -17700, -17785, -17869, -17953, -18037, -18121, -18205, -18288, -18372, -18455,
+	-18538, -18621, -18703, -18786, -18868, -18950, -19032, -19114, -19195, -19277, -19358, -19439,
+	-19520, -19601, -19681, -19761, -19841, -19921, -20001, -20081, -20160, -20239, -20318, -20397,
+	-20475, -20554, -20632, -20710, -20788, -20865, -20943, -21020, -21097, -21174, -21251, -21327,
+	-21403, -21479, -21555, -21631, -21706, -21781, -21856, -21931, -22006, -22080, -22154, -22228,
+	-22302, -22375, -22449, -22522, -22595, -22668, -22740, -22812, -22884, -22956, -23028, -23099,
+	-23170, -23241, -23312, -23383, -23453, -23523, -23593, -23663, -23732, -23801, -23870, -23939,
+	-24008, -24076, -24144, -24212, -24279, -24347, -24414, -24481, -24548, -24614, -24680, -24746,
+	-24812, -24878, -24943, -25008, -25073, -25138, -25202, -25266, -25330, -25394, -25457, -25520,
+	-25583, -25646, -25708, -25771, -25833, -25894, -25956, -26017, -26078, -26139, -26199, -26259,
+	-26320, -26379, -26439, -26498, -26557, -26616, -26674, -26733, -26791, -26848, -26906, -26963,
+	-27020, -27077, -27133, -27190, -27246, -27301, -27357, -27412, -27467, -27522, -27576, -27630,
+	-27684, -27738, -27791, -27844, -27897, -27950, -28002, -28054, -28106, -28158, -28209, -28260,
+	-28311, -28361, -28411, -28461, -28511, -28560, -28610, -28658, -28707, -28755, -28803, -28851,
+	-28899, -28946, -28993, -29040, -29086, -29132, -29178, -29224, -29269, -29314, -29359, -29404,
+	-29448, -29492, -29535, -29579, -29622, -29665, -29707, -29750, -29792, -29833, -29875, -29916,
+	-29957, -29997, -30038, -30078, -30118, -30157, -30196, -30235, -30274, -30312, -30350, -30388,
+	-30425, -30462, -30499, -30536, -30572, -30608, -30644, -30680, -30715, -30750, -30784, -30819,
+	-30853, -30886, -30920, -30953, -30986, -31018, -31050, -31082, -31114, -31146, -31177, -31207,
+	-31238, -31268, -31298, -31328, -31357, -31386, -31415, -31443, -31471, -31499, -31527, -31554,
+	-31581, -31608, -31634, -31660, -31686, -31711, -31737, -31761, -31786, -31810, -31834, -31858,
+	-31881, -31904, -31927, -31950, -31972, -31994, -32015, -32037, -32058, -32078, -32099, -32119,
+	-32138, -32158, -32177, -32196, -32214, -32233, -32251, -32268, -32286, -32303, -32319, -32336,
+	-32352, -32368, -32383, -32398, -32413, -32428, -32442, -32456, -32470, -32483, -32496, -32509,
+	-32522, -32534, -32546, -32557, -32568, -32579, -32590, -32600, -32610, -32620, -32629, -32638,
+	-32647, -32656, -32664, -32672, -32679, -32686, -32693, -32700, -32706, -32712, -32718, -32723,
+	-32729, -32733, -32738, -32742, -32746, -32749, -32753, -32756, -32758, -32760, -32762, -32764,
+	-32766, -32767, -32767, -32768, -32768, -32768, -32767, -32767, -32766, -32764, -32762, -32760,
+	-32758, -32756, -32753, -32749, -32746, -32742, -32738, -32733, -32729, -32723, -32718, -32712,
+	-32706, -32700, -32693, -32686, -32679, -32672, -32664, -32656, -32647, -32638, -32629, -32620,
+	-32610, -32600, -32590, -32579, -32568, -32557, -32546, -32534, -32522, -32509, -32496, -32483,
+	-32470, -32456, -32442, -32428, -32413, -32398, -32383, -32368, -32352, -32336, -32319, -32303,
+	-32286, -32268, -32251, -32233, -32214, -32196, -32177, -32158, -32138, -32119, -32099, -32078,
+	-32058, -32037, -32015, -31994, -31972, -31950, -31927, -31904, -31881, -31858, -31834, -31810,
+	-31786, -31761, -31737, -31711, -31686, -31660, -31634, -31608, -31581, -31554, -31527, -31499,
+	-31471, -31443, -31415, -31386, -31357, -31328, -31298, -31268, -31238, -31207, -31177, -31146,
+	-31114, -31082, -31050, -31018, -30986, -30953, -30920, -30886, -30853, -30819, -30784, -30750,
+	-30715, -30680, -30644, -30608, -30572, -30536, -30499, -30462, -30425, -30388, -30350, -30312,
+	-30274, -30235, -30196, -30157, -30118, -30078, -30038, -29997, -29957, -29916, -29875, -29833,
+	-29792, -29750, -29707, -29665, -29622, -29579, -29535, -29492, -29448, -29404, -29359, -29314,
+	-29269, -29224, -29178, -29132, -29086, -29040, -28993, -28946, -28899, -28851, -28803, -28755,
+	-28707, -28658, -28610, -28560, -28511, -28461, -28411, -28361, -28311, -28260, -28209, -28158,
+	-28106, -28054, -28002, -27950, -27897, -27844, -27791, -27738, -27684, -27630, -27576, -27522,
+	-27467, -27412, -27357, -27301, -27246, -27190, -27133, -27077, -27020, -26963, -26906, -26848,
+	-26791, -26733, -26674, -26616, -26557, -26498, -26439, -26379, -26320, -26259, -26199, -26139,
+	-26078, -26017, -25956, -25894, -25833, -25771, -25708, -25646, -25583, -25520, -25457, -25394,
+	-25330, -25266, -25202, -25138, -25073, -25008, -24943, -24878, -24812, -24746, -24680, -24614,
+	-24548, -24481, -24414, -24347, -24279, -24212, -24144, -24076, -24008, -23939, -23870, -23801,
+	-23732, -23663, -23593, -23523, -23453, -23383, -23312, -23241, -23170, -23099, -23028, -22956,
+	-22884, -22812, -22740, -22668, -22595, -22522, -22449, -22375, -22302, -22228, -22154, -22080,
+	-22006, -21931, -21856, -21781, -21706, -21631, -21555, -21479, -21403, -21327, -21251, -21174,
+	-21097, -21020, -20943, -20865, -20788, -20710, -20632, -20554, -20475, -20397, -20318, -20239,
+	-20160, -20081, -20001, -19921, -19841, -19761, -19681, -19601, -19520, -19439, -19358, -19277,
+	-19195, -19114, -19032, -18950, -18868, -18786, -18703, -18621, -18538, -18455, -18372, -18288,
+	-18205, -18121, -18037, -17953, -17869, -17785, -17700, -17616, -17531, -17446, -17361, -17275,
+	-17190, -17104, -17018, -16932, -16846, -16760, -16673, -16587, -16500, -16413, -16326, -16239,
+	-16151, -16064, -15976, -15888, -15800, -15712, -15624, -15535, -15447, -15358, -15269, -15180,
+	-15091, -15002, -14912, -14823, -14733, -14643, -14553, -14463, -14373, -14282, -14192, -14101,
+	-14010, -13919, -13828, -13737, -13646, -13554, -13463, -13371, -13279, -13187, -13095, -13003,
+	-12910, -12818, -12725, -12633, -12540, -12447, -12354, -12261, -12167, -12074, -11980, -11887,
+	-11793, -11699, -11605, -11511, -11417, -11323, -11228, -11134, -11039, -10945, -10850, -10755,
+	-10660, -10565, -10469, -10374, -10279, -10183, -10088,  -9992,  -9896,  -9800,  -9704,  -9608,
+	 -9512,  -9416,  -9319,  -9223,  -9127,  -9030,  -8933,  -8836,  -8740,  -8643,  -8546,  -8449,
+	 -8351,  -8254,  -8157,  -8059,  -7962,  -7864,  -7767,  -7669,  -7571,  -7473,  -7376,  -7278,
+	 -7180,  -7081,  -6983,  -6885,  -6787,  -6688,  -6590,  -6491,  -6393,  -6294,  -6195,  -6097,
+	 -5998,  -5899,  -5800,  -5701,  -5602,  -5503,  -5404,  -5305,  -5205,  -5106,  -5007,  -4907,
+	 -4808,  -4709,  -4609,  -4510,  -4410,  -4310,  -4211,  -4111,  -4011,  -3911,  -3812,  -3712,
+	 -3612,  -3512,  -3412,  -3312,  -3212,  -3112,  -3012,  -2912,  -2811,  -2711,  -2611,  -2511,
+	 -2411,  -2310,  -2210,  -2110,  -2009,  -1909,  -1809,  -1708,  -1608,  -1507,  -1407,  -1307,
+	 -1206,  -1106,  -1005,   -905,   -804,   -704,   -603,   -503,   -402,   -302,   -201,   -101,
+	     0,    101,    201,    302,    402,    503,    603,    704,    804,    905,   1005,   1106,
+	  1206,   1307,   1407,   1507,   1608,   1708,   1809,   1909,   2009,   2110,   2210,   2310,
+	  2411,   2511,   2611,   2711,   2811,   2912,   3012,   3112,   3212,   3312,   3412,   3512,
+	  3612,   3712,   3812,   3911,   4011,   4111,   4211,   4310,   4410,   4510,   4609,   4709,
+	  4808,   4907,   5007,   5106,   5205,   5305,   5404,   5503,   5602,   5701,   5800,   5899,
+	  5998,   6097,   6195,   6294,   6393,   6491,   6590,   6688,   6787,   6885,   6983,   7081,
+	  7180,   7278,   7376,   7473,   7571,   7669,   7767,   7864,   7962,   8059,   8157,   8254,
+	  8351,   8449,   8546,   8643,   8740,   8836,   8933,   9030,   9127,   9223,   9319,   9416,
+	  9512,   9608,   9704,   9800,   9896,   9992,  10088,  10183,  10279,  10374,  10469,  10565,
+	 10660,  10755,  10850,  10945,  11039,  11134,  11228,  11323,  11417,  11511,  11605,  11699,
+	 11793,  11887,  11980,  12074,  12167,  12261,  12354,  12447,  12540,  12633,  12725,  12818,
+	 12910,  13003,  13095,  13187,  13279,  13371,  13463,  13554,  13646,  13737,  13828,  13919,
+	 14010,  14101,  14192,  14282,  14373,  14463,  14553,  14643,  14733,  14823,  14912,  15002,
+	 15091,  15180,  15269,  15358,  15447,  15535,  15624,  15712,  15800,  15888,  15976,  16064,
+	 16151,  16239,  16326,  16413,  16500,  16587,  16673,  16760,  16846,  16932,  17018,  17104,
+	 17190,  17275,  17361,  17446,  17531,  17616,  17700,  17785,  17869,  17953,  18037,  18121,
+	 18205,  18288,  18372,  18455,  18538,  18621,  18703,  18786,  18868,  18950,  19032,  19114,
+	 19195,  19277,  19358,  19439,  19520,  19601,  19681,  19761,  19841,  19921,  20001,  20081,
+	 20160,  20239,  20318,  20397,  20475,  20554,  20632,  20710,  20788,  20865,  20943,  21020,
+	 21097,  21174,  21251,  21327,  21403,  21479,  21555,  21631,  21706,  21781,  21856,  21931,
+	 22006,  22080,  22154,  22228,  22302,  22375,  22449,  22522,  22595,  22668,  22740,  22812,
+	 22884,  22956,  23028,  23099,  23170,  23241,  23312,  23383,  23453,  23523,  23593,  23663,
+	 23732,  23801,  23870,  23939,  24008,  24076,  24144,  24212,  24279,  24347,  24414,  24481,
+	 24548,  24614,  24680,  24746,  24812,  24878,  24943,  25008,  25073,  25138,  25202,  25266,
+	 25330,  25394,  25457,  25520,  25583,  25646,  25708,  25771,  25833,  25894,  25956,  26017,
+	 26078,  26139,  26199,  26259,  26320,  26379,  26439,  26498,  26557,  26616,  26674,  26733,
+	 26791,  26848,  26906,  26963,  27020,  27077,  27133,  27190,  27246,  27301,  27357,  27412,
+	 27467,  27522,  27576,  27630,  27684,  27738,  27791,  27844,  27897,  27950,  28002,  28054,
+	 28106,  28158,  28209,  28260,  28311,  28361,  28411,  28461,  28511,  28560,  28610,  28658,
+	 28707,  28755,  28803,  28851,  28899,  28946,  28993,  29040,  29086,  29132,  29178,  29224,
+	 29269,  29314,  29359,  29404,  29448,  29492,  29535,  29579,  29622,  29665,  29707,  29750,
+	 29792,  29833,  29875,  29916,  29957,  29997,  30038,  30078,  30118,  30157,  30196,  30235,
+	 30274,  30312,  30350,  30388,  30425,  30462,  30499,  30536,  30572,  30608,  30644,  30680,
+	 30715,  30750,  30784,  30819,  30853,  30886,  30920,  30953,  30986,  31018,  31050,  31082,
+	 31114,  31146,  31177,  31207,  31238,  31268,  31298,  31328,  31357,  31386,  31415,  31443,
+	 31471,  31499,  31527,  31554,  31581,  31608,  31634,  31660,  31686,  31711,  31737,  31761,
+	 31786,  31810,  31834,  31858,  31881,  31904,  31927,  31950,  31972,  31994,  32015,  32037,
+	 32058,  32078,  32099,  32119,  32138,  32158,  32177,  32196,  32214,  32233,  32251,  32268,
+	 32286,  32303,  32319,  32336,  32352,  32368,  32383,  32398,  32413,  32428,  32442,  32456,
+	 32470,  32483,  32496,  32509,  32522,  32534,  32546,  32557,  32568,  32579,  32590,  32600,
+	 32610,  32620,  32629,  32638,  32647,  32656,  32664,  32672,  32679,  32686,  32693,  32700,
+	 32706,  32712,  32718,  32723,  32729,  32733,  32738,  32742,  32746,  32749,  32753,  32756,
+	 32758,  32760,  32762,  32764,  32766,  32767,  32767,  32767
+};
+
+/******************************************************************************
+ * 	Packed complex q15: real part in the low halfword, imaginary in the high
+ *****************************************************************************/
+
+#if SPECTRUM_USE_DSP
+
+#define cpx_hadd(a, b) 		__SHADD16((a), (b))		// (a + b) / 2
+#define cpx_hsub(a, b) 		__SHSUB16((a), (b))		// (a - b) / 2
+#define cpx_hsub_j(a, b) 	__SHSAX((a), (b))		// (a - jb) / 2
+#define cpx_hadd_j(a, b) 	__SHASX((a), (b))		// (a + jb) / 2
+#define cpx_conj(a) 		__PKHBT((a), __QSUB16(0, (a)), 0)
+#define cpx_rot(a) 			__ROR((a), 16)			// swap re and im
+
+/* a * w, w = cos - j*sin packed as (cos, sin) */
+static inline uint32_t cpx_mul(uint32_t a, uint32_t w)
+{
+	int32_t re = (int32_t)__SMUAD(a, w) >> 15;
+	int32_t im = (int32_t)__SMUSDX(w, a) >> 15;
+
+	return __PKHBT(re, im, 16);
+}
+
+static inline uint64_t cpx_power(uint32_t a, uint64_t acc)
+{
+	return __SMLALD(a, a, acc);
+}
+
+#else
+
+#define RE(a) 				((int32_t)(int16_t)(a))
+#define IM(a) 				((int32_t)(int16_t)((a) >> 16))
+
+static inline uint32_t cpx_pack(int32_t re, int32_t im)
+{
+	return (uint16_t)re | ((uint32_t)(uint16_t)im << 16);
+}
+
+static inline int32_t cpx_sat(int32_t x)
+{
+	return x > 32767 ? 32767 : (x < -32768 ? -32768 : x);
+}
+
+static inline uint32_t cpx_hadd(uint32_t a, uint32_t b)
+{
+	return cpx_pack((RE(a) + RE(b)) >> 1, (IM(a) + IM(b)) >> 1);
+}
+
+static inline uint32_t cpx_hsub(uint32_t a, uint32_t b)
+{
+	return cpx_pack((RE(a) - RE(b)) >> 1, (IM(a) - IM(b)) >> 1);
+}
+
+static inline uint32_t cpx_hsub_j(uint32_t a, uint32_t b)
+{
+	return cpx_pack((RE(a) + IM(b)) >> 1, (IM(a) - RE(b)) >> 1);
+}
+
+static inline uint32_t cpx_hadd_j(uint32_t a, uint32_t b)
+{
+	return cpx_pack((RE(a) - IM(b)) >> 1, (IM(a) + RE(b)) >> 1);
+}
+
+static inline uint32_t cpx_conj(uint32_t a)
+{
+	return cpx_pack(RE(a), cpx_sat(-IM(a)));
+}
+
+static inline uint32_t cpx_rot(uint32_t a)
+{
+	return (a >> 16) | (a << 16);
+}
+
+static inline uint32_t cpx_mul(uint32_t a, uint32_t w)
+{
+	int32_t re = (RE(a) * RE(w) + IM(a) * IM(w)) >> 15;
+	int32_t im = (IM(a) * RE(w) - RE(a) * IM(w)) >> 15;
+
+	return cpx_pack(re, im);
+}
+
+static inline uint64_t cpx_power(uint32_t a, uint64_t acc)
+{
+	return acc + (uint32_t)(RE(a) * RE(a)) + (uint32_t)(IM(a) * IM(a));
+}
+
+#endif
+
+/* e^(-j*2*pi*idx/2048) */
+static inline uint32_t spectrum_twiddle(uint32_t idx)
+{
+	uint16_t c = (uint16_t)spectrum_cos[idx & (SPECTRUM_TABLE - 1)];
+	uint16_t s = (uint16_t)spectrum_cos[(idx - SPECTRUM_QUARTER) & (SPECTRUM_TABLE - 1)];
+
+	return c | ((uint32_t)s << 16);
+}
+
+static uint32_t spectrum_reverse(uint32_t i, uint8_t bits)
+{
+#if SPECTRUM_USE_DSP
+	return __RBIT(i) >> (32 - bits);
+#else
+	uint32_t r = 0;
+
+	for(uint8_t b = 0; b < bits; b++){
+		r = (r << 1) | ((i >> b) & 1);
+	}
+	return r;
+#endif
+}
+
+/**
+ * @brief in place complex FFT, m points, output scaled by 1/m
+ */
+static void spectrum_cfft(uint32_t *z, uint16_t m, uint8_t log2m)
+{
+	uint32_t a, b, c, d, s, t;
+	uint32_t w1, w2, w3;
+	uint16_t len, q, step;
+
+	/* Radix-2^2 DIF: outputs land in plain bit reversed order */
+	for(len = m; len >= 4; len >>= 2){
+		q 	 = len >> 2;
+		step = SPECTRUM_TABLE / len;
+		for(uint16_t k = 0; k < q; k++){
+			w1 = spectrum_twiddle(k * step);
+			w2 = spectrum_twiddle(2 * k * step);
+			w3 = spectrum_twiddle(3 * k * step);
+			for(uint16_t g = k; g < m; g += len){
+				a = z[g];
+				b = z[g + q];
+				c = z[g + 2 * q];
+				d = z[g + 3 * q];
+				s = cpx_hadd(a, c);
+				t = cpx_hadd(b, d);
+				a = cpx_hsub(a, c);
+				b = cpx_hsub(b, d);
+				z[g] 		 = cpx_hadd(s, t);
+				z[g + q] 	 = cpx_mul(cpx_hsub(s, t), w2);
+				z[g + 2 * q] = cpx_mul(cpx_hsub_j(a, b), w1);
+				z[g + 3 * q] = cpx_mul(cpx_hadd_j(a, b), w3);
+			}
+		}
+	}
+	if(len == 2){
+		for(uint16_t g = 0; g < m; g += 2){
+			a = z[g];
+			b = z[g + 1];
+			z[g] 	 = cpx_hadd(a, b);
+			z[g + 1] = cpx_hsub(a, b);
+		}
+	}
+
+	for(uint32_t i = 1; i < m; i++){
+		uint32_t r = spectrum_reverse(i, log2m);
+		if(r > i){
+			a 	 = z[i];
+			z[i] = z[r];
+			z[r] = a;
+		}
+	}
+}
+
+/**
+ * @brief configure a spectrum engine
+ * @param sp:		struct to configure ex:&mic_spectrum
+ * @param n:		real samples per frame, power of 2 from 256 to 2048
+ * @param frame:	n samples where spectrum_feed assembles the frame
+ * @param work:		n values for the bins, 4 byte aligned
+ * @return 1 if configured, 0 if n is not supported
+ */
+uint8_t spectrum_init(spectrum_t *sp, uint16_t n, int16_t *frame, int16_t *work)
+{
+	uint8_t log2n = 0;
+
+	while((1u << log2n) < n){
+		log2n++;
+	}
+	if(n < SPECTRUM_MIN_N || n > SPECTRUM_MAX_N || (1u << log2n) != n){
+		return 0;
+	}
+	sp->n 	  = n;
+	sp->log2n = log2n;
+	sp->frame = frame;
+	sp->work  = work;
+	sp->shift = 0;
+	sp->fill  = 0;
+	sp->ready = 0;
+	sp->lost  = 0;
+	return 1;
+}
+
+/**
+ * @brief appends samples to the frame, call from the producer interrupt
+ * @param sp:		spectrum struct
+ * @param x:		first sample ex:mic_pcm or &accel[0].z
+ * @param count:	samples to take
+ * @param stride:	int16 between samples, 1 for plain PCM, 3 for one axis of xyz
+ * @return 1 when this call completed a frame
+ */
+uint8_t spectrum_feed(spectrum_t *sp, const int16_t *x, uint16_t count, uint8_t stride)
+{
+	uint16_t fill = sp->fill;
+	uint16_t i;
+
+	if(sp->ready){
+		sp->lost += count;
+		return 0;
+	}
+	for(i = 0; i < count && fill < sp->n; i++){
+		sp->frame[fill++] = x[(uint32_t)i * stride];
+	}
+	sp->fill = fill;
+	if(fill < sp->n){
+		return 0;
+	}
+	sp->lost += count - i;
+	sp->ready = 1;
+	return 1;
+}
+
+/**
+ * @brief checks if a full frame waits for spectrum_run
+ * @param sp:	spectrum struct
+ */
+uint8_t spectrum_ready(const spectrum_t *sp)
+{
+	return sp->ready;
+}
+
+/**
+ * @brief transforms the waiting frame and hands it back to spectrum_feed
+ * @param sp:	spectrum struct
+ */
+void spectrum_run(spectrum_t *sp)
+{
+	spectrum_transform(sp, sp->frame, 1);
+	sp->fill  = 0;
+	sp->ready = 0;
+}
+
+/**
+ * @brief windows and transforms n samples into sp->work
+ * @note  for blocks already in memory, ex: an accelerometer FIFO burst
+ * @param sp:		spectrum struct
+ * @param x:		first sample
+ * @param stride:	int16 between samples
+ */
+void spectrum_transform(spectrum_t *sp, const int16_t *x, uint8_t stride)
+{
+	uint32_t *z 	 = (uint32_t *)sp->work;
+	uint16_t  n 	 = sp->n;
+	uint16_t  m 	 = n >> 1;
+	uint32_t  step 	 = SPECTRUM_TABLE >> sp->log2n;
+	uint32_t  peak 	 = 0;
+	uint32_t  a, b, even, odd, t;
+	int32_t   v, re, im;
+	uint8_t   shift;
+
+	/* Block floating point: the quietest frame still uses all 16 bits */
+	for(uint16_t i = 0; i < n; i++){
+		v = x[(uint32_t)i * stride];
+		peak |= (uint32_t)(v < 0 ? ~v : v);
+	}
+	shift = 0;
+	while(shift < 15 && (peak << (shift + 1)) < 0x8000){
+		shift++;
+	}
+	sp->shift = (int8_t)shift;
+
+	/* Hann window, w = (1 - cos) / 2 */
+	for(uint16_t i = 0; i < n; i++){
+		v = (int32_t)x[(uint32_t)i * stride] << shift;
+		sp->work[i] = (int16_t)((v * ((32768 - spectrum_cos[i * step]) >> 1)) >> 15);
+	}
+
+	spectrum_cfft(z, m, (uint8_t)(sp->log2n - 1));
+
+	/* Split: X[k] = (E + W^k * O) / 2, X[m-k] = conj(E - W^k * O) / 2 */
+	re 	 = (int16_t)z[0];
+	im 	 = (int16_t)(z[0] >> 16);
+	z[0] = (uint16_t)((re + im) >> 1) | ((uint32_t)(uint16_t)((re - im) >> 1) << 16);
+	for(uint16_t k = 1; k <= m / 2; k++){
+		a 	 = z[k];
+		b 	 = cpx_conj(z[m - k]);
+		even = cpx_hadd(a, b);
+		odd  = cpx_conj(cpx_rot(cpx_hsub(a, b)));		// -j * (a - b) / 2
+		t 	 = cpx_mul(odd, spectrum_twiddle(k * step));
+		z[k] 	 = cpx_hadd(even, t);
+		z[m - k] = cpx_conj(cpx_hsub(even, t));
+	}
+}
+
+/**
+ * @brief bin closest to a frequency
+ * @param sp:	spectrum struct
+ * @param hz:	frequency
+ * @param fs:	sample rate of the frame ex:16000
+ */
+uint16_t spectrum_bin(const spectrum_t *sp, uint32_t hz, uint32_t fs)
+{
+	uint32_t bin = (hz * sp->n + fs / 2) / fs;
+
+	return (uint16_t)(bin > sp->n / 2 ? sp->n / 2 : bin);
+}
+
+/**
+ * @brief mean square of the frame between two bins
+ * @note  relative to a full scale sample squared, the same reference as
+ * 		  the dBFS levels of mic_level. Window and shift are compensated
+ * @param sp:		spectrum struct, after spectrum_run or spectrum_transform
+ * @param first:	first bin of the band
+ * @param last:		bin after the band, up to n/2
+ */
+float spectrum_band(const spectrum_t *sp, uint16_t first, uint16_t last)
+{
+	const uint32_t *z = (const uint32_t *)sp->work;
+	uint64_t 		energy = 0;
+	uint64_t 		mirror = 0;
+	int32_t 		v;
+
+	if(last > sp->n / 2){
+		last = sp->n / 2;
+	}
+	/* work[1] holds Nyquist, not the imaginary part of DC */
+	if(first == 0 && last > 0){
+		v 	   = sp->work[0];
+		energy = (uint64_t)(v * v);
+		first  = 1;
+	}
+	for(uint16_t k = first; k < last; k++){
+		mirror = cpx_power(z[k], mirror);
+	}
+	//bins above DC also stand for their negative frequency
+	energy += 2 * mirror;
+	return (float)energy * SPECTRUM_HANN_POWER
+		   / (float)(1ull << (30 + 2 * sp->shift));
+}
+
+/**
+ * @brief magnitude of bins 0..n/2-1, q15 of the shifted frame (sp->shift)
+ * @param sp:	spectrum struct, after spectrum_run or spectrum_transform
+ * @param mag:	n/2 results
+ */
+void spectrum_magnitude(const spectrum_t *sp, uint16_t *mag)
+{
+	const uint32_t *z = (const uint32_t *)sp->work;
+	uint32_t 		x, r, bit;
+
+	for(uint16_t k = 0; k < sp->n / 2; k++){
+		x 	= k == 0 ? (uint32_t)(sp->work[0] * sp->work[0]) : (uint32_t)cpx_power(z[k], 0);
+		r 	= 0;
+		bit = 1ul << 30;
+		while(bit > x){
+			bit >>= 2;
+		}
+		while(bit != 0){
+			if(x >= r + bit){
+				x -= r + bit;
+				r  = (r >> 1) + bit;
+			}
+			else{
+				r >>= 1;
+			}
+			bit >>= 2;
+		}
+		mag[k] = (uint16_t)r;
+	}
+}
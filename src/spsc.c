@@ -0,0 +1,175 @@
+#include <string.h>
+#include "spsc.h"
+
+/**
+ * @brief configures an empty channel
+ * @param ch:		struct to configure
+ * @param buffer:	storage of size * item bytes
+ * @param item:		bytes per item ex:1, sizeof(mic_record_t), sizeof(void *)
+ * @param size:		items, power of 2
+ * @return 1 if configured
+ */
+uint8_t spsc_init(spsc_t *ch, void *buffer, uint16_t item, uint16_t size)
+{
+	if(buffer == NULL || item == 0 || size == 0 || (size & (size - 1)) != 0){
+		return 0;
+	}
+	ch->buffer 	   = buffer;
+	ch->item 	   = item;
+	ch->size 	   = size;
+	ch->head 	   = 0;
+	ch->tail 	   = 0;
+	ch->notify 	   = NULL;
+	ch->ctx 	   = NULL;
+	ch->high_water = 0;
+	ch->dropped    = 0;
+	return 1;
+}
+
+/**
+ * @brief sets the callback run on the empty to not empty transition
+ * @note  call before the producer starts
+ * @param ch:		channel struct
+ * @param notify:	callback, NULL for none
+ * @param ctx:		passed to notify
+ */
+void spsc_set_notify(spsc_t *ch, spsc_notify_t notify, void *ctx)
+{
+	ch->ctx 	= ctx;
+	ch->notify 	= notify;
+}
+
+/**
+ * @brief copies items in, as many as fit
+ * @note  producer only
+ * @param ch:		channel struct
+ * @param items:	count * item bytes
+ * @param count:	items to write
+ * @return items written, the rest is counted in dropped
+ */
+uint16_t spsc_write(spsc_t *ch, const void *items, uint16_t count)
+{
+	uint32_t head = ch->head;
+	uint32_t tail = ch->tail;
+	uint32_t used = head - tail;
+	uint32_t pos  = head & (ch->size - 1);
+	uint32_t first;
+
+	if(count > ch->size - used){
+		ch->dropped += count - (ch->size - used);
+		count = ch->size - used;
+	}
+	if(count == 0){
+		return 0;
+	}
+	//two copies when the block wraps
+	first = ch->size - pos < count ? ch->size - pos : count;
+	memcpy(&ch->buffer[pos * ch->item], items, first * ch->item);
+	memcpy(ch->buffer, (const uint8_t *)items + first * ch->item, (count - first) * ch->item);
+	__DMB();
+	ch->head = head + count;
+
+	if(used + count > ch->high_water){
+		ch->high_water = used + count;
+	}
+	if(used == 0 && ch->notify != NULL){
+		ch->notify(ch->ctx);
+	}
+	return count;
+}
+
+/**
+ * @brief free items, producer side
+ */
+uint16_t spsc_space(const spsc_t *ch)
+{
+	return ch->size - (ch->head - ch->tail);
+}
+
+/**
+ * @brief writes one pointer, the channel item must be sizeof(void *)
+ * @return 1 if written
+ */
+uint8_t spsc_push_ptr(spsc_t *ch, void *ptr)
+{
+	return spsc_write(ch, &ptr, 1);
+}
+
+/**
+ * @brief copies items out, batch drain
+ * @note  consumer only
+ * @param ch:		channel struct
+ * @param items:	room for max * item bytes
+ * @param max:		items to read at most
+ * @return items read, 0 if empty
+ */
+uint16_t spsc_read(spsc_t *ch, void *items, uint16_t max)
+{
+	uint32_t tail = ch->tail;
+	uint32_t count = ch->head - tail;
+	uint32_t pos  = tail & (ch->size - 1);
+	uint32_t first;
+
+	if(count > max){
+		count = max;
+	}
+	if(count == 0){
+		return 0;
+	}
+	__DMB();
+	first = ch->size - pos < count ? ch->size - pos : count;
+	memcpy(items, &ch->buffer[pos * ch->item], first * ch->item);
+	memcpy((uint8_t *)items + first * ch->item, ch->buffer, (count - first) * ch->item);
+	__DMB();
+	ch->tail = tail + count;
+	return count;
+}
+
+/**
+ * @brief items waiting in place, without copying
+ * @note  consumer only, release them with spsc_consume
+ * @param ch:		channel struct
+ * @param items:	set to the first waiting item
+ * @return contiguous items at *items, a wrapped channel needs two rounds
+ */
+uint16_t spsc_peek(const spsc_t *ch, void **items)
+{
+	uint32_t tail  = ch->tail;
+	uint32_t count = ch->head - tail;
+	uint32_t pos   = tail & (ch->size - 1);
+
+	__DMB();
+	*items = &ch->buffer[pos * ch->item];
+	return ch->size - pos < count ? ch->size - pos : count;
+}
+
+/**
+ * @brief frees items seen with spsc_peek
+ * @param ch:		channel struct
+ * @param count:	items done, at most the spsc_peek result
+ */
+void spsc_consume(spsc_t *ch, uint16_t count)
+{
+	__DMB();
+	ch->tail += count;
+}
+
+/**
+ * @brief items waiting, consumer side
+ */
+uint16_t spsc_count(const spsc_t *ch)
+{
+	return ch->head - ch->tail;
+}
+
+/**
+ * @brief reads one pointer, the channel item must be sizeof(void *)
+ * @return the pointer, NULL if empty
+ */
+void *spsc_pop_ptr(spsc_t *ch)
+{
+	void *ptr = NULL;
+
+	spsc_read(ch, &ptr, 1);
+	return ptr;
+}
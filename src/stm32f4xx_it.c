@@ -5,6 +5,9 @@
 #include <cmsis_os.h>
 #endif
 #include "stm32f4xx_it.h"
+#include "stm32f411e_discovery.h"
+#include "uart_rx.h"
+#include "prof.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -17,9 +20,16 @@
 /*            	  	    Processor Exceptions Handlers                         */
 /******************************************************************************/
 
-extern TIM_HandleTypeDef  htim3;
+extern DMA_HandleTypeDef  hdma_adc1;
+extern TIM_HandleTypeDef  htim2;
 extern UART_HandleTypeDef huart1;
 extern UART_HandleTypeDef huart2;
+extern DMA_HandleTypeDef  hdma_usart2_rx;
+extern DMA_HandleTypeDef  hdma_usart2_tx;
+extern uart_rx_t		  wifi_rx;
+extern I2S_HandleTypeDef  hAudioInI2s;
+extern I2C_HandleTypeDef  I2cHandle;
+extern SPI_HandleTypeDef  SpiHandle;
 /**
   * @brief  This function handles SysTick Handler, but only if no RTOS defines it.
   * @param  None
@@ -27,19 +37,33 @@ extern UART_HandleTypeDef huart2;
   */
 void SysTick_Handler(void)
 {
+	PROF_ISR_ENTER();
 	HAL_IncTick();
 	HAL_SYSTICK_IRQHandler();
 #ifdef USE_RTOS_SYSTICK
 	osSystickHandler();
 #endif
+	PROF_ISR_EXIT(PROF_SYSTICK_IRQ);
 }
 
 /**
-  * @brief This function handles TIM3 global interrupt.
+  * @brief This function handles TIM2 global interrupt.
   */
-void TIM3_IRQHandler(void)
+void TIM2_IRQHandler(void)
 {
-  HAL_TIM_IRQHandler(&htim3);
+  PROF_ISR_ENTER();
+  HAL_TIM_IRQHandler(&htim2);
+  PROF_ISR_EXIT(PROF_TIM2_IRQ);
+}
+
+/**
+  * @brief This function handles DMA2 stream0 global interrupt (ADC1).
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_DMA_IRQHandler(&hdma_adc1);
+  PROF_ISR_EXIT(PROF_DMA2_S0_IRQ);
 }
 
 /**
@@ -47,7 +71,9 @@ void TIM3_IRQHandler(void)
   */
 void USART1_IRQHandler(void)
 {
+  PROF_ISR_ENTER();
   HAL_UART_IRQHandler(&huart1);
+  PROF_ISR_EXIT(PROF_USART1_IRQ);
 }
 
 /**
@@ -55,7 +81,130 @@ void USART1_IRQHandler(void)
   */
 void USART2_IRQHandler(void)
 {
+  PROF_ISR_ENTER();
+  uart_rx_irq_handler(&wifi_rx);
   HAL_UART_IRQHandler(&huart2);
+  PROF_ISR_EXIT(PROF_USART2_IRQ);
+}
+
+/**
+  * @brief This function handles DMA1 stream5 global interrupt (USART2 Rx).
+  */
+void DMA1_Stream5_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_DMA_IRQHandler(&hdma_usart2_rx);
+  PROF_ISR_EXIT(PROF_DMA1_S5_IRQ);
+}
+
+/**
+  * @brief This function handles DMA1 stream6 global interrupt (USART2 Tx).
+  */
+void DMA1_Stream6_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+  PROF_ISR_EXIT(PROF_DMA1_S6_IRQ);
+}
+
+/**
+  * @brief This function handles DMA1 stream3 global interrupt (I2S2 Rx, microphone).
+  */
+void DMA1_Stream3_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_DMA_IRQHandler(hAudioInI2s.hdmarx);
+  PROF_ISR_EXIT(PROF_DMA1_S3_IRQ);
+}
+
+/**
+  * @brief This function handles DMA1 stream0 global interrupt (I2C1 Rx, accelerometer FIFO).
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_DMA_IRQHandler(I2cHandle.hdmarx);
+  PROF_ISR_EXIT(PROF_DMA1_S0_IRQ);
+}
+
+/**
+  * @brief This function handles I2C1 event interrupt.
+  */
+void I2C1_EV_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_I2C_EV_IRQHandler(&I2cHandle);
+  PROF_ISR_EXIT(PROF_I2C1_IRQ);
+}
+
+/**
+  * @brief This function handles I2C1 error interrupt.
+  */
+void I2C1_ER_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_I2C_ER_IRQHandler(&I2cHandle);
+  PROF_ISR_EXIT(PROF_I2C1_IRQ);
+}
+
+/**
+  * @brief This function handles EXTI line 4 interrupt (accelerometer INT1, FIFO watermark).
+  */
+void EXTI4_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_GPIO_EXTI_IRQHandler(ACCELERO_INT1_PIN);
+  PROF_ISR_EXIT(PROF_EXTI4_IRQ);
+}
+
+/**
+  * @brief This function handles DMA2 stream2 global interrupt (SPI1 Rx, gyroscope FIFO).
+  */
+void DMA2_Stream2_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_DMA_IRQHandler(SpiHandle.hdmarx);
+  PROF_ISR_EXIT(PROF_DMA2_S2_IRQ);
+}
+
+/**
+  * @brief This function handles DMA2 stream3 global interrupt (SPI1 Tx).
+  */
+void DMA2_Stream3_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_DMA_IRQHandler(SpiHandle.hdmatx);
+  PROF_ISR_EXIT(PROF_DMA2_S3_IRQ);
+}
+
+/**
+  * @brief This function handles SPI1 global interrupt (errors during DMA transfers).
+  */
+void SPI1_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_SPI_IRQHandler(&SpiHandle);
+  PROF_ISR_EXIT(PROF_SPI1_IRQ);
+}
+
+/**
+  * @brief This function handles EXTI line 1 interrupt (gyroscope INT2, FIFO watermark).
+  */
+void EXTI1_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_GPIO_EXTI_IRQHandler(GYRO_INT2_PIN);
+  PROF_ISR_EXIT(PROF_EXTI1_IRQ);
+}
+
+/**
+  * @brief This function handles FLASH global interrupt (end of the log sector erase).
+  */
+void FLASH_IRQHandler(void)
+{
+  PROF_ISR_ENTER();
+  HAL_FLASH_IRQHandler();
+  PROF_ISR_EXIT(PROF_FLASH_IRQ);
 }
 
 
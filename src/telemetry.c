@@ -0,0 +1,121 @@
+#include "telemetry.h"
+
+static uint8_t telemetry_varint(uint8_t *out, uint32_t value)
+{
+	uint8_t n = 0;
+
+	while(value >= 0x80){
+		out[n++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	out[n++] = (uint8_t)value;
+	return n;
+}
+
+static void telemetry_reset(telemetry_t *tm)
+{
+	tm->len   = TELEMETRY_HEADER_SIZE;
+	tm->count = 0;
+	tm->seen  = 0;
+}
+
+/**
+ * @brief configure telemetry struct
+ * @param tm:	struct to configure ex:&telemetry
+ * @param hcrc:	initialized CRC unit ex:&hcrc
+ */
+void telemetry_init(telemetry_t *tm, CRC_HandleTypeDef *hcrc)
+{
+	tm->hcrc 	 = hcrc;
+	tm->sequence = 0;
+	telemetry_reset(tm);
+}
+
+/**
+ * @brief appends one sample to the frame being built
+ * @param tm:		telemetry struct
+ * @param sensor:	sensor id, below TELEMETRY_SENSORS
+ * @param tick:		sample time in ms
+ * @param value:	sample value, sent with 0.1 resolution
+ * @return 1 if added, 0 if the frame is full and must be finished first
+ */
+uint8_t telemetry_add(telemetry_t *tm, uint8_t sensor, uint32_t tick, float value)
+{
+	uint8_t *frame = (uint8_t *)tm->frame;
+	int32_t  scaled, delta;
+
+	if(sensor >= TELEMETRY_SENSORS){
+		return 1;
+	}
+	if(tm->len + TELEMETRY_SAMPLE_MAX + 3 + 4 > TELEMETRY_FRAME_SIZE || tm->count == 0xFF){
+		return 0;
+	}
+
+	//first sample sets the frame time base
+	if(tm->count == 0){
+		tm->last_tick = tick;
+		frame[4] = (uint8_t)(tick);
+		frame[5] = (uint8_t)(tick >> 8);
+		frame[6] = (uint8_t)(tick >> 16);
+		frame[7] = (uint8_t)(tick >> 24);
+	}
+
+	scaled = (int32_t)(value * 10.0f + (value < 0 ? -0.5f : 0.5f));
+	delta  = scaled;
+	if(tm->seen & (1u << sensor)){
+		delta = scaled - tm->last_value[sensor];
+	}
+	tm->last_value[sensor] = scaled;
+	tm->seen |= 1u << sensor;
+
+	frame[tm->len++] = sensor;
+	tm->len += telemetry_varint(&frame[tm->len], tick - tm->last_tick);
+	tm->len += telemetry_varint(&frame[tm->len], ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+	tm->last_tick = tick;
+	tm->count++;
+	return 1;
+}
+
+/**
+ * @brief samples waiting in the frame being built
+ * @param tm:	telemetry struct
+ */
+uint8_t telemetry_count(const telemetry_t *tm)
+{
+	return tm->count;
+}
+
+/**
+ * @brief closes the frame: header, padding and CRC. The next sample
+ * 		  starts a new frame.
+ * @param tm:		telemetry struct
+ * @param frame:	set to the finished frame, valid until the next telemetry_add
+ * @return frame length in bytes, 0 if there were no samples
+ */
+uint16_t telemetry_finish(telemetry_t *tm, const uint8_t **frame)
+{
+	uint8_t *buf = (uint8_t *)tm->frame;
+	uint16_t len = tm->len;
+
+	*frame = buf;
+	if(tm->count == 0){
+		return 0;
+	}
+
+	buf[0] = TELEMETRY_SYNC;
+	buf[1] = TELEMETRY_VERSION;
+	buf[2] = (uint8_t)(tm->sequence);
+	buf[3] = (uint8_t)(tm->sequence >> 8);
+	buf[8] = (uint8_t)(len - TELEMETRY_HEADER_SIZE);
+	buf[9] = tm->count;
+	while(len % 4){
+		buf[len++] = 0;
+	}
+
+	tm->frame[len / 4] = HAL_CRC_Calculate(tm->hcrc, tm->frame, len / 4);
+	len += 4;
+
+	tm->sequence++;
+	telemetry_reset(tm);
+	return len;
+}
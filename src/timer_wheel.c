@@ -0,0 +1,240 @@
+#include <string.h>
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_MASK 	(TIMER_WHEEL_SLOTS - 1)
+
+//ticks covered by one slot of a level
+#define TIMER_WHEEL_SPAN(level) 	(1u << (TIMER_WHEEL_BITS * (level)))
+
+//slots from index to the next set bit after it, 1..SLOTS, 0 if none
+static uint32_t timer_wheel_ahead(uint32_t bitmap, uint32_t index)
+{
+	uint32_t rot;
+
+	if(bitmap == 0){
+		return 0;
+	}
+	index = (index + 1) & TIMER_WHEEL_MASK;
+	rot   = index == 0 ? bitmap : (bitmap >> index) | (bitmap << (TIMER_WHEEL_SLOTS - index));
+	return __CLZ(__RBIT(rot)) + 1;
+}
+
+static void timer_wheel_insert(timer_wheel_t *tw, wheel_timer_t *timer)
+{
+	uint32_t delta = timer->expires - tw->now;
+	uint32_t at    = timer->expires;
+	uint8_t  level = 0;
+
+	if(delta >= TIMER_WHEEL_RANGE){
+		at 	  = tw->now + TIMER_WHEEL_RANGE - 1;
+		delta = TIMER_WHEEL_RANGE - 1;
+	}
+	while(delta >= TIMER_WHEEL_SPAN(level + 1)){
+		level++;
+	}
+	timer->level 	 = level;
+	timer->slot 	 = (at >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+	timer->next 	 = tw->slots[level][timer->slot];
+	timer->prev_next = &tw->slots[level][timer->slot];
+	if(timer->next != NULL){
+		timer->next->prev_next = &timer->next;
+	}
+	tw->slots[level][timer->slot] = timer;
+	tw->bitmap[level] |= 1u << timer->slot;
+}
+
+static void timer_wheel_unlink(timer_wheel_t *tw, wheel_timer_t *timer)
+{
+	*timer->prev_next = timer->next;
+	if(timer->next != NULL){
+		timer->next->prev_next = timer->prev_next;
+	}
+	timer->prev_next = NULL;
+	//also right when the timer was in the due list: the slot is empty then
+	if(tw->slots[timer->level][timer->slot] == NULL){
+		tw->bitmap[timer->level] &= ~(1u << timer->slot);
+	}
+}
+
+//takes a whole slot into list, its first timer linked from the list head. 1 if not empty
+static uint8_t timer_wheel_take(timer_wheel_t *tw, uint8_t level, uint8_t slot, wheel_timer_t **list)
+{
+	*list = tw->slots[level][slot];
+	if(*list == NULL){
+		return 0;
+	}
+	(*list)->prev_next = list;
+	tw->slots[level][slot] = NULL;
+	tw->bitmap[level] &= ~(1u << slot);
+	return 1;
+}
+
+/**
+ * @brief clears the wheel
+ * @param tw:	wheel struct
+ * @param now:	current tick
+ */
+void timer_wheel_init(timer_wheel_t *tw, uint32_t now)
+{
+	memset(tw, 0, sizeof(*tw));
+	tw->now = now;
+}
+
+/**
+ * @brief starts or restarts a timer
+ * @param tw:		wheel struct
+ * @param timer:	timer with its callback set ex:WHEEL_TIMER_INIT
+ * @param now:		current tick, may be ahead of the last expire call
+ * @param delay:	ticks to the first expiry, at least 1
+ * @param period:	ticks between the next ones, 0 for one shot
+ */
+void timer_wheel_start(timer_wheel_t *tw, wheel_timer_t *timer, uint32_t now, uint32_t delay, uint32_t period)
+{
+	if(timer->prev_next != NULL){
+		timer_wheel_unlink(tw, timer);
+	}
+	else if(++tw->count > tw->high_water){
+		tw->high_water = tw->count;
+	}
+	//never in the slot of the tick already processed
+	if((int32_t)(now + delay - tw->now) < 1){
+		now   = tw->now;
+		delay = 1;
+	}
+	timer->expires = now + delay;
+	timer->period  = period;
+	timer_wheel_insert(tw, timer);
+}
+
+/**
+ * @brief stops a timer, nothing if it is not running
+ * @param tw:		wheel struct
+ * @param timer:	timer struct
+ */
+void timer_wheel_stop(timer_wheel_t *tw, wheel_timer_t *timer)
+{
+	if(timer->prev_next == NULL){
+		return;
+	}
+	timer_wheel_unlink(tw, timer);
+	tw->count--;
+}
+
+/**
+ * @brief 1 while the timer is running
+ */
+uint8_t timer_wheel_active(const wheel_timer_t *timer)
+{
+	return timer->prev_next != NULL;
+}
+
+/**
+ * @brief one step of the wheel towards now: moves one timer of a slot
+ * 		  coming down, or advances one tick (to the next wrap over an empty
+ * 		  level 0), or returns one expired timer. A periodic timer returned
+ * 		  is already running again, a one shot one is stopped
+ * @note  call until it returns 0, each call in its own critical section;
+ * 		  the last call may return a timer too
+ * @param tw:		wheel struct
+ * @param now:		current tick
+ * @param expired:	the timer whose callback must run, NULL if none this step
+ * @return 1 while work up to now is left, 0 when caught up
+ */
+uint8_t timer_wheel_expire(timer_wheel_t *tw, uint32_t now, wheel_timer_t **expired)
+{
+	wheel_timer_t *timer;
+	uint32_t 	   step;
+	uint8_t 	   level, taken = 0;
+
+	*expired = NULL;
+	//slots coming down, each timer lands at least one level lower
+	for(level = 1; level < TIMER_WHEEL_LEVELS; level++){
+		if(tw->cascade[level] != NULL){
+			timer = tw->cascade[level];
+			timer_wheel_unlink(tw, timer);
+			timer_wheel_insert(tw, timer);
+			return 1;
+		}
+	}
+	if(tw->due == NULL && !tw->collect){
+		if(tw->now == now){
+			return 0;
+		}
+		if(tw->count == 0){
+			tw->now = now;
+			return 0;
+		}
+
+		//one tick, or up to the next wrap when level 0 is empty
+		step = tw->bitmap[0] == 0 ? TIMER_WHEEL_SLOTS - (tw->now & TIMER_WHEEL_MASK) : 1;
+		if(step > now - tw->now){
+			step = now - tw->now;
+		}
+		tw->now 	+= step;
+		tw->collect  = 1;
+		for(level = 1; level < TIMER_WHEEL_LEVELS; level++){
+			if((tw->now & (TIMER_WHEEL_SPAN(level) - 1)) != 0){
+				break;
+			}
+			taken |= timer_wheel_take(tw, level, (tw->now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK,
+									  &tw->cascade[level]);
+		}
+		if(taken){
+			return 1;
+		}
+	}
+	//cascades first, a timer coming down at this tick fires now
+	if(tw->collect){
+		tw->collect = 0;
+		timer_wheel_take(tw, 0, tw->now & TIMER_WHEEL_MASK, &tw->due);
+	}
+	if(tw->due != NULL){
+		timer = tw->due;
+		timer_wheel_unlink(tw, timer);
+		if(timer->period > 0){
+			timer->expires += timer->period;
+			timer_wheel_insert(tw, timer);
+		}
+		else{
+			tw->count--;
+		}
+		*expired = timer;
+	}
+	return tw->due != NULL || tw->now != now;
+}
+
+/**
+ * @brief ticks from the last processed tick to the next one with work (an
+ * 		  expiry or a cascade of a non empty slot)
+ * @param tw:	wheel struct
+ * @return ticks, 0 if the current tick still has work, TIMER_WHEEL_IDLE
+ * 		   without timers
+ */
+uint32_t timer_wheel_next(const timer_wheel_t *tw)
+{
+	uint32_t next = TIMER_WHEEL_IDLE, slots, at;
+
+	if(tw->count == 0){
+		return TIMER_WHEEL_IDLE;
+	}
+	if(tw->due != NULL || tw->collect){
+		return 0;
+	}
+	for(uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++){
+		if(tw->cascade[level] != NULL){
+			return 0;
+		}
+	}
+	for(uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++){
+		slots = timer_wheel_ahead(tw->bitmap[level], (tw->now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+		if(slots == 0){
+			continue;
+		}
+		//start of that slot, when it expires or cascades
+		at = ((tw->now >> (TIMER_WHEEL_BITS * level)) + slots) << (TIMER_WHEEL_BITS * level);
+		if(at - tw->now < next){
+			next = at - tw->now;
+		}
+	}
+	return next;
+}
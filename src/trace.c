@@ -0,0 +1,137 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "prof.h"
+#include "trace.h"
+
+#define TRACE_MASK 		(TRACE_EVENTS - 1)
+
+/* Tasks named in the dump, at least uxTaskGetNumberOfTasks */
+#define TRACE_TASKS 	8
+
+/* Events per UART write */
+#define TRACE_CHUNK 	32
+
+static trace_event_t 	 trace_ring[TRACE_EVENTS];
+static volatile uint32_t trace_head = 0;			// Events since trace_start
+static volatile uint8_t  trace_on = 0;
+static uint8_t 			 trace_queues = 0;
+static TaskStatus_t 	 trace_tasks[TRACE_TASKS];
+
+/**
+ * @brief empties the ring and starts recording
+ * @note  the DWT cycle counter must be running ex:prof_init
+ */
+void trace_start(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	trace_head = 0;
+	trace_on   = 1;
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief stops recording, the ring keeps its events
+ */
+void trace_stop(void)
+{
+	trace_on = 0;
+}
+
+/**
+ * @brief appends one event, overwriting the oldest when full
+ * @note  any context, interrupts are masked for a few cycles
+ * @param type:	TRACE_TASK_IN...
+ * @param id:	task, queue or exception number
+ * @param arg:	depends on type
+ */
+void trace_record(uint8_t type, uint8_t id, uint16_t arg)
+{
+	uint32_t 	   primask = __get_PRIMASK();
+	trace_event_t *ev;
+
+	__disable_irq();
+	if(trace_on){
+		ev = &trace_ring[trace_head++ & TRACE_MASK];
+		ev->time = DWT->CYCCNT;
+		ev->type = type;
+		ev->id 	 = id;
+		ev->arg  = arg;
+	}
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief id for a new queue, called by traceQUEUE_CREATE
+ * @return 1, 2... in creation order
+ */
+uint8_t trace_queue_number(void)
+{
+	return ++trace_queues;
+}
+
+static void trace_u32(uint8_t *out, uint32_t value)
+{
+	out[0] = value;
+	out[1] = value >> 8;
+	out[2] = value >> 16;
+	out[3] = value >> 24;
+}
+
+/**
+ * @brief sends the header and the recorded events (format in trace.h), then
+ * 		  records again from an empty ring. Events while sending are lost
+ * @note  blocking, call from a low priority task
+ * @param huart:	debug UART ex:&huart1
+ */
+void trace_dump(UART_HandleTypeDef *huart)
+{
+	uint8_t 	header[22];
+	uint8_t 	task[1 + configMAX_TASK_NAME_LEN];
+	uint32_t 	count, first, n;
+	UBaseType_t tasks;
+	const char *name;
+
+	trace_stop();
+	count = trace_head < TRACE_EVENTS ? trace_head : TRACE_EVENTS;
+	first = trace_head - count;
+	tasks = uxTaskGetSystemState(trace_tasks, TRACE_TASKS, NULL);
+
+	memcpy(header, "TRC1", 4);
+	trace_u32(&header[4], SystemCoreClock);
+	trace_u32(&header[8], configTICK_RATE_HZ);
+	trace_u32(&header[12], count);
+	trace_u32(&header[16], first);
+	header[20] = tasks;
+	header[21] = PROF_PROBES;
+	HAL_UART_Transmit(huart, header, sizeof(header), 1000);
+
+	for(UBaseType_t t = 0; t < tasks; t++){
+		memset(task, 0, sizeof(task));
+		task[0] = trace_tasks[t].xTaskNumber;
+		//the name field is not NUL terminated when the name fills it
+		memcpy(&task[1], trace_tasks[t].pcTaskName, strnlen(trace_tasks[t].pcTaskName, configMAX_TASK_NAME_LEN));
+		HAL_UART_Transmit(huart, task, sizeof(task), 1000);
+	}
+	for(int p = 0; p < PROF_PROBES; p++){
+		name = prof_name(p);
+		HAL_UART_Transmit(huart, (uint8_t *)name, strlen(name) + 1, 1000);
+	}
+
+	//oldest first, in chunks that never cross the end of the ring
+	while(count > 0){
+		n = TRACE_EVENTS - (first & TRACE_MASK);
+		if(n > count){
+			n = count;
+		}
+		if(n > TRACE_CHUNK){
+			n = TRACE_CHUNK;
+		}
+		HAL_UART_Transmit(huart, (uint8_t *)&trace_ring[first & TRACE_MASK], n * sizeof(trace_event_t), 1000);
+		first += n;
+		count -= n;
+	}
+	trace_start();
+}
@@ -0,0 +1,177 @@
+#include "uart_rx.h"
+
+/**
+ * @brief start circular DMA reception with idle line detection
+ * @param rx:		struct to configure ex:&wifi_rx
+ * @param huart:	UART with a linked DMA Rx stream in circular mode ex:&huart2
+ * @param buffer:	DMA destination buffer
+ * @param size:		buffer size in bytes
+ * @return HAL status of HAL_UART_Receive_DMA
+ */
+HAL_StatusTypeDef uart_rx_start(uart_rx_t 		  *rx,
+								UART_HandleTypeDef *huart,
+								uint8_t 		   *buffer,
+								uint16_t 			size){
+	HAL_StatusTypeDef status;
+
+	rx->huart  	   = huart;
+	rx->buffer 	   = buffer;
+	rx->size   	   = size;
+	rx->head   	   = 0;
+	rx->tail   	   = 0;
+	rx->frames 	   = 0;
+	rx->frames_read = 0;
+	rx->overruns   = 0;
+
+	status = HAL_UART_Receive_DMA(huart, buffer, size);
+	if(status != HAL_OK){
+		return status;
+	}
+
+	/* The end of a frame is signalled by one idle character on the line */
+	__HAL_UART_CLEAR_IDLEFLAG(huart);
+	__HAL_UART_ENABLE_IT(huart, UART_IT_IDLE);
+	return HAL_OK;
+}
+
+/**
+ * @brief restarts reception after a UART error, unread bytes are dropped,
+ * 		  the overrun count is kept
+ * @note  call from HAL_UART_ErrorCallback, and again from a task while it
+ * 		  fails (with that interrupt masked)
+ * @param rx:	rx struct, started before
+ * @return HAL_OK if receiving, also when the error left the DMA running,
+ * 		   the status of HAL_UART_Receive_DMA otherwise
+ */
+HAL_StatusTypeDef uart_rx_restart(uart_rx_t *rx)
+{
+	uint32_t 		  overruns = rx->overruns;
+	HAL_StatusTypeDef status;
+
+	if(rx->huart->RxState == HAL_UART_STATE_BUSY_RX){
+		return HAL_OK;
+	}
+	status 		 = uart_rx_start(rx, rx->huart, rx->buffer, rx->size);
+	rx->overruns = overruns;
+	return status;
+}
+
+/**
+ * @brief sets the callback run when new bytes arrive, so the consumer can
+ * 		  sleep instead of polling. Kept across uart_rx_start
+ * @param rx:		rx struct
+ * @param notify:	callback, NULL for none
+ * @param ctx:		passed to notify
+ */
+void uart_rx_set_notify(uart_rx_t *rx, uart_rx_notify_t notify, void *ctx)
+{
+	rx->ctx    = ctx;
+	rx->notify = notify;
+}
+
+/**
+ * @brief move head to the current DMA write position (producer side)
+ * @note  call from DMA half/full complete and idle interrupts, so the
+ * 		  DMA never completes a whole lap without being observed
+ * @param rx:	rx struct
+ */
+void uart_rx_update(uart_rx_t *rx)
+{
+	uint16_t pos  = rx->size - (uint16_t)__HAL_DMA_GET_COUNTER(rx->huart->hdmarx);
+	uint16_t head = rx->head;
+	uint16_t used, added;
+
+	if(pos >= rx->size){
+		pos = 0;
+	}
+
+	added = (uint16_t)((pos  + rx->size - head)     % rx->size);
+	used  = (uint16_t)((head + rx->size - rx->tail) % rx->size);
+
+	//unread bytes were overwritten by the DMA: the ring now holds the
+	//newest bytes, the oldest intact one right after the write position
+	if(used + added >= rx->size){
+		rx->overruns++;
+		rx->tail = (uint16_t)((pos + 1) % rx->size);
+	}
+
+	rx->head = pos;
+	if(added > 0 && rx->notify != NULL){
+		rx->notify(rx->ctx);
+	}
+}
+
+/**
+ * @brief handles idle line interrupt, must be called before HAL_UART_IRQHandler
+ * @param rx:	rx struct
+ */
+void uart_rx_irq_handler(uart_rx_t *rx)
+{
+	if(__HAL_UART_GET_FLAG(rx->huart, UART_FLAG_IDLE) &&
+	   __HAL_UART_GET_IT_SOURCE(rx->huart, UART_IT_IDLE)){
+		__HAL_UART_CLEAR_IDLEFLAG(rx->huart);
+		uart_rx_update(rx);
+		rx->frames++;
+	}
+}
+
+/**
+ * @brief number of received bytes not yet consumed
+ * @param rx:	rx struct
+ */
+uint16_t uart_rx_available(const uart_rx_t *rx)
+{
+	return (uint16_t)((rx->head + rx->size - rx->tail) % rx->size);
+}
+
+/**
+ * @brief returns the largest contiguous span of unread bytes without copying
+ * @param rx:	rx struct
+ * @param data:	set to the first unread byte inside the DMA buffer
+ * @return span length, call again after uart_rx_consume to get the wrapped part
+ */
+uint16_t uart_rx_peek(const uart_rx_t *rx, const uint8_t **data)
+{
+	uint16_t head = rx->head;
+	uint16_t tail = rx->tail;
+
+	*data = &rx->buffer[tail];
+	if(head >= tail){
+		return head - tail;
+	}
+	return rx->size - tail;
+}
+
+/**
+ * @brief releases bytes previously returned by uart_rx_peek
+ * @note  an overrun moves tail from the interrupt: the store fails if one
+ * 		  ran since the load and the release is clamped to what is left
+ * @param rx:	rx struct
+ * @param len:	number of bytes to release
+ */
+void uart_rx_consume(uart_rx_t *rx, uint16_t len)
+{
+	uint16_t tail, available, n;
+
+	do{
+		tail 	  = __LDREXH(&rx->tail);
+		available = (uint16_t)((rx->head + rx->size - tail) % rx->size);
+		n 		  = len < available ? len : available;
+	}while(__STREXH((uint16_t)((tail + n) % rx->size), &rx->tail));
+}
+
+/**
+ * @brief checks if the line went idle since the last call
+ * @param rx:	rx struct
+ * @return 1 if at least one frame ended, 0 otherwise
+ */
+uint8_t uart_rx_frame_ready(uart_rx_t *rx)
+{
+	uint32_t frames = rx->frames;
+
+	if(frames == rx->frames_read){
+		return 0;
+	}
+	rx->frames_read = frames;
+	return 1;
+}
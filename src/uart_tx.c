@@ -0,0 +1,108 @@
+#include "uart_tx.h"
+
+//starts the next descriptor from the completion interrupt. The ones the
+//HAL refuses are dropped and completed, so the queue never stalls
+static void uart_tx_start_isr(uart_tx_t *tx)
+{
+	uart_tx_desc_t *desc;
+
+	while(tx->tail != tx->head){
+		desc = &tx->queue[tx->tail];
+		if(HAL_UART_Transmit_DMA(tx->huart, (uint8_t *)desc->data, desc->len) == HAL_OK){
+			return;
+		}
+		tx->failed++;
+		if(desc->done != NULL){
+			desc->done(desc->data);
+		}
+		tx->tail = (tx->tail + 1) % UART_TX_QUEUE_SIZE;
+	}
+	tx->busy = 0;
+}
+
+/**
+ * @brief configure transmit queue
+ * @param tx:		struct to configure ex:&wifi_tx
+ * @param huart:	UART with a linked DMA Tx stream ex:&huart2
+ */
+void uart_tx_init(uart_tx_t *tx, UART_HandleTypeDef *huart)
+{
+	tx->huart 	   = huart;
+	tx->head 	   = 0;
+	tx->tail 	   = 0;
+	tx->busy 	   = 0;
+	tx->high_water = 0;
+	tx->rejected   = 0;
+	tx->failed 	   = 0;
+}
+
+/**
+ * @brief free descriptors, callers can check it before building a message
+ * @param tx:	transmit queue
+ */
+uint8_t uart_tx_free(const uart_tx_t *tx)
+{
+	return (uint8_t)((tx->tail + UART_TX_QUEUE_SIZE - tx->head - 1) % UART_TX_QUEUE_SIZE);
+}
+
+/**
+ * @brief queues a buffer for DMA transmission without copying it
+ * @note  call from task context only, a single producer per queue
+ * @param tx:	transmit queue
+ * @param data:	buffer, must stay valid until done is called
+ * @param len:	bytes to send
+ * @param done:	completion callback, runs in interrupt context, may be NULL
+ * @return 1 if queued, 0 if the queue is full (backpressure) or the HAL
+ * 		   refused to start the transfer. On 0 done is never called
+ */
+uint8_t uart_tx_send(uart_tx_t *tx, const uint8_t *data, uint16_t len, uart_tx_done_t done)
+{
+	uint8_t head = tx->head;
+	uint8_t next = (head + 1) % UART_TX_QUEUE_SIZE;
+	uint8_t used;
+
+	if(next == tx->tail){
+		tx->rejected++;
+		return 0;
+	}
+
+	tx->queue[head].data = data;
+	tx->queue[head].len  = len;
+	tx->queue[head].done = done;
+	__DMB();						//descriptor visible before the ISR can see it
+	tx->head = next;
+
+	used = (uint8_t)((next + UART_TX_QUEUE_SIZE - tx->tail) % UART_TX_QUEUE_SIZE);
+	if(used > tx->high_water){
+		tx->high_water = used;
+	}
+
+	//with no transfer running no completion interrupt can race this
+	if(!tx->busy){
+		tx->busy = 1;
+		if(HAL_UART_Transmit_DMA(tx->huart, (uint8_t *)data, len) != HAL_OK){
+			tx->head = head;
+			tx->busy = 0;
+			tx->failed++;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief ends the current descriptor and starts the next one,
+ * 		  call from HAL_UART_TxCpltCallback
+ * @param tx:	transmit queue
+ */
+void uart_tx_complete_isr(uart_tx_t *tx)
+{
+	uart_tx_desc_t *desc = &tx->queue[tx->tail];
+
+	if(desc->done != NULL){
+		desc->done(desc->data);
+	}
+	tx->tail = (tx->tail + 1) % UART_TX_QUEUE_SIZE;
+
+	uart_tx_start_isr(tx);
+}
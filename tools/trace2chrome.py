@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""Converts a trace_dump capture ('t' on the debug console) to the Chrome
+trace event format, for chrome://tracing or https://ui.perfetto.dev.
+
+    python3 tools/trace2chrome.py capture.bin [-o trace.json]
+
+capture.bin is the raw USART1 byte stream (115200 8N1), saved with any
+terminal that logs binary, ex: picocom --logfile. Console text around the
+dump is skipped; with several dumps the last one is converted (--dump picks
+another). Format of the dump in inc/trace.h.
+
+Tracks: one per task (running spans, ready/delay/wait marks, the queue and
+notify calls it made), one per interrupt (spans named by the prof probe of
+the exit), and 'sleep' for tickless idle. Queue fill levels are counters.
+
+Times: the 32 bit cycle counter is unwrapped event to event, so two events
+more than 2^32 cycles apart (44.7 s at 96 MHz) without a sleep between them
+come out too close. The counter stops in sleep; the ticks slept, from the
+TRACE_SLEEP / TRACE_WAKE arguments, are put back to a tick.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"TRC1"
+TASK_NAME_LEN = 16              # configMAX_TASK_NAME_LEN
+HEADER = struct.Struct("<4sIIIIBB")
+EVENT = struct.Struct("<IBBH")
+
+# Event types, inc/trace.h
+(TASK_IN, TASK_READY, TASK_DELAY, QUEUE_SEND, QUEUE_RECEIVE, QUEUE_BLOCK_SEND,
+ QUEUE_BLOCK_RECV, QUEUE_FAILED, NOTIFY_BLOCK, NOTIFY_GIVE, ISR_ENTER, ISR_EXIT,
+ SLEEP, WAKE) = range(14)
+
+QUEUE_OPS = {
+    QUEUE_SEND: ("send", 1),
+    QUEUE_RECEIVE: ("receive", -1),
+    QUEUE_BLOCK_SEND: ("block on send", 0),
+    QUEUE_BLOCK_RECV: ("block on receive", 0),
+    QUEUE_FAILED: ("failed", 0),
+}
+
+# Exception numbers (IPSR) of the handlers in src/stm32f4xx_it.c
+EXCEPTIONS = {
+    11: "SVCall", 14: "PendSV", 15: "SysTick", 20: "FLASH", 23: "EXTI1",
+    26: "EXTI4", 27: "DMA1_Stream0", 30: "DMA1_Stream3", 32: "DMA1_Stream5",
+    33: "DMA1_Stream6", 44: "TIM2", 47: "I2C1_EV", 48: "I2C1_ER", 51: "SPI1",
+    53: "USART1", 54: "USART2", 72: "DMA2_Stream0", 74: "DMA2_Stream2",
+    75: "DMA2_Stream3",
+}
+
+PID = 1
+SLEEP_TID = 0
+ISR_TID = 1000                  # + exception number
+
+
+class DumpError(Exception):
+    pass
+
+
+def parse(data, offset):
+    """Header, task and probe names and events of the dump at offset."""
+    if len(data) < offset + HEADER.size:
+        raise DumpError("truncated header")
+    magic, cpu_hz, tick_hz, count, lost, tasks, probes = HEADER.unpack_from(data, offset)
+    if cpu_hz == 0 or tick_hz == 0:
+        raise DumpError("bad clock rates %d / %d" % (cpu_hz, tick_hz))
+    pos = offset + HEADER.size
+
+    names = {}
+    for _ in range(tasks):
+        record = data[pos:pos + 1 + TASK_NAME_LEN]
+        if len(record) < 1 + TASK_NAME_LEN:
+            raise DumpError("truncated task table")
+        names[record[0]] = record[1:].split(b"\0")[0].decode("ascii", "replace")
+        pos += 1 + TASK_NAME_LEN
+
+    probe_names = []
+    for _ in range(probes):
+        end = data.find(b"\0", pos)
+        if end < 0:
+            raise DumpError("truncated probe names")
+        probe_names.append(data[pos:end].decode("ascii", "replace"))
+        pos = end + 1
+
+    if len(data) < pos + count * EVENT.size:
+        raise DumpError("%d events announced, %d bytes left" % (count, len(data) - pos))
+    events = [EVENT.unpack_from(data, pos + i * EVENT.size) for i in range(count)]
+    for time, kind, ident, arg in events:
+        if kind > WAKE:
+            raise DumpError("unknown event type %d" % kind)
+    return {
+        "cpu_hz": cpu_hz, "tick_hz": tick_hz, "lost": lost, "tasks": names,
+        "probes": probe_names, "events": events,
+    }
+
+
+def convert(dump):
+    """Chrome trace events of a parsed dump."""
+    cpu_hz = dump["cpu_hz"]
+    cycles_per_tick = cpu_hz / dump["tick_hz"]
+    tasks = dump["tasks"]
+    probes = dump["probes"]
+    out = []
+    isr_tracks = set()
+    task_tracks = set(tasks)
+
+    def us(cycles):
+        return cycles * 1e6 / cpu_hz
+
+    def task_name(ident):
+        return tasks.get(ident, "task %d" % ident)
+
+    def span(tid, name, start, end, args=None):
+        event = {"ph": "X", "pid": PID, "tid": tid, "name": name, "ts": us(start),
+                 "dur": us(end - start)}
+        if args:
+            event["args"] = args
+        out.append(event)
+
+    def mark(tid, name, at, args=None):
+        event = {"ph": "i", "s": "t", "pid": PID, "tid": tid, "name": name, "ts": us(at)}
+        if args:
+            event["args"] = args
+        out.append(event)
+
+    now = 0                     # Unwrapped cycles since the first event
+    last_raw = None
+    running = None              # (task, start)
+    isr_stack = []              # (exception, start)
+    sleeping = None             # (start, tick, raw counter)
+    unmatched = 0
+
+    for raw, kind, ident, arg in dump["events"]:
+        if last_raw is not None:
+            now += (raw - last_raw) & 0xFFFFFFFF
+        last_raw = raw
+        context = ISR_TID + isr_stack[-1][0] if isr_stack else (running[0] if running else SLEEP_TID)
+
+        if kind == TASK_IN:
+            if running is not None:
+                span(running[0], "running", running[1], now)
+            running = (ident, now)
+            task_tracks.add(ident)
+        elif kind == TASK_READY:
+            mark(ident, "ready", now)
+            task_tracks.add(ident)
+        elif kind == TASK_DELAY:
+            mark(ident, "delay", now)
+        elif kind == NOTIFY_BLOCK:
+            mark(ident, "wait notify", now)
+        elif kind == NOTIFY_GIVE:
+            mark(context, "notify " + task_name(ident), now)
+        elif kind in QUEUE_OPS:
+            op, change = QUEUE_OPS[kind]
+            queue = "queue %d" % ident
+            mark(context, "%s %s" % (queue, op), now, {"waiting": arg})
+            out.append({"ph": "C", "pid": PID, "name": queue, "ts": us(now),
+                        "args": {"waiting": max(0, arg + change)}})
+        elif kind == ISR_ENTER:
+            isr_stack.append((ident, now))
+            isr_tracks.add(ident)
+        elif kind == ISR_EXIT:
+            # the enter may be older than the ring
+            if isr_stack and isr_stack[-1][0] == ident:
+                start = isr_stack.pop()[1]
+                name = probes[arg] if arg < len(probes) else EXCEPTIONS.get(ident, "irq")
+                span(ISR_TID + ident, name, start, now)
+            else:
+                unmatched += 1
+            isr_tracks.add(ident)
+        elif kind == SLEEP:
+            sleeping = (now, arg, raw)
+        elif kind == WAKE and sleeping is not None:
+            start, tick, _ = sleeping
+            ticks = (arg - tick) & 0xFFFF
+            # whatever the counter did not count while stopped
+            now = max(now, start + round(ticks * cycles_per_tick))
+            span(SLEEP_TID, "sleep", start, now, {"ticks": ticks})
+            sleeping = None
+
+    if running is not None:
+        span(running[0], "running", running[1], now)
+
+    meta = [{"ph": "M", "pid": PID, "name": "process_name", "args": {"name": "STM32F411"}},
+            {"ph": "M", "pid": PID, "tid": SLEEP_TID, "name": "thread_name", "args": {"name": "sleep"}}]
+    for ident in sorted(task_tracks):
+        meta.append({"ph": "M", "pid": PID, "tid": ident, "name": "thread_name",
+                     "args": {"name": "%s (%d)" % (task_name(ident), ident)}})
+    for ident in sorted(isr_tracks):
+        meta.append({"ph": "M", "pid": PID, "tid": ISR_TID + ident, "name": "thread_name",
+                     "args": {"name": "%s irq (%d)" % (EXCEPTIONS.get(ident, "exception"), ident)}})
+    return meta + out, now, unmatched
+
+
+def main():
+    parser = argparse.ArgumentParser(description="trace_dump capture to Chrome trace JSON")
+    parser.add_argument("capture", help="raw bytes received from the debug UART")
+    parser.add_argument("-o", "--output", help="JSON file, default capture name + .json")
+    parser.add_argument("--dump", type=int, default=-1, help="dump to convert, 0 first, -1 last (default)")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        data = f.read()
+    offsets = []
+    pos = data.find(MAGIC)
+    while pos >= 0:
+        offsets.append(pos)
+        pos = data.find(MAGIC, pos + 1)
+    if not offsets:
+        sys.exit("%s: no TRC1 dump" % args.capture)
+    try:
+        offset = offsets[args.dump]
+    except IndexError:
+        sys.exit("%s: %d dumps" % (args.capture, len(offsets)))
+
+    try:
+        dump = parse(data, offset)
+    except DumpError as e:
+        sys.exit("%s: %s" % (args.capture, e))
+    events, cycles, unmatched = convert(dump)
+
+    output = args.output or args.capture.rsplit(".", 1)[0] + ".json"
+    with open(output, "w") as f:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ns",
+                   "otherData": {"cpu_hz": dump["cpu_hz"], "lost": dump["lost"]}}, f)
+    print("%s: %d events over %.3f ms, %d lost before them, %d interrupt exits without entry"
+          % (output, len(dump["events"]), cycles * 1e3 / dump["cpu_hz"], dump["lost"], unmatched))
+
+
+if __name__ == "__main__":
+    main()